@@ -68,6 +68,31 @@ written by
 #endif
 
 
+const int CChannel::m_iMaxBatch;
+
+// Convert packet header and, for control packets, the control information
+// between host and network order. Both directions are the same operation
+// apart from the function used.
+static void hton_packet(CPacket& packet, int32_t* header)
+{
+   if (packet.getFlag())
+      for (int i = 0, n = packet.getLength() / 4; i < n; ++ i)
+         *((uint32_t *)packet.m_pcData + i) = htonl(*((uint32_t *)packet.m_pcData + i));
+
+   for (int j = 0; j < 4; ++ j)
+      header[j] = htonl(header[j]);
+}
+
+static void ntoh_packet(CPacket& packet, int32_t* header)
+{
+   for (int k = 0; k < 4; ++ k)
+      header[k] = ntohl(header[k]);
+
+   if (packet.getFlag())
+      for (int l = 0, n = packet.getLength() / 4; l < n; ++ l)
+         *((uint32_t *)packet.m_pcData + l) = ntohl(*((uint32_t *)packet.m_pcData + l));
+}
+
 CChannel::CChannel():
 m_iIPversion(AF_INET),
 m_iSockAddrSize(sizeof(sockaddr_in)),
@@ -234,20 +259,8 @@ void CChannel::getPeerAddr(sockaddr* addr) const
 
 int CChannel::sendto(const sockaddr* addr, CPacket& packet) const
 {
-   // convert control information into network order
-   if (packet.getFlag())
-      for (int i = 0, n = packet.getLength() / 4; i < n; ++ i)
-         *((uint32_t *)packet.m_pcData + i) = htonl(*((uint32_t *)packet.m_pcData + i));
-
-   // convert packet header into network order
-   for (int j = 0; j < 4; ++ j)
-      packet.m_nHeader[j] = htonl(packet.m_nHeader[j]);
-   //uint32_t* p = packet.m_nHeader;
-   //for (int j = 0; j < 4; ++ j)
-   //{
-   //   *p = htonl(*p);
-   //   ++ p;
-   //}
+   // convert control information and packet header into network order
+   hton_packet(packet, packet.m_nHeader);
 
    #ifndef WIN32
       msghdr        mh;
@@ -282,22 +295,74 @@ int CChannel::sendto(const sockaddr* addr, CPacket& packet) const
    #endif
 
    // convert back into local host order
-   for (int k = 0; k < 4; ++ k)
-      packet.m_nHeader[k] = ntohl(packet.m_nHeader[k]);
-   //p = packet.m_nHeader;
-   //for (int k = 0; k < 4; ++ k)
-   //{
-   //   *p = ntohl(*p);
-   //    ++ p;
-   //}
+   ntoh_packet(packet, packet.m_nHeader);
 
-   if (packet.getFlag())
+   return res;
+}
+
+int CChannel::sendto(sockaddr* const* addr, CPacket* const* packet, int n) const
+{
+#ifdef UDT_HAVE_MMSG
+   int           sent = 0;
+   mmsghdr       mmh[m_iMaxBatch];
+   struct iovec  iov[m_iMaxBatch][2];
+
+   while (sent < n)
    {
-      for (int l = 0, n = packet.getLength() / 4; l < n; ++ l)
-         *((uint32_t *)packet.m_pcData + l) = ntohl(*((uint32_t *)packet.m_pcData + l));
+      const int batch = (n - sent) < m_iMaxBatch ? (n - sent) : m_iMaxBatch;
+
+      for (int i = 0; i < batch; ++ i)
+      {
+         CPacket& pkt = *packet[sent + i];
+
+         hton_packet(pkt, pkt.m_nHeader);
+
+         iov[i][0].iov_len  = pkt.m_PacketVector[0].iov_len;
+         iov[i][0].iov_base = pkt.m_PacketVector[0].iov_base;
+         iov[i][1].iov_len  = pkt.m_PacketVector[1].iov_len;
+         iov[i][1].iov_base = pkt.m_PacketVector[1].iov_base;
+
+         mmh[i].msg_hdr.msg_name = addr[sent + i];
+         mmh[i].msg_hdr.msg_namelen = m_iSockAddrSize;
+         mmh[i].msg_hdr.msg_iov = &iov[i][0];
+         mmh[i].msg_hdr.msg_iovlen = 2;
+         mmh[i].msg_hdr.msg_control = NULL;
+         mmh[i].msg_hdr.msg_controllen = 0;
+         mmh[i].msg_hdr.msg_flags = 0;
+         mmh[i].msg_len = 0;
+      }
+
+      // sendmmsg(2) may send fewer than requested; whatever is left over
+      // is handed to the next call. Anything that fails outright is dropped,
+      // just like a failing sendmsg(2) in the single packet version - the
+      // loss will be detected and the packet retransmitted.
+      int done = 0;
+      while (done < batch)
+      {
+         const int res = ::sendmmsg(m_iSocket, &mmh[done], batch - done, 0);
+         if (res <= 0)
+            break;
+         done += res;
+      }
+
+      for (int i = 0; i < batch; ++ i)
+      {
+         CPacket& pkt = *packet[sent + i];
+         ntoh_packet(pkt, pkt.m_nHeader);
+      }
+
+      sent += batch;
+      if (done < batch)
+         return sent - batch + done;
    }
-
-   return res;
+   return sent;
+#else
+   int sent = 0;
+   for (int i = 0; i < n; ++ i)
+      if (sendto(addr[i], *packet[i]) >= 0)
+         ++ sent;
+   return sent;
+#endif
 }
 
 int CChannel::recvfrom(sockaddr* addr, CPacket& packet) const
@@ -354,20 +419,7 @@ int CChannel::recvfrom(sockaddr* addr, CPacket& packet) const
    packet.setLength(res - CPacket::m_iPktHdrSize);
 
    // convert back into local host order
-   for (int i = 0; i < 4; ++ i)
-      packet.m_nHeader[i] = ntohl(packet.m_nHeader[i]);
-   //uint32_t* p = packet.m_nHeader;
-   //for (int i = 0; i < 4; ++ i)
-   //{
-   //   *p = ntohl(*p);
-   //   ++ p;
-   //}
-
-   if (packet.getFlag())
-   {
-      for (int j = 0, n = packet.getLength() / 4; j < n; ++ j)
-         *((uint32_t *)packet.m_pcData + j) = ntohl(*((uint32_t *)packet.m_pcData + j));
-   }
+   ntoh_packet(packet, packet.m_nHeader);
 
    return packet.getLength();
 }
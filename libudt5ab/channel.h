@@ -45,6 +45,13 @@ written by
 #include "udt.h"
 #include "packet.h"
 
+// On Linux we can send several datagrams per system call using
+// sendmmsg(2). Everywhere else the batch sendto() below falls back to
+// one sendmsg(2) per packet.
+#ifdef LINUX
+   #define UDT_HAVE_MMSG 1
+#endif
+
 
 class CChannel
 {
@@ -144,6 +151,17 @@ public:
 
    int sendto(const sockaddr* addr, CPacket& packet) const;
 
+      // Functionality:
+      //    Send a batch of packets, using as few system calls as possible.
+      // Parameters:
+      //    0) [in] addr: array of pointers to the destination addresses.
+      //    1) [in] packet: array of pointers to CPacket entities.
+      //    2) [in] n: number of packets in the batch.
+      // Returned value:
+      //    Number of packets actually sent.
+
+   int sendto(sockaddr* const* addr, CPacket* const* packet, int n) const;
+
       // Functionality:
       //    Receive a packet from the channel and record the source address.
       // Parameters:
@@ -154,6 +172,10 @@ public:
 
    int recvfrom(sockaddr* addr, CPacket& packet) const;
 
+      // Maximum number of datagrams moved per sendmmsg(2) call.
+
+   static const int m_iMaxBatch = 32;
+
 private:
    void setUDPSockOpt();
 
@@ -548,13 +548,28 @@ void CSndQueue::init(const CChannel* c, const CTimer* t)
          if (currtime < ts)
             self->m_pTimer->sleepto(ts);
 
-         // it is time to send the next pkt
-         sockaddr* addr;
-         CPacket pkt;
-         if (self->m_pSndUList->pop(addr, pkt) < 0)
+         // it is time to send the next pkt. Collect whatever else is due
+         // by now as well such that they can go out in one system call;
+         // at high rates the sender is usually behind schedule so this
+         // batches without affecting the pacing
+         sockaddr* addr[CChannel::m_iMaxBatch];
+         CPacket   pkt[CChannel::m_iMaxBatch];
+         CPacket*  ppkt[CChannel::m_iMaxBatch];
+         int       n = 0;
+
+         while ((n < CChannel::m_iMaxBatch) && (self->m_pSndUList->pop(addr[n], pkt[n]) >= 0))
+         {
+            ppkt[n] = &pkt[n];
+            ++ n;
+         }
+
+         if (0 == n)
             continue;
 
-         self->m_pChannel->sendto(addr, pkt);
+         if (1 == n)
+            self->m_pChannel->sendto(addr[0], pkt[0]);
+         else
+            self->m_pChannel->sendto(addr, ppkt, n);
       }
       else
       {
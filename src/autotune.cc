@@ -0,0 +1,278 @@
+// watch the queues of a running processing chain and adapt their capacity
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <autotune.h>
+#include <runtime.h>
+#include <evlbidebug.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+
+#include <sstream>
+#include <algorithm>
+
+#include <errno.h>
+#include <sys/time.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(autotuneexception)
+
+// A queue that was grown but did not overflow for this many
+// consecutive intervals is a candidate for shrinking
+static const unsigned int nQuietBeforeShrink = 10;
+
+
+autotune_parms::autotune_parms():
+    interval( 500 ), max_memory( 256ULL*1024*1024 )
+{}
+
+autotuner::qstate_type::qstate_type():
+    initial( 0 ), max_occ( 0 ), nquiet( 0 ), rate( 0.0 ), grown_rate( -1.0 )
+{}
+
+
+autotuner::autotuner(runtime* rte, const autotune_parms& ap):
+    rteptr( rte ), parameters( ap ), stop( false ), blocksize( 0 )
+{
+    EZASSERT2(rteptr, autotuneexception, EZINFO("no runtime given"));
+    EZASSERT2(parameters.interval>0, autotuneexception, EZINFO("the sample interval must be > 0"));
+
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+    PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+    PTHREAD2_CALL( ::pthread_create(&tid, 0, &autotuner::thread_fn, this),
+                   ::pthread_cond_destroy(&condition); ::pthread_mutex_destroy(&mutex) );
+}
+
+autotune_parms autotuner::parms( void ) const {
+    return parameters;
+}
+
+string autotuner::status( void ) {
+    ostringstream  oss;
+    mutex_locker   locker( mutex );
+
+    if( qstates.empty() )
+        return "<no transfer>";
+
+    oss << mode;
+    for(unsigned int q=0; q<qstates.size(); q++) {
+        const qstate_type&  qs = qstates[q];
+        const unsigned int  cap = qs.last.capacity;
+
+        oss << " : q" << q << "=" << cap << "/" << qs.initial << "/"
+            << (cap ? (100*qs.last.size)/cap : 0) << "%/"
+            << (unsigned long long)(qs.rate+0.5);
+    }
+    return oss.str();
+}
+
+string autotuner::remembered( void ) {
+    ostringstream  oss;
+    mutex_locker   locker( mutex );
+
+    for(remember_type::const_iterator p=memory.begin(); p!=memory.end(); p++) {
+        oss << (p==memory.begin() ? "" : " : ") << p->first << "=";
+        for(unsigned int q=0; q<p->second.size(); q++)
+            oss << (q ? "," : "") << p->second[q];
+    }
+    return oss.str();
+}
+
+autotuner::~autotuner() {
+    PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+    stop = true;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+    PTHREAD_CALL( ::pthread_join(tid, 0) );
+
+    ::pthread_cond_destroy(&condition);
+    ::pthread_mutex_destroy(&mutex);
+}
+
+void* autotuner::thread_fn(void* selfptr) {
+    autotuner*       self = (autotuner*)selfptr;
+    struct timeval   prev, now;
+    struct timespec  wakeup;
+
+    DEBUG(2, "autotuner: starting, interval=" << self->parameters.interval << "ms, "
+             << "max_memory=" << self->parameters.max_memory << "B" << endl);
+
+    ::gettimeofday(&prev, 0);
+
+    mutex_locker     locker( self->mutex );
+    while( !self->stop ) {
+        int               rv = 0;
+        unsigned long int us = prev.tv_usec + (self->parameters.interval % 1000)*1000;
+
+        wakeup.tv_sec  = prev.tv_sec + self->parameters.interval/1000 + us/1000000;
+        wakeup.tv_nsec = (us % 1000000) * 1000;
+
+        while( !self->stop && rv!=ETIMEDOUT )
+            rv = ::pthread_cond_timedwait(&self->condition, &self->mutex, &wakeup);
+        if( self->stop )
+            break;
+
+        ::gettimeofday(&now, 0);
+        try {
+            self->sample( (double)(now.tv_sec - prev.tv_sec) + ((double)now.tv_usec - (double)prev.tv_usec)/1.0e6 );
+        }
+        catch( const exception& e ) {
+            DEBUG(1, "autotuner: caught exception - " << e.what() << endl);
+        }
+        catch( ... ) {
+            DEBUG(1, "autotuner: caught unknown exception" << endl);
+        }
+        prev = now;
+    }
+    // Do not keep the last chain alive any longer than necessary
+    self->observed = chain();
+    DEBUG(2, "autotuner: done" << endl);
+    return (void*)0;
+}
+
+// Called with the mutex held
+void autotuner::sample(double dt) {
+    bool          xfer;
+    chain         c;
+    string        m;
+    unsigned int  bs;
+
+    // Get a consistent view of what the runtime's up to
+    {
+        ostringstream              oss;
+        scopedrtelock              srtl( *rteptr );
+        const constraintset_type&  sizes( rteptr->sizes );
+
+        c    = rteptr->processingchain;
+        xfer = (rteptr->transfermode!=no_transfer);
+        bs   = sizes[constraints::blocksize];
+        if( bs==constraints::unconstrained )
+            bs = rteptr->netparms.get_blocksize();
+        oss << rteptr->transfermode;
+        m = oss.str();
+    }
+
+    if( !xfer || c.nqueue()==0 ) {
+        // transfer done or not started yet. Let go of the chain
+        observed = chain();
+        qstates.clear();
+        return;
+    }
+
+    if( !(c==observed) ) {
+        // A new chain, take the initial values
+        observed  = c;
+        mode      = m;
+        blocksize = bs;
+        qstates   = qstates_type( c.nqueue() );
+        for(unsigned int q=0; q<qstates.size(); q++) {
+            qstates[q].last    = c.queue_stats(q);
+            qstates[q].initial = qstates[q].last.capacity;
+        }
+
+        // If we've seen this mode before, start from the values that we
+        // ended up with then. The memory budget still holds.
+        remember_type::const_iterator  p = memory.find(mode);
+
+        if( p!=memory.end() && p->second.size()==qstates.size() ) {
+            for(unsigned int q=0; q<qstates.size(); q++) {
+                qstate_type&             qs = qstates[q];
+                const unsigned long long add = (p->second[q]>qs.initial ? (p->second[q]-qs.initial) : 0) * (unsigned long long)blocksize;
+
+                if( add==0 || extra_bytes()+add>parameters.max_memory )
+                    continue;
+                c.queue_capacity(q, p->second[q]);
+                qs.last.capacity = p->second[q];
+                DEBUG(2, "autotuner[" << mode << "]: q" << q << " start at remembered capacity " << p->second[q] << endl);
+            }
+        }
+        return;
+    }
+    this->tune(dt);
+}
+
+// Called with the mutex held and this->observed a running chain
+void autotuner::tune(double dt) {
+    vector<unsigned int>  caps;
+
+    if( dt<=0.0 )
+        return;
+
+    for(unsigned int q=0; q<qstates.size(); q++) {
+        qstate_type&               qs = qstates[q];
+        bqueue_stats               cur = observed.queue_stats(q);
+        const unsigned long long   d_full = (cur.n_full>qs.last.n_full ? cur.n_full-qs.last.n_full : 0);
+        const unsigned long long   d_pop  = (cur.n_popped>qs.last.n_popped ? cur.n_popped-qs.last.n_popped : 0);
+
+        qs.rate    = (double)d_pop/dt;
+        qs.max_occ = std::max(qs.max_occ, cur.size);
+        qs.last    = cur;
+
+        if( d_full ) {
+            qs.nquiet = 0;
+
+            // If we grew this queue last time and the throughput did not
+            // improve, the consumer is plain too slow and a bigger queue
+            // would only postpone the overflow at the expense of memory
+            if( qs.grown_rate>=0.0 && qs.rate<=1.05*qs.grown_rate )
+                continue;
+
+            const unsigned long long budget = parameters.max_memory - std::min(parameters.max_memory, extra_bytes());
+            const unsigned long long room   = (blocksize ? budget/blocksize : 0);
+            const unsigned int       newcap = cur.capacity + (unsigned int)std::min((unsigned long long)cur.capacity, room);
+
+            if( newcap<=cur.capacity )
+                continue;
+            observed.queue_capacity(q, newcap);
+            DEBUG(2, "autotuner[" << mode << "]: q" << q << " overflowed " << d_full << "x, "
+                     << cur.capacity << " => " << newcap << endl);
+            qs.last.capacity = newcap;
+            qs.grown_rate    = qs.rate;
+            qs.max_occ       = 0;
+            continue;
+        }
+        // No overflow this interval so any growth did its job
+        qs.grown_rate = -1.0;
+        if( ++qs.nquiet<nQuietBeforeShrink || cur.capacity<=qs.initial || qs.max_occ>cur.capacity/4 )
+            continue;
+
+        const unsigned int  newcap = std::max(qs.initial, cur.capacity/2);
+
+        observed.queue_capacity(q, newcap);
+        DEBUG(2, "autotuner[" << mode << "]: q" << q << " max occupancy " << qs.max_occ << ", "
+                 << cur.capacity << " => " << newcap << endl);
+        qs.last.capacity = newcap;
+        qs.nquiet        = 0;
+        qs.max_occ       = 0;
+    }
+
+    // Keep track of what we've got for this mode
+    for(unsigned int q=0; q<qstates.size(); q++)
+        caps.push_back( qstates[q].last.capacity );
+    memory[mode] = caps;
+}
+
+unsigned long long autotuner::extra_bytes( void ) const {
+    unsigned long long  n = 0;
+
+    for(qstates_type::const_iterator p=qstates.begin(); p!=qstates.end(); p++)
+        if( p->last.capacity>p->initial )
+            n += (p->last.capacity - p->initial);
+    return n * blocksize;
+}
@@ -0,0 +1,117 @@
+// watch the queues of a running processing chain and adapt their capacity
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_AUTOTUNE_H
+#define JIVE5AB_AUTOTUNE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <chain.h>
+#include <ezexcept.h>
+
+#include <pthread.h>
+
+DECLARE_EZEXCEPT(autotuneexception)
+
+struct runtime;
+
+// Parameters of the autotuner.
+//   interval:   sample period, in milliseconds
+//   max_memory: how many bytes the tuner is allowed to add on top of what
+//               the transfer was set up with. Queue elements are accounted
+//               for as one block of the current transfer's blocksize each;
+//               the blockpools upstream grow (and shrink) on demand so
+//               this effectively bounds the amount of blocks in flight.
+struct autotune_parms {
+    unsigned int        interval;
+    unsigned long long  max_memory;
+
+    // defaults: 500ms, 256MB
+    autotune_parms();
+};
+
+// Once started, the autotuner samples the queues of the runtime's
+// processing chain every 'interval'. If a step had to wait for room in
+// its output queue the queue is grown (doubled), provided the memory
+// budget allows it and the previous growth did improve the throughput.
+// Queues which were grown but have not overflowed for a number of
+// intervals, and are mostly empty, are shrunk again, never below their
+// configured size.
+//
+// The capacities are remembered per transfer mode; a subsequent transfer
+// of the same mode (with the same chain layout) starts with the values
+// found before.
+class autotuner {
+    public:
+        autotuner(runtime* rteptr, const autotune_parms& ap);
+
+        autotune_parms  parms( void ) const;
+
+        // Human readable state:
+        //   "<transfermode> : q<n>=<capacity>/<initial>/<occupancy %>/<blocks per second> ..."
+        // and the remembered capacities "<mode>=<cap>,<cap>,..."
+        std::string     status( void );
+        std::string     remembered( void );
+
+        // Stops and joins the sampling thread.
+        ~autotuner();
+
+    private:
+        // per-queue bookkeeping
+        struct qstate_type {
+            unsigned int        initial;     // capacity the chain was built with
+            unsigned int        max_occ;     // highest occupancy seen in current interval
+            unsigned int        nquiet;      // consecutive intervals without overflow
+            double              rate;        // elements/s popped in last interval
+            double              grown_rate;  // rate at time of last growth (<0 => not grown)
+            bqueue_stats        last;
+
+            qstate_type();
+        };
+        typedef std::vector<qstate_type>                   qstates_type;
+        typedef std::map<std::string, std::vector<unsigned int> > remember_type;
+
+        runtime*         rteptr;
+        const autotune_parms parameters;
+        bool             stop;
+        pthread_t        tid;
+        pthread_mutex_t  mutex;
+        pthread_cond_t   condition;
+
+        // state of the currently observed chain
+        chain            observed;
+        std::string      mode;
+        unsigned int     blocksize;
+        qstates_type     qstates;
+        remember_type    memory;
+
+        static void* thread_fn(void* selfptr);
+        void         sample(double dt);
+        void         tune(double dt);
+        // to be called with mutex held
+        unsigned long long extra_bytes( void ) const;
+
+        // not copyable/assignable
+        autotuner();
+        autotuner(const autotuner&);
+        const autotuner& operator=(const autotuner&);
+};
+
+#endif
@@ -23,6 +23,8 @@
 #include <atomic.h>
 #include <mutex_locker.h>
 #include <evlbidebug.h>
+#include <tracering.h>
+#include <warmstart.h>
 
 #include <string.h>
 #include <limits.h>   // For UINT_MAX d'oh
@@ -50,7 +52,7 @@ struct garbage_type {
     const unsigned int nblock;
 
     garbage_type(const pool_type& pool):
-        sz( pool.nblock * pool.block_size ), tryCount( 0 ), use_cnt( pool.use_cnt ), 
+        sz( pool_memory_size(pool.block_size, pool.nblock) ), tryCount( 0 ), use_cnt( pool.use_cnt ), 
         memory( pool.memory ), nblock( pool.nblock )
     {}
 
@@ -65,7 +67,7 @@ struct garbage_type {
 
         if( usecount==0 ) {
             delete [] use_cnt;
-            delete [] memory;
+            warm_free(memory, sz);
             if( tryCount!=1 ) {
                 DEBUG(3, "garbage_type::try_delete/deleted pool sz=" << sz << " after " << tryCount << " attempts" << endl);
             }
@@ -120,6 +122,10 @@ void maybe_add_to_can( garbage_type& gt ) {
         garbagecan.push_back( gt );
 }
 
+uint64_t pool_memory_size(unsigned int bs, unsigned int nb) {
+    return ((uint64_t)bs * (uint64_t)nb) + 16;
+}
+
 // a single pool consists of both memory
 // and an array of counters
 // NOTE: we allocate 16 bytes extra because some of the 
@@ -151,8 +157,9 @@ pool_type::pool_type(unsigned int bs, unsigned int nb):
     EZASSERT2(((nb64*bs64)+16)<=(uint64_t)UINT_MAX,
               pool_error,
               EZINFO("(nblock x blocksize) + overhead > UINT_MAX! [" << nb << " x " << bs << " > " << UINT_MAX));
-    // *now* we can safely alloc memory
-    memory  = new unsigned char [(block_size * nblock) + 16];
+    // *now* we can safely alloc memory. With warm start enabled this may
+    // be the memory of an earlier pool of the same size (see warmstart.h)
+    memory  = warm_alloc(pool_memory_size(block_size, nblock));
     use_cnt = new refcount_type[nblock];
     ::memset(use_cnt, 0x0, nblock * sizeof(refcount_type));
 }
@@ -243,6 +250,7 @@ block blockpool_type::get( void ) {
     // oh dear. someone wants a block
     block                rv;
     pool_pointer_pointer oldcurpool = curpool;
+    const tracetime_type t0 = trace_now();
 
     // first: loop over all pools we manage to see if someone
     // has a free blocks
@@ -260,9 +268,13 @@ block blockpool_type::get( void ) {
     if( rv.empty() ) {
         // I guess it's safe to assume allocation from a freshly created
         // pool should always succeed ...
+        const tracetime_type  tg = trace_now();
+
         curpool = pools.insert(pools.end(), new pool_type(blocksize, nblock_p_pool));
         rv      = (*curpool)->get();
+        trace_complete("pool grow", tg, (uint64_t)blocksize*nblock_p_pool);
     }
+    trace_complete("block get", t0, blocksize);
     return rv;
 }
 
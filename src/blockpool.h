@@ -23,10 +23,16 @@
 #include <block.h>
 #include <ezexcept.h>
 
+#include <stdint.h>
+
 DECLARE_EZEXCEPT(pool_error)
 DECLARE_EZEXCEPT(blockpool_error)
 
 
+// the number of bytes of memory a pool of nb blocks of bs bytes
+// allocates (for warm_prefault(), see warmstart.h)
+uint64_t pool_memory_size(unsigned int bs, unsigned int nb);
+
 // a single pool consists of both memory
 // and an array of counters
 struct pool_type {
@@ -21,6 +21,7 @@
 #define EVLBI5A_QUEUE_H
 
 #include <queue>
+#include <vector>
 #include <iostream>
 #include <time.h>
 #include <errno.h>
@@ -32,6 +33,22 @@
 enum pop_result_type { pop_success, pop_timeout, pop_disabled };
 enum push_result_type { push_success, push_overflow, push_disabled };
 
+// Snapshot of the state of a queue, see bqueue<>::get_stats().
+// The counters are cumulative since construction of the queue; the
+// "n_full" and "n_empty" count how often a push() had to wait because
+// the queue was full c.q. a pop() had to wait because it was empty
+struct bqueue_stats {
+    unsigned int        size;
+    unsigned int        capacity;
+    unsigned long long  n_full;
+    unsigned long long  n_empty;
+    unsigned long long  n_popped;
+
+    bqueue_stats():
+        size( 0 ), capacity( 0 ), n_full( 0 ), n_empty( 0 ), n_popped( 0 )
+    {}
+};
+
 // Inside the push() and pop() methods, which are called a bazillion
 // times/second, the PTHREAD_CALL() macro is WAY to expensive. (Each
 // invocation creates a std::string + some more stuff). Great for
@@ -41,12 +58,65 @@ enum push_result_type { push_success, push_overflow, push_disabled };
 // Can't have everything - both speed & copious debug.
 #define FASTPTHREAD_CALL(p) if(p) throw pthreadexception(std::string(#p));
 
+// FIFO on a ring of elements that only grows. A std::queue (std::deque)
+// allocates and frees a chunk of memory every few elements that pass
+// through; this one stops allocating once it has held as many elements as
+// it ever will at once, which for a bqueue is at most its capacity.
+// Popped slots are reset such that, e.g., blocks are released right away.
+template <typename Element>
+class ringqueue {
+    public:
+        typedef typename std::vector<Element>::size_type size_type;
+        typedef typename std::vector<Element>::reference reference;
+
+        ringqueue():
+            head( 0 ), count( 0 )
+        {}
+
+        bool      empty( void ) const {
+            return count==0;
+        }
+        size_type size( void ) const {
+            return count;
+        }
+        reference front( void ) {
+            return ring[head];
+        }
+
+        void push( const Element& e ) {
+            if( count==ring.size() )
+                grow();
+            ring[ (head+count)%ring.size() ] = e;
+            count++;
+        }
+        void pop( void ) {
+            ring[head] = Element();
+            head       = (head+1)%ring.size();
+            count--;
+        }
+
+    private:
+        std::vector<Element>  ring;
+        size_type             head;
+        size_type             count;
+
+        // double the ring, moving the elements to the start
+        void grow( void ) {
+            std::vector<Element>  newring( ring.empty() ? 16 : 2*ring.size() );
+
+            for(size_type i=0; i<count; i++)
+                newring[i] = ring[ (head+i)%ring.size() ];
+            ring.swap( newring );
+            head = 0;
+        }
+};
+
 // An interthread queue storing up to 'capacity' elements of type 'Element'.
 // Element must be copyable and assignable.
 template <typename Element>
 class bqueue {
     public:
-        typedef std::queue<Element>            queue_type;
+        typedef ringqueue<Element>             queue_type;
         typedef typename queue_type::size_type capacity_type;
         static const capacity_type             invalid_size = (capacity_type)-1;
 
@@ -170,6 +240,32 @@ class bqueue {
             return;
         }
 
+        // change the capacity of a queue in flight. Unlike
+        // resize_enable{_push}() the queue is not cleared and the
+        // enabled state is left as is.  Shrinking below the current
+        // amount of elements is allowed; pushers will block until enough
+        // elements have been popped.
+        void set_capacity(unsigned int newcap) {
+            PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+            const bool grow = (newcap>capacity || capacity==invalid_size);
+            capacity = newcap;
+            // if there's more room now, let blocked pushers re-evaluate
+            if( grow )
+                PTHREAD_CALL( ::pthread_cond_broadcast(&condition_push) );
+            PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+        }
+
+        // fill in a snapshot of the queue's occupancy and counters
+        void get_stats(bqueue_stats* qs) {
+            PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+            qs->size     = (unsigned int)queue.size();
+            qs->capacity = (unsigned int)capacity;
+            qs->n_full   = nFull;
+            qs->n_empty  = nEmpty;
+            qs->n_popped = nPopped;
+            PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+        }
+
         // enable the pop end of the queue only
         void enable_pop_only() {
             // need mutex to safely change our state
@@ -199,6 +295,8 @@ class bqueue {
 
             // wait until we can either push OR the queue is disabled
             //   (if necessary)
+            if( enable_push && queue.size()>=capacity )
+                nFull++;
             while( enable_push && queue.size()>=capacity )
                 FASTPTHREAD_CALL( ::pthread_cond_wait(&condition_push, &mutex) );
 
@@ -231,7 +329,7 @@ class bqueue {
         //   If there is no room, will return push_overflow.
         //   Otherwise, the element is put onto the queueu
         //   and push_success is returned.
-        bool try_push( const Element& b ) {
+        push_result_type try_push( const Element& b ) {
             push_result_type ret;
             // first things first ...
             FASTPTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
@@ -273,6 +371,8 @@ class bqueue {
 
             // wait until we can pop or until queue is disabled
             //   (if necessary)
+            if( enable_pop && queue.empty() )
+                nEmpty++;
             while( enable_pop && queue.empty() )
                 FASTPTHREAD_CALL( ::pthread_cond_wait(&condition_pop, &mutex) );
 
@@ -282,6 +382,7 @@ class bqueue {
             if( (did_pop=enable_pop)==true ) {
                 b = queue.front();
                 queue.pop();
+                nPopped++;
             }
             // take care of delayed disable: if enable_push=false and
             // queue.empty() => possibly delayed disable in effect.
@@ -330,6 +431,8 @@ class bqueue {
             // wait for pop or until queue is disabled
             //   (if necessary)
             int timed = 0;
+            if( enable_pop && queue.empty() )
+                nEmpty++;
             while( enable_pop && queue.empty() && timed != ETIMEDOUT) {
                 PTHREAD_TIMEDWAIT( (timed = ::pthread_cond_timedwait(&condition_pop, &mutex, &absolute_time)), if ( ::pthread_mutex_unlock(&mutex) ) PTINFO(" (in cleanup: mutex unlocking failed)") ; );
             }
@@ -343,6 +446,7 @@ class bqueue {
                 if ( !queue.empty()) {
                     b = queue.front();
                     queue.pop();
+                    nPopped++;
                     result = pop_success;
                 }
                 else {
@@ -398,6 +502,7 @@ class bqueue {
                 else {
                     b = queue.front();
                     queue.pop();
+                    nPopped++;
                     result = pop_success;
                 }
             }
@@ -543,6 +648,10 @@ class bqueue {
         pthread_cond_t         condition_push;
         pthread_mutex_t        mutex;
         capacity_type          capacity;
+        // statistics, see bqueue_stats
+        unsigned long long     nFull;
+        unsigned long long     nEmpty;
+        unsigned long long     nPopped;
 
         // init with capacity 'cap'
         // Note: '0' is a valid size.
@@ -551,6 +660,9 @@ class bqueue {
             enable_push   = enable_pop = (capacity!=invalid_size);
             nPush         = 0;
             nPop          = 0;
+            nFull         = 0;
+            nEmpty        = 0;
+            nPopped       = 0;
 
             PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
             PTHREAD_CALL( ::pthread_cond_init(&condition_pop, 0) ); 
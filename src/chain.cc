@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/types.h>
+#include <time.h>
 
 using namespace std;
 
@@ -77,6 +78,45 @@ bool chain::empty(void) const {
     return _chain->empty();
 }
 
+bool chain::operator==(const chain& other) const {
+    return (const void*)_chain==(const void*)other._chain;
+}
+
+unsigned int chain::nqueue(void) const {
+    return (_chain->closed ? (unsigned int)_chain->queues.size() : 0);
+}
+
+bqueue_stats chain::queue_stats(unsigned int q) const {
+    bqueue_stats  qs;
+
+    EZASSERT2(q<this->nqueue(), chainexcept, EZINFO("queue #" << q << " does not exist"));
+    _chain->queues[q]->getstats( &qs );
+    return qs;
+}
+
+double chain::cputime(stepid s) {
+    double              rv = 0.0;
+    struct timespec     ts;
+    clockid_t           cid;
+    mutex_locker        locker( _chain->mutex );
+
+    // Once joining has started the threads may be gone
+    if( !_chain->running || _chain->joining || s>=_chain->steps.size() )
+        return rv;
+
+    const tid_type&  threads( _chain->steps[s]->threads );
+    for(tid_type::const_iterator curtid=threads.begin(); curtid!=threads.end(); curtid++)
+        if( ::pthread_getcpuclockid(**curtid, &cid)==0 && ::clock_gettime(cid, &ts)==0 )
+            rv += (double)ts.tv_sec + (double)ts.tv_nsec/1.0e9;
+    return rv;
+}
+
+void chain::queue_capacity(unsigned int q, unsigned int newcap) {
+    EZASSERT2(q<this->nqueue(), chainexcept, EZINFO("queue #" << q << " does not exist"));
+    EZASSERT2(newcap>0, chainexcept, EZINFO("queue capacity must be > 0"));
+    _chain->queues[q]->setcapacity( newcap );
+}
+
 chain::~chain() throw(pthreadexception) { }
 
 
@@ -132,6 +172,8 @@ chain::internalq::~internalq() {
     disable.erase();
     delayed_disable.erase();
     qdeleter.erase();
+    setcapacity.erase();
+    getstats.erase();
 }
 
 // The stepfn_type: combines a pointer to an actual step
@@ -31,6 +31,7 @@
 #include <pthreadcall.h>
 #include <countedpointer.h>
 #include <mutex_locker.h>
+#include <tracering.h>
 
 #if 1
 // Make it compile with GCC >=4.3 and <4.3 as well as clang500.2.79
@@ -235,17 +236,24 @@ void assign(T* valptr, T val) {
     *valptr = val;
 }
 
-// InputQueues only allow popping
+// InputQueues only allow popping. The time spent in push/pop, i.e.
+// waiting for the neighbouring step, is traced (see tracering.h)
 template <typename Element>
 struct inq_type {
     friend class chain;
 
     bool pop(Element& e) {
-        return qptr->pop(e);
+        const tracetime_type  t0 = trace_now();
+        const bool            rv = qptr->pop(e);
+        trace_complete("pop", t0);
+        return rv;
     }
 
     pop_result_type pop(Element& e, const struct timespec& absolute_time) {
-        return qptr->pop(e, absolute_time);
+        const tracetime_type   t0 = trace_now();
+        const pop_result_type  rv = qptr->pop(e, absolute_time);
+        trace_complete("pop", t0);
+        return rv;
     }
 
 //    private:
@@ -260,7 +268,14 @@ struct outq_type {
     friend class chain;
 
     bool push(const Element& e) {
-        return qptr->push(e);
+        const tracetime_type  t0 = trace_now();
+        const bool            rv = qptr->push(e);
+        trace_complete("push", t0);
+        return rv;
+    }
+
+    push_result_type try_push(const Element& e) {
+        return qptr->try_push(e);
     }
 
     //private:
@@ -469,6 +484,10 @@ class chain {
             thunk_type   disable;
             thunk_type   delayed_disable;
             thunk_type   qdeleter;
+            // Curried "->set_capacity(unsigned int)" and
+            // "->get_stats(bqueue_stats*)"
+            curry_type   setcapacity;
+            curry_type   getstats;
 
             ~internalq();
 
@@ -744,6 +763,8 @@ class chain {
             iq->enable          = makethunk(&qtype::enable, q);
             iq->disable         = makethunk(&qtype::disable, q);
             iq->delayed_disable = makethunk(&qtype::delayed_disable, q);
+            iq->setcapacity     = makethunk(&qtype::set_capacity, q);
+            iq->getstats        = makethunk(&qtype::get_stats, q);
 
 
             // And the internal step. Because this is the
@@ -861,6 +882,8 @@ class chain {
             iq->disable         = makethunk(&qtype::disable, newq);
             iq->qdeleter        = makethunk(&deleter<qtype>, newq);
             iq->delayed_disable = makethunk(&qtype::delayed_disable, newq);
+            iq->setcapacity     = makethunk(&qtype::set_capacity, newq);
+            iq->getstats        = makethunk(&qtype::get_stats, newq);
 
             // Now the internal step.
             // This step created a new queue (its output).
@@ -1316,6 +1339,26 @@ class chain {
        // Returns wether the chain is empty (== a default chain)
         bool empty( void ) const;
 
+        // Two chain objects are equal if they refer to the same
+        // (shared) chain
+        bool operator==( const chain& other ) const;
+
+        // Inspect/modify the queues in between the steps whilst the chain
+        // is running. Queue #n is the output queue of step #n. 
+        // The set of queues is fixed once the chain is closed so these do
+        // not take the chain's mutex; nqueue() returns 0 for a chain that
+        // isn't closed yet.
+        unsigned int nqueue( void ) const;
+        bqueue_stats queue_stats( unsigned int q ) const;
+        // Changes the capacity of the queue without disturbing its
+        // contents. The new capacity persists across subsequent run()s.
+        void         queue_capacity( unsigned int q, unsigned int newcap );
+
+        // CPU time (seconds) used so far by the threads executing step
+        // 's'. Only available whilst the chain is running; returns 0
+        // otherwise or for threads whose CPU clock could not be read.
+        double       cputime( stepid s );
+
         ~chain() throw(pthreadexception);
     private:
 
@@ -18,6 +18,9 @@
 //          P.O. Box 2
 //          7990 AA Dwingeloo
 #include <chainstats.h>
+#include <tracering.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
 
 using namespace std;
 
@@ -31,7 +34,41 @@ statentry_type::statentry_type(const string& nm, int64_t c):
     stepname( nm ), count( c )
 {}
 
+int64_t statentry_type::value( void ) const {
+    int64_t  v = 0;
+    return count.sum( v );
+}
+
+chainstats_type::chainstats_type() {
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+}
+
+chainstats_type::chainstats_type(const chainstats_type& other) {
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+    mutex_locker  locker( other.mutex );
+    statistics = other.statistics;
+}
+
+const chainstats_type& chainstats_type::operator=(const chainstats_type& other) {
+    if( this==&other )
+        return *this;
+    // Never hold both mutexes
+    statsmap_type  tmp;
+    {
+        mutex_locker  locker( other.mutex );
+        tmp = other.statistics;
+    }
+    mutex_locker  locker( mutex );
+    statistics.swap( tmp );
+    return *this;
+}
+
+chainstats_type::~chainstats_type() {
+    ::pthread_mutex_destroy(&mutex);
+}
+
 void chainstats_type::init(chain::stepid id, const string& name, int64_t n) {
+    mutex_locker             locker( mutex );
     statsmap_type::iterator  statptr = statistics.find(id);
 
     if( statptr!=statistics.end() && statptr->second.stepname!=name ) {
@@ -40,24 +77,36 @@ void chainstats_type::init(chain::stepid id, const string& name, int64_t n) {
     }
     if( statptr==statistics.end() )
         statistics[id] = statentry_type(name, n);
+    // Steps register from their own thread(s)
+    trace_thread_name( name );
 }
 
 void chainstats_type::add(chain::stepid id, int64_t amount) {
+    mutex_locker  locker( mutex );
     EZASSERT2(statistics.find(id)!=statistics.end(), chainstatistics,
               EZINFO("No entry for step #" << id << " present?!"));
-    statistics[id].count += amount;
+    statistics[id].count.shard() += amount;
 }
 
 counter_type& chainstats_type::counter(chain::stepid id) {
     static counter_type     dummy;
+    mutex_locker            locker( mutex );
     statsmap_type::iterator entry = statistics.find(id);
 
     if( entry!=statistics.end() )
-        return entry->second.count;
+        return entry->second.count.shard();
     return dummy;
 }
 
+int64_t chainstats_type::value(chain::stepid id) const {
+    mutex_locker    locker( mutex );
+    const_iterator  entry = statistics.find(id);
+
+    return (entry!=statistics.end() ? entry->second.value() : 0);
+}
+
 void chainstats_type::clear( void ) {
+    mutex_locker  locker( mutex );
     statistics.clear();
 }
 
@@ -27,23 +27,37 @@
 #include <counter.h>
 
 #include <stdint.h> // for [u]int<N>_t  types
+#include <pthread.h>
 
 DECLARE_EZEXCEPT(chainstatistics)
 
 // Keep one of these per step in the chain
+// The counter is sharded such that multiple threads executing the same
+// step do not fight over it; value() adds up the shards
 struct statentry_type {
-    std::string      stepname;
-    counter_type count;
+    std::string                 stepname;
+    sharded_type<counter_type>  count;
 
     statentry_type();
     statentry_type(const std::string& nm, int64_t c);
+
+    int64_t value( void ) const;
 };
 
 
+// The steps add their entries from their own threads, under whichever
+// lock they like, and anyone may read the counters at any time, so the map
+// is protected by a mutex of its own. Iterating is not protected: only
+// iterate over a copy (copying takes the mutex).
 struct chainstats_type {
     typedef std::map<chain::stepid, statentry_type> statsmap_type;
     typedef statsmap_type::const_iterator const_iterator; 
 
+    chainstats_type();
+    chainstats_type(const chainstats_type& other);
+    const chainstats_type& operator=(const chainstats_type& other);
+    ~chainstats_type();
+
     // initializes an entry for step <id>.
     // set the name of a step and an optional inital countervalue
     // (defaults to 0)
@@ -58,8 +72,16 @@ struct chainstats_type {
     //
     // The dummy counter is shared between everyone who requests the counter
     // for a non-existing step.
+    //
+    // Each call returns a different shard of the step's counter (see
+    // sharded_type<> in counter.h) so call this once per thread and keep
+    // the reference. To read the counter use "value()" below.
     counter_type& counter(chain::stepid id);
 
+    // The sum of all shards of the counter of step <id>; 0 if the step
+    // has no entry
+    int64_t value(chain::stepid id) const;
+
     // add <amount> to the counter for step <id>
     void add(chain::stepid id, int64_t amount);
 
@@ -71,7 +93,8 @@ struct chainstats_type {
     const_iterator end( void ) const;
 
     private:
-        statsmap_type  statistics;
+        statsmap_type            statistics;
+        mutable pthread_mutex_t  mutex;
 };
 
 #endif
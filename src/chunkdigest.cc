@@ -0,0 +1,399 @@
+// per-range digests of FlexBuff chunks, for verifying/resuming transfers
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <chunkdigest.h>
+#include <evlbidebug.h>
+#include <stringutil.h>
+#include <threadutil.h>
+
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+    #include <sys/xattr.h>
+#endif
+
+using namespace std;
+
+#ifdef O_LARGEFILE
+    #define LARGEFILEFLAG  O_LARGEFILE
+#else
+    #define LARGEFILEFLAG  0
+#endif
+
+const off_t chunkdigest_type::defaultRangeSize = 16*1024*1024;
+
+byterange_type::byterange_type():
+    offset( 0 ), length( 0 )
+{}
+
+byterange_type::byterange_type(off_t o, off_t l):
+    offset( o ), length( l )
+{}
+
+chunkdigest_type::chunkdigest_type():
+    rangeSize( defaultRangeSize ), size( 0 )
+{}
+
+string chunkdigest_type::toString( void ) const {
+    ostringstream  oss;
+
+    oss << hex << rangeSize << "/" << size << "/";
+    for(vector<uint64_t>::const_iterator p=digest.begin(); p!=digest.end(); p++)
+        oss << (p==digest.begin() ? "" : ",") << *p;
+    return oss.str();
+}
+
+bool chunkdigest_type::fromString(const string& s) {
+    uint64_t                       rs, sz, d;
+    vector<uint64_t>               dg;
+    const vector<string>           parts = ::split(s, '/');
+
+    if( parts.size()!=3 ||
+        ::sscanf(parts[0].c_str(), "%" SCNx64, &rs)!=1 || rs==0 ||
+        ::sscanf(parts[1].c_str(), "%" SCNx64, &sz)!=1 )
+        return false;
+
+    const vector<string>  digests = ::split(parts[2], ',', true);
+
+    for(vector<string>::const_iterator p=digests.begin(); p!=digests.end(); p++) {
+        if( ::sscanf(p->c_str(), "%" SCNx64, &d)!=1 )
+            return false;
+        dg.push_back( d );
+    }
+    // Must have one digest per range, or none at all if only the size
+    // is known
+    if( !dg.empty() && dg.size()!=(sz+rs-1)/rs )
+        return false;
+    rangeSize = (off_t)rs;
+    size      = (off_t)sz;
+    digest.swap( dg );
+    return true;
+}
+
+
+//
+//  XXH64, after the reference implementation by Yann Collet
+//  (https://github.com/Cyan4973/xxHash, BSD 2-clause license)
+//
+static const uint64_t prime64_1 = 0x9E3779B185EBCA87ull;
+static const uint64_t prime64_2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t prime64_3 = 0x165667B19E3779F9ull;
+static const uint64_t prime64_4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t prime64_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl64(uint64_t x, unsigned int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// The digest is defined on little endian words
+static inline uint64_t read64(const unsigned char* p) {
+    return  (uint64_t)p[0]        | ((uint64_t)p[1] << 8)  | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * prime64_2;
+    acc  = rotl64(acc, 31);
+    return acc * prime64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * prime64_1 + prime64_4;
+}
+
+uint64_t xxh64(const void* data, size_t n, uint64_t seed) {
+    const unsigned char*  p   = (const unsigned char*)data;
+    const unsigned char*  end = p + n;
+    uint64_t              h;
+
+    if( n>=32 ) {
+        const unsigned char* const limit = end - 32;
+        uint64_t                   v1 = seed + prime64_1 + prime64_2;
+        uint64_t                   v2 = seed + prime64_2;
+        uint64_t                   v3 = seed;
+        uint64_t                   v4 = seed - prime64_1;
+
+        do {
+            v1 = xxh64_round(v1, read64(p));    p += 8;
+            v2 = xxh64_round(v2, read64(p));    p += 8;
+            v3 = xxh64_round(v3, read64(p));    p += 8;
+            v4 = xxh64_round(v4, read64(p));    p += 8;
+        } while( p<=limit );
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = seed + prime64_5;
+    }
+    h += (uint64_t)n;
+
+    for( ; p+8<=end; p+=8) {
+        h ^= xxh64_round(0, read64(p));
+        h  = rotl64(h, 27) * prime64_1 + prime64_4;
+    }
+    if( p+4<=end ) {
+        h ^= (uint64_t)read32(p) * prime64_1;
+        h  = rotl64(h, 23) * prime64_2 + prime64_3;
+        p += 4;
+    }
+    for( ; p<end; p++) {
+        h ^= (uint64_t)(*p) * prime64_5;
+        h  = rotl64(h, 11) * prime64_1;
+    }
+    h ^= h >> 33;
+    h *= prime64_2;
+    h ^= h >> 29;
+    h *= prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+chunkdigest_type chunkdigest_compute(const void* data, size_t n, off_t rangeSize) {
+    chunkdigest_type      cd;
+    const unsigned char*  p = (const unsigned char*)data;
+
+    cd.rangeSize = rangeSize;
+    cd.size      = (off_t)n;
+    for(size_t done=0; done<n; done+=(size_t)rangeSize)
+        cd.digest.push_back( xxh64(p+done, std::min(n-done, (size_t)rangeSize)) );
+    return cd;
+}
+
+
+// What is stored in the extended attribute. The file is local so native
+// byte order will do; the digests follow this header
+#if defined(__linux__)
+static const char* const xattrName = "user.jive5ab.xxh64";
+
+struct stored_digest_type {
+    uint64_t  rangeSize;
+    uint64_t  size;
+    int64_t   mtime_sec;
+    int64_t   mtime_nsec;
+};
+
+static void fill_stored(stored_digest_type& sd, const struct stat& st) {
+    sd.size       = (uint64_t)st.st_size;
+    sd.mtime_sec  = (int64_t)st.st_mtim.tv_sec;
+    sd.mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+}
+#endif
+
+void chunkdigest_store(int fd, const chunkdigest_type& cd) {
+#if defined(__linux__)
+    struct stat          st;
+    stored_digest_type   sd;
+
+    if( ::fstat(fd, &st)!=0 || st.st_size!=cd.size )
+        return;
+    fill_stored(sd, st);
+    sd.rangeSize = (uint64_t)cd.rangeSize;
+
+    string   value( (const char*)&sd, sizeof(sd) );
+    if( !cd.digest.empty() )
+        value.append( (const char*)&cd.digest[0], cd.digest.size()*sizeof(uint64_t) );
+
+    if( ::fsetxattr(fd, xattrName, value.data(), value.size(), 0)!=0 )
+        DEBUG(4, "chunkdigest_store: not stored - " << evlbi5a::strerror(errno) << endl);
+#else
+    (void)fd;
+    (void)cd;
+#endif
+}
+
+void chunkdigest_invalidate(int fd) {
+#if defined(__linux__)
+    ::fremovexattr(fd, xattrName);
+#else
+    (void)fd;
+#endif
+}
+
+// Retrieve the stored digest if it still describes the file. A rangeSize
+// of 0 accepts whatever range size the digest was taken with
+static bool chunkdigest_stored(int fd, off_t rangeSize, chunkdigest_type& cd) {
+#if defined(__linux__)
+    char                 buf[ 4096 ];
+    ssize_t              n;
+    struct stat          st;
+    stored_digest_type   sd, cur;
+
+    if( ::fstat(fd, &st)!=0 || (n=::fgetxattr(fd, xattrName, buf, sizeof(buf)))<(ssize_t)sizeof(sd) )
+        return false;
+    ::memcpy(&sd, buf, sizeof(sd));
+    fill_stored(cur, st);
+
+    const size_t  ndigest = (size_t)(n - sizeof(sd))/sizeof(uint64_t);
+
+    if( sd.rangeSize==0 || (rangeSize>0 && sd.rangeSize!=(uint64_t)rangeSize) || sd.size!=cur.size ||
+        sd.mtime_sec!=cur.mtime_sec || sd.mtime_nsec!=cur.mtime_nsec ||
+        ndigest!=(size_t)((sd.size+sd.rangeSize-1)/sd.rangeSize) )
+        return false;
+    cd.rangeSize = (off_t)sd.rangeSize;
+    cd.size      = st.st_size;
+    cd.digest.resize( ndigest );
+    if( ndigest )
+        ::memcpy(&cd.digest[0], buf+sizeof(sd), ndigest*sizeof(uint64_t));
+    return true;
+#else
+    (void)fd;
+    (void)rangeSize;
+    (void)cd;
+    return false;
+#endif
+}
+
+// Digest of the 'len' bytes at 'pos' in the file
+static bool digest_range(int fd, off_t pos, size_t len, vector<unsigned char>& buf, uint64_t& d) {
+    ssize_t  nr = 0;
+
+    buf.resize( std::max(buf.size(), len) );
+    for(size_t done=0; done<len; done+=(size_t)nr)
+        if( (nr=::pread(fd, &buf[done], len-done, pos+(off_t)done))<=0 )
+            return false;
+    d = xxh64(&buf[0], len);
+    return true;
+}
+
+bool chunkdigest_peek(const string& path, off_t rangeSize, chunkdigest_type& cd) {
+    int    fd;
+    bool   rv;
+
+    if( (fd=::open(path.c_str(), O_RDONLY|LARGEFILEFLAG))<0 )
+        return false;
+    rv = chunkdigest_stored(fd, rangeSize, cd);
+    ::close(fd);
+    return rv;
+}
+
+bool chunkdigest_get(const string& path, off_t rangeSize, chunkdigest_type& cd) {
+    int                    fd;
+    off_t                  sz;
+    bool                   ok = true;
+    chunkdigest_type       rv;
+    vector<unsigned char>  buf;
+
+    if( (fd=::open(path.c_str(), O_RDONLY|LARGEFILEFLAG))<0 )
+        return false;
+    if( chunkdigest_stored(fd, rangeSize, cd) ) {
+        ::close(fd);
+        return true;
+    }
+    if( (sz=::lseek(fd, 0, SEEK_END))<0 ) {
+        ::close(fd);
+        return false;
+    }
+    DEBUG(4, "chunkdigest_get: computing digest of " << path << endl);
+#if defined(__linux__)
+    ::posix_fadvise(fd, 0, sz, POSIX_FADV_SEQUENTIAL);
+#endif
+    rv.rangeSize = rangeSize;
+    rv.size      = sz;
+    rv.digest.resize( (size_t)((sz+rangeSize-1)/rangeSize) );
+    for(size_t i=0; ok && i<rv.digest.size(); i++) {
+        const off_t  pos = (off_t)i * rangeSize;
+
+        ok = digest_range(fd, pos, (size_t)std::min(rangeSize, sz-pos), buf, rv.digest[i]);
+    }
+    if( ok ) {
+        chunkdigest_store(fd, rv);
+        cd = rv;
+    } else {
+        DEBUG(-1, "chunkdigest_get: failed to read " << path << " - " << evlbi5a::strerror(errno) << endl);
+    }
+    ::close(fd);
+    return ok;
+}
+
+bool chunkdigest_load(int fd, chunkdigest_type& cd) {
+    return chunkdigest_stored(fd, 0, cd);
+}
+
+void chunkdigest_update(int fd, const chunkdigest_type& before, off_t offset, off_t length) {
+    off_t                  sz;
+    bool                   ok = true;
+    chunkdigest_type       rv( before );
+    vector<unsigned char>  buf;
+
+    if( (sz=::lseek(fd, 0, SEEK_END))<0 )
+        return;
+    // Without a valid digest from before, all of it is read
+    if( rv.digest.empty() ) {
+        rv.rangeSize = chunkdigest_type::defaultRangeSize;
+        rv.size      = 0;
+        offset       = 0;
+        length       = sz;
+    }
+    // Ranges from where the old and new size differ must be done too
+    const off_t   rs      = rv.rangeSize;
+    const size_t  nOld    = rv.digest.size();
+    const size_t  firstSz = (rv.size==sz ? (size_t)-1 : (size_t)(std::min(rv.size, sz)/rs));
+
+    rv.size = sz;
+    rv.digest.resize( (size_t)((sz+rs-1)/rs) );
+    for(size_t i=0; ok && i<rv.digest.size(); i++) {
+        const off_t  pos = (off_t)i * rs;
+
+        if( i<nOld && i<firstSz && (pos+rs<=offset || pos>=offset+length) )
+            continue;
+        ok = digest_range(fd, pos, (size_t)std::min(rs, sz-pos), buf, rv.digest[i]);
+    }
+    if( ok )
+        chunkdigest_store(fd, rv);
+    else
+        DEBUG(-1, "chunkdigest_update: failed to read back - " << evlbi5a::strerror(errno) << endl);
+}
+
+byterangelist_type chunkdigest_diff(const chunkdigest_type& local, const chunkdigest_type& remote) {
+    byterangelist_type  rv;
+
+    if( local.rangeSize!=remote.rangeSize || remote.size>local.size ) {
+        rv.push_back( byterange_type(0, local.size) );
+        return rv;
+    }
+    for(size_t i=0; i<local.digest.size(); i++) {
+        const off_t  offset = (off_t)i * local.rangeSize;
+        const off_t  length = std::min(local.rangeSize, local.size-offset);
+
+        // the remote range must exist, be as long and have the same digest
+        if( offset+length<=remote.size && i<remote.digest.size() && remote.digest[i]==local.digest[i] )
+            continue;
+        if( !rv.empty() && rv.back().offset+rv.back().length==offset )
+            rv.back().length += length;
+        else
+            rv.push_back( byterange_type(offset, length) );
+    }
+    return rv;
+}
@@ -0,0 +1,104 @@
+// per-range digests of FlexBuff chunks, for verifying/resuming transfers
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_CHUNKDIGEST_H
+#define JIVE5AB_CHUNKDIGEST_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// The rsync protocol (vbs2net, the copy engine) compares chunks by their
+// digest: the chunk is cut in ranges of 'rangeSize' bytes (the last one
+// may be shorter) and of each range the 64-bit xxHash (XXH64, seed 0) is
+// taken. Only the ranges whose digest differs need to be sent again, so
+// a partly written chunk is completed rather than sent again in full.
+//
+// Computing the digest of a chunk means reading it, so the writers store
+// the digest of what they've written with the file, in the extended
+// attribute "user.jive5ab.xxh64", together with the size and modification
+// time of the file; a digest whose file has been changed since is not
+// used. Where extended attributes are not supported the digest is
+// computed each time it is needed.
+struct byterange_type {
+    off_t   offset;
+    off_t   length;
+
+    byterange_type();
+    byterange_type(off_t o, off_t l);
+};
+typedef std::list<byterange_type>  byterangelist_type;
+
+struct chunkdigest_type {
+    // 16MB
+    static const off_t     defaultRangeSize;
+
+    off_t                  rangeSize;
+    off_t                  size;
+    std::vector<uint64_t>  digest;
+
+    chunkdigest_type();
+
+    // "<rangeSize>/<size>/<digest 0>,<digest 1>,..." (numbers in hex)
+    // Without digests only the size of the chunk is known
+    // fromString() returns false if 's' is not of that form
+    std::string  toString( void ) const;
+    bool         fromString(const std::string& s);
+};
+
+uint64_t         xxh64(const void* data, size_t n, uint64_t seed = 0);
+
+// Digest of 'n' bytes of chunk data in memory
+chunkdigest_type chunkdigest_compute(const void* data, size_t n, off_t rangeSize = chunkdigest_type::defaultRangeSize);
+
+// Store the digest of the data just written to 'fd' with the file.
+// Failure to do so is not an error; the digest is then computed when
+// needed.
+void             chunkdigest_store(int fd, const chunkdigest_type& cd);
+
+// Get the digest of the file at 'path', from what was stored with the
+// file if that is still valid or else by reading the file (and storing
+// the result). Returns false if the file could not be read.
+bool             chunkdigest_get(const std::string& path, off_t rangeSize, chunkdigest_type& cd);
+
+// Only get the digest that was stored with the file at 'path'; the file
+// is never read. Returns false if there is none or it's no longer valid.
+bool             chunkdigest_peek(const std::string& path, off_t rangeSize, chunkdigest_type& cd);
+
+// Forget the stored digest
+void             chunkdigest_invalidate(int fd);
+
+// After writing 'length' bytes at 'offset' in place, bring the digest
+// stored with 'fd' (opened read/write) up to date. 'before' is what
+// chunkdigest_load() returned before the write, if it returned true;
+// then only the ranges written to (or beyond the old end) are read back.
+// Otherwise pass a default chunkdigest_type and the whole file is read.
+bool             chunkdigest_load(int fd, chunkdigest_type& cd);
+void             chunkdigest_update(int fd, const chunkdigest_type& before, off_t offset, off_t length);
+
+// The byte ranges of the chunk described by 'local' that must be sent to
+// turn the chunk described by 'remote' into it. Adjacent ranges are
+// merged. If the remote chunk is larger or was cut in ranges of a
+// different size the whole chunk is returned.
+byterangelist_type chunkdigest_diff(const chunkdigest_type& local, const chunkdigest_type& remote);
+
+#endif
@@ -0,0 +1,294 @@
+// execute control commands in the background
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <cmdexecutor.h>
+#include <mk5_exception.h>
+#include <evlbidebug.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <threadutil.h>
+#include <mountpoint.h>
+#include <dosyscall.h>
+
+#include <set>
+#include <sstream>
+#include <algorithm>
+#include <exception>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define QRY(q)  ((q?"?":"="))
+
+DEFINE_EZEXCEPT(cmdexecutorexception)
+
+// Number of most recent command latencies the percentiles are computed from
+static const unsigned int  nLatency   = 1024;
+
+static double delta_t(const struct timeval& a, const struct timeval& b) {
+    return (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_usec - a.tv_usec)/1.0e6;
+}
+
+
+cmdexec_job::cmdexec_job(int f, bool q, const vector<string>& a, mk5cmd c, runtime* r, const struct timeval& t):
+    fd( f ), qry( q ), args( a ), fn( c ), rteptr( r ), received( t )
+{}
+
+
+// The queued jobs, the runtimes that have a worker, the runtimes that have
+// a job executing and the finished jobs; all protected by the mutex. Each
+// runtime with jobs gets one detached worker, which executes that
+// runtime's jobs in order and leaves when there are none left.
+struct cmdexecutor_type {
+    typedef list<cmdexec_job>       jobs_type;
+    typedef set<const runtime*>     runtimes_type;
+
+    bool             stop;
+    unsigned int     nWorker;
+    jobs_type        queue;
+    jobs_type        finished;
+    runtimes_type    workers;
+    runtimes_type    executing;
+    int              notify[2];
+    pthread_mutex_t  mutex;
+    pthread_cond_t   condition;
+
+    // latency statistics
+    uint64_t         nCommand;
+    uint64_t         nBackground;
+    unsigned int     nextLatency;
+    vector<double>   latency;
+
+    cmdexecutor_type():
+        stop( false ), nWorker( 0 ), nCommand( 0 ), nBackground( 0 ), nextLatency( 0 )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+        PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+        ASSERT2_ZERO( ::pipe(notify), SCINFO("failed to create notification pipe") );
+        // Workers must never block on notifying; one byte in the pipe is
+        // enough to wake up the poll loop
+        ASSERT_COND( ::fcntl(notify[0], F_SETFL, O_NONBLOCK)==0 );
+        ASSERT_COND( ::fcntl(notify[1], F_SETFL, O_NONBLOCK)==0 );
+    }
+
+    // mutex must be held
+    bool busy(const runtime* rteptr) const {
+        if( executing.find(rteptr)!=executing.end() )
+            return true;
+        for(jobs_type::const_iterator p=queue.begin(); p!=queue.end(); p++)
+            if( p->rteptr==rteptr )
+                return true;
+        return false;
+    }
+
+    // mutex must be held. The first job for the runtime
+    jobs_type::iterator next(const runtime* rteptr) {
+        jobs_type::iterator  p = queue.begin();
+        while( p!=queue.end() && p->rteptr!=rteptr )
+            p++;
+        return p;
+    }
+
+    ~cmdexecutor_type() {
+        ::close( notify[0] );
+        ::close( notify[1] );
+        ::pthread_cond_destroy(&condition);
+        ::pthread_mutex_destroy(&mutex);
+    }
+};
+
+static cmdexecutor_type  cmdexecutor;
+
+
+static void* cmdexec_worker(void* arg) {
+    const runtime* rteptr = (const runtime*)arg;
+    mutex_locker   locker( cmdexecutor.mutex );
+
+    while( !cmdexecutor.stop ) {
+        cmdexecutor_type::jobs_type::iterator  p = cmdexecutor.next( rteptr );
+
+        if( p==cmdexecutor.queue.end() )
+            break;
+
+        // Move the job to the finished list; it's not visible to the poll
+        // loop until the notification is sent
+        cmdexecutor_type::jobs_type  job;
+        job.splice(job.begin(), cmdexecutor.queue, p);
+        cmdexecutor.executing.insert( rteptr );
+
+        PTHREAD_CALL( ::pthread_mutex_unlock(&cmdexecutor.mutex) );
+        DEBUG(4, "cmdexec_worker: executing " << job.front().args[0] << QRY(job.front().qry) << endl);
+        job.front().reply = cmdexec_execute(job.front().fn, job.front().qry, job.front().args, *job.front().rteptr);
+        PTHREAD_CALL( ::pthread_mutex_lock(&cmdexecutor.mutex) );
+
+        cmdexecutor.executing.erase( rteptr );
+        cmdexecutor.finished.splice(cmdexecutor.finished.end(), job);
+        if( ::write(cmdexecutor.notify[1], "", 1)<0 && errno!=EAGAIN )
+            DEBUG(-1, "cmdexec_worker: failed to notify - " << evlbi5a::strerror(errno) << endl);
+        PTHREAD_CALL( ::pthread_cond_broadcast(&cmdexecutor.condition) );
+    }
+    cmdexecutor.workers.erase( rteptr );
+    cmdexecutor.nWorker--;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&cmdexecutor.condition) );
+    return (void*)0;
+}
+
+
+cmdexec_class cmdexec_classify(const string& keyword, bool qry, const runtime& rte) {
+    // Read-only status queries
+    static char const* const fast[] = {
+        "evlbi", "tstat", "memstat", "version", "dts_id", "os_rev",
+        "sfxc_server", "vbs_copy", "cmdstat"
+    };
+    // Commands that scan mountpoints or read from recordings
+    static char const* const slow[] = {
+        "scan_check?", "file_check?", "data_check?", "dir_info?", "rtime?",
+        "vbs_list?", "scan_set="
+    };
+
+    if( rte.xlrdev )
+        return cmdexec_inline;
+    if( qry )
+        for(unsigned int i=0; i<sizeof(fast)/sizeof(fast[0]); i++)
+            if( keyword==fast[i] )
+                return cmdexec_fast;
+
+    const string  kw( keyword+QRY(qry) );
+    for(unsigned int i=0; i<sizeof(slow)/sizeof(slow[0]); i++)
+        if( kw==slow[i] )
+            return cmdexec_background;
+    return cmdexec_inline;
+}
+
+string cmdexec_execute(mk5cmd fn, bool qry, const vector<string>& args, runtime& rte, bool protect) {
+    const string& keyword( args[0] );
+    string        reply;
+
+    try {
+        reply = fn(qry, args, rte);
+    }
+    catch( const Error_Code_6_Exception& e) {
+        reply = string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
+    }
+    catch( const Error_Code_8_Exception& e) {
+        reply = string("!")+keyword+" " + QRY(qry) + " 8 : " + e.what() + ";";
+    }
+    catch( const cmdexception& e ) {
+        reply = string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
+    }
+    catch( const exception& e ) {
+        reply = string("!")+keyword+" " + QRY(qry) + " 4 : " + e.what() + ";";
+    }
+    catch( ... ) {
+        reply = string("!")+keyword+" " + QRY(qry) + " 4 : unknown exception ;";
+    }
+    // do the protect=off bookkeeping
+    if( protect )
+        rte.protected_count = max(rte.protected_count, 1u) - 1;
+    return reply;
+}
+
+void cmdexec_submit(const cmdexec_job& job) {
+    mutex_locker   locker( cmdexecutor.mutex );
+
+    EZASSERT2(!cmdexecutor.stop, cmdexecutorexception, EZINFO("command executor is shutting down"));
+
+    cmdexecutor.queue.push_back( job );
+    if( cmdexecutor.workers.find(job.rteptr)==cmdexecutor.workers.end() ) {
+        pthread_t   tid;
+        int         rv;
+
+        if( (rv=::mp_pthread_create(&tid, &cmdexec_worker, (void*)job.rteptr))!=0 ) {
+            cmdexecutor.queue.pop_back();
+            THROW_EZEXCEPT(cmdexecutorexception, "failed to start worker - " << evlbi5a::strerror(rv));
+        }
+        ::pthread_detach( tid );
+        cmdexecutor.workers.insert( job.rteptr );
+        cmdexecutor.nWorker++;
+    }
+}
+
+bool cmdexec_busy(const runtime* rteptr) {
+    mutex_locker   locker( cmdexecutor.mutex );
+    return cmdexecutor.busy( rteptr );
+}
+
+int cmdexec_notifyfd( void ) {
+    return cmdexecutor.notify[0];
+}
+
+list<cmdexec_job> cmdexec_finished( void ) {
+    char               buf[64];
+    list<cmdexec_job>  rv;
+
+    while( ::read(cmdexecutor.notify[0], buf, sizeof(buf))>0 ) { }
+
+    mutex_locker   locker( cmdexecutor.mutex );
+    rv.swap( cmdexecutor.finished );
+    return rv;
+}
+
+void cmdexec_record(const struct timeval& received, bool background) {
+    struct timeval  now;
+
+    ::gettimeofday(&now, 0);
+
+    mutex_locker    locker( cmdexecutor.mutex );
+    const double    dt = delta_t(received, now);
+
+    if( cmdexecutor.latency.size()<nLatency )
+        cmdexecutor.latency.push_back( dt );
+    else
+        cmdexecutor.latency[ cmdexecutor.nextLatency ] = dt;
+    cmdexecutor.nextLatency = (cmdexecutor.nextLatency+1) % nLatency;
+    cmdexecutor.nCommand++;
+    if( background )
+        cmdexecutor.nBackground++;
+}
+
+string cmdexec_status( void ) {
+    ostringstream   oss;
+    vector<double>  lat;
+    unsigned int    nQueued;
+    {
+        mutex_locker    locker( cmdexecutor.mutex );
+        lat     = cmdexecutor.latency;
+        nQueued = cmdexecutor.queue.size() + cmdexecutor.executing.size();
+        oss << cmdexecutor.nCommand << " : " << cmdexecutor.nBackground << " : " << nQueued;
+    }
+    sort(lat.begin(), lat.end());
+    if( lat.empty() )
+        lat.push_back( 0.0 );
+    oss << " : " << lat[ (lat.size()-1)/2 ]*1.0e3
+        << " : " << lat[ (size_t)((lat.size()-1)*0.99) ]*1.0e3
+        << " : " << lat.back()*1.0e3;
+    return oss.str();
+}
+
+void cmdexec_shutdown( void ) {
+    mutex_locker   locker( cmdexecutor.mutex );
+
+    cmdexecutor.stop = true;
+    cmdexecutor.queue.clear();
+    while( cmdexecutor.nWorker )
+        PTHREAD_CALL( ::pthread_cond_wait(&cmdexecutor.condition, &cmdexecutor.mutex) );
+}
@@ -0,0 +1,101 @@
+// execute control commands in the background
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_CMDEXECUTOR_H
+#define JIVE5AB_CMDEXECUTOR_H
+
+#include <mk5command.h>
+#include <runtime.h>
+#include <ezexcept.h>
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+
+DECLARE_EZEXCEPT(cmdexecutorexception)
+
+// All control connections are served from main()'s poll(2) loop. Commands
+// that may take a long time (they scan mountpoints or read from
+// recordings) are handed to a worker thread for their runtime so the loop
+// keeps serving the other clients. The rules:
+//
+//   * commands for one runtime are executed one after the other, in the
+//     order they were received: while a runtime has a command queued or
+//     executing, every command for that runtime is queued as well and
+//     executed by that runtime's one worker
+//   * commands for different runtimes may execute at the same time;
+//     state the commands keep should be kept per runtime (per_runtime<>
+//     locks its map for this)
+//   * a few read-only status queries (evlbi?, tstat?, ...) do not wait
+//     for a busy runtime; they only look at data protected by their own
+//     locks
+//   * a connection that is waiting for a reply is not read from until the
+//     reply has been sent, so the replies come in the order of the
+//     commands
+//   * systems with a StreamStor execute everything in the poll loop, the
+//     device is not meant to be driven from several threads
+typedef enum { cmdexec_inline, cmdexec_fast, cmdexec_background } cmdexec_class;
+
+cmdexec_class cmdexec_classify(const std::string& keyword, bool qry, const runtime& rte);
+
+struct cmdexec_job {
+    int                      fd;        // connection that issued the command
+    bool                     qry;
+    std::vector<std::string> args;      // args[0] is the keyword
+    mk5cmd                   fn;
+    runtime*                 rteptr;
+    struct timeval           received;
+    std::string              reply;     // set when executed
+
+    cmdexec_job(int f, bool q, const std::vector<std::string>& a, mk5cmd c,
+                runtime* r, const struct timeval& t);
+};
+
+// Execute the command and return the formatted reply; exceptions are
+// turned into error replies. 'protect' says wether to do the
+// protect=off bookkeeping on the runtime
+std::string cmdexec_execute(mk5cmd fn, bool qry, const std::vector<std::string>& args,
+                            runtime& rte, bool protect = true);
+
+// Queue the job; it is executed by a worker as soon as all earlier jobs
+// for the same runtime are done. May throw if no worker could be started
+void        cmdexec_submit(const cmdexec_job& job);
+
+// True if the runtime has jobs queued or executing
+bool        cmdexec_busy(const runtime* rteptr);
+
+// Becomes readable when jobs have finished; collect them with
+// cmdexec_finished()
+int                     cmdexec_notifyfd( void );
+std::list<cmdexec_job>  cmdexec_finished( void );
+
+// Keep latency statistics: 'received' is when the command came in
+void        cmdexec_record(const struct timeval& received, bool background);
+
+// "<commands> : <in background> : <queued/executing now> : <p50 ms> :
+//  <p99 ms> : <max ms>" - the percentiles over the most recent commands
+std::string cmdexec_status( void );
+
+// Drop queued jobs and wait for the executing ones to finish. Must be
+// called before the runtimes are deleted
+void        cmdexec_shutdown( void );
+
+#endif
@@ -0,0 +1,463 @@
+// copy many FlexBuff recordings to another FlexBuff at once
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <copyengine.h>
+#include <threadfns/multisend.h>
+#include <vbscatalog.h>
+#include <evlbidebug.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <threadutil.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include <errno.h>
+#include <fnmatch.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(copyengineexception)
+
+copyengine_parms::copyengine_parms():
+    nThread( 8 ), perDisk( 2 )
+{}
+
+
+static double delta_t(const struct timeval& a, const struct timeval& b) {
+    return (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_usec - a.tv_usec)/1.0e6;
+}
+
+struct copyjob_type {
+    enum state_type {
+        queued, negotiating, copying, done, failed, cancelled
+    };
+
+    const string          recname;
+    const networkargs     dest;
+    mountpointlist_type   mountpoints;
+    state_type            state;
+    chunklist_type        pending;
+    set<int>              fds;        // connections in use for this recording
+    unsigned int          nChunk, nChunkDone;
+    unsigned int          nInFlight;  // chunks being sent, +1 while negotiating
+    uint64_t              nByte, nByteDone, lastByte;
+    double                rate;
+    string                error;
+    struct timeval        last;
+
+    copyjob_type(const string& rn, const mountpointlist_type& mps, const networkargs& na):
+        recname( rn ), dest( na ), mountpoints( mps ), state( queued ),
+        nChunk( 0 ), nChunkDone( 0 ), nInFlight( 0 ), nByte( 0 ), nByteDone( 0 ), lastByte( 0 ), rate( 0.0 )
+    {
+        ::gettimeofday(&last, 0);
+    }
+
+    bool finished( void ) const {
+        return (state==done || state==failed || state==cancelled) && nInFlight==0;
+    }
+    bool active( void ) const {
+        return state==queued || state==negotiating || state==copying;
+    }
+};
+
+static const char* state_name(copyjob_type::state_type s) {
+    switch( s ) {
+        case copyjob_type::queued:      return "queued";
+        case copyjob_type::negotiating: return "negotiating";
+        case copyjob_type::copying:     return "copying";
+        case copyjob_type::done:        return "done";
+        case copyjob_type::failed:      return "failed";
+        case copyjob_type::cancelled:   return "cancelled";
+    }
+    return "?";
+}
+
+// The engine's state, all protected by the mutex. Sender threads are
+// detached; they exit when there are more than configured. At shutdown
+// (copyengine_shutdown()) all connections are shut down and we wait for
+// the senders to leave.
+struct copyengine_type {
+    typedef list<copyjob_type*>          jobs_type;
+    typedef map<string, unsigned int>    diskload_type;
+
+    copyengine_parms  parms;
+    bool              stop;
+    unsigned int      nThread;
+    jobs_type         jobs;
+    diskload_type     diskload;
+    pthread_mutex_t   mutex;
+    pthread_cond_t    condition;
+
+    copyengine_type():
+        stop( false ), nThread( 0 )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+        PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+    }
+
+    // (mutex must be held)
+    void shutdown(copyjob_type* job) {
+        for(set<int>::const_iterator p=job->fds.begin(); p!=job->fds.end(); p++)
+            ::shutdown(*p, SHUT_RDWR);
+    }
+
+    // If senders are still running (copyengine_shutdown() was not
+    // called) they still use all of this, so leave it be
+    ~copyengine_type() {
+        if( nThread )
+            return;
+        for(jobs_type::iterator p=jobs.begin(); p!=jobs.end(); p++)
+            delete *p;
+        ::pthread_cond_destroy(&condition);
+        ::pthread_mutex_destroy(&mutex);
+    }
+};
+
+static copyengine_type  copyengine;
+
+
+// Keeps the recording's progress + connections up to date while a chunk
+// is being sent
+struct job_monitor: public chunksend_monitor {
+    copyjob_type*   job;
+    int             curfd;
+
+    job_monitor(copyjob_type* j):
+        job( j ), curfd( -1 )
+    {}
+
+    virtual void connection(int fd) {
+        mutex_locker   locker( copyengine.mutex );
+        job->fds.erase( curfd );
+        if( (curfd=fd)<0 )
+            return;
+        job->fds.insert( fd );
+        // Cancelled whilst connecting?
+        if( job->state==copyjob_type::cancelled || copyengine.stop )
+            ::shutdown(fd, SHUT_RDWR);
+    }
+    virtual void sent(off_t n) {
+        struct timeval  now;
+        ::gettimeofday(&now, 0);
+
+        mutex_locker    locker( copyengine.mutex );
+        const double    dt = delta_t(job->last, now);
+
+        job->nByteDone += (uint64_t)n;
+        if( dt>=1.0 ) {
+            job->rate     = (double)(job->nByteDone - job->lastByte)/dt;
+            job->lastByte = job->nByteDone;
+            job->last     = now;
+        }
+    }
+};
+
+
+// Find out which chunks the remote end needs. Called without the mutex
+// held; the job is in the 'negotiating' state so no other sender touches
+// it, and it counts as in flight so it is not deleted.
+static void negotiate(copyjob_type* job) {
+    chunklist_type     fl = get_chunklist(job->recname, job->mountpoints);
+    uint64_t           nbyte = 0;
+    fdoperations_type  fdops( job->dest.netparms.get_protocol() );
+
+    if( !fl.empty() ) {
+        // The connection can only be shut down once we know it so check
+        // if we were cancelled whilst connecting
+        fdreaderargs*  conn = net_client( job->dest );
+
+        {
+            mutex_locker   locker( copyengine.mutex );
+            job->fds.insert( conn->fd );
+            if( job->state!=copyjob_type::negotiating || copyengine.stop )
+                ::shutdown(conn->fd, SHUT_RDWR);
+        }
+        try {
+            fl = rsync_negotiate(job->recname, fl, conn->fd, fdops);
+        }
+        catch( ... ) {
+            {
+                mutex_locker   locker( copyengine.mutex );
+                job->fds.clear();
+            }
+            ::close_filedescriptor( conn );
+            delete conn;
+            throw;
+        }
+        {
+            mutex_locker   locker( copyengine.mutex );
+            job->fds.clear();
+        }
+        ::close_filedescriptor( conn );
+        delete conn;
+    }
+    fl = stripe_chunklist( fl );
+
+    // Of chunks the remote end has part of only the differing ranges are sent
+    for(chunklist_type::const_iterator p=fl.begin(); p!=fl.end(); p++) {
+        struct stat   st;
+        for(byterangelist_type::const_iterator r=p->ranges.begin(); r!=p->ranges.end(); r++)
+            nbyte += (uint64_t)r->length;
+        if( p->ranges.empty() && ::stat((p->mountpoint+"/"+p->relative_path).c_str(), &st)==0 )
+            nbyte += (uint64_t)st.st_size;
+    }
+
+    mutex_locker   locker( copyengine.mutex );
+    if( job->state!=copyjob_type::negotiating )
+        return;
+    job->pending = fl;
+    job->nChunk  = fl.size();
+    job->nByte   = nbyte;
+    job->state   = (fl.empty() ? copyjob_type::done : copyjob_type::copying);
+    DEBUG(2, "copyengine: " << job->recname << " - " << job->nChunk << " chunks, " << job->nByte << " bytes to copy" << endl);
+}
+
+static void* copyengine_sender(void*) {
+    mutex_locker   locker( copyengine.mutex );
+
+    while( !copyengine.stop && copyengine.nThread<=copyengine.parms.nThread ) {
+        copyjob_type*                     job = 0;
+        copyengine_type::jobs_type::iterator p;
+
+        // New recordings first: find out what to send for them so their
+        // chunks join the pool
+        for(p=copyengine.jobs.begin(); p!=copyengine.jobs.end(); p++)
+            if( (*p)->state==copyjob_type::queued )
+                break;
+        if( p!=copyengine.jobs.end() ) {
+            string   error;
+
+            job        = *p;
+            job->state = copyjob_type::negotiating;
+            job->nInFlight++;
+            PTHREAD_CALL( ::pthread_mutex_unlock(&copyengine.mutex) );
+            try {
+                negotiate( job );
+            }
+            catch( const std::exception& e ) {
+                error = e.what();
+            }
+            catch( ... ) {
+                error = "caught unknown exception";
+            }
+            PTHREAD_CALL( ::pthread_mutex_lock(&copyengine.mutex) );
+            job->nInFlight--;
+            if( !error.empty() && job->state==copyjob_type::negotiating ) {
+                DEBUG(-1, "copyengine: " << job->recname << " - " << error << endl);
+                job->state = copyjob_type::failed;
+                job->error = error;
+            }
+            PTHREAD_CALL( ::pthread_cond_broadcast(&copyengine.condition) );
+            continue;
+        }
+
+        // Find the first chunk, in order of the recordings, that's on a
+        // disk that's not too busy
+        chunklist_type::iterator  c;
+        for(p=copyengine.jobs.begin(); job==0 && p!=copyengine.jobs.end(); p++) {
+            if( (*p)->state!=copyjob_type::copying )
+                continue;
+            for(c=(*p)->pending.begin(); c!=(*p)->pending.end(); c++) {
+                if( copyengine.diskload[c->mountpoint]<copyengine.parms.perDisk ) {
+                    job = *p;
+                    break;
+                }
+            }
+        }
+        if( job==0 ) {
+            PTHREAD_CALL( ::pthread_cond_wait(&copyengine.condition, &copyengine.mutex) );
+            continue;
+        }
+
+        bool                  ok = false;
+        string                error;
+        job_monitor           monitor( job );
+        const chunk_location  cl( *c );
+        fdoperations_type     fdops( job->dest.netparms.get_protocol() );
+
+        job->pending.erase( c );
+        job->nInFlight++;
+        copyengine.diskload[cl.mountpoint]++;
+        PTHREAD_CALL( ::pthread_mutex_unlock(&copyengine.mutex) );
+
+        try {
+            if( !(ok=send_chunk_file(job->dest, fdops, cl, "vbs_copy", &monitor)) )
+                error = "failed to send "+cl.relative_path+" - "+evlbi5a::strerror(errno);
+        }
+        catch( const std::exception& e ) {
+            error = e.what();
+        }
+        catch( ... ) {
+            error = "caught unknown exception sending "+cl.relative_path;
+        }
+
+        PTHREAD_CALL( ::pthread_mutex_lock(&copyengine.mutex) );
+        copyengine.diskload[cl.mountpoint]--;
+        job->nInFlight--;
+        if( ok ) {
+            job->nChunkDone++;
+        } else if( job->state==copyjob_type::copying ) {
+            // no use continuing with this one; the chunks in flight will
+            // finish and a next copy of it will only send what's missing
+            DEBUG(-1, "copyengine: " << job->recname << " - " << error << endl);
+            job->state = copyjob_type::failed;
+            job->error = error;
+            job->pending.clear();
+        }
+        if( job->state==copyjob_type::copying && job->pending.empty() && job->nInFlight==0 ) {
+            job->state = copyjob_type::done;
+            DEBUG(2, "copyengine: " << job->recname << " done, " << job->nByteDone << " bytes" << endl);
+        }
+        PTHREAD_CALL( ::pthread_cond_broadcast(&copyengine.condition) );
+    }
+    copyengine.nThread--;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&copyengine.condition) );
+    return (void*)0;
+}
+
+// Start senders until there are as many as configured (mutex must be held)
+static void start_senders( void ) {
+    while( copyengine.nThread<copyengine.parms.nThread ) {
+        pthread_t   tid;
+        int         rv;
+
+        if( (rv=::mp_pthread_create(&tid, &copyengine_sender, 0))!=0 )
+            THROW_EZEXCEPT(copyengineexception, "failed to start sender thread - " << evlbi5a::strerror(rv));
+        ::pthread_detach( tid );
+        copyengine.nThread++;
+    }
+}
+
+
+vector<string> copyengine_add(const patternlist_type& patterns, const mountpointlist_type& mps,
+                              const networkargs& dest) {
+    set<string>     recordings;
+    vector<string>  rv;
+
+    EZASSERT2(dest.netparms.get_protocol()=="tcp", copyengineexception, EZINFO("can only copy over tcp"));
+    EZASSERT2(!mps.empty(), copyengineexception, EZINFO("no mountpoints selected to copy from"));
+
+    const catalog_listing_type  listing( catalog_recordings(mps) );
+
+    for(patternlist_type::const_iterator pat=patterns.begin(); pat!=patterns.end(); pat++)
+        for(catalog_listing_type::const_iterator r=listing.begin(); r!=listing.end(); r++)
+            if( ::fnmatch(pat->c_str(), r->first.c_str(), 0)==0 )
+                recordings.insert( r->first );
+
+    mutex_locker   locker( copyengine.mutex );
+    EZASSERT2(!copyengine.stop, copyengineexception, EZINFO("the copy engine is shutting down"));
+    for(set<string>::const_iterator r=recordings.begin(); r!=recordings.end(); r++) {
+        copyengine_type::jobs_type::const_iterator p;
+
+        for(p=copyengine.jobs.begin(); p!=copyengine.jobs.end(); p++)
+            if( (*p)->recname==*r && (*p)->active() )
+                break;
+        if( p!=copyengine.jobs.end() )
+            continue;
+        copyengine.jobs.push_back( new copyjob_type(*r, mps, dest) );
+        rv.push_back( *r );
+    }
+    start_senders();
+    PTHREAD_CALL( ::pthread_cond_broadcast(&copyengine.condition) );
+    return rv;
+}
+
+unsigned int copyengine_cancel(const string& pattern) {
+    unsigned int   n = 0;
+    mutex_locker   locker( copyengine.mutex );
+
+    for(copyengine_type::jobs_type::iterator p=copyengine.jobs.begin(); p!=copyengine.jobs.end(); p++) {
+        copyjob_type*  job = *p;
+
+        if( !job->active() || ::fnmatch(pattern.c_str(), job->recname.c_str(), 0)!=0 )
+            continue;
+        job->state = copyjob_type::cancelled;
+        job->pending.clear();
+        copyengine.shutdown( job );
+        n++;
+    }
+    PTHREAD_CALL( ::pthread_cond_broadcast(&copyengine.condition) );
+    return n;
+}
+
+void copyengine_shutdown( void ) {
+    mutex_locker   locker( copyengine.mutex );
+
+    copyengine.stop = true;
+    for(copyengine_type::jobs_type::iterator p=copyengine.jobs.begin(); p!=copyengine.jobs.end(); p++)
+        copyengine.shutdown( *p );
+    PTHREAD_CALL( ::pthread_cond_broadcast(&copyengine.condition) );
+    while( copyengine.nThread )
+        PTHREAD_CALL( ::pthread_cond_wait(&copyengine.condition, &copyengine.mutex) );
+}
+
+void copyengine_clear( void ) {
+    mutex_locker   locker( copyengine.mutex );
+
+    for(copyengine_type::jobs_type::iterator p=copyengine.jobs.begin(); p!=copyengine.jobs.end(); ) {
+        if( (*p)->finished() ) {
+            delete *p;
+            copyengine.jobs.erase( p++ );
+        } else {
+            p++;
+        }
+    }
+}
+
+void copyengine_set_parms(const copyengine_parms& cp) {
+    EZASSERT2(cp.nThread>0 && cp.perDisk>0, copyengineexception, EZINFO("need at least one thread and one chunk per disk"));
+
+    mutex_locker   locker( copyengine.mutex );
+    copyengine.parms = cp;
+    // only start senders if there's something to do; surplus ones leave
+    // by themselves
+    if( !copyengine.jobs.empty() && !copyengine.stop )
+        start_senders();
+    PTHREAD_CALL( ::pthread_cond_broadcast(&copyengine.condition) );
+}
+
+copyengine_parms copyengine_get_parms( void ) {
+    mutex_locker   locker( copyengine.mutex );
+    return copyengine.parms;
+}
+
+string copyengine_status( void ) {
+    ostringstream   oss;
+    mutex_locker    locker( copyengine.mutex );
+
+    for(copyengine_type::jobs_type::const_iterator p=copyengine.jobs.begin(); p!=copyengine.jobs.end(); p++) {
+        const copyjob_type*  job = *p;
+
+        oss << (p==copyengine.jobs.begin() ? "" : " : ")
+            << job->recname << "/" << state_name(job->state) << "/"
+            << job->nChunkDone << "/" << job->nChunk << "/"
+            << job->nByteDone << "/" << job->nByte << "/"
+            << (job->state==copyjob_type::copying ? job->rate/1.0e6 : 0.0);
+        if( !job->error.empty() )
+            oss << "/" << job->error;
+    }
+    return oss.str();
+}
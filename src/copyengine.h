@@ -0,0 +1,74 @@
+// copy many FlexBuff recordings to another FlexBuff at once
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_COPYENGINE_H
+#define JIVE5AB_COPYENGINE_H
+
+#include <threadfns.h>
+#include <mountpoint.h>
+#include <ezexcept.h>
+
+#include <string>
+#include <vector>
+
+DECLARE_EZEXCEPT(copyengineexception)
+
+// The copy engine copies whole FlexBuff recordings to a remote jive5ab
+// that does "net2vbs=open", using the same protocol as vbs2net: per
+// recording the remote end is asked which chunks it still needs, then
+// each chunk goes over its own TCP connection. In contrast to vbs2net,
+// which copies one recording per transfer, any number of recordings can
+// be queued; a shared pool of sender threads copies chunks of several
+// recordings at the same time, limited by the number of chunks that may
+// be read from any one disk (mountpoint) at once. The engine runs
+// independently of the runtimes' transfers.
+struct copyengine_parms {
+    unsigned int   nThread;   // number of sender threads
+    unsigned int   perDisk;   // max. chunks being read per mountpoint
+
+    // defaults: 8 threads, 2 per disk
+    copyengine_parms();
+};
+
+// Queue recordings matching any of the patterns (shell wildcards, matched
+// against the recording names found on 'mps') for copying to the host +
+// port in 'dest' (protocol must be tcp). Recordings already queued or
+// being copied are not added twice. Returns the recordings added.
+std::vector<std::string> copyengine_add(const patternlist_type& patterns, const mountpointlist_type& mps,
+                                        const networkargs& dest);
+
+// Cancel the queued/active recordings that match 'pattern'. Chunks being
+// sent are interrupted. Returns the number of recordings cancelled.
+unsigned int     copyengine_cancel(const std::string& pattern);
+
+// Forget about recordings that are done, failed or were cancelled
+void             copyengine_clear( void );
+
+void             copyengine_set_parms(const copyengine_parms& cp);
+copyengine_parms copyengine_get_parms( void );
+
+// Interrupt all copies and wait for the sender threads to leave. To be
+// called before main() returns; no recordings can be added afterwards
+void             copyengine_shutdown( void );
+
+// "<recording>/<state>/<chunks done>/<chunks>/<bytes done>/<bytes>/<MB/s>[/<error>] : ..."
+// in the order the recordings were added
+std::string      copyengine_status( void );
+
+#endif
@@ -2,6 +2,7 @@
 #define EVLBI5A_COUNTER_H
 #include <stdint.h> // for [u]int<N>_t  types
 #include <iostream>
+#include <atomic.h>
 
 // If we compile w/o debug or with low enough debug level then all counters
 // are real counters, otherwise we can completely disable memory access to
@@ -65,4 +66,61 @@ typedef real_counter_type   ucounter_type;
 #endif  // GDBDEBUG>=2
 
 
+// Counters that are updated per packet by more than one thread at the same
+// time should not live on the same cache line; the line bounces between
+// the cores at every increment. A sharded_type<T> holds a number of copies
+// of T, each at least a cache line away from the next. A thread asks for a
+// shard once - typically when it starts - and updates that one, unlocked,
+// just like before. Readers add up all shards.
+// With more than nShard threads updating at the same time some of them will
+// share a shard. This is no worse than everyone sharing one counter.
+// Only put counters in here that are added to: a shard keeps its value
+// after its thread is gone, and a shard may be shared, so a value that is
+// set ("the current rate") would be summed with stale or unrelated ones.
+// Such values should be kept per thread or per connection elsewhere.
+template <typename T>
+class sharded_type {
+    public:
+        static const unsigned int nShard = 16;
+
+        sharded_type():
+            nextShard( 0 )
+        { this->clear(); }
+
+        // The initial value ends up in the first shard
+        template <typename V>
+        explicit sharded_type(const V& init):
+            nextShard( 0 )
+        { this->clear(); shards[0].value = init; }
+
+        // Hands out shards round robin
+        T& shard( void ) {
+            return shards[ atomic_inc(&nextShard) % nShard ].value;
+        }
+
+        // Adds the values of all shards to 'r'. T must be convertible to R
+        // and R must support "+=".
+        template <typename R>
+        R& sum(R& r) const {
+            for(unsigned int i=0; i<nShard; i++)
+                r += (R)shards[i].value;
+            return r;
+        }
+
+        void clear( void ) {
+            for(unsigned int i=0; i<nShard; i++)
+                shards[i].value = T();
+        }
+
+    private:
+        struct shard_type {
+            T     value;
+            char  pad[64];
+        };
+        volatile uint32_t  nextShard;
+        shard_type         shards[nShard];
+};
+
+
+
 #endif
@@ -0,0 +1,255 @@
+// walk directory trees with several threads at once
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <dirwalker.h>
+#include <mountpoint.h>
+#include <evlbidebug.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <threadutil.h>
+
+#include <deque>
+#include <algorithm>
+#include <exception>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+dirwalk_entry_type::dirwalk_entry_type(const string& n, unsigned char t):
+    name( n ), type( t )
+{}
+
+dirwalk_visitor::~dirwalk_visitor() {}
+
+void dirwalk_visitor::found(const string&, const string&, unsigned int, const dirwalk_entries_type&) {}
+
+
+// Symlinks and entries of unknown type get the type of what they point at
+static unsigned char resolve_type(int dirfd, const char* name, unsigned char type) {
+    struct stat  st;
+
+    if( type!=DT_UNKNOWN && type!=DT_LNK )
+        return type;
+    if( ::fstatat(dirfd, name, &st, 0)!=0 )
+        return DT_UNKNOWN;
+    if( S_ISDIR(st.st_mode) )
+        return DT_DIR;
+    if( S_ISREG(st.st_mode) )
+        return DT_REG;
+    return type;
+}
+
+static bool dot_or_dotdot(const char* name) {
+    return name[0]=='.' && (name[1]=='\0' || (name[1]=='.' && name[2]=='\0'));
+}
+
+#if defined(__linux__) && defined(SYS_getdents64)
+// struct linux_dirent64 is not in any header; its layout is fixed:
+//      uint64_t d_ino; int64_t d_off; unsigned short d_reclen;
+//      unsigned char d_type; char d_name[];
+static const size_t  direntReclen = 16;
+static const size_t  direntType   = 18;
+static const size_t  direntName   = 19;
+static const size_t  direntBufSz  = 256*1024;
+
+int dirwalk_read(const string& dir, dirwalk_entries_type& entries) {
+    const int     fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    vector<char>  buf( direntBufSz );
+    long          n;
+
+    if( fd<0 )
+        return errno;
+    while( (n=::syscall(SYS_getdents64, fd, &buf[0], buf.size()))>0 ) {
+        for(long off=0; off<n; ) {
+            unsigned short     reclen;
+            const char*        name = &buf[off + direntName];
+
+            ::memcpy(&reclen, &buf[off + direntReclen], sizeof(reclen));
+            if( !dot_or_dotdot(name) )
+                entries.push_back( dirwalk_entry_type(name, resolve_type(fd, name, (unsigned char)buf[off + direntType])) );
+            off += reclen;
+        }
+    }
+    const int  eno = (n<0 ? errno : 0);
+    ::close( fd );
+    return eno;
+}
+#else
+int dirwalk_read(const string& dir, dirwalk_entries_type& entries) {
+    DIR*           dirp;
+    struct dirent* de;
+
+    if( (dirp=::opendir(dir.c_str()))==0 )
+        return errno;
+    errno = 0;
+    while( (de=::readdir(dirp))!=0 ) {
+        if( !dot_or_dotdot(de->d_name) )
+            entries.push_back( dirwalk_entry_type(de->d_name, resolve_type(::dirfd(dirp), de->d_name, de->d_type)) );
+        errno = 0;
+    }
+    const int  eno = errno;
+    ::closedir( dirp );
+    return eno;
+}
+#endif
+
+
+// The shared state of one walk. Threads are started when there is more
+// work queued than there are idle threads, up to the maximum. The calling
+// thread does its share too.
+struct dirwalk_work_type {
+    string        root;
+    string        path;
+    unsigned int  depth;
+
+    dirwalk_work_type(const string& r, const string& p, unsigned int d):
+        root( r ), path( p ), depth( d )
+    {}
+};
+
+struct dirwalk_state_type {
+    typedef deque<dirwalk_work_type>  queue_type;
+
+    dirwalk_visitor&   visitor;
+    const unsigned int maxThread;
+    unsigned int       nIdle;
+    unsigned int       nBusy;
+    queue_type         queue;
+    vector<pthread_t>  threads;
+    pthread_mutex_t    mutex;
+    pthread_cond_t     condition;
+
+    dirwalk_state_type(dirwalk_visitor& v, unsigned int n):
+        visitor( v ), maxThread( n ), nIdle( 0 ), nBusy( 0 )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+        PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+    }
+
+    ~dirwalk_state_type() {
+        ::pthread_cond_destroy(&condition);
+        ::pthread_mutex_destroy(&mutex);
+    }
+
+    // mutex must be held
+    void push(const dirwalk_work_type& w);
+
+    void work( void );
+};
+
+static void* dirwalk_thread(void* argptr) {
+    ((dirwalk_state_type*)argptr)->work();
+    return (void*)0;
+}
+
+void dirwalk_state_type::push(const dirwalk_work_type& w) {
+    pthread_t  tid;
+    int        rv;
+
+    queue.push_back( w );
+    if( nIdle>0 ) {
+        ::pthread_cond_signal(&condition);
+        return;
+    }
+    // +1 for the calling thread
+    if( threads.size()+1>=maxThread )
+        return;
+    if( (rv=::mp_pthread_create(&tid, &dirwalk_thread, this))!=0 ) {
+        DEBUG(4, "dirwalk: failed to start extra thread - " << evlbi5a::strerror(rv) << endl);
+        return;
+    }
+    threads.push_back( tid );
+}
+
+void dirwalk_state_type::work( void ) {
+    while( true ) {
+        dirwalk_work_type  w("", "", 0);
+        {
+            mutex_locker   locker( mutex );
+
+            while( queue.empty() && nBusy>0 ) {
+                nIdle++;
+                ::pthread_cond_wait(&condition, &mutex);
+                nIdle--;
+            }
+            if( queue.empty() )
+                break;
+            w = queue.front();
+            queue.pop_front();
+            nBusy++;
+        }
+
+        try {
+            struct stat  st;
+            // The roots are the only ones of which we don't know yet
+            // whether they're directories
+            if( (w.depth>0 || (::stat(w.path.c_str(), &st)==0 && S_ISDIR(st.st_mode))) &&
+                visitor.descend(w.root, w.path, w.depth) ) {
+                dirwalk_entries_type  entries;
+                const int             eno = dirwalk_read(w.path, entries);
+
+                if( eno!=0 )
+                    DEBUG(4, "dirwalk: " << w.path << " - " << evlbi5a::strerror(eno) << endl);
+                visitor.found(w.root, w.path, w.depth, entries);
+
+                const string  pfx( w.path.empty() || w.path[w.path.size()-1]!='/' ? w.path+"/" : w.path );
+                mutex_locker  locker( mutex );
+                for(dirwalk_entries_type::const_iterator p=entries.begin(); p!=entries.end(); p++)
+                    if( p->type==DT_DIR )
+                        push( dirwalk_work_type(w.root, pfx+p->name, w.depth+1) );
+            }
+        }
+        catch( const exception& e ) {
+            DEBUG(-1, "dirwalk: " << w.path << " - " << e.what() << endl);
+        }
+        catch( ... ) {
+            DEBUG(-1, "dirwalk: " << w.path << " - caught unknown exception" << endl);
+        }
+
+        mutex_locker   locker( mutex );
+        // Wake up the others if they have to stop
+        if( --nBusy==0 && queue.empty() )
+            ::pthread_cond_broadcast(&condition);
+    }
+}
+
+void dirwalk(const list<string>& roots, dirwalk_visitor& visitor, unsigned int nthread) {
+    dirwalk_state_type  state(visitor, max(nthread, 1u));
+
+    {
+        mutex_locker   locker( state.mutex );
+        for(list<string>::const_iterator p=roots.begin(); p!=roots.end(); p++)
+            state.push( dirwalk_work_type(*p, *p, 0) );
+    }
+    state.work();
+
+    // Once one thread leaves, all work is done; the threads list doesn't
+    // change anymore
+    for(vector<pthread_t>::iterator p=state.threads.begin(); p!=state.threads.end(); p++)
+        ::pthread_join(*p, 0);
+}
@@ -0,0 +1,68 @@
+// walk directory trees with several threads at once
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_DIRWALKER_H
+#define JIVE5AB_DIRWALKER_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+// One entry of a directory: its name and type (DT_DIR, DT_REG, ... from
+// dirent.h). Symbolic links and entries the file system did not give a
+// type for are stat(2)'ed: their type is that of what they refer to, or
+// DT_UNKNOWN if that fails.
+struct dirwalk_entry_type {
+    std::string     name;
+    unsigned char   type;
+
+    dirwalk_entry_type(const std::string& n, unsigned char t);
+};
+typedef std::vector<dirwalk_entry_type>  dirwalk_entries_type;
+
+// Read all entries of a directory, except "." and "..". On Linux this uses
+// getdents64(2) with a large buffer: many entries per system call and no
+// per-entry work in libc. Returns 0 or an errno value.
+int dirwalk_read(const std::string& dir, dirwalk_entries_type& entries);
+
+// The walker calls these for every directory it comes across; they may be
+// called from several threads at the same time. Exceptions thrown by them
+// are logged and otherwise ignored.
+struct dirwalk_visitor {
+    // Directory 'path' is 'depth' levels below 'root' (the root itself has
+    // depth 0). Return true to read its entries; directories found in it
+    // are offered to descend() in turn. Deciding this early, from the name
+    // alone, is what keeps the walk from reading whole trees.
+    virtual bool descend(const std::string& root, const std::string& path, unsigned int depth) = 0;
+
+    // The entries of a directory that was read
+    virtual void found(const std::string& root, const std::string& path, unsigned int depth,
+                       const dirwalk_entries_type& entries);
+
+    virtual ~dirwalk_visitor();
+};
+
+// Walk the trees below the roots with (at most) 'nthread' threads. All
+// directories being read, irrespective of which root they are under, are
+// shared between the threads. Returns when all is done.
+void dirwalk(const std::list<std::string>& roots, dirwalk_visitor& visitor, unsigned int nthread = 8);
+
+#endif
@@ -17,6 +17,7 @@
 //          Joint Institute for VLBI in Europe
 //          P.O. Box 2
 //          7990 AA Dwingeloo
+#include <evlbidebug.h>
 #include <iostream>
 
 // Yah we rly need to lock during outputting stuff
@@ -27,6 +28,14 @@
 #include <string.h>
 #include <threadutil.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
 static int             dbglev_val   = 1;
 // if msglevel>fnthres_val level => functionnames are printed in DEBUG()
 static int             fnthres_val  = 5; 
@@ -66,3 +75,319 @@ void do_cerr_unlock( void ) {
         std::cerr << "do_cerr_unlock() failed - " << evlbi5a::strerror(rv) << std::endl;
     }
 }
+
+
+//
+// Asynchronous output of DEBUG() messages
+//
+// The queue is a bounded multi-producer queue after D. Vyukov. Each cell
+// has a sequence number: a producer holding ticket 'pos' may fill the cell
+// if its sequence equals 'pos', the consumer may empty it once it equals
+// 'pos+1'. Producers only ever do a compare-and-swap on the head, so
+// DEBUG() never waits for the logger thread or for the target.
+// The logger thread is the only consumer. When it finds the queue empty it
+// says so in logSleeping and blocks reading logWake; the producer that
+// sees it sleeping wakes it with a byte, so only the first message after
+// an idle period costs a system call.
+// Producers count themselves in logInFlight while they look at logRunning
+// and push, such that stopping the logger can wait for them.
+static const unsigned long  logqCapacity = 8192;    // power of two
+
+struct logcell_type {
+    volatile unsigned long  sequence;
+    char*                   message;
+};
+
+static logcell_type                 logq[ logqCapacity ];
+static volatile unsigned long       logqHead    = 0;
+static unsigned long                logqTail    = 0;
+static bool                         logqInit    = false;
+
+static volatile bool                logRunning  = false;
+static volatile bool                logStop     = false;
+static volatile bool                logSleeping = false;
+static volatile long                logInFlight = 0;
+static int                          logWake[2]  = { -1, -1 };
+static volatile unsigned long long  logQueued   = 0;
+static volatile unsigned long long  logDropped  = 0;
+static unsigned long long           logWritten  = 0;
+
+static pthread_t                    logThread;
+static pthread_mutex_t              logControl  = PTHREAD_MUTEX_INITIALIZER;
+static debuglog_target              logTarget   = debuglog_sync;
+static std::string                  logPath;
+static int                          logFd       = -1;
+static bool                         logAtExit   = false;
+
+static bool logq_push(char* m) {
+    unsigned long  pos = logqHead;
+
+    while( true ) {
+        logcell_type&        cell = logq[ pos & (logqCapacity-1) ];
+        const unsigned long  seq  = cell.sequence;
+        const long           diff = (long)(seq - pos);
+
+        __sync_synchronize();
+        if( diff==0 ) {
+            if( __sync_bool_compare_and_swap(&logqHead, pos, pos+1) ) {
+                cell.message = m;
+                __sync_synchronize();
+                cell.sequence = pos + 1;
+                return true;
+            }
+        } else if( diff<0 ) {
+            // the consumer hasn't emptied this cell yet: full
+            return false;
+        }
+        pos = logqHead;
+    }
+}
+
+static bool logq_empty( void ) {
+    return logq[ logqTail & (logqCapacity-1) ].sequence!=logqTail+1;
+}
+
+static void wake_logger( void ) {
+    if( ::write(logWake[1], "", 1)<0 ) {
+        // EAGAIN: there's enough in the pipe to wake it up already
+    }
+}
+
+// Only by the logger thread or, once that one's gone, under logControl
+static char* logq_pop( void ) {
+    logcell_type&  cell = logq[ logqTail & (logqCapacity-1) ];
+    char*          m;
+
+    if( cell.sequence!=logqTail+1 )
+        return 0;
+    __sync_synchronize();
+    m = cell.message;
+    __sync_synchronize();
+    cell.sequence = logqTail + logqCapacity;
+    logqTail++;
+    return m;
+}
+
+static void write_message(const char* m) {
+    if( logTarget==debuglog_syslog ) {
+        // syslog(3) wants one line per entry
+        const char*  eol;
+
+        while( *m!='\0' ) {
+            if( (eol=::strchr(m, '\n'))==0 )
+                eol = m + ::strlen(m);
+            if( eol>m )
+                ::syslog(LOG_INFO, "%.*s", (int)(eol-m), m);
+            m = (*eol=='\0') ? eol : eol+1;
+        }
+        return;
+    }
+    size_t  n = ::strlen(m);
+
+    while( n>0 ) {
+        const ssize_t  w = ::write(logFd, m, n);
+
+        if( w<0 ) {
+            if( errno==EINTR )
+                continue;
+            // nowhere left to complain to
+            break;
+        }
+        m += w;
+        n -= (size_t)w;
+    }
+}
+
+static unsigned int drain_logq( void ) {
+    char*         m;
+    unsigned int  n = 0;
+
+    while( (m=logq_pop())!=0 ) {
+        write_message(m);
+        ::free(m);
+        logWritten++;
+        n++;
+    }
+    return n;
+}
+
+static void* logger_thread(void*) {
+    unsigned long long  reported = 0;
+
+    while( true ) {
+        const unsigned int  n = drain_logq();
+        unsigned long long  dropped = logDropped;
+
+        if( dropped!=reported ) {
+            std::ostringstream  oss;
+
+            oss << "debuglog: " << (dropped - reported) << " message(s) dropped" << std::endl;
+            write_message(oss.str().c_str());
+            reported = dropped;
+        }
+        // Whatever was pushed since the drain above, before logStop was
+        // set, must still be written
+        if( logStop ) {
+            drain_logq();
+            break;
+        }
+        if( n==0 ) {
+            char  buf[64];
+
+            logSleeping = true;
+            __sync_synchronize();
+            // A producer that pushed before seeing logSleeping doesn't wake
+            // us, so look once more
+            if( logq_empty() && !logStop )
+                while( ::read(logWake[0], buf, sizeof(buf))<0 && errno==EINTR ) { }
+            logSleeping = false;
+        }
+    }
+    return 0;
+}
+
+// Must be called with logControl held
+static void stop_logger( void ) {
+    if( !logRunning )
+        return;
+    logRunning = false;
+    __sync_synchronize();
+
+    // Producers that saw logRunning may still be pushing; after they're
+    // done nobody else will. The logger thread writes everything before
+    // it leaves
+    while( logInFlight )
+        ::sched_yield();
+    logStop = true;
+    __sync_synchronize();
+    wake_logger();
+    ::pthread_join(logThread, 0);
+
+    if( logTarget==debuglog_file )
+        ::close(logFd);
+    if( logTarget==debuglog_syslog )
+        ::closelog();
+    logFd     = -1;
+    logTarget = debuglog_sync;
+    logPath.clear();
+}
+
+debuglog_stats::debuglog_stats():
+    target( debuglog_sync ), nQueued( 0 ), nWritten( 0 ), nDropped( 0 ), capacity( 0 )
+{}
+
+const char* debuglog_target_name(debuglog_target t) {
+    switch( t ) {
+        case debuglog_sync:   return "sync";
+        case debuglog_stderr: return "stderr";
+        case debuglog_file:   return "file";
+        case debuglog_syslog: return "syslog";
+        default:              break;
+    }
+    return "<unknown>";
+}
+
+bool debuglog_start(debuglog_target target, const std::string& path) {
+    int   fd = -1;
+
+    if( target==debuglog_sync ) {
+        debuglog_stop();
+        return true;
+    }
+    if( target==debuglog_file && (fd=::open(path.c_str(), O_WRONLY|O_CREAT|O_APPEND, 0644))<0 )
+        return false;
+
+    ::pthread_mutex_lock(&logControl);
+    stop_logger();
+
+    if( !logqInit ) {
+        // Producers must never block on waking the logger
+        if( ::pipe(logWake)!=0 ) {
+            if( target==debuglog_file )
+                ::close(fd);
+            ::pthread_mutex_unlock(&logControl);
+            return false;
+        }
+        ::fcntl(logWake[1], F_SETFL, O_NONBLOCK);
+        for(unsigned long i=0; i<logqCapacity; i++)
+            logq[i].sequence = i;
+        logqInit = true;
+    }
+    logTarget = target;
+    logPath   = path;
+    logFd     = (target==debuglog_stderr ? STDERR_FILENO : fd);
+    if( target==debuglog_syslog )
+        ::openlog("jive5ab", LOG_PID, LOG_DAEMON);
+
+    logStop     = false;
+    logSleeping = false;
+    if( ::pthread_create(&logThread, 0, logger_thread, 0)!=0 ) {
+        if( target==debuglog_file )
+            ::close(fd);
+        if( target==debuglog_syslog )
+            ::closelog();
+        logFd     = -1;
+        logTarget = debuglog_sync;
+        logPath.clear();
+        ::pthread_mutex_unlock(&logControl);
+        return false;
+    }
+    __sync_synchronize();
+    logRunning = true;
+
+    // Messages still in the queue when the program exits must be written
+    if( !logAtExit ) {
+        ::atexit(debuglog_stop);
+        logAtExit = true;
+    }
+    ::pthread_mutex_unlock(&logControl);
+    return true;
+}
+
+void debuglog_stop( void ) {
+    ::pthread_mutex_lock(&logControl);
+    stop_logger();
+    ::pthread_mutex_unlock(&logControl);
+}
+
+debuglog_stats debuglog_get_stats( void ) {
+    debuglog_stats  rv;
+
+    ::pthread_mutex_lock(&logControl);
+    rv.target   = logTarget;
+    rv.path     = logPath;
+    rv.nQueued  = logQueued;
+    rv.nWritten = logWritten;
+    rv.nDropped = logDropped;
+    rv.capacity = (unsigned int)logqCapacity;
+    ::pthread_mutex_unlock(&logControl);
+    return rv;
+}
+
+void do_debug_log(const std::string& s) {
+    // (__sync_fetch_and_add() is a full barrier)
+    __sync_fetch_and_add(&logInFlight, 1);
+    if( logRunning ) {
+        char*  m = (char*)::malloc(s.size()+1);
+
+        if( m!=0 ) {
+            ::memcpy(m, s.c_str(), s.size()+1);
+            if( logq_push(m) ) {
+                __sync_fetch_and_add(&logQueued, 1);
+                __sync_synchronize();
+                if( logSleeping && __sync_bool_compare_and_swap(&logSleeping, true, false) )
+                    wake_logger();
+                __sync_fetch_and_sub(&logInFlight, 1);
+                return;
+            }
+            ::free(m);
+        }
+        __sync_fetch_and_add(&logDropped, 1);
+        __sync_fetch_and_sub(&logInFlight, 1);
+        return;
+    }
+    __sync_fetch_and_sub(&logInFlight, 1);
+    do_cerr_lock();
+    std::cerr << s;
+    do_cerr_unlock();
+}
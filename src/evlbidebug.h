@@ -22,6 +22,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <string>
 #include <time.h>
 #include <sys/time.h>
 #include <stdio.h>
@@ -48,9 +49,43 @@ int fnthres_fn( int n );  // set current threshold value, returns previous level
 void do_cerr_lock( void );
 void do_cerr_unlock( void );
 
+// Where the DEBUG() messages go. With 'debuglog_sync' the thread issuing
+// the DEBUG() writes the message to std::cerr itself, holding the cerr
+// lock - which may take a while if the terminal or logfile is slow.
+// The other targets are asynchronous: the message is put in a lock-free
+// queue and a separate logger thread writes it to the target. The thread
+// issuing the DEBUG() never waits; if the queue is full the message is
+// dropped and counted.
+enum debuglog_target {
+    debuglog_sync = 0, debuglog_stderr, debuglog_file, debuglog_syslog
+};
+
+struct debuglog_stats {
+    debuglog_target     target;
+    std::string         path;       // only for debuglog_file
+    unsigned long long  nQueued, nWritten, nDropped;
+    unsigned int        capacity;
+
+    debuglog_stats();
+};
+
+const char*    debuglog_target_name(debuglog_target t);
+
+// (Re)direct the messages to 'target'. Messages still in the queue are
+// written to the previous target first. Returns false (and leaves the
+// current target) if 'path' could not be opened.
+bool           debuglog_start(debuglog_target target, const std::string& path = std::string());
+// Write out everything queued and go back to debuglog_sync
+void           debuglog_stop( void );
+debuglog_stats debuglog_get_stats( void );
+
+// Output a fully formatted message
+void do_debug_log(const std::string& s);
+
 // Prepare the debugstring in a local variable.
 // We do that so the amount of time spent holding the lock
-// is minimal.
+// is minimal - or, with an asynchronous target, so it can be queued
+// as one message.
 // this printed the actual level of the message. taken that out
 //            OsS_ZyP << a << " ";
 #define DEBUG(a, b) \
@@ -68,9 +103,7 @@ void do_cerr_unlock( void );
             if( dbglev_fn()>fnthres_fn() ) \
                 OsS_ZyP << EVDBG_FUNC; \
             OsS_ZyP << b;\
-            do_cerr_lock();\
-            std::cerr << OsS_ZyP.str();\
-            do_cerr_unlock();\
+            do_debug_log(OsS_ZyP.str());\
         }\
     } while( 0 );
 
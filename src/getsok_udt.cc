@@ -18,12 +18,18 @@
 //          P.O. Box 2
 //          7990 AA Dwingeloo
 #include <getsok_udt.h>
+#include <netparms.h>   // for defUDTCC
 #include <evlbidebug.h>
 #include <dosyscall.h>
 #include <libudt5ab/udt.h> // for UDT ... gah!
 #include <ezexcept.h>
 #include <threadutil.h>
+#include <mutex_locker.h>
+#include <libudt5ab/common.h> // for CTimer, CSeqNo
 
+#include <map>
+#include <cstdlib>
+#include <algorithm>
 #include <stdexcept>
 
 #include <netinet/in.h>
@@ -47,7 +53,7 @@ DEFINE_EZEXCEPT(udtexception)
 // feature (setsockopt-option), I'll try to make it not fail under
 // systems that don't have it.
 // Throws if something fails.
-int getsok_udt( const string& host, unsigned short port, const string& /*proto*/, const unsigned int mtu ) {
+int getsok_udt( const string& host, unsigned short port, const string& /*proto*/, const unsigned int mtu, const string& cc ) {
     int                s;
     const string       realproto( "tcp" );      // for getprotoent() - we want protocol number for TCP
     unsigned int       slen( sizeof(struct sockaddr_in) );
@@ -93,9 +99,18 @@ int getsok_udt( const string& host, unsigned short port, const string& /*proto*/
     // This is client socket so we need to set the sendbufsize only
     UDTASSERT2_ZERO( UDT::setsockopt(s, SOL_SOCKET, UDT_SNDBUF, &bufsz, sizeof(bufsz)), UDT::close(s) );
 
-    // On a client socket we support congestion control
-    CCCFactory<IPDBasedCC>  ccf;
-    UDTASSERT2_ZERO( UDT::setsockopt(s, SOL_SOCKET, UDT_CC, &ccf, sizeof(&ccf)), UDT::close(s) );
+    // On a client socket we support congestion control. UDT clones the
+    // factory so we can pass the registry's instance
+    CCCVirtualFactory*  ccf = 0;
+    try {
+        ccf = udt_cc_factory( cc );
+    }
+    catch( ... ) {
+        UDT::close(s);
+        throw;
+    }
+    DEBUG(4, "getsok_udt: using congestion control '" << (cc.empty()?defUDTCC:cc) << "'" << endl);
+    UDTASSERT2_ZERO( UDT::setsockopt(s, SOL_SOCKET, UDT_CC, ccf, sizeof(ccf)), UDT::close(s) );
 
     // Bind to local
     src.sin_family      = AF_INET;
@@ -262,3 +277,143 @@ IPDBasedCC::~IPDBasedCC()
 {}
 
 
+
+
+// The rate based congestion control
+//
+// Fraction of packets that may be lost in one rate control interval
+// before we start backing off.
+static const double rateCCLossThreshold = 0.05;
+// Never go slower than this factor times the target period
+static const double rateCCMaxBackoff    = 4.0;
+// Without ipd, send at least at this rate (bits/s) until the link
+// bandwidth estimate has settled. UDT starts that at 1 packet/s.
+static const double rateCCStartRate     = 1.0e9;
+
+RateBasedCC::RateBasedCC() :
+    IPDBasedCC(), _lastRCTime( 0 ), _lastSeqNo( 0 ), _nLost( 0 ), _backoff( 1.0 ),
+    _lastBandwidth( 0 ), _settled( false )
+{}
+
+void RateBasedCC::init() {
+    // ACK every SYN interval, like CUDTCC does. The window is not used
+    // to limit the rate, the packet sending period is
+    setACKTimer( m_iSYNInterval );
+
+    _lastRCTime     = CTimer::getTime();
+    _lastSeqNo      = m_iSndCurrSeqNo;
+    _nLost          = 0;
+    _backoff        = 1.0;
+    _lastBandwidth  = m_iBandwidth;
+    _settled        = false;
+    m_dCWndSize     = m_dMaxCWndSize;
+    m_dPktSndPeriod = this->target_period();
+}
+
+void RateBasedCC::onACK(int32_t) {
+    const uint64_t  now = CTimer::getTime();
+
+    if( now - _lastRCTime < (uint64_t)m_iSYNInterval )
+        return;
+
+    // how many packets did we send in this interval and how many of
+    // those were reported lost?
+    const int  nsent = CSeqNo::seqlen(_lastSeqNo, m_iSndCurrSeqNo) - 1;
+
+    if( nsent>0 ) {
+        const double lossfrac = double(_nLost)/double(nsent);
+
+        // multiplicative decrease like CUDTCC does but only on
+        // significant loss; recover by 1/16th per interval otherwise
+        if( lossfrac>rateCCLossThreshold )
+            _backoff = std::min(_backoff * 1.125, rateCCMaxBackoff);
+        else
+            _backoff = std::max(_backoff * 0.9375, 1.0);
+    }
+    // The estimate moves 1/8th towards the measured value on each ACK;
+    // once it changes little over an interval it is taken as is
+    if( !_settled && m_iBandwidth>1 && std::abs(m_iBandwidth - _lastBandwidth)<=m_iBandwidth/16 )
+        _settled = true;
+    _lastBandwidth  = m_iBandwidth;
+    _lastRCTime     = now;
+    _lastSeqNo      = m_iSndCurrSeqNo;
+    _nLost          = 0;
+    m_dCWndSize     = m_dMaxCWndSize;
+    m_dPktSndPeriod = this->target_period() * _backoff;
+}
+
+void RateBasedCC::onLoss(const int32_t* losslist, int size) {
+    // Loss list format (see packet.cpp): a seqno with the most significant
+    // bit set starts a range, the next entry is the end of that range
+    for( int i=0; i<size; i++ ) {
+        if( losslist[i] & 0x80000000 ) {
+            if( i+1<size )
+                _nLost += (uint64_t)CSeqNo::seqlen(losslist[i] & 0x7FFFFFFF, losslist[i+1]);
+            i++;
+        } else {
+            _nLost++;
+        }
+    }
+}
+
+void RateBasedCC::onTimeout() {
+    // No drastic action - the retransmissions are handled by UDT itself
+    // and the rate is re-evaluated on the next ACK
+}
+
+double RateBasedCC::target_period( void ) const {
+    const unsigned int ipd = this->get_ipd();
+
+    if( ipd>0 )
+        return double(ipd) / 1000.0;
+
+    // no ipd set: hold the estimated link capacity (UDT keeps it >= 1).
+    // Until that has settled, not slower than the start rate
+    const double  estimated = 1000000.0 / double(std::max(m_iBandwidth, 1));
+
+    if( _settled )
+        return estimated;
+    return std::min(estimated, double(m_iMSS) * 8.0e6 / rateCCStartRate);
+}
+
+RateBasedCC::~RateBasedCC()
+{}
+
+
+// The registry of congestion control algorithms
+typedef std::map<std::string, CCCVirtualFactory*>  cc_registry_type;
+
+static pthread_mutex_t   cc_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Must be called with the lock held. Fills in the built-in algorithms
+// on first use
+static cc_registry_type& cc_registry( void ) {
+    static cc_registry_type  registry;
+
+    if( registry.empty() ) {
+        registry.insert( make_pair(defUDTCC, new CCCFactory<IPDBasedCC>()) );
+        registry.insert( make_pair(string("rate"), new CCCFactory<RateBasedCC>()) );
+    }
+    return registry;
+}
+
+CCCVirtualFactory* udt_cc_factory(const string& name) {
+    mutex_locker                      locker( cc_registry_lock );
+    cc_registry_type&                 registry( cc_registry() );
+    cc_registry_type::const_iterator  p = registry.find( name.empty()?defUDTCC:name );
+
+    EZASSERT2( p!=registry.end(), udtexception,
+               EZINFO("unknown UDT congestion control '" << name << "'") );
+    return p->second;
+}
+
+string udt_cc_names( void ) {
+    mutex_locker                      locker( cc_registry_lock );
+    ostringstream                     names;
+    cc_registry_type&                 registry( cc_registry() );
+    cc_registry_type::const_iterator  p;
+
+    for( p=registry.begin(); p!=registry.end(); p++ )
+        names << (p==registry.begin()?"":",") << p->first;
+    return names.str();
+}
@@ -32,7 +32,10 @@ DECLARE_EZEXCEPT(udtexception)
 // Returns the filedescriptor for this open connection.
 // It will be in blocking mode.
 // Throws if something fails.
-int getsok_udt( const std::string& host, unsigned short port, const std::string& proto, const unsigned int mtu);
+// The congestion control algorithm is looked up by name in the
+// registry below; empty means the default ("ipd")
+int getsok_udt( const std::string& host, unsigned short port, const std::string& proto, const unsigned int mtu,
+                const std::string& cc = "");
 
 // Get a socket for incoming connections.
 // The returned filedescriptor is in blocking mode.
@@ -73,6 +76,52 @@ class IPDBasedCC:
         unsigned int  _ipd_in_ns;
 };
 
+// Rate based congestion control for long-haul links with small random
+// loss. Where CUDTCC backs off on every loss event, this one holds the
+// target rate - given by the ipd or, if no ipd set, the estimated link
+// bandwidth (at least 1Gbps until the estimate has settled) - and only
+// backs off when the fraction of lost packets over
+// a rate control interval exceeds a threshold. As soon as the loss
+// drops below the threshold again it creeps back up to the target.
+// Derived from IPDBasedCC such that everything that sets the ipd keeps
+// working unmodified.
+class RateBasedCC:
+    public IPDBasedCC
+{
+    public:
+        RateBasedCC();
+
+        virtual void init();
+        virtual void onACK(int32_t seqno);
+        virtual void onLoss(const int32_t* losslist, int size);
+        virtual void onTimeout();
+
+        virtual ~RateBasedCC();
+
+    private:
+        uint64_t  _lastRCTime;  // time of last rate update (us)
+        int32_t   _lastSeqNo;   // highest seqno sent at that time
+        uint64_t  _nLost;       // packets reported lost since then
+        double    _backoff;     // >= 1.0; multiplies the target period
+        int       _lastBandwidth; // link estimate at last rate update
+        bool      _settled;     // wether that estimate can be used as is
+
+        // the period (in us) we'd send at without any loss
+        double target_period( void ) const;
+};
+
+
+// Registry of congestion control algorithms selectable for UDT
+// connections via "net_protocol=udt:<name>". Contains:
+//    ipd   - IPDBasedCC (the default)
+//    rate  - RateBasedCC
+// Returns the factory for the algorithm called 'name' - the default if
+// 'name' is empty. Throws udtexception if the name is not known.
+CCCVirtualFactory* udt_cc_factory(const std::string& name);
+
+// Comma separated list of all registered names
+std::string        udt_cc_names( void );
+
 
 // We need to handle calls to the UDT::* functions a little bit different
 #ifdef __GNUC__
@@ -339,6 +339,12 @@ extern unsigned char st_syncword[];
 // mark5b syncword (0xABADDEED in little endian)
 static unsigned char mark5b_syncword[] = {0xed, 0xde, 0xad, 0xab};
 
+// VDIF reference epochs start on Jan 1st or Jul 1st; return the day of
+// the year (zero based) of the start of 'ref_epoch'
+static int vdif_epoch_yday(int ref_epoch) {
+    return (ref_epoch%2) ? 181 + (::is_leap_year(2000 + ref_epoch/2) ? 1 : 0) : 0;
+}
+
 // Mark4 timestamp is 13 BCD coded digits
 // YDDD HHMM SSss s     BCD
 // 0 1  2 3  4 5  6     byte index
@@ -519,14 +525,16 @@ highrestime_type decode_mk4_timestamp(unsigned char const* trackdata, const samp
         m4_time.tm_year -= 10;
 
     // Now that we have a properly filled in struct tm
-    // it's simple to make a time_t out of it.
-    // We must not forget to correct the '- 1900'
-    // Make sure the timezone environment variable is set to empty or to
-    // UTC!!!
-    m4_time.tm_year -= 1900;
-    frametime.tv_sec  = ::mktime(&m4_time);
+    // it's simple to make a time_t out of it: day-of-year and time-of-day
+    // are UTC so it's integer arithmetic only; mktime(3) would be by far
+    // the most expensive part of decoding the frame.
+    frametime.tv_sec  = ::utc_seconds(m4_time.tm_year, m4_time.tm_mday-1,
+                                      (time_t)3600*m4_time.tm_hour + 60*m4_time.tm_min + m4_time.tm_sec);
 
 #ifdef GDBDEBUG
+    // We must not forget to correct the '- 1900'
+    m4_time.tm_year -= 1900;
+    ::mktime(&m4_time);
     char buf[32];
     ::strftime(buf, sizeof(buf), "%d-%b-%Y (%j) %Hh%Mm%Ss", &m4_time);
     DEBUG(4, "mk4_ts: after normalization " << buf << " +" << frametime.tv_subsecond << "s" << endl);
@@ -544,7 +552,7 @@ highrestime_type decode_mk4_timestamp(unsigned char const* trackdata, const samp
 // is arguably easier to maintain/debug
 template <typename Header>
 highrestime_type decode_vlba_timestamp(Header const* ts, const headersearch::strict_type /*strict*/) {
-    const int       current_mjd = (int)::mjdnow();
+    const int       current_mjd = ::mjdtoday();
     struct tm       vlba_time;
     struct timespec rv = {0, 0};
 
@@ -609,12 +617,13 @@ highrestime_type decode_vlba_timestamp(Header const* ts, const headersearch::str
 #endif
 
     // We've set the date to the "tm_mday'th of Jan, 1970".
-    // Let the normalization work out the year/day-of-year from that.
-    // This only works correctly if the timezone environment variable has been set to empty or "UTC"
-    // (see ctime(3), tzset(3))
-    rv.tv_sec  = ::mktime(&vlba_time);
+    // The UNIX time is then simply the number of whole days plus the
+    // seconds within the day - no need for mktime(3) and the timezone
+    rv.tv_sec  = ::utc_seconds(1970, vlba_time.tm_mday-1,
+                               (time_t)3600*vlba_time.tm_hour + 60*vlba_time.tm_min + vlba_time.tm_sec);
 
 #ifdef GDBDEBUG
+    ::mktime(&vlba_time);
     char buf[32];
     ::strftime(buf, sizeof(buf), "%d-%b-%Y (%j) %Hh%Mm%Ss", &vlba_time);
     DEBUG(4, "vlba_ts: after normalization " << buf << " +" << (((double)rv.tv_nsec)*1.0e-9) << "s" << endl);
@@ -905,13 +914,14 @@ void encode_mk5b_timestamp(unsigned char* framedata,
     // Mk5B framesize == 10000 bytes == 80000 bits == 8.0e4 bits
     // 1s = 1.0e9 ns
     const samplerate_type frametime( hdr->get_state().frametime );
-    const subsecond_type  framenum( ts.tv_subsecond / frametime );
 
-    EZASSERT2(framenum.denominator()==1, headersearch_exception,
+    EZASSERT2(isMultipleOf(ts.tv_subsecond, frametime), headersearch_exception,
               EZINFO("time stamp " << ts << " is not representable as multiple of frame time " << frametime));
-    EZASSERT2(framenum.numerator()<UINT_MAX, headersearch_exception,
+    const uint64_t        framenum( nPeriod(ts.tv_subsecond, frametime) );
+
+    EZASSERT2(framenum<UINT_MAX, headersearch_exception,
               EZINFO("time stamp " << ts << " results in frame number > 2^32-1 for frame time " << frametime));
-    framenr      = (unsigned int)framenum.numerator();
+    framenr      = (unsigned int)framenum;
     word[1] = (framenr & 0x7fff);
 
     // TMJD + Integer seconds
@@ -964,30 +974,26 @@ void encode_vdif_timestamp(unsigned char* framedata,
 
     // Now set the zero point of that epoch, 00h00m00s on the 1st day of
     // month 0 (Jan) or 6 (July)
-    klad.tm_hour  = 0;
-    klad.tm_min   = 0; 
-    klad.tm_sec   = 0;
-    klad.tm_mon   = (klad.tm_mon/6)*6;
-    klad.tm_mday  = 1;
-    const time_t          tm_epoch = ::mktime(&klad);
+    const time_t          tm_epoch = ::utc_seconds(klad.tm_year + 1900, vdif_epoch_yday(epoch), 0);
     const samplerate_type frametime( hdr->get_state().frametime );
-    const subsecond_type  framenum( ts.tv_subsecond / frametime );
+
+    EZASSERT2(isMultipleOf(ts.tv_subsecond, frametime), headersearch_exception,
+              EZINFO("time stamp " << ts << " is not representable as multiple of frame time " << frametime));
+    const uint64_t        framenum( nPeriod(ts.tv_subsecond, frametime) );
 
 #ifdef GDBDEBUG
     DEBUG(4, "encode_vdif_ts: ts=" << ts << " (subsecond=" << ts.tv_subsecond << ") " << endl <<
              "                frametime=" << frametime << " => framenum=" << framenum << endl);
 #endif
 
-    EZASSERT2(framenum.denominator()==1, headersearch_exception,
-              EZINFO("time stamp " << ts << " is not representable as multiple of frame time " << frametime));
-    EZASSERT2(framenum.numerator()<((0x1<<24) - 1), headersearch_exception,
+    EZASSERT2(framenum<((0x1<<24) - 1), headersearch_exception,
               EZINFO("time stamp " << ts << " results in 24bit frame number overflow with frame time of " << frametime));
 
     vdif_hdr->legacy          = (hdr->frameformat==fmt_vdif_legacy);
     vdif_hdr->data_frame_len8 = (unsigned int)(((hdr->payloadsize+(vdif_hdr->legacy?16:32))/8) & 0x00ffffff);
     vdif_hdr->ref_epoch       = (unsigned char)(epoch & 0x3f);
     vdif_hdr->epoch_seconds   = (unsigned int)((ts.tv_sec - tm_epoch) & 0x3fffffff);
-    vdif_hdr->data_frame_num  = (uint32_t)(framenum.numerator()&0xffffff);
+    vdif_hdr->data_frame_num  = (uint32_t)(framenum&0xffffff);
     return;
 }
 
@@ -1040,12 +1046,7 @@ void encode_vdif2_timestamp(unsigned char* framedata,
 
     // Now set the zero point of that epoch, 00h00m00s on the 1st day of
     // month 0 (Jan) or 6 (July)
-    klad.tm_hour  = 0;
-    klad.tm_min   = 0; 
-    klad.tm_sec   = 0;
-    klad.tm_mon   = (klad.tm_mon/6)*6;
-    klad.tm_mday  = 1;
-    const time_t          tm_epoch = ::mktime(&klad);
+    const time_t          tm_epoch = ::utc_seconds(klad.tm_year + 1900, vdif_epoch_yday(epoch), 0);
 
 #ifdef GDBDEBUG
     DEBUG(4, "encode_vdif2_ts: ts=" << ts << " (subsecond=" << ts.tv_subsecond << ") " << endl <<
@@ -1243,23 +1244,13 @@ highrestime_type  vdif_frame_timestamp(unsigned char const* framedata,
                                        const samplerate_type& trackbitrate,
                                        decoderstate_type* decoder,
                                        const headersearch::strict_type /*strict*/) {
-    struct tm                 tm;
     struct vdif_header const* hdr = (struct vdif_header const*)framedata;
 
     EZASSERT2(trackbitrate>0, headersearch_exception, EZINFO("Cannot do VDIF timedecoding when bitrate == 0"));
 
-    // Get integer part of the time
-    tm.tm_wday   = 0;
-    tm.tm_isdst  = 0;
-    tm.tm_yday   = 0;
-    tm.tm_mday   = 1;
-    tm.tm_hour   = 0;
-    tm.tm_min    = 0;
-    tm.tm_sec    = (int)hdr->epoch_seconds;
-    tm.tm_year   = 100 + (hdr->ref_epoch/2);
-    tm.tm_mon    = 6   * (hdr->ref_epoch%2);
-
-    return highrestime_type( ::mktime(&tm), 
+    // Integer part of the time is the start of the reference epoch plus
+    // the seconds since then
+    return highrestime_type( ::utc_seconds(2000 + hdr->ref_epoch/2, vdif_epoch_yday(hdr->ref_epoch), (time_t)hdr->epoch_seconds),
                              (trackbitrate==headersearch_type::UNKNOWN_TRACKBITRATE) ? 
                                  highrestime_type::UNKNOWN_SUBSECOND :
                                  hdr->data_frame_num * decoder->frametime );
@@ -238,5 +238,17 @@ bool operator<(const highrestime_type& l, const highrestime_type& r) {
 // i.e. a high time resolution time difference.
 // 'frameduration' is fractional seconds.
 bool isModulo(const highrestime_type& dt, const boost::rational<uint64_t>& frameduration) {
-    return ((dt.tv_sec + dt.tv_subsecond)/frameduration).denominator()==1;
+    // (tv_sec*b + a)/b is normalized if a/b is
+    const uint64_t  b = dt.tv_subsecond.denominator();
+    return isMultipleOf(subsecond_type((uint64_t)dt.tv_sec*b + dt.tv_subsecond.numerator(), b), frameduration);
+}
+
+bool isMultipleOf(const subsecond_type& t, const subsecond_type& period) {
+    if( period.numerator()==0 )
+        return false;
+    return (period.denominator() % t.denominator())==0 && (t.numerator() % period.numerator())==0;
+}
+
+uint64_t nPeriod(const subsecond_type& t, const subsecond_type& period) {
+    return (t.numerator()/period.numerator()) * (period.denominator()/t.denominator());
 }
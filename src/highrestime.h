@@ -71,6 +71,14 @@ bool operator<(const highrestime_type& l, const highrestime_type& r);
 // 'frameduration' is fractional seconds.
 bool isModulo(const highrestime_type& dt, const subsecond_type& frameduration);
 
+// Integer tests for "t is an integer multiple of period" and, if it is,
+// how many periods t is, without going through the gcd(3)s of rational
+// division; these are done for each frame. With t = a/b and period = c/d
+// (both normalized) t/period is an integer iff b divides d and c divides
+// a, and then equals (a/c)*(d/b).
+bool     isMultipleOf(const subsecond_type& t, const subsecond_type& period);
+uint64_t nPeriod(const subsecond_type& t, const subsecond_type& period);
+
 std::ostream& operator<<(std::ostream& os, const highrestime_type& hrt);
 
 std::string tm2vex(const highrestime_type& hrt);
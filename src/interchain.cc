@@ -1,90 +1,224 @@
 #include <interchain.h>
 #include <iostream>
+#include <sstream>
 #include <mutex_locker.h>
+#include <pthreadcall.h>
 #include <evlbidebug.h>
+#include <vector>
 #include <set>
 
 using namespace std;
 
 DEFINE_EZEXCEPT(interchainexception)
 
-// global queue object used to communicate between 2 chains (written into by queue_writers, read from by queue_readers)
-struct interchain_queues_type {
-    set< bqueue<block>* > queues;
-    interchain_queues_type() {}
-    ~interchain_queues_type() {
-        // all registered queues should be removed at this stage, so check it
-        if ( !queues.empty() ) {
+// The global broadcast ring used to communicate between chains. Written
+// into by queue_writers/queue_forkers, read from by queue_readers.
+//
+// Blocks are refcounted so the ring holds a reference to each block only
+// once, irrespective of the number of taps. The data itself is never
+// copied. Slots that every tap has read are released immediately so
+// blocks go back to the recording's pool as soon as possible; when there
+// are no taps nothing is kept at all.
+//
+// The producer and taps serialize on one mutex; it is only held for a
+// block copy (refcount update) and some bookkeeping. The producer never
+// waits for a tap.
+struct interchain_ring_type {
+    typedef set<interchain_tap*>  taps_type;
+
+    bool             enabled;
+    uint64_t         head;        // sequence number of next block to push
+    uint64_t         tail;        // all slots before this one are released
+    uint64_t         generation;  // +1 each time the source stops
+    unsigned int     nWaiting;    // taps waiting in pop()
+    vector<block>    slots;
+    taps_type        taps;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   condition;
+
+    interchain_ring_type():
+        enabled( false ), head( 0 ), tail( 0 ), generation( 0 ), nWaiting( 0 ),
+        slots( 1024 )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+        PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+    }
+
+    // the cursor a tap actually continues at, counting drops
+    // (mutex must be held)
+    void catch_up(interchain_tap* tap) {
+        const uint64_t  cap = slots.size();
+
+        if( head-tap->cursor<=cap )
+            return;
+        const uint64_t  newcursor = (tap->policy==interchain_skip_to_newest ? head-1 : head-cap);
+
+        tap->nDropped += (newcursor - tap->cursor);
+        tap->cursor    = newcursor;
+    }
+
+    // release slots that no tap needs anymore (mutex must be held)
+    void release( void ) {
+        uint64_t  oldest = head;
+
+        for(taps_type::const_iterator p=taps.begin(); p!=taps.end(); p++)
+            oldest = std::min(oldest, (*p)->cursor);
+        // never go back in time nor release more than there is in the ring
+        oldest = std::max(oldest, tail);
+        if( head-oldest>slots.size() )
+            oldest = head - slots.size();
+        for( ; tail<oldest; tail++)
+            slots[ tail % slots.size() ] = block();
+        tail = oldest;
+    }
+
+    ~interchain_ring_type() {
+        // all registered taps should be removed at this stage, so check it
+        if ( !taps.empty() ) {
             DEBUG( -1, "Error: not all interchain queues are removed at cleanup!" << endl);
-            for ( set< bqueue<block>* >::iterator i = queues.begin();
-                  i != queues.end();
-                  i++) {
+            for ( taps_type::iterator i = taps.begin(); i != taps.end(); i++)
                 delete *i;
-            }
         }
+        ::pthread_cond_destroy(&condition);
+        ::pthread_mutex_destroy(&mutex);
     }
 };
 
-static interchain_queues_type interchain;
-static pthread_rwlock_t interchain_lock = PTHREAD_RWLOCK_INITIALIZER;
-static bqueue<block>::capacity_type capacity = 1024;
+static interchain_ring_type interchain;
+
+
+interchain_tap::interchain_tap(interchain_policy p):
+    policy( p ), pop_enabled( false ), cursor( 0 ), generation( 0 ), nDropped( 0 ), nPopped( 0 )
+{}
+
+interchain_tap::~interchain_tap() {}
+
+bool interchain_tap::pop( block& b ) {
+    mutex_locker   locker( interchain.mutex );
+
+    while( pop_enabled ) {
+        if( cursor<interchain.head ) {
+            interchain.catch_up(this);
+            b = interchain.slots[ cursor % interchain.slots.size() ];
+            cursor++;
+            nPopped++;
+            interchain.release();
+            return true;
+        }
+        if( generation!=interchain.generation ) {
+            // the source stopped since we last looked and we've read
+            // everything it produced
+            generation  = interchain.generation;
+            pop_enabled = false;
+            break;
+        }
+        interchain.nWaiting++;
+        PTHREAD_CALL( ::pthread_cond_wait(&interchain.condition, &interchain.mutex) );
+        interchain.nWaiting--;
+    }
+    return false;
+}
+
+void interchain_tap::enable_pop_only( void ) {
+    mutex_locker   locker( interchain.mutex );
+    pop_enabled = true;
+}
+
+void interchain_tap::disable_pop( void ) {
+    mutex_locker   locker( interchain.mutex );
+    pop_enabled = false;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&interchain.condition) );
+}
+
+uint64_t interchain_tap::lag( void ) const {
+    mutex_locker   locker( interchain.mutex );
+    return interchain.head - cursor;
+}
+uint64_t interchain_tap::dropped( void ) const {
+    mutex_locker   locker( interchain.mutex );
+    return nDropped;
+}
+uint64_t interchain_tap::popped( void ) const {
+    mutex_locker   locker( interchain.mutex );
+    return nPopped;
+}
+
+
+interchain_tap* request_interchain_queue( interchain_policy policy ) {
+    interchain_tap* tap = new interchain_tap( policy );
+    mutex_locker    locker( interchain.mutex );
 
-bqueue<block>* request_interchain_queue() {
-    bqueue<block>* q = new bqueue<block>();
-    rw_write_locker locker( interchain_lock );
-    EZASSERT2( interchain.queues.insert(q).second, interchainexception,
+    EZASSERT2( interchain.taps.insert(tap).second, interchainexception,
                EZINFO("Interchain queue is already registered?!?!") );
-    // enable the queue to receive data, so it can jump into the middle
-    // of a running transfer
-    q->resize_enable_push( capacity );
-    return q;
+    // start reading at the current position, so it can jump into the
+    // middle of a running transfer
+    tap->cursor     = interchain.head;
+    tap->generation = interchain.generation;
+    return tap;
 }
 
-void remove_interchain_queue( bqueue<block>* queue ) {
-    rw_write_locker locker( interchain_lock );
-    set< bqueue<block>* >::iterator i = interchain.queues.find(queue);
-    EZASSERT2( i != interchain.queues.end(), interchainexception, 
+void remove_interchain_queue( interchain_tap* tap ) {
+    mutex_locker                          locker( interchain.mutex );
+    interchain_ring_type::taps_type::iterator i = interchain.taps.find(tap);
+
+    EZASSERT2( i != interchain.taps.end(), interchainexception,
                EZINFO("Failed to find queue to remove") );
-    delete *i;
-    interchain.queues.erase(i);
+    DEBUG(3, "remove_interchain_queue: tap read " << tap->nPopped << " blocks, dropped " << tap->nDropped << endl);
+    interchain.taps.erase(i);
+    delete tap;
+    interchain.release();
 }
 
 bool interchain_queues_push( block& b ) {
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
-          i != interchain.queues.end();
-          i++ ) {
-        if ( !(*i)->push( b ) ) {
-            return false;
-        }
-    }
+    mutex_locker   locker( interchain.mutex );
+
+    if( !interchain.enabled )
+        return false;
+    // Without taps there's no need to hang on to the data
+    if( !interchain.taps.empty() )
+        interchain.slots[ interchain.head % interchain.slots.size() ] = b;
+    interchain.head++;
+    interchain.release();
+    if( interchain.nWaiting )
+        PTHREAD_CALL( ::pthread_cond_broadcast(&interchain.condition) );
     return true;
 }
 
 void interchain_queues_try_push( block& b ) {
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
-          i != interchain.queues.end();
-          i++ ) {
-        (*i)->try_push( b );
-    }
+    interchain_queues_push( b );
 }
 
 void interchain_queues_disable() {
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
-          i != interchain.queues.end();
-          i++ ) {
-        (*i)->disable();
-    }
+    mutex_locker   locker( interchain.mutex );
+    interchain.enabled = false;
+    interchain.generation++;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&interchain.condition) );
 }
 
-void interchain_queues_resize_enable_push( bqueue<block>::capacity_type newcap ) {
-    capacity = newcap;
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
-          i != interchain.queues.end();
-          i++ ) {
-        (*i)->resize_enable_push( newcap );
+void interchain_queues_resize_enable_push( unsigned int newcap ) {
+    mutex_locker   locker( interchain.mutex );
+
+    EZASSERT2( newcap>0, interchainexception, EZINFO("interchain capacity must be > 0") );
+    // Start afresh; whatever was left unread from a previous
+    // source transfer is gone
+    interchain.slots   = vector<block>( newcap );
+    interchain.head    = 0;
+    interchain.tail    = 0;
+    interchain.enabled = true;
+    // The taps start reading the new source; a stop of the previous one
+    // they haven't seen yet must not end that
+    for(interchain_ring_type::taps_type::iterator p=interchain.taps.begin(); p!=interchain.taps.end(); p++) {
+        (*p)->cursor     = 0;
+        (*p)->generation = interchain.generation;
     }
 }
+
+string interchain_status( void ) {
+    ostringstream  oss;
+    mutex_locker   locker( interchain.mutex );
+
+    oss << interchain.slots.size() << " : " << interchain.head;
+    for(interchain_ring_type::taps_type::const_iterator p=interchain.taps.begin(); p!=interchain.taps.end(); p++)
+        oss << " : " << (interchain.head - (*p)->cursor) << "/" << (*p)->nDropped << "/" << (*p)->nPopped;
+    return oss.str();
+}
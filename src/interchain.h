@@ -2,22 +2,80 @@
 #define JIVE5A_INTERCHAIN_H
 
 #include <block.h>
-#include <bqueue.h>
 #include <ezexcept.h>
+#include <string>
+
+#include <pthread.h>
+#include <stdint.h>
 
 DECLARE_EZEXCEPT(interchainexception)
 
-// functions to setup queues used by thread functions to communicate data between runtimes/chains
-bqueue<block>* request_interchain_queue();
-void remove_interchain_queue( bqueue<block>* queue );
+// Data recorded in one chain can be tapped by other chains (mem2net,
+// mem2file, mem2time, ...). The recording chain puts each block, once, in
+// a broadcast ring. Each tap has its own read cursor into that ring so a
+// tap can never stall the recording: a tap that falls behind by more than
+// the ring's capacity loses data according to its drop policy.
+enum interchain_policy {
+    // continue with the oldest block still available
+    interchain_drop_oldest,
+    // continue with the newest block; lowest latency, for monitoring
+    interchain_skip_to_newest
+};
+
+class interchain_tap {
+    public:
+        // Wait for the next block. Returns false if popping was disabled
+        // or once after the source transfer stopped and all its data was
+        // read; a new pop() waits for a new source transfer.
+        bool     pop( block& b );
+
+        // (re)allow popping c.q. make pop() return false (and wake up a
+        // waiting pop())
+        void     enable_pop_only( void );
+        void     disable_pop( void );
+
+        // how many blocks this tap is behind the producer, how many it
+        // lost and how many it read
+        uint64_t lag( void ) const;
+        uint64_t dropped( void ) const;
+        uint64_t popped( void ) const;
+
+    private:
+        friend struct interchain_ring_type;
+        friend interchain_tap* request_interchain_queue( interchain_policy );
+        friend void remove_interchain_queue( interchain_tap* );
+        friend void interchain_queues_resize_enable_push( unsigned int );
+        friend std::string interchain_status( void );
 
-// push on all interchain queues, a blocking version and a non-blocking,
-// note that the blocking version blocks on ALL queues and returns true iff all pushes return true
+        const interchain_policy  policy;
+        bool                     pop_enabled;
+        uint64_t                 cursor;
+        uint64_t                 generation;
+        uint64_t                 nDropped;
+        uint64_t                 nPopped;
+
+        interchain_tap(interchain_policy p);
+        ~interchain_tap();
+
+        interchain_tap();
+        interchain_tap(const interchain_tap&);
+        const interchain_tap& operator=(const interchain_tap&);
+};
+
+// functions to setup taps used by thread functions to communicate data between runtimes/chains
+interchain_tap* request_interchain_queue( interchain_policy policy = interchain_drop_oldest );
+void remove_interchain_queue( interchain_tap* tap );
+
+// put a block in the ring. Neither of them ever blocks; the
+// first one returns false if the ring is not enabled.
 bool interchain_queues_push( block& b );
 void interchain_queues_try_push( block& b );
 
-// disable all interchain queues
+// The source transfer stops. Taps can read what's left in the ring.
 void interchain_queues_disable();
-// enable pushing on interchain queues
-void interchain_queues_resize_enable_push( bqueue<block>::capacity_type newcap );
+// A source transfer starts with a ring of 'newcap' blocks
+void interchain_queues_resize_enable_push( unsigned int newcap );
+
+// "<capacity> : <blocks pushed> : <lag>/<dropped>/<popped> : ..."
+std::string interchain_status( void );
 #endif
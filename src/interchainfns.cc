@@ -40,8 +40,8 @@ queue_writer_args::~queue_writer_args() {
     }
 }
 
-queue_reader_args::queue_reader_args() : rteptr(NULL), pool(NULL), run(false), reuse_blocks(false), finished(false) {}
-queue_reader_args::queue_reader_args(runtime* r) : rteptr(r), pool(NULL), run(false), reuse_blocks(false), finished(false) {}
+queue_reader_args::queue_reader_args() : rteptr(NULL), pool(NULL), run(false), reuse_blocks(false), finished(false), policy(interchain_drop_oldest) {}
+queue_reader_args::queue_reader_args(runtime* r) : rteptr(r), pool(NULL), run(false), reuse_blocks(false), finished(false), policy(interchain_drop_oldest) {}
 queue_reader_args::~queue_reader_args() {
     delete pool;
 }
@@ -133,7 +133,7 @@ void queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* args) {
 
     // Now we are really going to read data; better have a queue then!
     // the request_interchain_queue() always succeeds or throws an exception
-    bqueue<block>* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue();
+    interchain_tap* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue( qargs->policy );
 
     // Now we can indicate we're running!
     RTEEXEC(*rteptr,
@@ -234,7 +234,8 @@ void queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* args) {
         }
         nrestart++;
     }
-    DEBUG(0, "queue_reader v1: stopping" << endl);
+    DEBUG(0, "queue_reader v1: stopping, lag " << interchain_queue->lag() << " dropped "
+             << interchain_queue->dropped() << " blocks" << endl);
     qargs->finished = true;
 }
 
@@ -272,7 +273,7 @@ void stupid_queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* a
 
     // Now we are really going to read data; better have a queue then!
     // the request_interchain_queue() always succeeds or throws an exception
-    bqueue<block>* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue();
+    interchain_tap* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue( qargs->policy );
 
     // Now we can indicate we're running!
     RTEEXEC(*rteptr,
@@ -299,7 +300,8 @@ void stupid_queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* a
             }
         }
     }
-    DEBUG(0, "stupid_queue_reader: stopping, read " << counter << " (" << byteprint((double)counter, "byte") << ")" << endl);
+    DEBUG(0, "stupid_queue_reader: stopping, read " << counter << " (" << byteprint((double)counter, "byte") << "), "
+             << "lag " << interchain_queue->lag() << " dropped " << interchain_queue->dropped() << " blocks" << endl);
     qargs->finished = true;
 }
 
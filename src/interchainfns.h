@@ -24,6 +24,7 @@
 #include <block.h>
 #include <blockpool.h>
 #include <threadfns.h>
+#include <interchain.h>
 
 struct queue_writer_args {
     queue_writer_args();
@@ -41,6 +42,8 @@ struct queue_reader_args {
     bool run;
     bool reuse_blocks; // reuse blocks from interchain queue in this chain (if true), or always make a local copy (if false)
     bool finished;
+    // what to do if the reader falls behind the source too far
+    interchain_policy policy;
 
     queue_reader_args();
     queue_reader_args(runtime* r);
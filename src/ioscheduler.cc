@@ -0,0 +1,260 @@
+// process-wide scheduling of disk I/O between runtimes
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <ioscheduler.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <tracering.h>
+
+#include <map>
+#include <sstream>
+#include <algorithm>
+
+#include <time.h>
+#include <errno.h>
+#include <sys/time.h>
+
+using namespace std;
+
+// Longest a playback or copy I/O waits for its turn, in seconds
+static const time_t  maxWait = 1;
+
+static double delta_t(const struct timeval& a, const struct timeval& b) {
+    return (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_usec - a.tv_usec)/1.0e6;
+}
+
+// Bytes transferred and the rate, updated at most once per second
+struct iorate_type {
+    uint64_t        nbyte, lastbyte;
+    double          rate;
+    struct timeval  last;
+
+    iorate_type():
+        nbyte( 0 ), lastbyte( 0 ), rate( 0.0 )
+    {
+        ::gettimeofday(&last, 0);
+    }
+
+    void add(uint64_t n, const struct timeval& now) {
+        const double  dt = delta_t(last, now);
+
+        nbyte += n;
+        if( dt>=1.0 ) {
+            rate     = (double)(nbyte - lastbyte)/dt;
+            lastbyte = nbyte;
+            last     = now;
+        }
+    }
+
+    // If nothing's been added for a while the rate goes down
+    double current(const struct timeval& now) const {
+        const double  dt = delta_t(last, now);
+        return (dt>=2.0) ? (double)(nbyte - lastbyte)/dt : rate;
+    }
+};
+
+struct iodisk_type {
+    unsigned int  active[ioclass_nclass];
+    unsigned int  waiting[ioclass_nclass];
+    // bytes done divided by share: the class with the lowest goes first
+    double        vtime[ioclass_nclass];
+    uint64_t      nbyte[ioclass_nclass];
+    iorate_type   rate;
+
+    iodisk_type() {
+        std::fill(&active[0],  &active[ioclass_nclass],  0);
+        std::fill(&waiting[0], &waiting[ioclass_nclass], 0);
+        std::fill(&vtime[0],   &vtime[ioclass_nclass],   0.0);
+        std::fill(&nbyte[0],   &nbyte[ioclass_nclass],   0);
+    }
+};
+
+struct ioaccount_type {
+    iorate_type   rate;
+};
+
+// Disks and accounts are never removed, so the slots can keep pointers
+// to them
+struct iosched_type {
+    typedef map<string, iodisk_type>                    disks_type;
+    typedef map<pair<string, int>, ioaccount_type>      accounts_type;
+
+    iosched_parms    parms;
+    disks_type       disks;
+    accounts_type    accounts;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   condition;
+
+    iosched_type() {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+        PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+    }
+
+    ~iosched_type() {
+        ::pthread_cond_destroy(&condition);
+        ::pthread_mutex_destroy(&mutex);
+    }
+};
+
+static iosched_type  iosched;
+
+
+const char* ioclass_name(ioclass_type c) {
+    switch( c ) {
+        case ioclass_record:   return "record";
+        case ioclass_playback: return "playback";
+        case ioclass_copy:     return "copy";
+        default:               break;
+    }
+    return "<unknown>";
+}
+
+iosched_parms::iosched_parms():
+    playbackShare( 1 ), copyShare( 1 ), perDisk( 2 )
+{}
+
+static ioclass_type other_class(ioclass_type c) {
+    return (c==ioclass_playback) ? ioclass_copy : ioclass_playback;
+}
+
+static unsigned int share(ioclass_type c, const iosched_parms& p) {
+    return (c==ioclass_playback) ? p.playbackShare : p.copyShare;
+}
+
+// Playback/copy I/O may go if no recording I/O is being done, there is a
+// free slot and the other class, if waiting, isn't behind on its share
+static bool may_go(const iodisk_type& d, ioclass_type c, const iosched_parms& p) {
+    const ioclass_type  o = other_class(c);
+
+    if( d.active[ioclass_record]>0 || d.active[ioclass_playback]+d.active[ioclass_copy]>=p.perDisk )
+        return false;
+    return d.waiting[o]==0 || d.vtime[o]>=d.vtime[c];
+}
+
+ioslot::ioslot(const string& mountpoint, ioclass_type c, const string& owner):
+    disk( 0 ), account( 0 ), ioclass( c )
+{
+    mutex_locker   locker( iosched.mutex );
+
+    account = &iosched.accounts[ make_pair(owner.empty() ? string("-") : owner, (int)c) ];
+    if( mountpoint.empty() )
+        return;
+
+    disk = &iosched.disks[ mountpoint ];
+    if( c==ioclass_record ) {
+        disk->active[c]++;
+        return;
+    }
+
+    // A class that was idle while the other was busy does not get to
+    // make up for lost time
+    const ioclass_type  o = other_class(c);
+
+    if( disk->active[c]+disk->waiting[c]==0 && disk->active[o]+disk->waiting[o]>0 )
+        disk->vtime[c] = std::max(disk->vtime[c], disk->vtime[o]);
+
+    // Wait at most maxWait
+    int                   rv = 0;
+    struct timeval        now;
+    struct timespec       deadline;
+    const tracetime_type  t0 = trace_now();
+
+    ::gettimeofday(&now, 0);
+    deadline.tv_sec  = now.tv_sec + maxWait;
+    deadline.tv_nsec = now.tv_usec * 1000;
+
+    disk->waiting[c]++;
+    while( rv!=ETIMEDOUT && !may_go(*disk, c, iosched.parms) )
+        PTHREAD_TIMEDWAIT( (rv=::pthread_cond_timedwait(&iosched.condition, &iosched.mutex, &deadline)),
+                           disk->waiting[c]-- );
+    disk->waiting[c]--;
+    trace_complete("ioslot wait", t0);
+    disk->active[c]++;
+    // The other class may now be allowed to use another slot
+    PTHREAD_CALL( ::pthread_cond_broadcast(&iosched.condition) );
+}
+
+void ioslot::done(uint64_t nbyte) {
+    struct timeval  now;
+
+    ::gettimeofday(&now, 0);
+
+    mutex_locker    locker( iosched.mutex );
+
+    account->rate.add(nbyte, now);
+    if( disk==0 )
+        return;
+    disk->nbyte[ioclass] += nbyte;
+    disk->rate.add(nbyte, now);
+    if( ioclass!=ioclass_record )
+        disk->vtime[ioclass] += (double)nbyte/(double)share(ioclass, iosched.parms);
+}
+
+ioslot::~ioslot() {
+    if( disk==0 )
+        return;
+    mutex_locker   locker( iosched.mutex );
+    disk->active[ioclass]--;
+    // no throwing from a destructor
+    ::pthread_cond_broadcast(&iosched.condition);
+}
+
+
+void iosched_set_parms(const iosched_parms& p) {
+    mutex_locker   locker( iosched.mutex );
+    iosched.parms = p;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&iosched.condition) );
+}
+
+iosched_parms iosched_get_parms( void ) {
+    mutex_locker   locker( iosched.mutex );
+    return iosched.parms;
+}
+
+string iosched_owners( void ) {
+    struct timeval   now;
+    ostringstream    oss;
+
+    ::gettimeofday(&now, 0);
+
+    mutex_locker     locker( iosched.mutex );
+    for(iosched_type::accounts_type::const_iterator p=iosched.accounts.begin(); p!=iosched.accounts.end(); p++)
+        oss << (p==iosched.accounts.begin() ? "" : " : ")
+            << p->first.first << "/" << ioclass_name((ioclass_type)p->first.second) << "/"
+            << p->second.rate.nbyte << "/" << p->second.rate.current(now)/1.0e6;
+    return oss.str();
+}
+
+string iosched_disks( void ) {
+    struct timeval   now;
+    ostringstream    oss;
+
+    ::gettimeofday(&now, 0);
+
+    mutex_locker     locker( iosched.mutex );
+    for(iosched_type::disks_type::const_iterator p=iosched.disks.begin(); p!=iosched.disks.end(); p++) {
+        const iodisk_type&  d = p->second;
+
+        oss << (p==iosched.disks.begin() ? "" : " : ")
+            << p->first << "/" << d.nbyte[ioclass_record] << "/" << d.nbyte[ioclass_playback] << "/"
+            << d.nbyte[ioclass_copy] << "/" << d.rate.current(now)/1.0e6 << "/"
+            << d.waiting[ioclass_playback]+d.waiting[ioclass_copy];
+    }
+    return oss.str();
+}
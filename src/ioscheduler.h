@@ -0,0 +1,95 @@
+// process-wide scheduling of disk I/O between runtimes
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_IOSCHEDULER_H
+#define JIVE5AB_IOSCHEDULER_H
+
+#include <string>
+
+#include <stdint.h>
+
+// Several runtimes may use the same disks at the same time: one records
+// (net2vbs, record), another plays back (vbs2net, disk2net, the SFXC
+// server) or copies (vbs2net, vbs_copy). Without coordination a playback
+// or copy can take away so much disk bandwidth that the recording can't
+// keep up and loses data.
+//
+// Therefore all disk I/O of those goes through the scheduler, in pieces of
+// a few MB at most, per mountpoint:
+//      - recording I/O never waits
+//      - playback and copy I/O waits while recording I/O is being done on
+//        that mountpoint, and at most 'perDisk' of them are done at the
+//        same time
+//      - when both playback and copy I/O wait for the same mountpoint they
+//        get it in proportion to their shares
+//      - but no playback or copy I/O waits longer than a second; after
+//        that it goes ahead anyway. The readers only see wether they're
+//        being stopped (chain stop, SFXC client gone) in between I/Os, and
+//        a continuous recording must not starve them completely
+// The bytes done are counted per runtime/class and per mountpoint.
+enum ioclass_type {
+    ioclass_record = 0, ioclass_playback, ioclass_copy, ioclass_nclass
+};
+
+const char*  ioclass_name(ioclass_type c);
+
+struct iosched_parms {
+    unsigned int  playbackShare;
+    unsigned int  copyShare;
+    unsigned int  perDisk;      // max. playback + copy I/Os per mountpoint at once
+
+    // defaults: shares 1 : 1, 2 per disk
+    iosched_parms();
+};
+
+struct iodisk_type;
+struct ioaccount_type;
+
+// One piece of I/O of class 'c' by 'owner' (typically the runtime's name)
+// on 'mountpoint'. The constructor waits until the I/O may be done; tell
+// how many bytes were actually transferred using done(). The I/O is over
+// when the object goes out of scope. I/O on an unknown (empty) mountpoint
+// is counted but not scheduled.
+class ioslot {
+    public:
+        ioslot(const std::string& mountpoint, ioclass_type c, const std::string& owner);
+
+        void done(uint64_t nbyte);
+
+        ~ioslot();
+
+    private:
+        iodisk_type*     disk;
+        ioaccount_type*  account;
+        ioclass_type     ioclass;
+
+        // no copying
+        ioslot(const ioslot&);
+        const ioslot& operator=(const ioslot&);
+};
+
+void          iosched_set_parms(const iosched_parms& p);
+iosched_parms iosched_get_parms( void );
+
+// "<owner>/<class>/<bytes>/<MB/s>[ : ...]"
+std::string   iosched_owners( void );
+// "<mountpoint>/<record bytes>/<playback bytes>/<copy bytes>/<MB/s>/<I/Os waiting>[ : ...]"
+std::string   iosched_disks( void );
+
+#endif
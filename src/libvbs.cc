@@ -10,6 +10,8 @@
 #include <ezexcept.h>
 #include <hex.h>
 #include <threadutil.h>
+#include <dirwalker.h>
+#include <pthreadcall.h>
 
 // Standardized C++ headers
 #include <iostream>
@@ -32,6 +34,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <pthread.h>    // for thread safety! ;-)
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
 
 using namespace std;
 
@@ -78,19 +83,24 @@ struct filechunk_type {
         // this throws off the automatic number-base detection [it would
         // interpret the number as octal].
         chunkNumber = (unsigned int)::strtoul(fnm.substr(dot+1).c_str(), 0, 10);
+
+        // "<mountpoint>/<recording>/<chunk>"
+        const string::size_type  slash = fnm.find_last_of('/');
+        if( slash!=string::npos && slash>0 )
+            mountPoint = fnm.substr(0, fnm.find_last_of('/', slash-1));
     }
 
     // Constructor for a Mark6 format chunk. It has a number, a size, a location
     // within a file and the file descriptor whence it came
-    filechunk_type(unsigned int chunk, off_t fpos, off_t sz, int fd):
-        chunkSize( sz ), chunkPos( fpos ), chunkFd( -fd ), chunkOffset( 0 ), chunkNumber( chunk )
+    filechunk_type(unsigned int chunk, off_t fpos, off_t sz, int fd, string const& mp):
+        mountPoint( mp ), chunkSize( sz ), chunkPos( fpos ), chunkFd( -fd ), chunkOffset( 0 ), chunkNumber( chunk )
     {}
 
     // When copying file chunks be sure to copy the file descriptor only in the Mark6 case.
     // In the FlexBuff case we want to open new file descriptor for this chunk; each flexbuff 
     // file chunk manages its own file descriptor.
     filechunk_type(filechunk_type const& other):
-        pathToChunk( other.pathToChunk ), chunkSize( other.chunkSize ), chunkPos( other.chunkPos ), 
+        pathToChunk( other.pathToChunk ), mountPoint( other.mountPoint ), chunkSize( other.chunkSize ), chunkPos( other.chunkPos ), 
         chunkFd( (other.chunkFd<0) ? other.chunkFd : invalidFileDescriptor ),
         chunkOffset( other.chunkOffset ), chunkNumber( other.chunkNumber )
     { }
@@ -131,6 +141,7 @@ struct filechunk_type {
     // depends on the value of 'chunkNumber' so we can safely edit
     // chunkOffset w/o worrying about compromising the set]
     string                 pathToChunk;
+    string                 mountPoint;
     off_t                  chunkSize;
     off_t                  chunkPos;
     mutable int            chunkFd;
@@ -161,8 +172,6 @@ typedef set<filechunk_type>             filechunks_type;
 
 // These look for VBS recordings
 void scanRecording(string const& recname, direntries_type const& mountpoints, filechunks_type& fcs);
-void scanRecordingMountpoint(string const& recname, string const& mp, filechunks_type& fcs);
-void scanRecordingDirectory(string const& recname, string const& dir, filechunks_type& fcs);
 
 // These for Mark6
 void scanMk6Recording(string const& recname, direntries_type const& mountpoints, filechunks_type& fcs);
@@ -368,9 +377,8 @@ int vbs_open( char const* recname, char const* const* rootdirs ) {
     // Ok, scan all mountpoints for chunks of the recording
     filechunks_type  chunks;
  
-    // The dir_mapper/dir_filter functions from directory_helper_templates.h
-    // throw the error code if they fail. Here we translate that into
-    // a better typed exception 
+    // scanRecording() throws the error code if opening a chunk fails.
+    // Here we translate that into a better typed exception
     try { 
         ::scanRecording(recname, newmps, chunks);
     } catch( int eno ) {
@@ -616,6 +624,139 @@ int vbs_close(int fd) {
     return 0;
 }
 
+//////////////////////////////////////////////////
+//
+//  ssize_t vbs_sendfile(int outfd, int fd, size_t count)
+//
+//  send bytes from a previously opened recording
+//  to outfd w/o copying them through user space
+//
+//////////////////////////////////////////////////
+
+ssize_t vbs_sendfile(int outfd, int fd, size_t count) {
+#if defined(__linux__)
+    openedfiles_type::iterator fptr;
+
+    // we need read-only access to the int -> openfile_type mapping, but
+    // only to find our entry: sendfile(2) may block on a slow receiver
+    // for as long as it likes and must not keep vbs_open()/vbs_close() of
+    // other recordings waiting. Map entries don't move and only the
+    // owner of 'fd' closes it.
+    {
+        rw_read_locker             lockert( openedFilesLock );
+
+        if( (fptr=openedFiles.find(fd))==openedFiles.end() ) {
+            errno = EBADF;
+            return -1;
+        }
+    }
+    openfile_type&   of = fptr->second;
+    filechunks_type& chunks = of.fileChunks;
+
+    // Skip chunks we're done with, like vbs_read() does. We send from at
+    // most one chunk per call; the caller loops anyway
+    while( of.chunkPtr!=chunks.end() &&
+           of.filePointer>=of.chunkPtr->chunkOffset+of.chunkPtr->chunkSize ) {
+        of.chunkPtr->close_chunk();
+        of.chunkPtr++;
+    }
+    if( of.chunkPtr==chunks.end() || count==0 )
+        return 0;
+
+    int                   realfd;
+    const filechunk_type& chunk = *of.chunkPtr;
+    const off_t           n2s = min((off_t)count, chunk.chunkOffset+chunk.chunkSize - of.filePointer);
+    // Mark6 chunks share the file descriptor so we must not rely on (nor
+    // change) its file pointer; sendfile(2) with an offset doesn't
+    off_t                 pos = of.filePointer - chunk.chunkOffset + chunk.chunkPos;
+    ssize_t               actualsent;
+
+    if( (realfd=chunk.open_chunk())==invalidFileDescriptor )
+        return -1;
+    if( (actualsent=::sendfile(outfd, realfd, &pos, (size_t)n2s))<0 )
+        return -1;
+    of.filePointer += actualsent;
+    return actualsent;
+#else
+    (void)outfd; (void)fd; (void)count;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+//////////////////////////////////////////////////
+//
+//  int vbs_mountpoint(int fd, char* mp, size_t n)
+//
+//  the mountpoint of the chunk holding the byte
+//  at the current file pointer
+//
+//////////////////////////////////////////////////
+
+int vbs_mountpoint(int fd, char* mp, size_t n) {
+    rw_read_locker             lockert( openedFilesLock );
+    openedfiles_type::iterator fptr = openedFiles.find(fd) ;
+
+    if( fptr==openedFiles.end() ) {
+        errno = EBADF;
+        return -1;
+    }
+    openfile_type&                  of = fptr->second;
+    filechunks_type::const_iterator p  = of.chunkPtr;
+
+    // the file pointer may be past the current chunk; vbs_read() only
+    // moves on when it needs to
+    while( p!=of.fileChunks.end() && of.filePointer>=p->chunkOffset+p->chunkSize )
+        p++;
+
+    const string  rv( (p==of.fileChunks.end()) ? string() : p->mountPoint );
+
+    if( rv.size()>=n ) {
+        errno = ERANGE;
+        return -1;
+    }
+    ::strcpy(mp, rv.c_str());
+    return 0;
+}
+
+//////////////////////////////////////////////////
+//
+//  int vbs_readahead(int fd, size_t count)
+//
+//  posix_fadvise(2) WILLNEED the next 'count' bytes
+//  of each chunk they fall in
+//
+//////////////////////////////////////////////////
+
+int vbs_readahead(int fd, size_t count) {
+    rw_read_locker             lockert( openedFilesLock );
+    openedfiles_type::iterator fptr = openedFiles.find(fd) ;
+
+    if( fptr==openedFiles.end() ) {
+        errno = EBADF;
+        return -1;
+    }
+#if defined(__linux__)
+    openfile_type&   of = fptr->second;
+    off_t            fp = of.filePointer;
+    const off_t      end = of.filePointer + (off_t)count;
+
+    for(filechunks_type::iterator p=of.chunkPtr; p!=of.fileChunks.end() && fp<end; p++) {
+        const off_t  n = min(end, p->chunkOffset+p->chunkSize) - fp;
+        int          realfd;
+
+        if( n<=0 )
+            continue;
+        if( (realfd=p->open_chunk())==invalidFileDescriptor )
+            return -1;
+        // it's advice; if the kernel doesn't want to, so be it
+        (void)::posix_fadvise(realfd, fp - p->chunkOffset + p->chunkPos, n, POSIX_FADV_WILLNEED);
+        fp += n;
+    }
+#endif
+    return 0;
+}
+
 #if 0
 //////////////////////////////////////////
 //
@@ -646,30 +787,6 @@ int vbs_setdbg(int newlevel) {
 //
 /////////////////////////////////////////
 
-void scanRecording(string const& recname, direntries_type const& mountpoints, filechunks_type& fcs) {
-    // Loop over all mountpoints and check if there are file chunks for this
-    // recording
-    for(direntries_type::const_iterator curmp=mountpoints.begin(); curmp!=mountpoints.end(); curmp++)
-        scanRecordingMountpoint(recname, *curmp, fcs);
-}
-
-void scanRecordingMountpoint(string const& recname, string const& mp, filechunks_type& fcs) {
-    struct stat     dirstat;
-    const string    dir(mp+"/"+recname);
-
-    if( ::lstat(dir.c_str(), &dirstat)<0 ) {
-        if( errno!=ENOENT )
-            DEBUG(4, "scanRecordingMountpoint(" << recname << ", " << mp << ")/::lstat() fails - " << evlbi5a::strerror(errno) << endl);
-        return;
-    }
-    // OK, we got the status. If it's not a directory ...
-    if( !S_ISDIR(dirstat.st_mode) )
-        return;
-
-    // Go ahead and scan the directory for chunks
-    scanRecordingDirectory(recname, dir, fcs);
-}
-
 // Complaint by users: jive5ab, m5copy, vbs_ls, vbs_rm and vbs_fs don't seem to pick up
 // FlexBuff recordings with regex majik characters (".", "+" et.al.) in
 // them. Now, creating recordings with those characters in their names might
@@ -714,21 +831,77 @@ struct isRecordingChunk {
         isRecordingChunk( isRecordingChunk const& );
 };
 
-void scanRecordingDirectory(string const& recname, string const& dir, filechunks_type& rv) {
-    DIR*             dirp;
-    direntries_type  chunks;
-    isRecordingChunk predicate( recname );
+// The recording's directories on all mountpoints are read in parallel by
+// the dirwalker, as is the opening of the chunks (for their size). Errors
+// can't be thrown from the walker's threads; the first one is remembered
+// and thrown once the walk is done.
+struct recordingScanner: public dirwalk_visitor {
+    recordingScanner(string const& recname, filechunks_type& fcs):
+        __m_predicate( recname ), __m_chunks( fcs ), __m_errno( 0 )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&__m_mutex, 0) );
+    }
 
-    if( (dirp=::opendir(dir.c_str()))==0 ) {
-        DEBUG(4, "scanRecordingDirectory(" << recname << ", " << dir << ")/ ::opendir fails - " << evlbi5a::strerror(errno) << endl);
-        return;
+    // Only the directories <mountpoint>/<recname> themselves
+    virtual bool descend(string const& , string const& path, unsigned int depth) {
+        struct stat     dirstat;
+
+        if( depth>0 )
+            return false;
+        if( ::lstat(path.c_str(), &dirstat)<0 ) {
+            if( errno!=ENOENT )
+                DEBUG(4, "recordingScanner(" << path << ")/::lstat() fails - " << evlbi5a::strerror(errno) << endl);
+            return false;
+        }
+        return S_ISDIR(dirstat.st_mode);
     }
-    chunks = dir_filter(dirp, predicate);
-    ::closedir(dirp);
 
-    // If we find duplicates, now *that* is a reason to throw up
-    for(direntries_type::const_iterator p=chunks.begin(); p!=chunks.end(); p++)
-        EZASSERT2((rv.insert(filechunk_type(dir+"/"+*p))).second, vbs_except, EZINFO(" duplicate insert for chunk " << *p));
+    virtual void found(string const& , string const& dir, unsigned int , dirwalk_entries_type const& entries) {
+        for(dirwalk_entries_type::const_iterator p=entries.begin(); p!=entries.end(); p++) {
+            if( !__m_predicate(p->name) )
+                continue;
+            try {
+                filechunk_type  fc( dir+"/"+p->name );
+                mutex_locker    locker( __m_mutex );
+
+                // If we find duplicates, now *that* is a reason to throw up
+                if( !__m_chunks.insert(fc).second && __m_duplicate.empty() )
+                    __m_duplicate = p->name;
+            }
+            catch( int eno ) {
+                mutex_locker    locker( __m_mutex );
+                if( __m_errno==0 )
+                    __m_errno = eno;
+            }
+        }
+    }
+
+    virtual ~recordingScanner() {
+        ::pthread_mutex_destroy(&__m_mutex);
+    }
+
+    isRecordingChunk  __m_predicate;
+    filechunks_type&  __m_chunks;
+    int               __m_errno;
+    string            __m_duplicate;
+    pthread_mutex_t   __m_mutex;
+
+    private:
+        recordingScanner();
+        recordingScanner( recordingScanner const& );
+};
+
+void scanRecording(string const& recname, direntries_type const& mountpoints, filechunks_type& fcs) {
+    list<string>      recdirs;
+    recordingScanner  scanner(recname, fcs);
+
+    for(direntries_type::const_iterator curmp=mountpoints.begin(); curmp!=mountpoints.end(); curmp++)
+        recdirs.push_back( *curmp+"/"+recname );
+    ::dirwalk(recdirs, scanner);
+
+    if( scanner.__m_errno )
+        throw scanner.__m_errno;
+    EZASSERT2(scanner.__m_duplicate.empty(), vbs_except, EZINFO(" duplicate insert for chunk " << scanner.__m_duplicate));
 }
 
 ////////////////////////////////////////
@@ -820,6 +993,7 @@ void scanMk6RecordingFile(string const& /*recname*/, string const& file, filechu
     unsigned char     buf[ fh_size+wb_size /*MYMAX_Local(fh_size, wb_size)*/ ];
     mk6_file_header*  fh6  = (mk6_file_header*)&buf[0];
     mk6_wb_header_v2* wbh  = (mk6_wb_header_v2*)&buf[0];
+    const string      mountpoint( file.substr(0, file.find_last_of('/')) );
 
     // File existence has been checked before so now we MUST be able to open it
     ASSERT2_POS( fd=::open(file.c_str(), O_RDONLY), SCINFO(" failed to open file " << file) );
@@ -859,7 +1033,7 @@ void scanMk6RecordingFile(string const& /*recname*/, string const& file, filechu
         fpos += wb_size;
 
         // We cannot tolerate duplicate inserts
-        EZASSERT2(rv.insert(filechunk_type((unsigned int)wbh->blocknum, fpos, wbh->wb_size-wb_size, fd)).second, vbs_except,
+        EZASSERT2(rv.insert(filechunk_type((unsigned int)wbh->blocknum, fpos, wbh->wb_size-wb_size, fd, mountpoint)).second, vbs_except,
                   EZINFO(" duplicate insert for chunk " << wbh->blocknum); ::close(fd) );
 
         // Advance file pointer
@@ -51,6 +51,30 @@ ssize_t vbs_read(int fd, void* buf, size_t count);
 off_t   vbs_lseek(int fd, off_t offset, int whence);
 int     vbs_close(int fd);
 
+/*
+ * Send up to 'count' bytes, starting at the current file pointer of
+ * recording 'fd', to 'outfd' without copying them through user space
+ * (sendfile(2) straight from the chunk files). Advances the file pointer
+ * by the amount sent. Returns that amount (0 at end of recording) or -1
+ * and sets errno. errno==ENOSYS or EINVAL means zero-copy is not possible
+ * for this 'outfd' and the caller should fall back to vbs_read().
+ */
+ssize_t vbs_sendfile(int outfd, int fd, size_t count);
+
+/*
+ * Copy the mountpoint of the chunk holding the data at the current file
+ * pointer of recording 'fd' into 'mp' ('n' bytes long), e.g. to schedule
+ * disk I/O. At the end of the recording it is "". Returns 0 or -1 and sets
+ * errno.
+ */
+int     vbs_mountpoint(int fd, char* mp, size_t n);
+
+/*
+ * Tell the kernel we'll need 'count' bytes starting at the current file
+ * pointer of recording 'fd' soon. Returns 0 or -1 and sets errno.
+ */
+int     vbs_readahead(int fd, size_t count);
+
 #if 0
 /* Set library debug level. Higher, positive, numbers produce more output. Returns
  * previous level, default is "0", no output. */
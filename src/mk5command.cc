@@ -78,6 +78,17 @@ const mk5commandmap_type& make_mk5a_commandmap( bool buffering ) {
     ASSERT_COND( mk5.insert(make_pair("dbglev", debuglevel_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("evlbi", evlbi_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("bufsize", bufsize_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("autotune", autotune_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("interchain", interchain_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("sfxc_server", sfxc_server_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_copy", vbs_copy_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("iosched", iosched_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("trace", trace_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("debuglog", debuglog_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("warmstart", warmstart_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_impair", net_impair_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_list", vbs_list_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("cmdstat", cmdstat_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("version", version_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("position", position_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("start_stats", start_stats_fn)).second );
@@ -222,6 +233,17 @@ const mk5commandmap_type& make_dim_commandmap( bool buffering ) {
     ASSERT_COND( mk5.insert(make_pair("dbglev", debuglevel_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("evlbi", evlbi_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("bufsize", bufsize_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("autotune", autotune_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("interchain", interchain_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("sfxc_server", sfxc_server_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_copy", vbs_copy_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("iosched", iosched_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("trace", trace_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("debuglog", debuglog_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("warmstart", warmstart_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_impair", net_impair_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_list", vbs_list_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("cmdstat", cmdstat_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("version", version_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("pointers", position_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("start_stats", start_stats_fn)).second );
@@ -373,6 +395,17 @@ const mk5commandmap_type& make_dom_commandmap( bool ) {
 
     ASSERT_COND( mk5.insert(make_pair("evlbi", evlbi_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("bufsize", bufsize_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("autotune", autotune_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("interchain", interchain_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("sfxc_server", sfxc_server_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_copy", vbs_copy_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("iosched", iosched_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("trace", trace_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("debuglog", debuglog_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("warmstart", warmstart_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_impair", net_impair_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_list", vbs_list_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("cmdstat", cmdstat_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("version", version_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("pointers", position_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("start_stats", start_stats_fn)).second );
@@ -478,6 +511,17 @@ const mk5commandmap_type& make_mk5c_commandmap( bool buffering, bool have_daught
     ASSERT_COND( mk5.insert(make_pair("mode", mk5bdom_mode_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("evlbi", evlbi_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("bufsize", bufsize_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("autotune", autotune_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("interchain", interchain_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("sfxc_server", sfxc_server_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_copy", vbs_copy_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("iosched", iosched_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("trace", trace_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("debuglog", debuglog_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("warmstart", warmstart_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_impair", net_impair_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_list", vbs_list_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("cmdstat", cmdstat_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("version", version_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("position", position_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("pointers", position_fn)).second );
@@ -614,6 +658,17 @@ const mk5commandmap_type& make_generic_commandmap( bool buffering ) {
     ASSERT_COND( mk5.insert(make_pair("mode", mk5bdom_mode_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("evlbi", evlbi_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("bufsize", bufsize_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("autotune", autotune_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("interchain", interchain_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("sfxc_server", sfxc_server_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_copy", vbs_copy_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("iosched", iosched_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("trace", trace_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("debuglog", debuglog_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("warmstart", warmstart_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_impair", net_impair_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_list", vbs_list_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("cmdstat", cmdstat_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("version", version_fn)).second );
     // Data check could be useful if we could let it read from mem or file
     //ASSERT_COND( mk5.insert(make_pair("data_check", data_check_5a_fn)).second );
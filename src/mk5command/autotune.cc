@@ -0,0 +1,110 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <autotune.h>
+#include <countedpointer.h>
+#include <iostream>
+#include <errno.h>
+#include <stdlib.h>
+
+using namespace std;
+
+typedef countedpointer<autotuner>  autotuner_ptr;
+typedef per_runtime<autotuner_ptr> autotuners_type;
+
+static autotuners_type  autotuners;
+
+// Only positive numbers. Empty means 'keep default'
+static void parse_uint(const string& s, const char* what, unsigned long long& v) {
+    char*               eocptr;
+    unsigned long long  tmp;
+
+    if( s.empty() )
+        return;
+    errno = 0;
+    tmp   = ::strtoull(s.c_str(), &eocptr, 0);
+    EZASSERT2(eocptr!=s.c_str() && *eocptr=='\0' && errno!=ERANGE && tmp>0, cmdexception,
+              EZINFO(what << " '" << s << "' not a number/out of range"));
+    v = tmp;
+}
+
+// autotune = on [: <max memory MB> [: <interval ms>]]
+// autotune = off
+// autotune? 0 : off ;
+// autotune? 0 : on : <max memory MB> : <interval ms> : <mode> : q<n>=<capacity>/<initial>/<occupancy>%/<rate> ... ;
+//     the capacities the tuner ended up with for each transfer mode it
+//     has seen, for use as fixed values, are available via
+// autotune? remembered
+string autotune_fn(bool q, const vector<string>& args, runtime& rte) {
+    ostringstream              reply;
+    autotuners_type::iterator  curtuner = autotuners.find(&rte);
+
+    reply << "!" << args[0] << (q?"?":"=") << " ";
+
+    if( q ) {
+        if( curtuner==autotuners.end() ) {
+            reply << " 0 : off ;";
+            return reply.str();
+        }
+        const autotune_parms  ap = curtuner->second->parms();
+
+        if( OPTARG(1, args)=="remembered" )
+            reply << " 0 : " << curtuner->second->remembered() << " ;";
+        else
+            reply << " 0 : on : " << ap.max_memory/(1024*1024) << " : " << ap.interval << " : "
+                  << curtuner->second->status() << " ;";
+        return reply.str();
+    }
+
+    const string  onoff( OPTARG(1, args) );
+
+    if( onoff!="on" && onoff!="off" ) {
+        reply << " 8 : expect 'on' or 'off' ;";
+        return reply.str();
+    }
+
+    autotune_parms      ap;
+    unsigned long long  mb = ap.max_memory/(1024*1024), ival = ap.interval;
+
+    parse_uint(OPTARG(2, args), "max memory", mb);
+    parse_uint(OPTARG(3, args), "interval", ival);
+    EZASSERT2(ival<=60000, cmdexception, EZINFO("interval must be <= 60000ms"));
+    ap.max_memory = mb*1024*1024;
+    ap.interval   = (unsigned int)ival;
+
+    // Stop the current tuner. per_runtime<>::erase() holds the runtime
+    // lock, which the tuner's thread may be waiting for, so it must not
+    // be destroyed in there. The extra reference makes that happen after
+    // the erase(): resetting it wakes up and joins the tuner's thread,
+    // which takes at most the time of one sample
+    autotuner_ptr  previous;
+
+    if( curtuner!=autotuners.end() ) {
+        previous = curtuner->second;
+        autotuners.erase( curtuner );
+    }
+    previous = autotuner_ptr();
+
+    // (Re)start with the new parameters
+    if( onoff=="on" )
+        autotuners[&rte] = autotuner_ptr( new autotuner(&rte, ap) );
+    reply << " 0 ;";
+    return reply.str();
+}
@@ -0,0 +1,68 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <evlbidebug.h>
+#include <iostream>
+
+using namespace std;
+
+
+// Where the DEBUG() messages go (see evlbidebug.h)
+//
+//  debuglog = sync | stderr | syslog
+//  debuglog = file : <path>
+//      'sync' writes them from the thread that issues them, the others
+//      via the logger thread. A file is appended to.
+//
+//  debuglog?  0 : <target> [: <path>] : <# queued> : <# written> : <# dropped> : <queue size> ;
+string debuglog_fn(bool q, const vector<string>& args, runtime&) {
+    ostringstream   reply;
+    const string    what( OPTARG(1, args) );
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+
+    if( q ) {
+        const debuglog_stats  st = debuglog_get_stats();
+
+        reply << " 0 : " << debuglog_target_name(st.target);
+        if( st.target==debuglog_file )
+            reply << " : " << st.path;
+        reply << " : " << st.nQueued << " : " << st.nWritten << " : " << st.nDropped << " : " << st.capacity << " ;";
+        return reply.str();
+    }
+
+    if( what=="sync" ) {
+        debuglog_stop();
+    } else if( what=="stderr" || what=="syslog" ) {
+        EZASSERT2(debuglog_start(what=="stderr" ? debuglog_stderr : debuglog_syslog), cmdexception,
+                  EZINFO("failed to start the logger thread"));
+    } else if( what=="file" ) {
+        const string  path( OPTARG(2, args) );
+
+        EZASSERT2(!path.empty(), cmdexception, EZINFO("no file name given"));
+        EZASSERT2(debuglog_start(debuglog_file, path), cmdexception,
+                  EZINFO("failed to open " << path << " or to start the logger thread"));
+    } else {
+        reply << " 2 : " << (what.empty() ? string("<empty>") : what) << " does not apply to " << args[0] << " ;";
+        return reply.str();
+    }
+    reply << " 0 ;";
+    return reply.str();
+}
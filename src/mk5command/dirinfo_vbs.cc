@@ -18,6 +18,7 @@
 //          7990 AA Dwingeloo
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
+#include <vbscatalog.h>
 #include <iostream>
 
 using namespace std;
@@ -33,10 +34,17 @@ string dir_info_vbs_fn( bool qry, const vector<string>& args, runtime& rte) {
         return reply.str();
     }
 
-    const mountpointinfo_type mpi( ::statmountpoints(rte.mk6info.mountpoints) ); 
-
-    // Currently we cannot say exactly how many scans are recorded
-    reply << " 0 : ? : " << (mpi.f_size - mpi.f_free)  << " : " << mpi.f_size << " ;";
+    const mountpointinfo_type mpi( ::catalog_space(rte.mk6info.mountpoints) ); 
+    const int                 nrec( rte.mk6info.mk6 ? -1 : ::catalog_nrecording(rte.mk6info.mountpoints) );
+
+    // The catalog only knows how many FlexBuff recordings there are, and
+    // only once the disks have been walked for something else
+    reply << " 0 : ";
+    if( nrec<0 )
+        reply << "?";
+    else
+        reply << nrec;
+    reply << " : " << (mpi.f_size - mpi.f_free)  << " : " << mpi.f_size << " ;";
 
     return reply.str();
 }
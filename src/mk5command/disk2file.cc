@@ -19,6 +19,7 @@
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
 #include <sfxc_binary_command.h>
+#include <warmstart.h>
 #include <threadfns.h>
 #include <tthreadfns.h>
 #include <iostream>
@@ -189,7 +190,7 @@ string disk2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
            
             // Now it's safe to use 'd2f.*' 
             uint64_t start   = d2f.disk_args.pp_start.Addr;
-            uint64_t current = (uint64_t)rte.statistics.counter(d2f.disk_stepid) + start;
+            uint64_t current = (uint64_t)rte.statistics.value(d2f.disk_stepid) + start;
             uint64_t end     = d2f.disk_args.pp_end.Addr;
 
             reply << " 0 : active : " << d2f.file_name << " : " << start << " : " << current << " : "
@@ -348,6 +349,7 @@ string disk2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
     rte.processingchain = c;
 
     rte.processingchain.run();
+    ramp_begin(&rte);
 
     rte.processingchain.communicate(d2f.file_stepid, &fdreaderargs::set_bytes_to_cache, bytes_to_cache);
 
@@ -468,6 +470,7 @@ void attempt_stream_to_sfxc(int sfxcfd, mk5read_msg* mk5read_cmd, runtime& rte )
     rte.processingchain = c;
 
     rte.processingchain.run();
+    ramp_begin(&rte);
 
     // Now it's safe to set the transfermode
     rte.transfersubmode.clr_all().set( run_flag );
@@ -19,6 +19,7 @@
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
 #include <countedpointer.h>
+#include <warmstart.h>
 #include <threadfns.h>
 #include <tthreadfns.h>
 #include <data_check.h>
@@ -102,7 +103,7 @@ string disk2file_vbs_fn(bool qry, const vector<string>& args, runtime& rte ) {
            
             // Now it's safe to use 'd2f.*' 
             uint64_t start   = d2f->disk_args->start;
-            uint64_t current = (uint64_t)rte.statistics.counter(d2f->vbs_stepid) + start;
+            uint64_t current = (uint64_t)rte.statistics.value(d2f->vbs_stepid) + start;
             uint64_t end     = d2f->disk_args->end;
 
             reply << " 0 : active : " << d2f->file_name << " : " << start << " : " << current << " : "
@@ -251,6 +252,7 @@ string disk2file_vbs_fn(bool qry, const vector<string>& args, runtime& rte ) {
     rte.processingchain = c;
 
     rte.processingchain.run();
+    ramp_begin(&rte);
 
     rte.transfersubmode.clr_all().set( run_flag );
     rte.transfermode = disk2file;
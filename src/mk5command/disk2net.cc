@@ -92,7 +92,7 @@ string disk2net_fn( bool qry, const vector<string>& args, runtime& rte) {
                 if ( (rte.transfersubmode & run_flag) && (rte.transfersubmode & connected_flag) ) {
                     uint64_t start = rte.processingchain.communicate(0, &diskreaderargs::get_start).Addr;
                     reply << " : " << start
-                          << " : " << rte.statistics.counter(0) + start
+                          << " : " << rte.statistics.value(0) + start
                           << " : " << rte.processingchain.communicate(0, &diskreaderargs::get_end);
                 }
             }
@@ -100,12 +100,12 @@ string disk2net_fn( bool qry, const vector<string>& args, runtime& rte) {
                 if ( (rte.transfersubmode & run_flag) && (rte.transfersubmode & connected_flag) ) {
                     off_t start = rte.processingchain.communicate(0, &fdreaderargs::get_start);
                     reply << " : " << start
-                          << " : " << rte.statistics.counter(0) + start
+                          << " : " << rte.statistics.value(0) + start
                           << " : " << rte.processingchain.communicate(0, &fdreaderargs::get_end);               
                 } 
             }
             else {
-                reply << " : " << rte.statistics.counter(0);
+                reply << " : " << rte.statistics.value(0);
             }
         }
         reply << " ;";
@@ -125,7 +125,7 @@ string disk2net_fn( bool qry, const vector<string>& args, runtime& rte) {
     //     <host> is optional (remembers last host, if any)
     //  file2net = connect : <host> : filename
     //     <host> is optional (remembers last host, if any)
-    //  fill2net = connect : <host> [ : [<start>] [ : <inc> ] [: <realtime>] ]
+    //  fill2net = connect : <host> [ : [<start>] [ : <inc> ] [: <realtime>] [: <threads>] ]
     //     <host> is as with disk2net
     //     <start>, <inc> are the fillpattern start + increment values
     //     both have defaults:
@@ -138,6 +138,9 @@ string disk2net_fn( bool qry, const vector<string>& args, runtime& rte) {
     //          if set to non-zero the framegenerator will honour the
     //          datarate set by the "mode" + "play_rate/clock_set"
     //          command. Otherwise it goes as fast as it can
+    //      <threads> integer, default 1
+    //          VDIF only: generate frames for VDIF threads 0..<threads>-1
+    //          in turn. Each thread carries the data rate of the mode.
     //    If a trackformat other than 'none' is set via the "mode=" 
     //    command the fillpattern will generate frames of the correct
     //    size, with the correct syncword at the correct place. ALL
@@ -218,6 +221,7 @@ string disk2net_fn( bool qry, const vector<string>& args, runtime& rte) {
                 const string  start_s( OPTARG(3, args) );
                 const string  inc_s( OPTARG(4, args) );
                 const string  realtime_s( OPTARG(5, args ) );
+                const string  threads_s( OPTARG(6, args ) );
 
                 if( start_s.empty()==false ) {
                     errno       = 0;
@@ -241,6 +245,15 @@ string disk2net_fn( bool qry, const vector<string>& args, runtime& rte) {
                                   SCINFO("'realtime' should be a decimal number") );
                     fpargs.realtime = (num!=0);
                 }
+                if( threads_s.empty()==false ) {
+                    unsigned long  num;
+                    num = ::strtoul(threads_s.c_str(), &eocptr, 10);
+                    ASSERT2_COND( eocptr!=threads_s.c_str() && *eocptr=='\0' && num>0 && num<=1024,
+                                  SCINFO("'threads' should be a number of VDIF threads (1-1024)") );
+                    ASSERT2_COND( num==1 || is_vdif(dataformat.frameformat),
+                                  SCINFO("more than one thread requires a VDIF mode") );
+                    fpargs.nthread = (unsigned int)num;
+                }
                 c.add(&fillpatternwrapper, 10, fpargs);
             }
 
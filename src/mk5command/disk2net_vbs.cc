@@ -120,7 +120,7 @@ string disk2net_vbs_fn( bool qry, const vector<string>& args, runtime& rte) {
 
             const off_t start = d2n_ptr->disk_args->start;
             reply << " : " << start
-                  << " : " << (uint64_t)rte.statistics.counter(d2n_ptr->vbsstep) + start
+                  << " : " << (uint64_t)rte.statistics.value(d2n_ptr->vbsstep) + start
                   << " : " << d2n_ptr->disk_args->end;
         } else {
             reply << "inactive";
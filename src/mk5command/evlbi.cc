@@ -26,10 +26,14 @@ using namespace std;
 string evlbi_fn(bool q, const vector<string>& args, runtime& rte ) {
     string        fmt("total : %t : loss : %l (%L) : out-of-order : %o (%O) : extent : %R");
     ostringstream reply;
+    evlbi_stats_type totals;
 
     // This command/query can execute always
 
     reply << "!" << args[0] << (q?('?'):('=')) << " 0 : ";
+    // UDT measures round trip time and rate for us - show them too
+    if( rte.netparms.get_protocol()=="udt" )
+        fmt += " : rtt : %T : rate : %b : retransmit : %s";
     if( !q ) {
         unsigned int                   n;
         ostringstream                  usrfmt;
@@ -40,6 +44,16 @@ string evlbi_fn(bool q, const vector<string>& args, runtime& rte ) {
             usrfmt << (n?" : ":"") << *vs;
         fmt = usrfmt.str();
     }
-    reply << fmt_evlbistats(rte.evlbi_stats, fmt.c_str()) << " ;";
+    rte.evlbi_stats.sum(totals);
+    rte.udt_links.summary(totals.rtt, totals.rate);
+    reply << fmt_evlbistats(totals, fmt.c_str());
+    // and per connection
+    if( q && rte.netparms.get_protocol()=="udt" ) {
+        const string  links( rte.udt_links.detail() );
+
+        if( !links.empty() )
+            reply << " : " << links;
+    }
+    reply << " ;";
     return reply.str();
 }
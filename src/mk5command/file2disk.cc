@@ -106,7 +106,7 @@ string file2disk_fn(bool qry, const vector<string>& args, runtime& rte ) {
             const f2d_ptr_type  f2d_ptr( ptr->second );
 
             reply << " 0 : active : " << f2d_ptr->file_name << " : " << f2d_ptr->file_args->start << " : " 
-                  << (rte.statistics.counter(f2d_ptr->file_stepid) + f2d_ptr->file_args->start) << " : "
+                  << (rte.statistics.value(f2d_ptr->file_stepid) + f2d_ptr->file_args->start) << " : "
                   << f2d_ptr->file_args->end << " : " << (f2d_ptr->scan_pointer.index() + 1) << " : "
                   << ROScanPointer::strip_asterisk( f2d_ptr->scan_pointer.name() ) << " ;";
         }
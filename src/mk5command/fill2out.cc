@@ -102,7 +102,7 @@ string fill2out_fn(bool qry, const vector<string>& args, runtime& rte ) {
             reply << " : " << scanPointers[&rte].name();
         // And insert the byte counter, if we're active
         if( ctm==rtm )
-            reply << " : " << rte.statistics.counter( 0 );
+            reply << " : " << rte.statistics.value( 0 );
         reply << " ;";
         return reply.str();
     }
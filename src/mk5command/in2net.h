@@ -23,6 +23,7 @@
 #include <mk5command/mk5.h>
 #include <mk5command/mk5functions.h> // for in2disk_fn command forwarding
 #include <mk5command/in2netsupport.h>
+#include <warmstart.h>
 #include <threadfns.h>
 #include <tthreadfns.h>
 #include <carrayutil.h>
@@ -225,7 +226,7 @@ std::string in2net_fn( bool qry, const std::vector<std::string>& args, runtime&
             } else {
                 // Ok, requested transfer mode == current transfer mode.
                 // Thus it MUST be active
-                reply << "active" << " : " << rte.statistics.counter(fifostep[&rte]) << " : " << rte.transfersubmode;
+                reply << "active" << " : " << rte.statistics.value(fifostep[&rte]) << " : " << rte.transfersubmode;
             }
         }
         reply << " ;";
@@ -495,6 +496,7 @@ std::string in2net_fn( bool qry, const std::vector<std::string>& args, runtime&
             // be in an indefinite state
             rte.processingchain = c;
             rte.processingchain.run();
+            ramp_begin(&rte);
 
             reply << " 0 ;";
         } else {
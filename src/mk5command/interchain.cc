@@ -0,0 +1,39 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <interchain.h>
+#include <iostream>
+
+using namespace std;
+
+
+// interchain? 0 : <capacity> : <blocks pushed> [: <lag>/<dropped>/<popped>]* ;
+//     one lag/dropped/popped triplet per tap, in blocks
+string interchain_fn(bool q, const vector<string>& args, runtime&) {
+    ostringstream   reply;
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+    // this is query only
+    if( q ) 
+        reply << " 0 : " << interchain_status() << " ;";
+    else
+        reply << " 2 : query only ;";
+    return reply.str();
+}
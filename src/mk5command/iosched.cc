@@ -0,0 +1,88 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <ioscheduler.h>
+#include <iostream>
+#include <limits.h>
+
+using namespace std;
+
+
+// Share the disks between recording, playback and copying runtimes.
+// Recording I/O always goes first; playback (vbs2net, disk2net, the SFXC
+// server) and copy (vbs2net in rsync mode, vbs_copy) I/O share what's left
+// in proportion to their shares.
+//
+//  iosched = <playback share> : <copy share> [: <perDisk>]
+//      <perDisk>: max. number of playback + copy I/Os on one mountpoint
+//      at the same time
+//
+//  iosched?          0 : <playback share> : <copy share> : <perDisk> ;
+//  iosched? runtime  0 : [<runtime>/<class>/<bytes>/<MB/s>]* ;
+//  iosched? disk     0 : [<mountpoint>/<record bytes>/<playback bytes>/<copy bytes>/<MB/s>/<I/Os waiting>]* ;
+static unsigned int parse_uint(const string& s, const char* what) {
+    char*          eocptr;
+    unsigned long  v;
+
+    errno = 0;
+    v     = ::strtoul(s.c_str(), &eocptr, 0);
+    EZASSERT2(eocptr!=s.c_str() && *eocptr=='\0' && errno!=ERANGE && v>0 && v<=UINT_MAX, cmdexception,
+              EZINFO(what << " '" << s << "' out of range"));
+    return (unsigned int)v;
+}
+
+string iosched_fn(bool q, const vector<string>& args, runtime&) {
+    ostringstream   reply;
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+
+    if( q ) {
+        const string  what( OPTARG(1, args) );
+
+        if( what=="runtime" || what=="disk" ) {
+            const string  status = (what=="runtime" ? iosched_owners() : iosched_disks());
+
+            reply << " 0";
+            if( !status.empty() )
+                reply << " : " << status;
+            reply << " ;";
+        } else if( what.empty() ) {
+            const iosched_parms  ip = iosched_get_parms();
+            reply << " 0 : " << ip.playbackShare << " : " << ip.copyShare << " : " << ip.perDisk << " ;";
+        } else {
+            reply << " 2 : " << what << " does not apply to " << args[0] << " ;";
+        }
+        return reply.str();
+    }
+
+    iosched_parms   ip = iosched_get_parms();
+    const string    play_s( OPTARG(1, args) );
+    const string    copy_s( OPTARG(2, args) );
+    const string    perdisk_s( OPTARG(3, args) );
+
+    EZASSERT2(!play_s.empty() && !copy_s.empty(), cmdexception, EZINFO("both playback and copy share must be given"));
+    ip.playbackShare = parse_uint(play_s, "playback share");
+    ip.copyShare     = parse_uint(copy_s, "copy share");
+    if( !perdisk_s.empty() )
+        ip.perDisk = parse_uint(perdisk_s, "perDisk");
+    iosched_set_parms( ip );
+    reply << " 0 ;";
+    return reply.str();
+}
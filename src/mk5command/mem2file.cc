@@ -59,7 +59,7 @@ string mem2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
         else {
             reply << "active";
         }
-        reply << " : " << rte.statistics.counter(1) << " ;";
+        reply << " : " << rte.statistics.value(1) << " ;";
         return reply.str();
     }
 
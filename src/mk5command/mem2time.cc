@@ -89,6 +89,8 @@ string mem2time_fn(bool qry, const vector<string>& args, runtime& rte ) {
             queue_reader_args qargs(&rte);
             qargs.run          = true;
             qargs.reuse_blocks = true;
+            // we're only interested in the time of the most recent data
+            qargs.policy       = interchain_skip_to_newest;
             c.register_cancel(c.add(&stupid_queue_reader, 10, qargs),
                               &cancel_queue_reader);
             // register the queue_reader finalizer
@@ -94,6 +94,17 @@ std::string dot_fn(bool q, const std::vector<std::string>& args, runtime& rte);
 std::string trackmask_fn(bool q, const std::vector<std::string>& args, runtime& rte);
 std::string version_fn(bool q, const std::vector<std::string>& args, runtime& );
 std::string bufsize_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string autotune_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string interchain_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string sfxc_server_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string vbs_copy_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string iosched_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string trace_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string debuglog_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string warmstart_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string net_impair_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string vbs_list_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string cmdstat_fn(bool q, const std::vector<std::string>& args, runtime& rte);
 std::string dot_set_fn(bool q, const std::vector<std::string>& args, runtime& rte);
 std::string disk_info_fn(bool q, const std::vector<std::string>& args, runtime& rte );
 std::string position_fn(bool q, const std::vector<std::string>& args, runtime& rte);
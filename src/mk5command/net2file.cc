@@ -21,6 +21,7 @@
 #include <threadfns.h>
 #include <tthreadfns.h>
 #include <iostream>
+#include <set>
 
 using namespace std;
 
@@ -61,6 +62,44 @@ void net2file_cleanup_host(runtime* rteptr, const string oldhost) {
 }
 
 
+// Parse "<tid>[-<tid>][,<tid>[-<tid>]]*" into the set of VDIF thread-ids
+static set<unsigned int> parse_vdif_threads(const string& s) {
+    set<unsigned int>     rv;
+    const vector<string>  entries = ::split(s, ',');
+
+    for(vector<string>::const_iterator entry=entries.begin(); entry!=entries.end(); entry++) {
+        const vector<string>  parts = ::split(*entry, '-');
+        unsigned long int     tids[2];
+
+        EZASSERT2(parts.size()==1 || parts.size()==2, cmdexception,
+                  EZINFO("'" << *entry << "' is not a VDIF thread-id or a range of them"));
+        for(unsigned int i=0; i<parts.size(); i++) {
+            char*   eocptr;
+
+            tids[i] = ::strtoul(parts[i].c_str(), &eocptr, 10);
+            EZASSERT2(eocptr!=parts[i].c_str() && *eocptr=='\0' && tids[i]<1024, cmdexception,
+                      EZINFO("'" << parts[i] << "' is not a VDIF thread-id (0-1023)"));
+        }
+        if( parts.size()==1 )
+            tids[1] = tids[0];
+        EZASSERT2(tids[0]<=tids[1], cmdexception, EZINFO("empty range of VDIF thread-ids " << *entry));
+        for(unsigned long int t=tids[0]; t<=tids[1]; t++)
+            rv.insert( (unsigned int)t );
+    }
+    return rv;
+}
+
+// "<name>,<mode>" => "<name>.<tid>,<mode>"
+static string vdif_thread_file(const string& filename, unsigned int tid) {
+    ostringstream           oss;
+    const string::size_type comma = filename.rfind(',');
+
+    oss << filename.substr(0, comma) << "." << tid;
+    if( comma!=string::npos )
+        oss << filename.substr(comma);
+    return oss.str();
+}
+
 string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
     // remember the stepid that does the writing, such that we can enquire
     // the amount of bytes it has written
@@ -84,7 +123,7 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
         } else {
             // We must retrieve the byte counter from the actual step that
             // did the writing
-            reply << "active : " << rte.statistics.counter( writestep[&rte] );
+            reply << "active : " << rte.statistics.value( writestep[&rte] );
         }
         // this displays the flags that are set, in HRF
         //reply << " : " << rte.transfersubmode;
@@ -100,9 +139,9 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
 
     bool  recognized = false;
     // net_protocol == udp/tcp
-    // open : <filename> [: <strict> ]
+    // open : <filename> [: <strict> [: <threads>] ]
     // net_protocol == unix
-    // open : <filename> : <unixpath> [ : <strict> ]
+    // open : <filename> : <unixpath> [ : <strict> [: <threads>] ]
     //
     //   <strict>: if given, it must be "1" to be recognized
     //      "1": IF a trackformat is set (via the "mode=" command)
@@ -112,6 +151,13 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
     //       default <strict> = 0
     //           (false/not strict/no filtering/blind dump-to-disk)
     //
+    //   <threads>: if given, the data is VDIF and the frames of each of
+    //      the listed VDIF threads ("0-7,16") are written to their own file,
+    //      "<filename>.<thread-id>". Only the frame length and thread-id
+    //      in the VDIF headers are looked at; frames of other threads are
+    //      dropped. Frames are written per thread in blocks of 2MB; use
+    //      "net2file=stop" to have the last ones written too.
+    //
     if( args[1]=="open" ) {
         recognized = true;
         if( rte.transfermode==no_transfer ) {
@@ -122,7 +168,9 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
             const string            filename( OPTARG(2, args) );
             const string            strictarg( OPTARG((unsigned int)(unix?4:3), args) ); 
             const string            uxpath( (unix?OPTARG(3, args):"") );
+            const string            threadsarg( OPTARG((unsigned int)(unix?5:4), args) );
             unsigned int            strict = 0;
+            set<unsigned int>       threads;
             stepids_type            fdsteps;
             chain::stepid           rdstep, wrstep;
                 
@@ -164,6 +212,12 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
                                                rte.trackbitrate(),
                                                rte.vdifframesize());
 
+            if( !threadsarg.empty() ) {
+                threads = parse_vdif_threads( threadsarg );
+                EZASSERT2(!dataformat.valid() || is_vdif(dataformat.frameformat), cmdexception,
+                          EZINFO("splitting by VDIF thread requires VDIF data or no mode set"));
+            }
+
             // set read/write and blocksizes based on parameters,
             // dataformats and compression
             rte.sizes = constrain(rte.netparms, dataformat, rte.solution);
@@ -204,10 +258,22 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
                 c.add(&frame2block, 3);
             }
 
-            // And write into a file
-            wrstep = c.add(&fdwriter<block>,  &open_file, filename, &rte);
-            c.register_cancel(wrstep, &close_filedescriptor);
-            fdsteps.push_back( wrstep );
+            if( threads.empty() ) {
+                // And write into a file
+                wrstep = c.add(&fdwriter<block>,  &open_file, filename, &rte);
+                c.register_cancel(wrstep, &close_filedescriptor);
+                fdsteps.push_back( wrstep );
+            } else {
+                // Route the frames by VDIF thread-id to a file per thread
+                chunkdestmap_type   cdm;
+
+                for(set<unsigned int>::const_iterator t=threads.begin(); t!=threads.end(); t++)
+                    cdm[ *t ] = vdif_thread_file(filename, *t);
+
+                c.add(&vdif_demux, 10, vdif_demux_args(&rte, (dataformat.valid() ? dataformat.framesize : 0), threads));
+                wrstep = c.add(&multiwriter<block, fdwriterfunctor>, &multifileopener, multidestparms(&rte, cdm));
+                c.register_cancel(wrstep, &multicloser);
+            }
             // store the write step for future reference
             writestep[&rte] = wrstep;
 
@@ -229,8 +295,8 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
                                             !dataformat.valid());
             // Also find out the current file size (note: it helps asking
             // the right step ... the one that's actually writing to the
-            // file! D'oh!
-            const off_t  fsz = rte.processingchain.communicate(wrstep, &fdreaderargs::get_file_size);
+            // file! D'oh! When splitting by thread there is no one file
+            const off_t  fsz = (threads.empty() ? rte.processingchain.communicate(wrstep, &fdreaderargs::get_file_size) : 0);
 
             reply << " 0 : " << fsz << " ;";
         } else {
@@ -197,7 +197,7 @@ string net2out_fn(bool qry, const vector<string>& args, runtime& rte ) {
                 reply << " : " << n2oref.scanptr.index() << " : " << n2oref.scanptr.name();
 
             // jive5ab addition: number of bytes to disk [fifo, really]
-            reply << " : " << rte.statistics.counter(n2oref.diskstep);
+            reply << " : " << rte.statistics.value(n2oref.diskstep);
         }
         reply << " ;";
         return reply.str();
@@ -18,6 +18,7 @@
 //          7990 AA Dwingeloo
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
+#include <warmstart.h>
 #include <threadfns.h>    // for all the processing steps + argument structs
 #include <threadutil.h>
 #include <threadfns/multisend.h>
@@ -277,6 +278,9 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
     const transfer_type               ctm( rte.transfermode ); // current transfer mode
     static per_runtime<nthread_type>  nthread;
     static per_runtime<chain::stepid> use_closefd;
+    static per_runtime<chain::stepid> writer_step;
+    static per_runtime<chain::stepid> spill_step;
+    static per_runtime<unsigned int>  spill_mb;
 
     // Assert that the requested transfermode is one that we support
     EZASSERT2(rtm==net2vbs || rtm==fill2vbs || rtm==vbsrecord || rtm==mem2vbs, cmdexception,
@@ -295,6 +299,10 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
         // may query 'nthread' rather than vbs2net status
         //    vbs2net?         => vbs2net status
         //    vbs2net? nthread => query how many threads configured
+        //    vbs2net? disks   => per-disk write statistics of the running
+        //                        transfer (see mfa_diskhealth())
+        //    vbs2net? spill   => size of the spill buffer [MB] and, if
+        //                        running, its statistics (see chunkspill_status())
         const string    what( OPTARG(1, args) );
 
         // Queries always work
@@ -304,6 +312,17 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
             reply << nthread[&rte].nParallelReader << " : " << nthread[&rte].nParallelWriter;
         } else if( what=="mk6" ) {
             reply << rte.mk6info.mk6;
+        } else if( what=="disks" ) {
+            per_runtime<chain::stepid>::const_iterator  p = writer_step.find( &rte );
+
+            if( ctm!=no_transfer && rtm==ctm && p!=writer_step.end() )
+                reply << rte.processingchain.communicate(p->second, &mfa_diskhealth);
+        } else if( what=="spill" ) {
+            per_runtime<chain::stepid>::const_iterator  p = spill_step.find( &rte );
+
+            reply << spill_mb[&rte];
+            if( ctm!=no_transfer && rtm==ctm && p!=spill_step.end() )
+                reply << " : " << rte.processingchain.communicate(p->second, &chunkspill_status);
         } else {
             if( ctm==no_transfer || rtm!=ctm ) {
                 // GiuseppeM suggests to return "on/off" for record?
@@ -317,7 +336,7 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                 if( rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs )
                     reply << " : " << rte.mk6info.dirList.size() << " : " << *rte.mk6info.dirList.begin();
                 // And add the byte counter
-                reply << " : " << rte.statistics.counter(0);
+                reply << " : " << rte.statistics.value(0);
             }
         }
         reply << " ;";
@@ -354,6 +373,10 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
             const string                    scanname( rsync ? string() : mk_scan_name(org_scanname, mk6info.mountpoints, mk6info.mk6) );
             chain::stepid                   s1, s2;
             mk6_file_header::packet_formats m6fmt = mk6_file_header::UNKNOWN_FORMAT;
+            // Mark6 recording straight off the network: the udpsnor reader
+            // can leave room for the write block header in front of each
+            // block, saving parallelwriter a write(2) per block
+            bool                            wb_headroom = false;
 
             // At the moment we can only do rsync over tcp or udt 
             if( rsync  ) {
@@ -443,6 +466,7 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                     c.add( &mk6_chunkmaker, 2, chunkmakerargs );
                 else
                     c.add( &chunkmaker    , 2, chunkmakerargs );
+                c.register_final( &write_timeindex, chunkmakerargs );
             } else {
                 // just suck the network card or membuf empty,
                 // allowing for partial blocks
@@ -480,7 +504,12 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                         // chunkmakers that know how to handle tagged blocks
                         useStreams = true;
                     } else {
-                        readstep = c.add(&netreader, 4, &net_server, networkargs(&rte, true));
+                        networkargs    na(&rte, true);
+
+                        wb_headroom = (rtm==vbsrecord && mk6info.mk6 && protocol=="udpsnor");
+                        if( wb_headroom )
+                            na.headroom = sizeof(mk6_wb_header_v2);
+                        readstep = c.add(&netreader, 4, &net_server, na);
 
                         // Cancellations are processed in the order they are
                         // registered. Which is good ... in case of UDPS protocol we
@@ -521,6 +550,19 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                     else
                         c.add( &chunkmaker            , nMountpoints, chunkmakerargs);
                 }
+                if( !useStreams )
+                    c.register_final( &write_timeindex, chunkmakerargs );
+            }
+
+            // If configured, an elastic buffer between chunkmaker and
+            // writers absorbs short disk stalls
+            per_runtime<chain::stepid>::iterator  oldspill = spill_step.find( &rte );
+            if( oldspill!=spill_step.end() )
+                spill_step.erase( oldspill );
+            if( !rsync && spill_mb[&rte]>0 ) {
+                spill_step[ &rte ] = c.add( &chunkspiller, nthreadref.nParallelWriter,
+                                            chunkspillargs(&rte, (uint64_t)spill_mb[&rte]*1024*1024, rte.netparms.get_blocksize(),
+                                                           wb_headroom ? (unsigned int)sizeof(mk6_wb_header_v2) : 0) );
             }
 
             // Add the striping step. If the selected mountpoint list is
@@ -528,9 +570,10 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
             // testin'
             s2 = c.add( is_null_diskset(mk6info.mountpoints) ? &parallelsink : &parallelwriter,
                         // and the step user data creation
-                        &get_mountpoints, &rte, mk6info.mk6 ? mark6_vars_type(m6pkt_sz, m6fmt)
+                        &get_mountpoints, &rte, mk6info.mk6 ? mark6_vars_type(m6pkt_sz, m6fmt, wb_headroom)
                                                             : mark6_vars_type() );
             c.register_cancel(s2, &mfa_close);
+            writer_step[ &rte ] = s2;
             // Set number of parallel writers as configured
             c.nthread( s2, nthreadref.nParallelWriter );
 
@@ -545,6 +588,7 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
             // install the chain in the rte and run it
             rte.processingchain = c;
             rte.processingchain.run();
+            ramp_begin(&rte);
                 
             // Update global transferstatus variables to
             // indicate what we're doing. the submode will
@@ -662,6 +706,24 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
             nthreadref.nParallelWriter = (unsigned int)nWrt;
         }
     }
+    // net2vbs = spill : <MB>
+    //   reserve <MB> of memory for chunks that can't be handed to a
+    //   writer right away; 0 = no spill buffer
+    if( args[1]=="spill" ) {
+        char*             eocptr;
+        const string      mb_s( OPTARG(2, args) );
+        unsigned long int mb;
+
+        recognized = true;
+        EZASSERT2(!mb_s.empty(), cmdexception, EZINFO("no spill buffer size given"));
+
+        errno = 0;
+        mb    = ::strtoul(mb_s.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=mb_s.c_str() && *eocptr=='\0' && errno!=ERANGE && mb<=UINT_MAX, cmdexception,
+                  EZINFO("spill buffer size '" << mb_s << "' out of range"));
+        spill_mb[ &rte ] = (unsigned int)mb;
+        reply << " 0 ;";
+    }
     if( args[1]=="mk6" ) {
         char*             eocptr;
         const string      mk6_s( OPTARG(2, args) );
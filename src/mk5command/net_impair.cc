@@ -0,0 +1,78 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <limits.h>
+
+using namespace std;
+
+
+// Deliberately impair the stream sent by the udps writer, for testing
+// how the receiving end - and its statistics - cope with loss and
+// reordering:
+//      net_impair = <loss %> : <reorder %> [: <seed>]
+//      net_impair?  => 0 : <loss %> : <reorder %> : <seed>
+// Which datagrams are dropped or sent out-of-order is decided by a
+// pseudo random generator seeded with <seed> (default 1), so a test can
+// be repeated exactly. "net_impair = 0 : 0" switches it off. Takes
+// effect at the next transfer.
+string net_impair_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream reply;
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    if( qry ) {
+        reply << " 0 : " << rte.netparms.impair_loss << " : " << rte.netparms.impair_reorder
+              << " : " << rte.netparms.impair_seed << " ;";
+        return reply.str();
+    }
+
+    if( args.size()<3 || args[1].empty() || args[2].empty() ) {
+        reply << " 8 : Command must have loss and reorder percentages ;";
+        return reply.str();
+    }
+
+    char*         eocptr;
+    double        pct[2];
+    unsigned long seed = 1;
+
+    for(unsigned int i=0; i<2; i++) {
+        errno  = 0;
+        pct[i] = ::strtod(args[i+1].c_str(), &eocptr);
+        EZASSERT2(eocptr!=args[i+1].c_str() && *eocptr=='\0' && errno!=ERANGE && pct[i]>=0.0 && pct[i]<=100.0,
+                  cmdexception, EZINFO("'" << args[i+1] << "' is not a percentage"));
+    }
+    EZASSERT2(pct[0]+pct[1]<=100.0, cmdexception, EZINFO("loss + reorder exceeds 100%"));
+
+    if( args.size()>3 && !args[3].empty() ) {
+        errno = 0;
+        seed  = ::strtoul(args[3].c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=args[3].c_str() && *eocptr=='\0' && errno!=ERANGE && seed<=UINT_MAX,
+                  cmdexception, EZINFO("seed '" << args[3] << "' NaN/out of range"));
+    }
+
+    RTEEXEC(rte, rte.netparms.impair_loss    = pct[0];
+                 rte.netparms.impair_reorder = pct[1];
+                 rte.netparms.impair_seed    = (unsigned int)seed);
+
+    reply << " 0 ;";
+    return reply.str();
+}
@@ -19,15 +19,23 @@
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
 #include <limits.h>
+#include <ctype.h>
 #include <iostream>
 #include <carrayutil.h>
 #include <stringutil.h>
+#include <getsok_udt.h>     // for udt_cc_factory(), udt_cc_names()
 
 using namespace std;
 
 
 // Expect:
 // net_protcol=<protocol>[:<socbufsize>[:<blocksize>[:<nblock>]]
+//
+// For protocol "udt" the congestion control algorithm may follow the
+// protocol:
+// net_protcol=udt[:<cc>][:<socbufsize>[:<blocksize>[:<nblock>]]
+// with <cc> the name of one of the registered algorithms (see
+// getsok_udt.h). It is recognized by it not being a number.
 // 
 // Note: existing uses of eVLBI protocolvalues mean that when "they" say
 //       'netprotcol=udp' they *actually* mean 'netprotocol=udps'
@@ -63,8 +71,12 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
         else
             reply << "Rx " << np.rcvbufsize << ", Tx " << np.sndbufsize;
         reply << " : " << np.get_blocksize()
-              << " : " << np.nblock 
-              << " ;";
+              << " : " << np.nblock;
+        // Add the congestion control at the end such that the
+        // positions of the other fields remain unaltered
+        if( proto_cp=="udt" )
+            reply << " : " << np.get_udtcc();
+        reply << " ;";
         return reply.str();
     }
 
@@ -76,11 +88,17 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
     // Make sure the reply is RLY empty [see before "return" below why]
     reply.str( string() );
 
-    // Extract potential arguments
-    const string proto( OPTARG(1, args) );
-    const string sokbufsz( OPTARG(2, args) );
-    const string workbufsz( OPTARG(3, args) );
-    const string nbuf( OPTARG(4, args) );
+    // Extract potential arguments. If the protocol is udt and it is
+    // followed by something that does not start with a digit, that's the
+    // congestion control algorithm and all other arguments shift by one
+    const string       proto( OPTARG(1, args) );
+    const string       cc_or_sokbufsz( OPTARG(2, args) );
+    const bool         has_cc = (proto=="udt" && !cc_or_sokbufsz.empty() &&
+                                 ::isalpha((unsigned char)cc_or_sokbufsz[0]));
+    const unsigned int nxt( has_cc ? 3 : 2 );
+    const string       sokbufsz( OPTARG(nxt, args) );
+    const string       workbufsz( OPTARG(nxt+1, args) );
+    const string       nbuf( OPTARG(nxt+2, args) );
 
     // See which arguments we got
     // #1 : <protocol>
@@ -97,7 +115,21 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
         // EZASSERT2( find_element(::tolower(proto), recognized), cmdexception,
         EZASSERT2( find_element(proto, recognized), cmdexception,
                    EZINFO("the protocol " << proto << " is not recognized as a valid protocol") );
+        // Selecting a protocol resets the congestion control to the
+        // default unless one was given explicitly
+        if( has_cc ) {
+            bool  known = true;
+            try {
+                udt_cc_factory( cc_or_sokbufsz );
+            }
+            catch( const udtexception& ) {
+                known = false;
+            }
+            EZASSERT2( known, cmdexception,
+                       EZINFO("the UDT congestion control " << cc_or_sokbufsz << " is not recognized, choose from " << udt_cc_names()) );
+        }
         np.set_protocol( proto );
+        np.set_udtcc( has_cc ? cc_or_sokbufsz : string() );
     }
 
     // #2 : <socbuf size> [we set both send and receivebufsizes to this value]
@@ -166,8 +198,8 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
         else
             reply << "!" << args[0] << " = 8 : <nbuf> out of range - 0 or too large ;";
     }
-    if( args.size()>5 )
-        DEBUG(1,"Extra arguments (>5) ignored" << endl);
+    if( args.size()>nxt+3 )
+        DEBUG(1,"Extra arguments (>" << nxt+3 << ") ignored" << endl);
 
     // If reply is still empty, the command was executed succesfully - indicate so
     if( reply.str().empty() )
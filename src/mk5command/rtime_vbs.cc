@@ -18,6 +18,7 @@
 //          7990 AA Dwingeloo
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
+#include <vbscatalog.h>
 #include <iostream>
 
 using namespace std;
@@ -33,7 +34,7 @@ string rtime_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
         return reply.str();
     }
    
-    mountpointinfo_type     mpi( ::statmountpoints(rte.mk6info.mountpoints) ); 
+    mountpointinfo_type     mpi( ::catalog_space(rte.mk6info.mountpoints) ); 
     headersearch_type       dataformat(rte.trackformat(), rte.ntrack(),
                                        rte.trackbitrate(),
                                        rte.vdifframesize());
@@ -20,7 +20,9 @@
 #include <mk5command/mk5.h>
 #include <data_check.h>
 #include <countedpointer.h>
+#include <timeindex.h>
 
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -47,6 +49,8 @@ string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
     INPROGRESS(rte, reply, streamstorbusy(rte.transfermode))
 
     countedpointer<data_reader_type> data_reader;
+    countedpointer<timeindex_type>   tindex;
+    off_t                            fpStart = 0;
     if ( from_file ) {
         const string filename = OPTARG(3, args);
         if ( filename.empty() ) {
@@ -65,6 +69,16 @@ string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
         // Construct reader from values set by "scan_set="
         data_reader = countedpointer<data_reader_type>( new vbs_reader_base(mk6info.scanName, mk6info.mountpoints,
                                                                             mk6info.fpStart,  mk6info.fpEnd) );
+        fpStart     = mk6info.fpStart;
+
+        // If the recording was indexed we can read exactly from a frame
+        // boundary near the end
+        try {
+            tindex = countedpointer<timeindex_type>( new timeindex_type(mk6info.scanName, mk6info.mountpoints) );
+        }
+        catch( const timeindexexception& e ) {
+            DEBUG(4, "scan_check: " << e.what() << endl);
+        }
     }
 
     string   bytes_to_read_arg = OPTARG(2, args);
@@ -131,7 +145,11 @@ string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
     if ( find_data_format( (unsigned char*)buffer->data, bytes_to_read, 4, strict, found_data_type) ) {
         // found something at start of the scan, check for the same format at the end
         uint64_t read_offset;
-        if ( is_vdif(found_data_type.format) ) {
+        if ( tindex && tindex->format()==found_data_type.format ) {
+            // the index knows where the frames are
+            read_offset = (uint64_t)(std::max(tindex->frame_at(fpStart + data_reader->length() - bytes_to_read), (int64_t)fpStart) - fpStart);
+        }
+        else if ( is_vdif(found_data_type.format) ) {
             // round the start of data to read to a multiple of 
             // VDIF frame size, in the hope of being on a frame
             read_offset = (data_reader->length() - bytes_to_read) 
@@ -21,6 +21,7 @@
 #include <data_check.h>
 #include <dotzooi.h>
 #include <countedpointer.h>
+#include <timeindex.h>
 
 #include <algorithm>
 #include <iostream>
@@ -223,9 +224,13 @@ string scan_set_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
     // as the offset might be given in time, we might need the data format 
     // to compute the data rate, do that data check only once.
     // Start with defaults: whole scan
+    // If the recording was indexed whilst it was recorded, times are
+    // looked up in the index rather than computed from the data rate
     bool            data_checked = false;
+    bool            index_checked = false;
     off_t           fpStart( 0 ), fpEnd( vbsrec->length() );
     data_check_type found_data_type;
+    countedpointer<timeindex_type> tindex;
 
     fpStart = 0;
     fpEnd   = vbsrec->length();
@@ -289,6 +294,67 @@ string scan_set_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
             // We can only do this if the disks are not being used
             INPROGRESS(rte, reply, (ctm==vbsrecord || ctm==fill2vbs))
 
+            if( !index_checked ) {
+                try {
+                    tindex = countedpointer<timeindex_type>( new timeindex_type(scanName, mk6info.mountpoints) );
+                }
+                catch( const timeindexexception& e ) {
+                    DEBUG(3, "scan_set: " << e.what() << ", computing offset from data rate" << endl);
+                }
+                index_checked = true;
+            }
+            if( tindex ) {
+                int64_t          byte_offset;
+                highrestime_type requested;
+
+                if ( relative_time ) {
+                    const highresdelta_type  dt( (int64_t)seconds_in_year(parsed_time)*1000000 + microseconds, 1000000 );
+
+                    // Negative values are wrt to end of scan, if parsing
+                    // end byte positive values are wrt start pos
+                    if ( arg[0] == '-' )
+                        requested = tindex->time_of(fpEnd) - dt;
+                    else
+                        requested = tindex->time_of(fpStart) + dt;
+                }
+                else {
+                    // re-run the parsing, defaulting to the data time
+                    const highrestime_type  data_time = tindex->start();
+
+                    ASSERT_COND( gmtime_r(&data_time.tv_sec, &parsed_time ) );
+                    microseconds = (unsigned int)::round( boost::rational_cast<double>(data_time.tv_subsecond * 1000000) );
+
+                    unsigned int fields = parse_vex_time(arg, parsed_time, microseconds);
+                    ASSERT_COND( fields > 0 );
+
+                    time_t requested_time = ::mktime( &parsed_time );
+                    ASSERT_COND( requested_time != (time_t)-1 );
+
+                    // Before the data? Then move to the next "mark" by
+                    // increasing the first field that was not given by one
+                    // (see below)
+                    requested = highrestime_type(requested_time, subsecond_type(microseconds, 1000000));
+                    if ( requested < data_time ) {
+                        const unsigned int field_second_values[] = { 
+                            1, 
+                            60, 
+                            60 * 60, 
+                            24 * 60 * 60, 
+                            365 * 24 * 60 * 60};
+                        requested += highresdelta_type(field_second_values[ min((size_t)fields, sizeof(field_second_values)/sizeof(field_second_values[0]) - 1) ]);
+                    }
+                }
+                if ( !tindex->offset_of(requested, byte_offset) ) {
+                    reply << " 8 : requested time " << tm2vex(requested) << " is not in the recording ;";
+                    return reply.str();
+                }
+                if ( argument_position == 2 ) 
+                    fpStart = byte_offset;
+                else
+                    fpEnd   = byte_offset;
+                continue;
+            }
+
             // we need a data format to compute a byte offset from the time offset 
             if ( !data_checked ) {
                 uint64_t                  scan_length = vbsrec->length();
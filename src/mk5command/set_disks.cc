@@ -71,12 +71,16 @@ string set_disks_fn(bool q, const vector<string>& args, runtime& rte ) {
     // Ok, let's get down to resolving, using the groups defined in the
     // current runtime and the built-in groupdefs and collect all
     // mountpoints matching the pattern(s)
-    mk6info.mountpoints = find_mountpoints( resolvePatterns(pl, mk6info.groupdefs) );
+    // Scanning may take a while; only hold the runtime lock for the
+    // assignment. sfxc clients read the mountpoints from the main thread
+    const mountpointlist_type  mps( find_mountpoints(resolvePatterns(pl, mk6info.groupdefs)) );
 
-    if( mk6info.mountpoints.empty() )
+    RTEEXEC(rte, mk6info.mountpoints = mps);
+
+    if( mps.empty() )
         reply << " 8 : 0 : no mountpoints matched your selection criteria";
     else
-        reply << " 0 : " << mk6info.mountpoints.size();
+        reply << " 0 : " << mps.size();
     reply << " ;";
     return reply.str();
 }
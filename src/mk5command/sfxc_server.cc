@@ -0,0 +1,72 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <sfxcserver.h>
+#include <iostream>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+
+using namespace std;
+
+
+// sfxc_server = on [: <max clients>]
+//     accept SFXC DataReaders again, at most <max clients> (default: keep
+//     the current maximum) at the same time
+// sfxc_server = off
+//     refuse new clients and disconnect the current ones
+// sfxc_server? 0 : <on|off> : <max clients> : <clients served> : <bytes sent> [: <id>/<recording>/<offset>/<bytes sent>/<MB/s now>/<MB/s average>/<zerocopy|copy>]* ;
+//     one entry per SFXC DataReader currently being served
+string sfxc_server_fn(bool q, const vector<string>& args, runtime&) {
+    ostringstream   reply;
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+    if( q ) {
+        reply << " 0 : " << sfxc_server_status() << " ;";
+        return reply.str();
+    }
+
+    const string  onoff( OPTARG(1, args) );
+
+    if( onoff=="off" ) {
+        sfxc_server_off();
+        reply << " 0 ;";
+        return reply.str();
+    }
+    if( onoff!="on" ) {
+        reply << " 8 : expect 'on' or 'off' ;";
+        return reply.str();
+    }
+
+    const string   maxstr( OPTARG(2, args) );
+    unsigned long  maxclient = sfxc_server_max();
+
+    if( !maxstr.empty() ) {
+        char*  eocptr;
+
+        errno     = 0;
+        maxclient = ::strtoul(maxstr.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=maxstr.c_str() && *eocptr=='\0' && errno!=ERANGE && maxclient>0 && maxclient<=UINT_MAX,
+                  cmdexception, EZINFO("max clients '" << maxstr << "' not a number/out of range"));
+    }
+    sfxc_server_on( (unsigned int)maxclient );
+    reply << " 0 ;";
+    return reply.str();
+}
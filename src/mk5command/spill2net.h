@@ -284,7 +284,7 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
             } else {
                 reply << "active";
 
-                const uint64_t current = rte.statistics.counter(reader_info.readstep);
+                const uint64_t current = rte.statistics.value(reader_info.readstep);
                 if( fromfile(ctm) ) {
                     const uint64_t  start = rte.processingchain.communicate(reader_info.readstep, &fdreaderargs::get_start);
                     const uint64_t  end   = rte.processingchain.communicate(reader_info.readstep, &fdreaderargs::get_end);
@@ -0,0 +1,59 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <tracering.h>
+#include <iostream>
+
+using namespace std;
+
+
+// Per-thread tracing of block get, queue push/pop, disk I/O and some
+// syscalls (see tracering.h)
+//
+//  trace = on | off
+//  trace = dump : <file>
+//      write the events still in the rings to <file>, in Chrome trace
+//      event (JSON) format. Replies the number of events written.
+//
+//  trace?  0 : <on|off> : <# threads traced> : <events per thread> ;
+string trace_fn(bool q, const vector<string>& args, runtime&) {
+    ostringstream   reply;
+    const string    what( OPTARG(1, args) );
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+
+    if( q ) {
+        reply << " 0 : " << (trace_enabled() ? "on" : "off") << " : " << trace_nring() << " : " << trace_ringsize() << " ;";
+        return reply.str();
+    }
+
+    if( what=="on" || what=="off" ) {
+        trace_enable( what=="on" );
+        reply << " 0 ;";
+    } else if( what=="dump" ) {
+        const string  file( OPTARG(2, args) );
+
+        EZASSERT2(!file.empty(), cmdexception, EZINFO("no file name given"));
+        reply << " 0 : " << trace_dump(file) << " ;";
+    } else {
+        reply << " 2 : " << (what.empty() ? string("<empty>") : what) << " does not apply to " << args[0] << " ;";
+    }
+    return reply.str();
+}
@@ -34,11 +34,16 @@ using namespace std;
 //                      get funny results
 //
 // tstat= <mumbojumbo>  (tstat as a command rather than a query)
-//   whatever argument you specify is completely ignored.
+//   whatever argument you specify is completely ignored, except "cpu".
 //   the format is now:
 //
 //   !tstat= 0 : <timestamp> : <transfer> : <step1 name> : <step1 counter> : <step2 name> : <step2 counter>
 //       <timestamp>  UNIX timestamp + added millisecond fractional seconds formatted as a float
+//
+//   "tstat = cpu" adds the CPU time (seconds) used so far by the thread(s)
+//   executing each step. Steps that internally run a chain of their own
+//   (e.g. the udps reader) only account for their own thread:
+//   !tstat= 0 : <timestamp> : <transfer> : <step1 name> : <step1 counter> : <step1 cpu> : ...
 //      
 //       This allows you to poll at your own frequency and compute the rates
 //       for over that period. Or graph them. Or throw them away.
@@ -85,9 +90,14 @@ string tstat_fn(bool q, const vector<string>& args, runtime& rte ) {
               << format("%.3lf", tijd) << " : "
               << transfermode ;
 
+        const bool cpu( args.size()>1 && args[1]=="cpu" );
+
         // output each chainstatcounter
-        for(curptr=current.begin(); curptr!=current.end(); curptr++)
-            reply << " : " << curptr->second.stepname << " : " << curptr->second.count;
+        for(curptr=current.begin(); curptr!=current.end(); curptr++) {
+            reply << " : " << curptr->second.stepname << " : " << curptr->second.value();
+            if( cpu )
+                reply << " : " << format("%.3lf", rte.processingchain.cputime(curptr->first));
+        }
 
         // finish off with the FIFOLength counter
         reply << " : FIFOLength : " << fifolen;
@@ -132,7 +142,7 @@ string tstat_fn(bool q, const vector<string>& args, runtime& rte ) {
         // equivalence making the stop condition simpler
         for(curptr=current.begin(), lastptr=laststats.begin();
             curptr!=current.end(); curptr++, lastptr++) {
-            double rate = (((double)(curptr->second.count-lastptr->second.count))/dt)*8.0;
+            double rate = (((double)(curptr->second.value()-lastptr->second.value()))/dt)*8.0;
             reply << " : " << curptr->second.stepname << " " << sciprintd(rate,"bps");
         }
         // Finish off with the FIFO percentage
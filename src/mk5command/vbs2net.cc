@@ -45,14 +45,15 @@ void vbs2netguard_fun(runtime* rteptr) {
 
 
 // Per runtime we keep the settings of how many parallel readers +
-// senders are started.
+// senders are started and wether chunks may be sent zero-copy.
 // The default c'tor assumes 1 each - the absolute minimum
 struct nthread_type {
     unsigned int    nParallelReader;
     unsigned int    nParallelSender;
+    bool            zeroCopy;
 
     nthread_type() :
-        nParallelReader( 1 ), nParallelSender( 1 )
+        nParallelReader( 1 ), nParallelSender( 1 ), zeroCopy( true )
     {}
 };
 
@@ -73,8 +74,9 @@ string vbs2net_fn( bool qry, const vector<string>& args, runtime& rte) {
     // Good. See what the usr wants
     if( qry ) {
         // may query 'nthread' rather than vbs2net status
-        //    vbs2net?         => vbs2net status
-        //    vbs2net? nthread => query how many threads configured
+        //    vbs2net?          => vbs2net status
+        //    vbs2net? nthread  => query how many threads configured
+        //    vbs2net? zerocopy => query wether zero-copy sending allowed
         const string    what( OPTARG(1, args) );
 
         // Queries always work
@@ -82,6 +84,8 @@ string vbs2net_fn( bool qry, const vector<string>& args, runtime& rte) {
 
         if( what=="nthread" ) {
             reply << nthread[&rte].nParallelReader << " : " << nthread[&rte].nParallelSender;
+        } else if( what=="zerocopy" ) {
+            reply << (nthread[&rte].zeroCopy ? "on" : "off");
         } else {
             if( ctm==no_transfer ) {
                 reply << "inactive";
@@ -96,7 +100,7 @@ string vbs2net_fn( bool qry, const vector<string>& args, runtime& rte) {
                 // we ARE running so we must be able to retrieve the lasthost
                 reply << status
                       << " : " << rte.netparms.host
-                      << " : " << rte.statistics.counter(0);
+                      << " : " << rte.statistics.value(0);
             }
         }
         reply << " ;";
@@ -127,7 +131,7 @@ string vbs2net_fn( bool qry, const vector<string>& args, runtime& rte) {
             const string            protocol( rte.netparms.get_protocol() );
             const string            scan( OPTARG(2, args) );
             const string            host( OPTARG(3, args) );
-            chain::stepid           s0, s1, s2;
+            chain::stepid           s0, s1;
             const nthread_type&     nthreadref = nthread[&rte];
 
             // At the moment we can only do this over tcp or udt or unix
@@ -141,17 +145,25 @@ string vbs2net_fn( bool qry, const vector<string>& args, runtime& rte) {
                 rte.netparms.host = host;
 
             // add the steps to the chain. 
-            s0 = c.add(&rsyncinitiator, nthreadref.nParallelReader+1, rsyncinitargs(scan, networkargs(&rte, rte.netparms)));
-            s1 = c.add( &parallelreader2, 4, multireadargs() );
-            s2 = c.add( &parallelsender, networkargs(&rte) );
+            // Chunk files are sent as-is so over TCP they can go straight
+            // from the page cache onto the network: each sender reads its
+            // own chunks. Otherwise separate readers fill blocks for the
+            // senders.
+            if( protocol=="tcp" && nthreadref.zeroCopy ) {
+                s0 = c.add(&rsyncinitiator, nthreadref.nParallelSender+1, rsyncinitargs(scan, networkargs(&rte, rte.netparms)));
+                s1 = c.add( &parallelfilesender, networkargs(&rte) );
+                c.nthread( s1, nthreadref.nParallelSender );
+            } else {
+                s0 = c.add(&rsyncinitiator, nthreadref.nParallelReader+1, rsyncinitargs(scan, networkargs(&rte, rte.netparms)));
+                s1 = c.add( &parallelreader2, 4, multireadargs(&rte) );
+                // Configure the number of parallel readers/senders 
+                c.nthread( s1, nthreadref.nParallelReader );
+                c.nthread( c.add(&parallelsender, networkargs(&rte)), nthreadref.nParallelSender );
+            }
 
             // Cancellation functions, if any
             c.register_cancel(s0, &rsyncinit_close);
 
-            // Configure the number of parallel readers/senders 
-            c.nthread( s1, nthreadref.nParallelReader );
-            c.nthread( s2, nthreadref.nParallelSender );
-
             // Register a finalizer which automatically clears the transfer when done 
             // we will typically have to wait for all readers + senders to
             // finish
@@ -244,6 +256,17 @@ string vbs2net_fn( bool qry, const vector<string>& args, runtime& rte) {
             nthreadref.nParallelSender = (unsigned int)nSnd;
         }
     }
+    // vbs2net = zerocopy : on|off
+    //   over TCP send the chunk files without copying them through
+    //   user space (default: on)
+    if( args[1]=="zerocopy" ) {
+        const string   zc( OPTARG(2, args) );
+
+        recognized = true;
+        EZASSERT2(zc=="on" || zc=="off", cmdexception, EZINFO("zerocopy must be 'on' or 'off'"));
+        nthread[&rte].zeroCopy = (zc=="on");
+        reply << " 0 ;";
+    }
     if( !recognized )
         reply << " 2 : " << args[1] << " does not apply to " << args[0] << " ;";
 
@@ -0,0 +1,112 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <copyengine.h>
+#include <iostream>
+#include <limits.h>
+
+using namespace std;
+
+
+// Copy (many) FlexBuff recordings to a remote net2vbs, several at once.
+//
+//  vbs_copy = add : <host> : <pattern> [: <pattern>]*
+//      queue the recordings on the selected disks that match any of the
+//      shell wildcard patterns; the current net_port and TCP settings
+//      of this runtime are used to connect to <host>
+//  vbs_copy = cancel : <pattern>
+//  vbs_copy = clear
+//      forget the recordings that are done/failed/cancelled
+//  vbs_copy = nthread : [<nThread>] : [<perDisk>]
+//      number of sender threads, number of chunks to read from one disk
+//      at the same time
+//
+//  vbs_copy?  0 : [<recording>/<state>/<chunks done>/<chunks>/<bytes done>/<bytes>/<MB/s>[/<error>]]* ;
+//  vbs_copy? nthread  0 : <nThread> : <perDisk> ;
+string vbs_copy_fn(bool q, const vector<string>& args, runtime& rte) {
+    ostringstream   reply;
+    const string    what( OPTARG(1, args) );
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+
+    if( q ) {
+        reply << " 0";
+        if( what=="nthread" ) {
+            const copyengine_parms  cp = copyengine_get_parms();
+            reply << " : " << cp.nThread << " : " << cp.perDisk;
+        } else {
+            const string  status = copyengine_status();
+            if( !status.empty() )
+                reply << " : " << status;
+        }
+        reply << " ;";
+        return reply.str();
+    }
+
+    if( what=="add" ) {
+        const string      host( OPTARG(2, args) );
+        patternlist_type  patterns;
+        netparms_type     np( rte.netparms );
+
+        EZASSERT2(!host.empty(), cmdexception, EZINFO("no host given"));
+        for(unsigned int i=3; i<args.size(); i++)
+            if( !args[i].empty() )
+                patterns.push_back( args[i] );
+        EZASSERT2(!patterns.empty(), cmdexception, EZINFO("no recording (pattern) given"));
+
+        np.host = host;
+        reply << " 0 : " << copyengine_add(patterns, rte.mk6info.mountpoints, networkargs(&rte, np)).size() << " ;";
+    } else if( what=="cancel" ) {
+        const string  pattern( OPTARG(2, args) );
+
+        EZASSERT2(!pattern.empty(), cmdexception, EZINFO("no recording (pattern) given"));
+        reply << " 0 : " << copyengine_cancel(pattern) << " ;";
+    } else if( what=="clear" ) {
+        copyengine_clear();
+        reply << " 0 ;";
+    } else if( what=="nthread" ) {
+        copyengine_parms  cp = copyengine_get_parms();
+        const string      nthr_s( OPTARG(2, args) );
+        const string      perdisk_s( OPTARG(3, args) );
+        char*             eocptr;
+        unsigned long     v;
+
+        if( !nthr_s.empty() ) {
+            errno = 0;
+            v     = ::strtoul(nthr_s.c_str(), &eocptr, 0);
+            EZASSERT2(eocptr!=nthr_s.c_str() && *eocptr=='\0' && errno!=ERANGE && v>0 && v<=UINT_MAX, cmdexception,
+                      EZINFO("nThread '" << nthr_s << "' out of range"));
+            cp.nThread = (unsigned int)v;
+        }
+        if( !perdisk_s.empty() ) {
+            errno = 0;
+            v     = ::strtoul(perdisk_s.c_str(), &eocptr, 0);
+            EZASSERT2(eocptr!=perdisk_s.c_str() && *eocptr=='\0' && errno!=ERANGE && v>0 && v<=UINT_MAX, cmdexception,
+                      EZINFO("perDisk '" << perdisk_s << "' out of range"));
+            cp.perDisk = (unsigned int)v;
+        }
+        copyengine_set_parms( cp );
+        reply << " 0 ;";
+    } else {
+        reply << " 2 : " << (what.empty() ? string("<empty>") : what) << " does not apply to " << args[0] << " ;";
+    }
+    return reply.str();
+}
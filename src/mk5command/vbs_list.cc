@@ -0,0 +1,61 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <vbscatalog.h>
+#include <iostream>
+#include <fnmatch.h>
+
+using namespace std;
+
+
+// List the FlexBuff recordings on the selected disks, from the catalog
+// [only the first query walks the disks]
+//
+//  vbs_list? [<pattern>]
+//      0 : <number of recordings> [: <recording>/<chunks>/<bytes>]* ;
+//      only recordings matching the shell wildcard pattern are listed
+string vbs_list_fn(bool q, const vector<string>& args, runtime& rte) {
+    ostringstream   reply;
+    const string    pattern( OPTARG(1, args) );
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+
+    if( !q ) {
+        reply << " 2 : query only ;";
+        return reply.str();
+    }
+    if( rte.mk6info.mountpoints.empty() ) {
+        reply << " 6 : no disks selected ;";
+        return reply.str();
+    }
+
+    const catalog_listing_type  listing( ::catalog_recordings(rte.mk6info.mountpoints) );
+    ostringstream               entries;
+    unsigned int                n = 0;
+
+    for(catalog_listing_type::const_iterator p=listing.begin(); p!=listing.end(); p++) {
+        if( !pattern.empty() && ::fnmatch(pattern.c_str(), p->first.c_str(), 0)!=0 )
+            continue;
+        entries << " : " << p->first << "/" << p->second.nChunk << "/" << p->second.nByte;
+        n++;
+    }
+    reply << " 0 : " << n << entries.str() << " ;";
+    return reply.str();
+}
@@ -0,0 +1,105 @@
+// Copyright (C) 2007-2013 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+// 
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <warmstart.h>
+#include <blockpool.h>
+#include <iostream>
+
+using namespace std;
+
+
+// Reuse of block pool memory between transfers and how long the last
+// transfer of this runtime took to get up to speed (see warmstart.h)
+//
+//  warmstart = on [: <max MB>]
+//  warmstart = off
+//      'off' frees the pool memory kept
+//  warmstart = prefault : <block size> : <nblock> [: <npool>]
+//      allocate and touch <npool> (default 1) pools of <nblock> blocks
+//      of <block size> bytes each, for the first transfer to use.
+//      Replies the number of pools kept.
+//
+//  warmstart?  0 : <on|off> : <max MB> : <MB kept> : <# pools kept> : <# reused> : <# not reused>
+//                : <first data (s)> : <steady (s)> : <steady rate (MB/s)> ;
+//      the last three are '-' if not (yet) known
+string warmstart_fn(bool q, const vector<string>& args, runtime& rte) {
+    ostringstream   reply;
+    const string    what( OPTARG(1, args) );
+
+    reply << "!" << args[0]  << (q?"?":"=") << " ";
+
+    if( q ) {
+        ramp_type              ramp;
+        const warmstart_parms  wp = warmstart_get_parms();
+        const warmcache_stats  ws = warm_cache_stats();
+
+        ramp_get(&rte, ramp);
+        reply << " 0 : " << (wp.enabled ? "on" : "off") << " : " << wp.maxCached/(1024*1024) << " : "
+              << ws.nByte/(1024*1024) << " : " << ws.nPool << " : " << ws.nHit << " : " << ws.nMiss << " : ";
+        if( ramp.firstData<0.0 )
+            reply << "- : ";
+        else
+            reply << ramp.firstData << " : ";
+        if( ramp.steady<0.0 )
+            reply << "- : - ;";
+        else
+            reply << ramp.steady << " : " << ramp.rate/1.0e6 << " ;";
+        return reply.str();
+    }
+
+    if( what=="on" || what=="off" ) {
+        warmstart_parms  wp = warmstart_get_parms();
+        const string     max( OPTARG(2, args) );
+
+        wp.enabled = (what=="on");
+        if( !max.empty() ) {
+            char*               eptr;
+            unsigned long int   mb;
+
+            mb = ::strtoul(max.c_str(), &eptr, 0);
+            EZASSERT2(eptr!=max.c_str() && *eptr=='\0', cmdexception,
+                      EZINFO("max MB '" << max << "' is not a number"));
+            wp.maxCached = (uint64_t)mb * 1024 * 1024;
+        }
+        warmstart_set_parms( wp );
+        reply << " 0 ;";
+    } else if( what=="prefault" ) {
+        const string        bs_s( OPTARG(2, args) ), nb_s( OPTARG(3, args) ), np_s( OPTARG(4, args) );
+        unsigned long int   bs, nb, np = 1;
+        char*               eptr;
+
+        EZASSERT2(warmstart_get_parms().enabled, cmdexception, EZINFO("warm start is not enabled"));
+        bs = ::strtoul(bs_s.c_str(), &eptr, 0);
+        EZASSERT2(!bs_s.empty() && *eptr=='\0' && bs>0 && bs<=UINT_MAX, cmdexception,
+                  EZINFO("invalid block size '" << bs_s << "'"));
+        nb = ::strtoul(nb_s.c_str(), &eptr, 0);
+        EZASSERT2(!nb_s.empty() && *eptr=='\0' && nb>0 && nb<=UINT_MAX, cmdexception,
+                  EZINFO("invalid number of blocks '" << nb_s << "'"));
+        if( !np_s.empty() ) {
+            np = ::strtoul(np_s.c_str(), &eptr, 0);
+            EZASSERT2(*eptr=='\0' && np>0 && np<=UINT_MAX, cmdexception,
+                      EZINFO("invalid number of pools '" << np_s << "'"));
+        }
+        reply << " 0 : " << warm_prefault(pool_memory_size((unsigned int)bs, (unsigned int)nb), (unsigned int)np) << " ;";
+    } else {
+        reply << " 2 : " << (what.empty() ? string("<empty>") : what) << " does not apply to " << args[0] << " ;";
+    }
+    return reply.str();
+}
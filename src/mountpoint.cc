@@ -1,5 +1,7 @@
 // Implementations
 #include <mountpoint.h>
+#include <dirwalker.h>
+#include <pthreadcall.h>
 #include <stringutil.h>
 #include <mutex_locker.h>
 #include <regular_expression.h>
@@ -18,7 +20,6 @@
 #include <stdexcept>
 
 #include <pthread.h>
-#include <ftw.h>
 #include <fnmatch.h>
 #include <signal.h>
 
@@ -116,22 +117,41 @@ int mp_pthread_create(pthread_t* thread, void *(*start_routine)(void*), void *ar
 //        or shell globbing!
 struct matchable_type {
     virtual bool    matches( const string& s ) const = 0;
+    // Could anything below directory 's' match? When in doubt, say yes
+    virtual bool    may_match_below( const string& ) const {
+        return true;
+    }
     virtual ~matchable_type() {};
 };
 
 // shell globbing uses ::fnmatch(3)
 struct shellglobbing_type: public matchable_type {
     shellglobbing_type(const string& glob):
-        __m_glob_pattern(glob)
+        __m_glob_pattern(glob), __m_glob_pieces( ::split(glob, '/', true) )
     { }
 
     virtual bool matches( const string& s ) const {
         return ::fnmatch(__m_glob_pattern.c_str(), s.c_str(), FNM_PATHNAME)==0;
     }
 
+    // With FNM_PATHNAME wildcards never match a '/' so the first n
+    // components of a path must match the first n components of the
+    // pattern for anything below it to match
+    virtual bool may_match_below( const string& s ) const {
+        const vector<string>::size_type  n = ::split(s, '/', true).size();
+        string                           leading;
+
+        if( n>=__m_glob_pieces.size() )
+            return false;
+        for(vector<string>::size_type i=0; i<n; i++)
+            leading += "/" + __m_glob_pieces[i];
+        return ::fnmatch((leading.empty() ? "/" : leading.c_str()), s.c_str(), FNM_PATHNAME)==0;
+    }
+
     ~shellglobbing_type() {}
 
-    const string    __m_glob_pattern;
+    const string            __m_glob_pattern;
+    const vector<string>    __m_glob_pieces;
 };
 
 // regex matchable, see regex(3)
@@ -187,7 +207,7 @@ struct delete_matchable {
 //
 //   Also, pattern 3 is a regex pattern, 1 and 2 are shell globbing
 //
-// The reason for (pre) optimizing this is that we do not want [n]ftw(3) to
+// The reason for (pre) optimizing this is that we do not want the directory walk to
 // grovel over ALL files/directories in the file system - we want to
 // restrict its search as much as we can.
 struct mpsettings_type {
@@ -361,79 +381,43 @@ mpmap_type analyze_patterns(const patternlist_type& patterns) {
 //  .first  = key   = the root path
 //  .second = value = contains maxdepth & list of regexes to match
 
-// For [n]ftw we need global info :-(
-namespace mp_ftw {
-    static pthread_mutex_t   mpLock = PTHREAD_MUTEX_INITIALIZER;
-
-    // Here we store the actual 'global' stuff for [n]ftw. Only copy data
-    // here after you've succesfully locked ...
-    static unsigned int          maxDepth;
-    static mountpointlist_type*  mountpointSet = 0;
-    static regexlist_type const* regexList = 0;
-}
-
-#define KEES(a) case (a): return string(#a); 
-string flag2str(int ftwf) {
-    switch(ftwf) {
-        KEES(FTW_D) 
-        KEES(FTW_F) 
-        KEES(FTW_DNR) 
-        KEES(FTW_DP) 
-        KEES(FTW_NS) 
-        KEES(FTW_SL) 
-        KEES(FTW_SLN)
-        default:
-            return string("(unknown)");
+// The directories below the start points are read in parallel by the
+// dirwalker. Each directory is matched against the patterns of its start
+// point; we only descend into it if that can still produce a match: not
+// too deep and, for shell globs, matching the pattern so far. This keeps
+// us from reading whole trees, e.g. the data directories on the disks.
+struct mountpoint_finder: public dirwalk_visitor {
+    mountpoint_finder(const mpmap_type& m, mountpointlist_type& mps):
+        __m_mpmap( m ), __m_mountpoints( mps )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&__m_mutex, 0) );
     }
-}
-
-int match_dirname(const char* path, const struct stat* , int flag, struct FTW* ftwp) {
-    // Only interested in directories
-    if( flag!=FTW_D )
-        return 0;
-
-    // We don't want to throw here - that would upset the calling 'nftw()'
-    // that we're inside of!
-    if( mp_ftw::regexList==0 || mp_ftw::mountpointSet==0 ) {
-        cerr << "match_dirname: regexList or mounpointset (or both) are NULL" << endl;
-        return 1;
-    }
-
-    // Match each path to all regexes and if they match - add the path to
-    // the set!
-    for( regexlist_type::const_iterator reptrptr=mp_ftw::regexList->begin(); reptrptr!=mp_ftw::regexList->end(); reptrptr++ )
-        if( (*reptrptr)->matches(path) )
-            mp_ftw::mountpointSet->insert(string(path));
-
-    // Stop processing if we've gone as deep as we must Make use of newer
-    // new ftw [fancier nftw(3), which in itself was an improvement on
-    // ftw(3) ...] features, like being able to skip going deeper into the
-    // hierarchy. When stuck with not-so-fancy nftw(3), one actually has to
-    // grovel over the WHOLE tree below the starting path given to nftw(3)
-    // ... OUCH.
-    if( (unsigned int)(ftwp->level)>=mp_ftw::maxDepth )
-#ifdef FTW_ACTIONRETVAL
-        return FTW_SKIP_SUBTREE;
-#else
-        return 0;
-#endif
 
+    virtual bool descend(const string& root, const string& path, unsigned int depth) {
+        mpmap_type::const_iterator  mpptr = __m_mpmap.find( root );
+        bool                        deeper = false;
 
-#if 0
-    cout << "[" << path << "]:";
-    for( regexlist_type::const_iterator reptr=mp_ftw::regexList->begin(); reptr!=mp_ftw::regexList->end(); reptr++ ) {
-        cout << "  " << *reptr << "=";
-        if( ::fnmatch(reptr->c_str(), path, FNM_PATHNAME)==0 ) {
-            mp_ftw::mountpointSet->insert(string(path));
-            cout << "1";
-        } else {
-            cout << "0";
+        if( mpptr==__m_mpmap.end() )
+            return false;
+        for(regexlist_type::const_iterator reptr=mpptr->second.regexes.begin(); reptr!=mpptr->second.regexes.end(); reptr++) {
+            if( (*reptr)->matches(path) ) {
+                mutex_locker  lck( __m_mutex );
+                __m_mountpoints.insert( path );
+            }
+            if( !deeper && depth<mpptr->second.maxdepth )
+                deeper = (*reptr)->may_match_below(path);
         }
+        return deeper;
+    }
+
+    virtual ~mountpoint_finder() {
+        ::pthread_mutex_destroy(&__m_mutex);
     }
-    cout << endl;
-#endif
-    return 0;
-}
+
+    const mpmap_type&     __m_mpmap;
+    mountpointlist_type&  __m_mountpoints;
+    pthread_mutex_t       __m_mutex;
+};
 
 // Functor for directory-helper-template which checks if
 // a given file name matches "/path/to/SCAN/SCAN.[0-9]{8}"
@@ -541,34 +525,20 @@ mountpointlist_type find_mountpoints(const patternlist_type& patterns) {
     mpmap_type          mountpoints = analyze_patterns(patterns);
     mountpointlist_type mps;
 
-    // Loop over all detected "start points" - the leading parts of patterns
-    // not containing globbing expressions.
+    list<string>        roots;
+
+    // Collect all detected "start points" - the leading parts of patterns
+    // not containing globbing expressions - and walk them all at once.
     for(mpmap_type::const_iterator p=mountpoints.begin(); p!=mountpoints.end(); p++) {
         // Special handling for the no mountpoint mountpoint
         if( p->first == noMountpoint ) {
             mps.insert( p->first );
             continue;
         }
-        // Grab lock on the FTW globals
-        mutex_locker    lck( mp_ftw::mpLock );
-
-        // Set up the external info for the NFTW call
-        mp_ftw::maxDepth      = p->second.maxdepth;
-        mp_ftw::regexList     = &p->second.regexes;
-        mp_ftw::mountpointSet = &mps;
-
-        // Ok, safe to call nftw now
-        int nftw_flags = 0;
-#ifdef FTW_ACTIONRETVAL
-        nftw_flags |= FTW_ACTIONRETVAL;
-#endif
-        ::nftw(p->first.c_str(), &match_dirname, 256, nftw_flags);
-
-        // Put back known bad values
-        mp_ftw::maxDepth      = 0;
-        mp_ftw::regexList     = 0;
-        mp_ftw::mountpointSet = 0;
+        roots.push_back( p->first );
     }
+    mountpoint_finder   finder(mountpoints, mps);
+    ::dirwalk(roots, finder);
 
     // mps is a set of existing directories that match the user's pattern(s).
     // Now it's time to wield out the ones that physically exist on the root
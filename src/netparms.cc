@@ -26,6 +26,7 @@ using namespace std;
 // some constant string-valued defaults for netparm
 const std::string defProtocol = std::string("tcp");
 const std::string defUDPHelper = std::string("smart");
+const std::string defUDTCC = std::string("ipd");
 
 // construct a default network parameter setting thingy
 netparms_type::netparms_type():
@@ -34,9 +35,11 @@ netparms_type::netparms_type():
     , theoretical_ipd_ns( netparms_type::defIPD )
     , ackPeriod( netparms_type::defACK )
     , nblock( netparms_type::defNBlock )
+    , impair_loss( 0.0 ), impair_reorder( 0.0 ), impair_seed( 1 )
     , protocol( defProtocol ), mtu( netparms_type::defMTU )
     , blocksize( netparms_type::defBlockSize )
     , port( netparms_type::defPort )
+    , udtcc( defUDTCC )
 #if 0
     , nmtu( netparms_type::nMTU )
 #endif
@@ -81,6 +84,12 @@ void netparms_type::set_ack( int ack ) {
     return;
 }
 
+void netparms_type::set_udtcc( const std::string& cc ) {
+    udtcc = cc;
+    if( udtcc.empty() )
+        udtcc = defUDTCC;
+}
+
 #if 0
 void netparms_type::set_nmtu( unsigned int n ) {
     nmtu = n;
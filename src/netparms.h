@@ -29,6 +29,7 @@
 // typically, net_protocol modifies these
 extern const std::string  defProtocol;// = std::string("tcp");
 extern const std::string  defUDPHelper;// = std::string("smart");
+extern const std::string  defUDTCC;// = std::string("ipd");
 
 struct netparms_type {
     // Defaults, for easy readability
@@ -69,6 +70,13 @@ struct netparms_type {
     int                theoretical_ipd_ns;
     int                ackPeriod;
     unsigned int       nblock;
+    // Deliberate impairment of sent udps traffic, for testing the
+    // receiving end (see "net_impair="): percentage of datagrams
+    // dropped/sent out of order, and the seed for the random
+    // generator deciding which. All zero means no impairment.
+    double             impair_loss;
+    double             impair_reorder;
+    unsigned int       impair_seed;
 
     // 
     // various parts in "the system" know about the following set of
@@ -139,6 +147,10 @@ struct netparms_type {
     void set_port( unsigned short portnr=0 );
     // ack==0 => reset to default (defACK)
     void set_ack( int ack=0 );
+    // Name of the congestion control algorithm to use on UDT
+    // connections ("net_protocol=udt:<cc>").
+    // cc.empty()==true => reset to default (defUDTCC)
+    void set_udtcc( const std::string& cc="" );
 
     // Note: the following method is implemented but 
     // we're not convinced that nmtu/datagram > 1
@@ -185,6 +197,9 @@ struct netparms_type {
     inline unsigned short get_port( void ) const {
         return port;
     }
+    inline std::string get_udtcc( void ) const {
+        return udtcc;
+    }
 
     private:
         // keep mtu and blocksize private.
@@ -209,6 +224,7 @@ struct netparms_type {
         unsigned int         mtu;
         unsigned int         blocksize;
         unsigned short       port;
+        std::string          udtcc;
 
         // if we ever want to send datagrams larger than 1 MTU,
         // make this'un non-const and clobber it to liking
@@ -68,13 +68,12 @@ struct per_runtime {
                 throw std::runtime_error( std::string("Failed to initialize mutex: ")+repr(errno)+" "+evlbi5a::strerror(errno) );
         }
 
-        // begin()/end()
-        iterator       begin( void ) {
-            return __my_map.begin();
-        }
-        const_iterator begin( void ) const {
-            return __my_map.begin();
-        }
+        // end()
+        //   Only there to compare the result of find() against; the
+        //   end iterator of a map is never invalidated. There is no
+        //   begin(): iterating over the map would need the lock held for
+        //   the whole loop. Use snapshot() to get a copy of the map,
+        //   taken under the lock, instead
         iterator       end( void ) {
             return __my_map.end();
         }
@@ -82,11 +81,24 @@ struct per_runtime {
             return __my_map.end();
         }
 
+        __my_map_type snapshot( void ) const {
+            mutex_locker   sml( __my_mutex );
+            return __my_map;
+        }
+
         // find()
+        //   Commands for different runtimes may execute at the same time
+        //   (see cmdexecutor.h) so the map itself is locked whilst looking
+        //   up or changing entries. The entry for a runtime is only
+        //   touched by the commands for that runtime, which are executed
+        //   one after the other, so iterators and references can be used
+        //   without the lock
         iterator       find(runtime const* rteptr) {
+            mutex_locker   sml( __my_mutex );
             return __my_map.find(rteptr);
         }
         const_iterator find(runtime const* rteptr) const {
+            mutex_locker   sml( __my_mutex );
             return __my_map.find(rteptr);
         }
 
@@ -100,6 +112,8 @@ struct per_runtime {
 
             if( rteptr->key_deleters.find((void*)this) == rteptr->key_deleters.end() )
                 rteptr->key_deleters[ (void*)this ] = &per_runtime<T>::key_deleter;
+
+            mutex_locker   sml( __my_mutex );
             return __my_map[ rteptr ];
         }
 
@@ -112,6 +126,8 @@ struct per_runtime {
 
             if( rteptr->key_deleters.find((void*)this) == rteptr->key_deleters.end() )
                 rteptr->key_deleters[ (void*)this ] = &per_runtime<T>::key_deleter;
+
+            mutex_locker   sml( __my_mutex );
             return __my_map.insert(val);
         }
 
@@ -124,6 +140,8 @@ struct per_runtime {
             scopedrtelock   srtl( *const_cast<runtime*>(rteptr) );
 
             rteptr->key_deleters.erase( (void*)this );
+
+            mutex_locker   sml( __my_mutex );
             __my_map.erase( p );
             return;
         }
@@ -133,6 +151,8 @@ struct per_runtime {
             scopedrtelock   srtl( *const_cast<runtime*>(rteptr) );
 
             rteptr->key_deleters.erase( (void*)this );
+
+            mutex_locker   sml( __my_mutex );
             return __my_map.erase( rteptr );
         }
 
@@ -149,7 +169,7 @@ struct per_runtime {
 
     private:
         __my_map_type   __my_map;
-        pthread_mutex_t __my_mutex;
+        mutable pthread_mutex_t __my_mutex;
 
         // This is a static member function taking two void*.
         // Because it is a member function of this templated object and we
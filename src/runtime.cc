@@ -31,6 +31,8 @@
 #include <dotzooi.h>
 #include <headersearch.h>
 #include <ezexcept.h>
+#include <mutex_locker.h>
+#include <warmstart.h>
 
 // c++
 #include <set>
@@ -51,9 +53,118 @@ DEFINE_EZEXCEPT(rte_error)
 evlbi_stats_type::evlbi_stats_type():
     ooosum(0), pkt_in( 0 ), pkt_lost( 0 ), pkt_ooo( 0 ),
     pkt_disc( 0 ), gap_sum( 0 ),
-    discont( 0 ), discont_sz( 0 )
+    discont( 0 ), discont_sz( 0 ),
+    pkt_retrans( 0 ), rtt( 0 ), rate( 0 )
 {}
 
+evlbi_stats_type& evlbi_stats_type::operator+=(const evlbi_stats_type& other) {
+    ooosum      += other.ooosum;
+    pkt_in      += other.pkt_in;
+    pkt_lost    += other.pkt_lost;
+    pkt_ooo     += other.pkt_ooo;
+    pkt_disc    += other.pkt_disc;
+    gap_sum     += other.gap_sum;
+    discont     += other.discont;
+    discont_sz  += other.discont_sz;
+    pkt_retrans += other.pkt_retrans;
+    return *this;
+}
+
+
+// A connection that hasn't reported for this long is gone
+static const double  udtlinkTimeout = 5.0;
+
+static double delta_t(const struct timeval& a, const struct timeval& b) {
+    return (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_usec - a.tv_usec)/1.0e6;
+}
+
+udtlinks_type::udtlinks_type() {
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+}
+
+udtlinks_type::link_type::link_type():
+    rtt( 0 ), rate( 0 ), npkt( 0 ), nlost( 0 ), bits( 0.0 )
+{
+    ::gettimeofday(&last, 0);
+    since = last;
+}
+
+// UDT's rate is over the interval since the previous update, which can
+// be very short. Average it over about a second.
+void udtlinks_type::update(int fd, double msRTT, double mbpsRate, uint64_t npkt, uint64_t nlost) {
+    struct timeval  now;
+    mutex_locker    locker( mutex );
+    link_type&      link( links[fd] );
+
+    ::gettimeofday(&now, 0);
+    // two updates within the same us give an infinite rate
+    if( mbpsRate>0.0 && mbpsRate<1.0e7 )
+        link.bits += mbpsRate * 1.0e6 * delta_t(link.last, now);
+    link.rtt    = (uint64_t)(msRTT * 1.0e3);
+    link.npkt  += npkt;
+    link.nlost += nlost;
+    link.last   = now;
+
+    const double  dt = delta_t(link.since, now);
+    if( dt>=1.0 ) {
+        link.rate  = (uint64_t)(link.bits / dt / 1.0e3);
+        link.bits  = 0.0;
+        link.since = now;
+    }
+}
+
+void udtlinks_type::expire( void ) {
+    struct timeval  now;
+
+    ::gettimeofday(&now, 0);
+    for(links_type::iterator p=links.begin(); p!=links.end(); ) {
+        if( delta_t(p->second.last, now)>udtlinkTimeout )
+            links.erase( p++ );
+        else
+            p++;
+    }
+}
+
+unsigned int udtlinks_type::summary(uint64_t& rtt, uint64_t& rate) {
+    mutex_locker    locker( mutex );
+
+    this->expire();
+    rtt  = 0;
+    rate = 0;
+    for(links_type::const_iterator p=links.begin(); p!=links.end(); p++) {
+        rtt   = std::max(rtt, p->second.rtt);
+        rate += p->second.rate;
+    }
+    return (unsigned int)links.size();
+}
+
+string udtlinks_type::detail( void ) {
+    ostringstream   oss;
+    mutex_locker    locker( mutex );
+
+    this->expire();
+    for(links_type::const_iterator p=links.begin(); p!=links.end(); p++) {
+        const link_type&  l( p->second );
+        const double      total = (double)(l.npkt + l.nlost);
+
+        oss << (p==links.begin() ? "" : " : ")
+            << "link : " << p->first
+            << " : rtt : " << format("%.3lf", (double)l.rtt/1.0e3) << "ms"
+            << " : loss : " << l.nlost << " (" << format("%5.2lf%%", (total>0 ? (double)l.nlost/total*100.0 : 0.0)) << ")"
+            << " : rate : " << format("%.3lf", (double)l.rate/1.0e3) << "Mbps";
+    }
+    return oss.str();
+}
+
+void udtlinks_type::clear( void ) {
+    mutex_locker  locker( mutex );
+    links.clear();
+}
+
+udtlinks_type::~udtlinks_type() {
+    ::pthread_mutex_destroy(&mutex);
+}
+
 
 string fmt_evlbistats(const evlbi_stats_type& es) {
     return fmt_evlbistats(es, "total:%t:ooo:%o:disc:%d:lost:%l:extent:%R");
@@ -147,6 +258,18 @@ string fmt_evlbistats(const evlbi_stats_type& es, char const* const fmt) {
                         output << avg_discsz << "seqnr/discontinuity";
                         break;
 
+                    // UDT telemetry: round trip time, rate and number of
+                    // retransmitted packets
+                    case 'T':
+                        output << format("%.3lf", (double)es.rtt/1.0e3) << "ms";
+                        break;
+                    case 'b':
+                        output << format("%.3lf", (double)es.rate/1.0e3) << "Mbps";
+                        break;
+                    case 's':
+                        output << es.pkt_retrans;
+                        break;
+
                     // timestamp. raw unixtimestamp (+millisecond fraction
                     // or human readable timeformat
                     case 'u':
@@ -1316,6 +1439,8 @@ void runtime::setCurrentScan( unsigned int index ) {
 
 runtime::~runtime() {
     DEBUG(3, "Cleaning up runtime" << endl);
+    // stop measuring how this one gets up to speed
+    ramp_forget(this);
     // if threadz running, kill'm!
     DEBUG(4, "Stopping processingchain .... " << endl);
     this->processingchain.stop();
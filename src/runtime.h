@@ -37,6 +37,7 @@
 #include <chainstats.h>
 #include <bqueue.h>
 #include <block.h>
+#include <interchain.h>
 #include <mk6info.h>
 #include <counter.h>
 
@@ -44,11 +45,13 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <map>
 
 // for mutex
 #include <pthread.h>
 
 #include <stdint.h> // for [u]int<N>_t  types
+#include <sys/time.h>
 
 
 // BE mentioned something: the usually static 'per_runtime<>' structs can
@@ -89,8 +92,64 @@ struct evlbi_stats_type {
                                        // was
     ucounter_type      discont;    // number of discontinuities (seqnr > expect)
     ucounter_type      discont_sz; // discontinuity size
+    // UDT connections also report what the protocol itself measured
+    ucounter_type      pkt_retrans;// packets retransmitted
+    // These are not counters but per connection values, they are not
+    // kept in the shards. The evlbi? query fills them in from the
+    // runtime's udt_links (see below)
+    uint64_t           rtt;        // largest round trip time (us)
+    uint64_t           rate;       // summed send or receive rate (kbit/s)
 
     evlbi_stats_type();
+
+    // Used for adding up the shards (see below). rtt and rate are
+    // left alone.
+    evlbi_stats_type& operator+=(const evlbi_stats_type& other);
+};
+
+// The round trip time and rate UDT measures are per connection; they
+// can't be added up over threads like the counters. Each thread using a
+// UDT connection reports them here after UDT::perfmon(). A connection
+// that hasn't reported for a few seconds is considered gone.
+struct udtlinks_type {
+    udtlinks_type();
+
+    // 'npkt' and 'nlost' are the packets transferred and lost since the
+    // previous update
+    void         update(int fd, double msRTT, double mbpsRate, uint64_t npkt, uint64_t nlost);
+    // Fills in the largest rtt and the summed rate of the connections
+    // still alive and returns how many there are
+    unsigned int summary(uint64_t& rtt, uint64_t& rate);
+    // Per connection still alive:
+    //   "link : <fd> : rtt : <rtt>ms : loss : <n> (<pct>%) : rate : <rate>Mbps"
+    // separated by " : "
+    std::string  detail( void );
+    void         clear( void );
+
+    ~udtlinks_type();
+
+    private:
+        struct link_type {
+            uint64_t        rtt;    // us
+            uint64_t        rate;   // kbit/s, averaged over >= 1s
+            uint64_t        npkt, nlost;
+            double          bits;   // sent/received since 'since'
+            struct timeval  last, since;
+
+            link_type();
+        };
+        typedef std::map<int, link_type>  links_type;
+
+        // forget the connections that weren't updated for a while
+        // (mutex must be held)
+        void expire( void );
+
+        pthread_mutex_t  mutex;
+        links_type       links;
+
+        // no copying
+        udtlinks_type(const udtlinks_type&);
+        const udtlinks_type& operator=(const udtlinks_type&);
 };
 
 std::string   fmt_evlbistats(const evlbi_stats_type& stats, char const*const fmt);
@@ -316,6 +375,10 @@ struct runtime {
 
     // the attributes of the runtime 
 
+    // The name it goes by ("runtime = <name>"), for reporting e.g. disk
+    // usage per runtime
+    std::string            name;
+
     // The actual processing chain. We make it a public variable; it is
     // up to the program to (1) make sure you're doing the right thing
     // and (2) it makes it obvious where the object is [number of layers
@@ -323,8 +386,8 @@ struct runtime {
     // the chain offers. Use it well.
     chain                  processingchain;
 
-    // the queue that can be used to communicate data between runtimes
-    bqueue<block>*         interchain_source_queue;
+    // our tap on the ring that communicates data between runtimes
+    interchain_tap*        interchain_source_queue;
 
     // The global transfermode and submode/status
     transfer_type          transfermode;
@@ -465,8 +528,12 @@ struct runtime {
     void setCurrentScan( unsigned int index );
 
     // evlbi stats. Currently only carries meaningful data when
-    // udp is chosen as network transport
-    evlbi_stats_type            evlbi_stats;
+    // udp is chosen as network transport.
+    // Reader threads take a shard of their own and update that;
+    // use ".sum()" to get the totals.
+    sharded_type<evlbi_stats_type> evlbi_stats;
+    // rtt/rate per UDT connection
+    udtlinks_type                  udt_links;
 
     // keep a mapping of jobid => rot-to-systemtime mapping
     // taskid == -1 => invalid/unknown taskid
@@ -0,0 +1,358 @@
+// serve SFXC DataReaders from FlexBuff/Mark6 recordings
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <sfxcserver.h>
+#include <libvbs.h>
+#include <ioscheduler.h>
+#include <auto_array.h>
+#include <evlbidebug.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <threadutil.h>
+
+#include <list>
+#include <vector>
+#include <sstream>
+#include <cstring>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(sfxcserverexception)
+
+// Amount sent per system call and how far we ask the kernel to read ahead
+// of the client
+static const size_t  sendSize      = 4*1024*1024;
+static const size_t  readaheadSize = 64*1024*1024;
+
+// Each client has its own worker thread and read-ahead
+static const unsigned int  defaultMaxClient = 16;
+
+static double delta_t(const struct timeval& a, const struct timeval& b) {
+    return (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_usec - a.tv_usec)/1.0e6;
+}
+
+struct sfxc_client_type {
+    unsigned int         id;
+    int                  fd;
+    const string         recname;
+    const off_t          offset;
+    mountpointlist_type  mountpoints;
+    pthread_t            tid;
+    bool                 done;
+    // statistics, protected by the server's mutex
+    bool                 zerocopy;
+    uint64_t             nbyte;
+    uint64_t             lastbyte;
+    double               rate;
+    struct timeval       start, last;
+
+    sfxc_client_type(unsigned int i, int f, const string& rn, off_t o, const mountpointlist_type& mps):
+        id( i ), fd( f ), recname( rn ), offset( o ), mountpoints( mps ), done( false ),
+        zerocopy( true ), nbyte( 0 ), lastbyte( 0 ), rate( 0.0 )
+    {
+        ::gettimeofday(&start, 0);
+        last = start;
+    }
+};
+
+// All clients being served. Finished workers are joined when the next
+// client comes in or the status is asked. sfxc_server_off() disconnects
+// the remaining clients and joins their workers; main() must do that
+// before returning because the workers use libvbs' statics.
+struct sfxc_server_type {
+    typedef list<sfxc_client_type*>  clients_type;
+
+    bool             stop;
+    unsigned int     maxClient;
+    unsigned int     nextId;
+    uint64_t         nServed;
+    uint64_t         nByte;
+    clients_type     clients;
+    pthread_mutex_t  mutex;
+
+    sfxc_server_type():
+        stop( false ), maxClient( defaultMaxClient ), nextId( 0 ), nServed( 0 ), nByte( 0 )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+    }
+
+    // join finished workers. mutex must NOT be held
+    void reap( void ) {
+        clients_type   finished;
+        {
+            mutex_locker   locker( mutex );
+            for(clients_type::iterator p=clients.begin(); p!=clients.end(); ) {
+                if( (*p)->done ) {
+                    finished.push_back( *p );
+                    clients.erase( p++ );
+                } else {
+                    p++;
+                }
+            }
+        }
+        for(clients_type::iterator p=finished.begin(); p!=finished.end(); p++) {
+            ::pthread_join((*p)->tid, 0);
+            delete *p;
+        }
+    }
+
+    // disconnect all clients and join their workers. mutex must NOT be held
+    void disconnect( void ) {
+        clients_type   all;
+        {
+            mutex_locker   locker( mutex );
+            // Make all blocking sends return. A worker that is done has
+            // closed its fd already
+            for(clients_type::iterator p=clients.begin(); p!=clients.end(); p++)
+                if( !(*p)->done )
+                    ::shutdown((*p)->fd, SHUT_RDWR);
+            all.swap( clients );
+        }
+        for(clients_type::iterator p=all.begin(); p!=all.end(); p++) {
+            ::pthread_join((*p)->tid, 0);
+            delete *p;
+        }
+    }
+
+    ~sfxc_server_type() {
+        ::pthread_mutex_destroy(&mutex);
+    }
+};
+
+static sfxc_server_type  sfxc_server;
+
+
+// Open the recording in whichever format it exists
+static int open_recording(const string& recname, const mountpointlist_type& mps) {
+    auto_array<char const*>             vbsdirs( new char const*[ mps.size()+1 ] );
+    mountpointlist_type::const_iterator curmp = mps.begin();
+
+    for(unsigned int i=0; i<mps.size(); i++, curmp++)
+        vbsdirs[i] = curmp->c_str();
+    vbsdirs[ mps.size() ] = 0;
+
+    int        fd1 = ::mk6_open(recname.c_str(), &vbsdirs[0]);
+    int        fd2 = ::vbs_open(recname.c_str(), &vbsdirs[0]);
+    const bool fd1ok( fd1>=0 ), fd2ok( fd2>=0 );
+
+    if( fd1ok && fd2ok ) {
+        ::vbs_close( fd1 );
+        ::vbs_close( fd2 );
+        THROW_EZEXCEPT(sfxcserverexception, "'" << recname << "' exists in both Mk6/FlexBuff format");
+    }
+    EZASSERT2(fd1ok || fd2ok, sfxcserverexception,
+              EZINFO("'" << recname << "' does not exist in either Mk6 or FlexBuff format"));
+    return fd1ok ? fd1 : fd2;
+}
+
+// Send 'n' bytes from 'buf', all of them unless error
+static bool write_all(int fd, const unsigned char* buf, size_t n) {
+    while( n ) {
+        const ssize_t  nw = ::write(fd, buf, n);
+        if( nw<0 && errno==EINTR )
+            continue;
+        if( nw<=0 )
+            return false;
+        buf += nw;
+        n   -= (size_t)nw;
+    }
+    return true;
+}
+
+static void* sfxc_client_fn(void* argptr) {
+    sfxc_client_type*  client = (sfxc_client_type*)argptr;
+    int                vbsfd  = -1;
+    uint64_t           nAhead = 0;
+    struct timeval     now;
+    string             reason( "end of recording" );
+    vector<unsigned char> buffer;
+
+    try {
+        vbsfd = open_recording(client->recname, client->mountpoints);
+        EZASSERT2(::vbs_lseek(vbsfd, client->offset, SEEK_SET)==client->offset, sfxcserverexception,
+                  EZINFO("cannot seek to " << client->offset << " in " << client->recname << " - " << evlbi5a::strerror(errno)));
+        DEBUG(2, "sfxc_client[" << client->id << "]: serving " << client->recname << " from "
+                 << client->offset << " on fd#" << client->fd << endl);
+
+        while( true ) {
+            ssize_t   n;
+            bool      zc;
+            {
+                mutex_locker   locker( sfxc_server.mutex );
+                if( sfxc_server.stop ) {
+                    reason = "server stopped";
+                    break;
+                }
+                zc = client->zerocopy;
+            }
+            // Keep the kernel busy fetching the data ahead of where the
+            // client is reading now. This is the playback I/O that is
+            // scheduled against recordings on the same disk.
+            if( nAhead<readaheadSize/2 ) {
+                char      mp[PATH_MAX];
+
+                if( ::vbs_mountpoint(vbsfd, mp, sizeof(mp))!=0 )
+                    mp[0] = '\0';
+                ioslot    slot(mp, ioclass_playback, "sfxc");
+                ::vbs_readahead(vbsfd, readaheadSize);
+                slot.done(readaheadSize);
+                nAhead = readaheadSize;
+            }
+
+            if( zc ) {
+                if( (n=::vbs_sendfile(client->fd, vbsfd, sendSize))<0 && (errno==EINVAL || errno==ENOSYS) ) {
+                    DEBUG(3, "sfxc_client[" << client->id << "]: no zero-copy to fd#" << client->fd
+                             << " - " << evlbi5a::strerror(errno) << endl);
+                    mutex_locker   locker( sfxc_server.mutex );
+                    client->zerocopy = false;
+                    continue;
+                }
+                if( n<0 && errno==EINTR )
+                    continue;
+            } else {
+                if( buffer.empty() )
+                    buffer.resize( sendSize );
+                if( (n=::vbs_read(vbsfd, &buffer[0], sendSize))>0 && !write_all(client->fd, &buffer[0], (size_t)n) )
+                    n = -1;
+            }
+            if( n==0 )
+                break;
+            if( n<0 ) {
+                reason = string("client gone - ")+evlbi5a::strerror(errno);
+                break;
+            }
+            nAhead = (nAhead>(uint64_t)n ? nAhead-(uint64_t)n : 0);
+
+            ::gettimeofday(&now, 0);
+            mutex_locker   locker( sfxc_server.mutex );
+            const double   dt = delta_t(client->last, now);
+
+            client->nbyte     += (uint64_t)n;
+            sfxc_server.nByte += (uint64_t)n;
+            if( dt>=1.0 ) {
+                client->rate     = (double)(client->nbyte - client->lastbyte)/dt;
+                client->lastbyte = client->nbyte;
+                client->last     = now;
+            }
+        }
+    }
+    catch( const std::exception& e ) {
+        reason = e.what();
+    }
+    catch( ... ) {
+        reason = "caught unknown exception";
+    }
+    if( vbsfd>=0 )
+        ::vbs_close( vbsfd );
+
+    ::gettimeofday(&now, 0);
+    mutex_locker   locker( sfxc_server.mutex );
+    const double   dt = delta_t(client->start, now);
+
+    // Under the lock such that sfxc_server_off() doesn't shut down an fd
+    // that's been reused
+    ::close( client->fd );
+
+    DEBUG(1, "sfxc_client[" << client->id << "]: " << client->recname << " sent " << client->nbyte << " bytes in "
+             << dt << "s [" << (dt>0 ? (double)client->nbyte/dt/1.0e6 : 0.0) << "MB/s, "
+             << (client->zerocopy ? "zerocopy" : "copy") << "] - " << reason << endl);
+    client->done = true;
+    return (void*)0;
+}
+
+
+void sfxc_serve(int fd, const mk5read_msg& msg, const mountpointlist_type& mps) {
+    // The VSN field and the padding after it are one NUL-padded name
+    char               name[ sizeof(msg.vsn)+sizeof(msg.pad)+1 ];
+    sfxc_client_type*  client;
+
+    EZASSERT2(!mps.empty(), sfxcserverexception, EZINFO("no mountpoints selected to serve recordings from"));
+
+    ::memcpy(name, (char const*)&msg, sizeof(name)-1);
+    name[ sizeof(name)-1 ] = '\0';
+    EZASSERT2(name[0]!='\0', sfxcserverexception, EZINFO("no recording name in request"));
+
+    sfxc_server.reap();
+    {
+        mutex_locker   locker( sfxc_server.mutex );
+        EZASSERT2(!sfxc_server.stop, sfxcserverexception, EZINFO("sfxc_server is off"));
+        EZASSERT2(sfxc_server.clients.size()<sfxc_server.maxClient, sfxcserverexception,
+                  EZINFO("already serving the maximum of " << sfxc_server.maxClient << " clients"));
+        client = new sfxc_client_type(sfxc_server.nextId++, fd, name, (off_t)msg.off, mps);
+    }
+    // Worker threads must not receive signals; those are for the main thread
+    const int   rv = ::mp_pthread_create(&client->tid, &sfxc_client_fn, client);
+    if( rv!=0 ) {
+        delete client;
+        THROW_EZEXCEPT(sfxcserverexception, "failed to start worker - " << evlbi5a::strerror(rv));
+    }
+    mutex_locker   locker( sfxc_server.mutex );
+    sfxc_server.clients.push_back( client );
+    sfxc_server.nServed++;
+}
+
+string sfxc_server_status( void ) {
+    struct timeval   now;
+    ostringstream    oss;
+
+    sfxc_server.reap();
+    ::gettimeofday(&now, 0);
+
+    mutex_locker     locker( sfxc_server.mutex );
+    oss << (sfxc_server.stop ? "off" : "on") << " : " << sfxc_server.maxClient << " : "
+        << sfxc_server.nServed << " : " << sfxc_server.nByte;
+    for(sfxc_server_type::clients_type::const_iterator p=sfxc_server.clients.begin();
+        p!=sfxc_server.clients.end(); p++) {
+        const sfxc_client_type*  c = *p;
+        const double             dt = delta_t(c->start, now);
+
+        oss << " : " << c->id << "/" << c->recname << "/" << c->offset << "/" << c->nbyte << "/"
+            << c->rate/1.0e6 << "/" << (dt>0 ? (double)c->nbyte/dt/1.0e6 : 0.0) << "/"
+            << (c->zerocopy ? "zerocopy" : "copy");
+    }
+    return oss.str();
+}
+
+void sfxc_server_on( unsigned int maxclient ) {
+    mutex_locker   locker( sfxc_server.mutex );
+
+    EZASSERT2(maxclient>0, sfxcserverexception, EZINFO("the maximum number of clients must be > 0"));
+    sfxc_server.stop      = false;
+    sfxc_server.maxClient = maxclient;
+}
+
+void sfxc_server_off( void ) {
+    {
+        mutex_locker   locker( sfxc_server.mutex );
+        sfxc_server.stop = true;
+    }
+    sfxc_server.disconnect();
+}
+
+unsigned int sfxc_server_max( void ) {
+    mutex_locker   locker( sfxc_server.mutex );
+    return sfxc_server.maxClient;
+}
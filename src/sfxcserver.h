@@ -0,0 +1,63 @@
+// serve SFXC DataReaders from FlexBuff/Mark6 recordings
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_SFXCSERVER_H
+#define JIVE5AB_SFXCSERVER_H
+
+#include <sfxc_binary_command.h>
+#include <mountpoint.h>
+#include <ezexcept.h>
+
+#include <string>
+
+DECLARE_EZEXCEPT(sfxcserverexception)
+
+// On systems without a StreamStor the mk5read port ("-S") serves
+// FlexBuff/Mark6 recordings. Each accepted DataReader gets its own worker
+// thread, which
+//      - opens the recording named in the request's VSN field
+//        (recording names of up to 15 characters may continue into the
+//        padding bytes) on the given mountpoints,
+//      - seeks to the requested offset,
+//      - asks the kernel to read ahead of the client's position and
+//      - sends the data straight from the chunk files using sendfile(2),
+//        falling back to read/write if that can't be done
+// until the end of the recording or until the client goes away. Many
+// clients can be served at the same time, independent of the runtimes, up
+// to a configurable maximum (default 16).
+//
+// Takes ownership of 'fd'; it is closed when the client is done. Throws
+// if the server is off, the maximum number of clients is being served or
+// the worker could not be started (the caller then closes 'fd').
+void        sfxc_serve(int fd, const mk5read_msg& msg, const mountpointlist_type& mps);
+
+// Accept clients again, at most 'maxclient' at the same time. Clients
+// already being served above the new maximum are not disconnected
+void         sfxc_server_on( unsigned int maxclient );
+// Refuse new clients, disconnect the current ones and wait for their
+// workers to finish. main() must call this before returning
+void         sfxc_server_off( void );
+unsigned int sfxc_server_max( void );
+
+// "<on|off> : <max clients> : <clients served> : <bytes sent> [ : <id>/
+// <recording>/<offset>/<bytes sent>/<MB/s now>/<MB/s average>/
+// <zerocopy|copy> ]*" for the clients being served now
+std::string sfxc_server_status( void );
+
+#endif
@@ -23,6 +23,7 @@
 #include <sstream>
 #include <exception>
 #include <map>
+#include <list>
 #include <set>
 #include <vector>
 #include <algorithm>
@@ -52,6 +53,9 @@
 #include <mk6info.h>
 #include <sciprint.h>
 #include <sfxc_binary_command.h>
+#include <sfxcserver.h>
+#include <copyengine.h>
+#include <cmdexecutor.h>
 
 // system headers (for sockets and, basically, everything else :))
 #include <time.h>
@@ -102,14 +106,28 @@ struct per_rt_data {
 
 typedef map<string, per_rt_data> runtimemap_type;
 
+// Runtimes whose owner went away whilst commands were still queued or
+// executing on them. They are deleted as soon as the command executor
+// reports those have finished, the poll loop must not wait for that.
+typedef list<runtime*> runtimelist_type;
+static runtimelist_type  runtimes_to_delete;
+
 // Per connection (file descriptor) keep track of the echo setting and which
 // runtime it referred to
+// The commands of the last line received that are yet to be executed and
+// the reply so far are kept here too; while 'waiting' a command is being
+// executed by the command executor and the connection is not read from.
 struct per_fd_data {
-    bool    echo;
-    string  runtime;
+    bool            echo;
+    string          runtime;
+    bool            crlf;
+    bool            waiting;
+    struct timeval  received;
+    vector<string>  commands;
+    string          reply;
 
     per_fd_data(bool e):
-        echo( e )
+        echo( e ), crlf( false ), waiting( false )
     {}
 };
 
@@ -187,9 +205,31 @@ void unobserve(int fd, fdmap_type& fdm, runtimemap_type& rtm) {
         if( currtm->second.owner==fd )
             rts_to_erase.push_back( currtm );
     for(erase_type::iterator eraseptr=rts_to_erase.begin(); eraseptr!=rts_to_erase.end(); eraseptr++) {
+        runtime*  rteptr = (*eraseptr)->second.rteptr;
+
         DEBUG(4, "unobserve: delete runtime " << (*eraseptr)->first << " because fd#" << fd << " is gone" << endl);
-        delete (*eraseptr)->second.rteptr;
         rtm.erase( *eraseptr );
+        // Other connections may have commands executing on it
+        if( ::cmdexec_busy(rteptr) )
+            runtimes_to_delete.push_back( rteptr );
+        else
+            delete rteptr;
+    }
+}
+
+// Delete the runtimes from runtimes_to_delete that have no commands
+// queued or executing anymore
+void delete_idle_runtimes( void ) {
+    runtimelist_type::iterator  p = runtimes_to_delete.begin();
+
+    while( p!=runtimes_to_delete.end() ) {
+        if( ::cmdexec_busy(*p) ) {
+            p++;
+            continue;
+        }
+        DEBUG(4, "delete_idle_runtimes: deleting runtime " << (void*)*p << endl);
+        delete *p;
+        runtimes_to_delete.erase( p++ );
     }
 }
 
@@ -547,10 +587,13 @@ string process_runtime_command( bool qry,
                 return string("!runtime = 4 : cannot create runtime with no name ;");
 
             // requested runtime doesn't exist yet, create it
+            runtime*  newrte = new runtime();
+
+            newrte->name = rt_name;
             if( rt_cmd == "transient" )
-                rtm.insert( make_pair(rt_name, per_rt_data(new runtime(), fdmptr->first)) );
+                rtm.insert( make_pair(rt_name, per_rt_data(newrte, fdmptr->first)) );
             else
-                rtm.insert( make_pair(rt_name, per_rt_data(new runtime())) );
+                rtm.insert( make_pair(rt_name, per_rt_data(newrte)) );
         }
         else if ( rt_cmd == "new" || rt_cmd == "transient" ) {
             // we requested a brand new runtime, it already existed, so report an error
@@ -577,6 +620,10 @@ string process_runtime_command( bool qry,
             return string("!runtime = 6 : no active runtime '") + rt_name + "' ;";
         }
 
+        if ( ::cmdexec_busy(rt_iter->second.rteptr) ) {
+            return string("!runtime = 6 : '") + rt_name + "' is executing commands ;";
+        }
+
         if ( fdmptr->second.runtime == rt_name ) {
             // if the runtime to delete is the current one, 
             // reset it to the default
@@ -589,6 +636,135 @@ string process_runtime_command( bool qry,
     return string("!runtime = 0 : ") + fdmptr->second.runtime + " ;"; 
 }
 
+// Execute the connection's pending commands, appending the replies to its
+// reply. Returns false if a command was handed to the command executor; the
+// remaining commands are executed after that one has finished.
+bool process_commands( fdmap_type::iterator fdmptr,
+                       runtimemap_type& runtimes,
+                       const mk5commandmap_type& rt0_mk5cmds,
+                       const mk5commandmap_type& generic_mk5cmds ) {
+    per_fd_data&  fdd( fdmptr->second );
+    string&       reply( fdd.reply );
+
+    while( !fdd.commands.empty() ) {
+        bool                               qry;
+        string                             keyword;
+        const string                       cmd( fdd.commands.front() );
+        vector<string>                     args;
+        string::size_type                  posn;
+        mk5commandmap_type::const_iterator cmdptr;
+
+        fdd.commands.erase( fdd.commands.begin() );
+        if( cmd.empty() )
+            continue;
+        DEBUG((fdd.echo?2:10000), "Processing command '" << cmd << "'" << endl);
+
+        // find out if it was a query or not
+        if( (posn=cmd.find_first_of("?="))==string::npos ) {
+            reply += ("!syntax = 7 : Not a command or query;");
+            continue;
+        }
+        qry     = (cmd[posn]=='?');
+        keyword = ::tolower( cmd.substr(0, posn) );
+        if( keyword.empty() ) {
+            reply += "!syntax = 7 : No keyword given ;";
+            continue;
+        }
+
+        // now get the arguments, if any
+        // (split everything after '?' or '=' at ':'s and each
+        // element is an argument)
+        args = ::split(cmd.substr(posn+1), ':');
+        // stick the keyword in at the first position
+        args.insert(args.begin(), keyword);
+
+        // see if we know about this specific command
+        try {
+            if( keyword == "runtime" ) {
+                // select a runtime to pass to the functions
+                reply += process_runtime_command( qry, args, fdmptr, runtimes);
+            } else if( keyword=="echo" ) {
+                // turn command echoing on or off
+                if( qry ) {
+                    ostringstream tmp;
+                    tmp << "!echo? 0 : " << (fdd.echo?"on":"off") << " ;";
+                    reply += tmp.str();
+                } else if( args.size()!=2 || !(args[1]=="on" || args[1]=="off") ) {
+                    reply += string("!echo= 8 : expects exactly one parameter 'on' or 'off';") ;
+                } else {
+                    // already verified we have 'on' or 'off'
+                    fdd.echo = (args[1]=="on");
+                    reply += string("!echo= 0 ;");
+                }
+            } else {
+                const mk5commandmap_type& mk5cmds = ( fdd.runtime==default_runtime ? rt0_mk5cmds : generic_mk5cmds );
+                if( (cmdptr=mk5cmds.find(keyword))==mk5cmds.end() ) {
+                    reply += (string("!")+keyword+((qry)?('?'):('='))+" 7 : ENOSYS - not implemented ;");
+                    continue;
+                }
+                
+                // Check if the runtime we are observing is
+                // still the one when we started observing
+                runtimemap_type::iterator   rt_iter = current_runtime(fdmptr, runtimes);
+
+                if ( rt_iter == runtimes.end() ) {
+                    reply += string("!")+keyword+" " + QRY(qry) + " 4 : current runtime ('" + fdd.runtime + "') has been deleted;";
+                }
+                else {
+                    runtime*            rteptr = rt_iter->second.rteptr;
+                    const cmdexec_class cc     = ::cmdexec_classify(keyword, qry, *rteptr);
+                    const bool          busy   = ::cmdexec_busy(rteptr);
+
+                    // Slow commands go to the background and, to keep
+                    // them in order, so does anything else for a runtime
+                    // that has commands queued
+                    if( cc==cmdexec_background || (busy && cc==cmdexec_inline) ) {
+                        ::cmdexec_submit( cmdexec_job(fdmptr->first, qry, args, cmdptr->second, rteptr, fdd.received) );
+                        fdd.waiting = true;
+                        return false;
+                    }
+                    // Status queries for a busy runtime leave the
+                    // protect=off bookkeeping to the queued commands
+                    reply += ::cmdexec_execute(cmdptr->second, qry, args, *rteptr, !busy);
+                    ::cmdexec_record(fdd.received, false);
+                }
+            }
+        }
+        catch( const exception& e ) {
+            reply += string("!")+keyword+" " + QRY(qry) + " 4 : " + e.what() + ";";
+        }
+        catch( ... ) {
+            reply += string("!")+keyword+" " + QRY(qry) + " 4 : unknown exception ;";
+        }
+    }
+    return true;
+}
+
+// Send the reply to the commands of the last line received, if any.
+// Returns false if the connection broke.
+bool send_reply( fdmap_type::iterator fdmptr ) {
+    per_fd_data&  fdd( fdmptr->second );
+
+    if( fdd.reply.empty() ) {
+        DEBUG(4, "No command(s) found, no reply sent" << endl);
+        return true;
+    }
+    // processed all commands in the string. send the reply
+    DEBUG((fdd.echo?2:10000), "Reply: " << fdd.reply << endl);
+    // do *not* forget the \r\n ...!
+    // HV: 18-nov-2011 see main() near 'const bool crlf =...';
+    if( fdd.crlf )
+        fdd.reply += "\r\n";
+    else
+        fdd.reply += "\n";
+
+    const ssize_t  nwrite = ::write(fdmptr->first, fdd.reply.c_str(), fdd.reply.size());
+
+    fdd.reply.clear();
+    // if <=0, socket was closed
+    return nwrite>0;
+}
+
 typedef enum { no_sfxc = 0, lissen_tcp, lissen_unix } sfxc_lissen_type;
 
 // main!
@@ -839,6 +1015,13 @@ int main(int argc, char** argv) {
         ASSERT_ZERO( sigfillset(&newset) );
         PTHREAD_CALL( ::pthread_sigmask(SIG_SETMASK, &newset, 0) );
 
+        // From now on DEBUG() messages are written to stderr by a separate
+        // thread such that the data path never waits for the terminal or
+        // the logfile. Started after blocking the signals, so it inherits
+        // that. "debuglog=" changes this.
+        if( !debuglog_start(debuglog_stderr) )
+            cerr << "Failed to start the logger thread, DEBUG() output is synchronous" << endl;
+
         // Good. Now we've done that, let's get down to business!
         int                rotsok = -1;
         int                listensok;
@@ -880,6 +1063,8 @@ int main(int argc, char** argv) {
         EZASSERT2(runtimes.insert( make_pair(default_runtime, per_rt_data(new runtime(xlrdev, ioboard))) ).second,
                   bookkeeping, EZINFO("Failed to put default runtime into runtime-map?!!!"));
         runtime&  rt0( *(runtimes.find(default_runtime)->second.rteptr) );
+
+        rt0.name = default_runtime;
         
         if( !ioboard.hardware().empty() ) {
             // make sure the user can write to DirList file (/var/dir/Mark5A)
@@ -1143,6 +1328,8 @@ int main(int argc, char** argv) {
             //      mainly used at correlator(s). Maps 'task_id'
             //      to rot-to-systemtime mapping
             //    * 'sfxc' => listens for incoming SFXC DataReader connections
+            //    * 'cmdexec' => the command executor writes on this
+            //      fd when commands executing in the background are done
             //    * 'commandfds' => accepted commandclients send
             //      commands over these fd's and we reply to them
             //      over the same fd. 
@@ -1157,14 +1344,15 @@ int main(int argc, char** argv) {
             const unsigned int           signalidx    = 1;
             const unsigned int           rotidx       = 2;
             const unsigned int           sfxcidx      = 3;
-            const unsigned int           cmdsockoffs  = 4;
+            const unsigned int           execidx      = 4;
+            const unsigned int           cmdsockoffs  = 5;
             // we need to fix those values here because the
             // acceptedfds/acceptedsfxcfds may change size below - e.g. if
             // clients made a connection. But those (new) fd's won't be in
             // the current list of fd's
             const unsigned int           n_jive5ab    = acceptedfds.size();
             const unsigned int           n_sfxc       = acceptedsfxcfds.size(); 
-            const unsigned int           nrfds        = 4 + n_jive5ab/*acceptedfds.size()*/ + n_sfxc/*acceptedsfxcfds.size()*/;
+            const unsigned int           nrfds        = cmdsockoffs + n_jive5ab/*acceptedfds.size()*/ + n_sfxc/*acceptedsfxcfds.size()*/;
             const unsigned int           nrlistenfd   = 2;
             const unsigned int           listenfds[2] = {listenidx, sfxcidx};
             char const * const           names[2]     = {"jive5ab", "sfxc"};
@@ -1194,10 +1382,20 @@ int main(int argc, char** argv) {
             fds[sfxcidx].fd        = sfxcsok;
             fds[sfxcidx].events    = POLLIN|POLLPRI|POLLERR|POLLHUP;
 
-            // Loop over the accepted connections
+            // Position 'execidx' is where the command executor tells us
+            // background commands have finished
+            fds[execidx].fd        = ::cmdexec_notifyfd();
+            fds[execidx].events    = POLLIN|POLLPRI|POLLERR|POLLHUP;
+
+            // Loop over the accepted connections. Those waiting for a
+            // command to finish in the background are not polled
+            // [negative fd's are ignored by poll(2)] - they are not read
+            // from and cannot be closed until the reply's been sent
             for(idx=cmdsockoffs, curfd=acceptedfds.begin();
                 curfd!=acceptedfds.end(); idx++, curfd++ ) {
-                fds[idx].fd     = curfd->first;
+                fdmap_type::const_iterator  fdmptr = fdmap.find( curfd->first );
+
+                fds[idx].fd     = (fdmptr!=fdmap.end() && fdmptr->second.waiting) ? -1 : curfd->first;
                 fds[idx].events = POLLIN|POLLPRI|POLLERR|POLLHUP;
             }
             // And append the accepted SFXC client connections
@@ -1321,6 +1519,38 @@ int main(int argc, char** argv) {
                 // Done dealing with the listening sockets
             }
 
+            // Commands that finished in the background: add their reply
+            // and go on with the rest of the commands of that line
+            if( (events=fds[execidx].revents)!=0 ) {
+                list<cmdexec_job>   finished( ::cmdexec_finished() );
+
+                for(list<cmdexec_job>::const_iterator job=finished.begin(); job!=finished.end(); job++) {
+                    fdmap_type::iterator    fdmptr = fdmap.find( job->fd );
+                    fdprops_type::iterator  fdptr  = acceptedfds.find( job->fd );
+
+                    ::cmdexec_record(job->received, true);
+                    if( fdmptr==fdmap.end() || fdptr==acceptedfds.end() ) {
+                        cerr << "main: internal error. command finished for fd#" << job->fd << " which is not in fdmap/acceptedfds" << endl;
+                        continue;
+                    }
+                    fdmptr->second.waiting  = false;
+                    fdmptr->second.reply   += job->reply;
+
+                    if( !::process_commands(fdmptr, runtimes, rt0_mk5cmds, generic_mk5cmds) )
+                        continue;
+                    if( !::send_reply(fdmptr) ) {
+                        lastsyserror_type lse;
+                        DEBUG(0, "Error on fd#" << fdptr->first << " ["
+                              << fdptr->second << "] - " << lse << endl);
+                        ::close( fdptr->first );
+                        ::unobserve(fdptr->first, fdmap, runtimes);
+                        acceptedfds.erase( fdptr );
+                    }
+                }
+                // Runtimes may have been waiting for these
+                ::delete_idle_runtimes();
+            }
+
             // On all other sockets, loox0r for commands!
             // NOTE: here we must not use 'acceptedfds.size()' because we
             //       may have accepted a new client; the 'fds[...]' array
@@ -1383,7 +1613,7 @@ int main(int argc, char** argv) {
                 // if stuff may be read, see what we can make of it
                 if( events&POLLIN ) {
                     char                           linebuf[4096];
-                    ssize_t                        nread, nwrite;
+                    ssize_t                        nread;
 
                     // attempt to read a line
                     nread = ::read(fd, linebuf, sizeof(linebuf));
@@ -1410,8 +1640,19 @@ int main(int argc, char** argv) {
                         try {
                             EZASSERT2(nread==sizeof(mk5read_msg), mk5read_exception, 
                                       EZINFO("Binary command size mismatch: expect " << sizeof(mk5read_msg) << ", got " << nread));
-                            // mk5read clients always execcute in runtime 0
-                            attempt_stream_to_sfxc(fdptr->first, (mk5read_msg*)linebuf, rt0);
+                            // mk5read clients always execcute in runtime 0. Without
+                            // a StreamStor they're served from FlexBuff/Mark6
+                            // recordings, in parallel, outside of any runtime
+                            if( rt0.xlrdev )
+                                attempt_stream_to_sfxc(fdptr->first, (mk5read_msg*)linebuf, rt0);
+                            else {
+                                // set_disks= may be executing in the
+                                // background, copy under the lock
+                                mountpointlist_type  mps;
+
+                                RTEEXEC(rt0, mps = rt0.mk6info.mountpoints);
+                                sfxc_serve(fdptr->first, *(mk5read_msg*)linebuf, mps);
+                            }
                         }
                         catch( std::exception const& e ) {
                             DEBUG(-1, "main/incoming mk5read_msg: " << e.what() << endl);
@@ -1439,9 +1680,7 @@ int main(int argc, char** argv) {
                     // And we need sanitizing variables ...
                     char*                          sptr;
                     char*                          eptr;
-                    string                         reply;
                     vector<string>                 commands;
-                    vector<string>::const_iterator curcmd;
 
                     // HV: 18-nov-2012
                     //     telnet sends \r\n, tstdimino sends a separate \n
@@ -1479,123 +1718,21 @@ int main(int argc, char** argv) {
                     // Even if we did receive only whitespace, we still need to
                     // send back *something*. A single ';' for an empty command should
                     // be just fine
-                    for( curcmd=commands.begin(); curcmd!=commands.end(); curcmd++ ) {
-                        bool                               qry;
-                        string                             keyword;
-                        const string&                      cmd( *curcmd );
-                        vector<string>                     args;
-                        string::size_type                  posn;
-                        mk5commandmap_type::const_iterator cmdptr;
-
-                        if( cmd.empty() )
-                            continue;
-                        DEBUG((fdmptr->second.echo?2:10000), "Processing command '" << cmd << "'" << endl);
-
-                        // find out if it was a query or not
-                        if( (posn=cmd.find_first_of("?="))==string::npos ) {
-                            reply += ("!syntax = 7 : Not a command or query;");
-                            continue;
-                        }
-                        qry     = (cmd[posn]=='?');
-                        keyword = ::tolower( cmd.substr(0, posn) );
-                        if( keyword.empty() ) {
-                            reply += "!syntax = 7 : No keyword given ;";
-                            continue;
-                        }
-
-                        // now get the arguments, if any
-                        // (split everything after '?' or '=' at ':'s and each
-                        // element is an argument)
-                        args = ::split(cmd.substr(posn+1), ':');
-                        // stick the keyword in at the first position
-                        args.insert(args.begin(), keyword);
-
-                        // see if we know about this specific command
-                        try {
-                            if( keyword == "runtime" ) {
-                                // select a runtime to pass to the functions
-                                reply += process_runtime_command( qry, args, fdmptr, runtimes);
-                            } else if( keyword=="echo" ) {
-                                // turn command echoing on or off
-                                if( qry ) {
-                                    ostringstream tmp;
-                                    tmp << "!echo? 0 : " << (fdmptr->second.echo?"on":"off") << " ;";
-                                    reply += tmp.str();
-                                } else if( args.size()!=2 || !(args[1]=="on" || args[1]=="off") ) {
-                                    reply += string("!echo= 8 : expects exactly one parameter 'on' or 'off';") ;
-                                } else {
-                                    // already verified we have 'on' or 'off'
-                                    fdmptr->second.echo = (args[1]=="on");
-                                    reply += string("!echo= 0 ;");
-                                }
-                            } else {
-                                mk5commandmap_type& mk5cmds = ( fdmptr->second.runtime==default_runtime ? rt0_mk5cmds : generic_mk5cmds );
-                                if( (cmdptr=mk5cmds.find(keyword))==mk5cmds.end() ) {
-                                    reply += (string("!")+keyword+((qry)?('?'):('='))+" 7 : ENOSYS - not implemented ;");
-                                    continue;
-                                }
-                                
-                                // Check if the runtime we are observing is
-                                // still the one when we started observing
-                                runtimemap_type::iterator   rt_iter = current_runtime(fdmptr, runtimes);
-
-                                if ( rt_iter == runtimes.end() ) {
-                                    reply += string("!")+keyword+" " + QRY(qry) + " 4 : current runtime ('" + fdmptr->second.runtime + "') has been deleted;";
-                                }
-                                else {
-                                    runtime* rteptr = rt_iter->second.rteptr;
-
-                                    try {
-                                        reply += cmdptr->second(qry, args, *rteptr);
-                                    } 
-                                    catch (...) {
-                                        // do the protect=off bookkeeping
-                                        rteptr->protected_count = max(rteptr->protected_count, 1u) - 1;
-                                        throw;
-                                    }
-                                    // do the protect=off bookkeeping
-                                    rteptr->protected_count = max(rteptr->protected_count, 1u) - 1;
-                                }
-                            }
-                        }
-                        catch( const Error_Code_6_Exception& e) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
-                        }
-                        catch( const Error_Code_8_Exception& e) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 8 : " + e.what() + ";";
-                        }
-                        catch( const cmdexception& e ) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
-                        }
-                        catch( const exception& e ) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 4 : " + e.what() + ";";
-                        }
-                        catch( ... ) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 4 : unknown exception ;";
-                        }
-                    }
+                    per_fd_data&  fdd( fdmptr->second );
 
-                    if( reply.empty() ) {
-                        DEBUG(4, "No command(s) found, no reply sent" << endl);
-                        break;
-                    }
-                    // processed all commands in the string. send the reply
-                    DEBUG((fdmptr->second.echo?2:10000), "Reply: " << reply << endl);
-                    // do *not* forget the \r\n ...!
-                    // HV: 18-nov-2011 see above near 'const bool crlf =...';
-                    if( crlf )
-                        reply += "\r\n";
-                    else
-                        reply += "\n";
+                    fdd.crlf     = crlf;
+                    fdd.commands = commands;
+                    fdd.reply.clear();
+                    ::gettimeofday(&fdd.received, 0);
 
-                    nwrite = ::write(fd, reply.c_str(), reply.size());
-                    // if <=0, socket was closed, remove it from the list
-                    if( nwrite<=0 ) {
-                        if( nwrite<0 ) {
-                            lastsyserror_type lse;
-                            DEBUG(0, "Error on fd#" << fdptr->first << " ["
-                                  << fdptr->second << "] - " << lse << endl);
-                        }
+                    // If a command went to the command executor, the reply
+                    // is sent when that has finished
+                    if( !::process_commands(fdmptr, runtimes, rt0_mk5cmds, generic_mk5cmds) )
+                        continue;
+                    if( !::send_reply(fdmptr) ) {
+                        lastsyserror_type lse;
+                        DEBUG(0, "Error on fd#" << fdptr->first << " ["
+                              << fdptr->second << "] - " << lse << endl);
                         ::close( fdptr->first );
                         ::unobserve(fdptr->first, fdmap, runtimes);
                         fdprops.erase( fdptr );
@@ -1620,6 +1757,17 @@ int main(int argc, char** argv) {
         cout << "main: caught unknown exception?!" << endl;
     }
 
+    // Commands may still be executing in the background on the runtimes
+    // we're about to delete
+    ::cmdexec_shutdown();
+
+    // Same for the SFXC DataReaders being served; their workers use
+    // libvbs' statics, which are destroyed after main() returns
+    ::sfxc_server_off();
+
+    // And the copy engine's senders
+    ::copyengine_shutdown();
+
     // The dot-clock can be stopped now. This can be done unconditionally;
     // the routine knows wether or not the dotclock was running
     dotclock_cleanup();
@@ -1656,6 +1804,11 @@ int main(int argc, char** argv) {
           rt_iter++ ) {
         delete rt_iter->second.rteptr;
     }
+    for ( runtimelist_type::iterator rt_iter = runtimes_to_delete.begin();
+          rt_iter != runtimes_to_delete.end();
+          rt_iter++ ) {
+        delete *rt_iter;
+    }
 
     // Unlink the unix domain socket - if necessary 
     if( sfxc_lissen==lissen_unix )
@@ -42,6 +42,8 @@
 #include <timezooi.h>
 #include <threadutil.h> // for install_zig_for_this_thread()
 #include <libvbs.h>
+#include <ioscheduler.h>
+#include <tracering.h>
 #include <carrayutil.h>
 #include <auto_array.h>
 #include <countedpointer.h>
@@ -350,7 +352,9 @@ void framepatterngenerator(outq_type<block>* outq, sync_type<fillpatargs>* args)
         args->cond_wait();
     // whilst we have the lock, do copy important values across
     stop = args->cancelled;
-    const uint64_t nword = args->userdata->nword;
+    const uint64_t     nword = args->userdata->nword;
+    const unsigned int nthread = (is_vdif(header.frameformat) ? std::max(args->userdata->nthread, 1u) : 1);
+    unsigned int       thread = 0;
     args->unlock();
 
     counter_type&   counter( rteptr->statistics.counter(args->stepid) );
@@ -364,7 +368,7 @@ void framepatterngenerator(outq_type<block>* outq, sync_type<fillpatargs>* args)
     DEBUG(0, "framepatterngenerator: generating " << nword << " words" << endl << 
              "                      " << header << " frames" << endl <<
              "                       frameduration " << sciprintd(boost::rational_cast<double>(frameduration), "s") << 
-                                    " realtime " << fpargs->realtime << endl <<
+                                    " realtime " << fpargs->realtime << " threads " << nthread << endl <<
              "                       blocksize " << bs << " (" << hex_t(bs) << ")" << endl);
     ts         = highrestime_type( ::time(0) );
     frameptr   = frame;
@@ -406,18 +410,23 @@ void framepatterngenerator(outq_type<block>* outq, sync_type<fillpatargs>* args)
                     // assume 1bits/sample
                     vdifh->log2nchans      = (unsigned int)::round( ::log2(header.ntrack) );
                     vdifh->bits_per_sample = 0;
+                    vdifh->thread_id       = thread & 0x3ff;
                 }
 
-                // Update frame variables
+                // Update frame variables. Time only advances once
+                // all threads have had their frame
                 fpargs->fill += fpargs->inc;
-                ts           += frameduration;
-
-                // If realtime, try wait for the frame time to appear
-                if( fpargs->realtime ) {
-                    // convert highrestime_type to struct timespec
-                    rt_wait.tv_sec  = ts.tv_sec;
-                    rt_wait.tv_nsec = boost::rational_cast<long>( ts.tv_subsecond * 1000000000 );
-                    ::clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &rt_wait, NULL);
+                if( ++thread==nthread ) {
+                    thread  = 0;
+                    ts     += frameduration;
+
+                    // If realtime, try wait for the frame time to appear
+                    if( fpargs->realtime ) {
+                        // convert highrestime_type to struct timespec
+                        rt_wait.tv_sec  = ts.tv_sec;
+                        rt_wait.tv_nsec = boost::rational_cast<long>( ts.tv_subsecond * 1000000000 );
+                        ::clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &rt_wait, NULL);
+                    }
                 }
                 framecount++;
             }
@@ -1129,7 +1138,7 @@ void udpsreaderv4(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
 
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
             rteptr->statistics.init(args->stepid, "UdpsReadv4"),
             delete [] dummybuf; delete [] workbuf; delete [] fpblock; SYNCEXEC(args, delete network->threadid; network->threadid=0));
 
@@ -1159,23 +1168,25 @@ void udpsreaderv4(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     // removed then (if you do it via pointer
     // then there's two)
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&   loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type&   pktcnt( rteptr->evlbi_stats.pkt_in );
-    ucounter_type&   ooocnt( rteptr->evlbi_stats.pkt_ooo );
-    ucounter_type&   disccnt( rteptr->evlbi_stats.pkt_disc );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&   loscnt( evlbi.pkt_lost );
+    ucounter_type&   pktcnt( evlbi.pkt_in );
+    ucounter_type&   ooocnt( evlbi.pkt_ooo );
+    ucounter_type&   disccnt( evlbi.pkt_disc );
 #if 0
-    ucounter_type&   discont( rteptr->evlbi_stats.discont );
-    ucounter_type&   discont_sz( rteptr->evlbi_stats.discont_sz );
-    ucounter_type&   gapsum( rteptr->evlbi_stats.gap_sum );
+    ucounter_type&   discont( evlbi.discont );
+    ucounter_type&   discont_sz( evlbi.discont_sz );
+    ucounter_type&   gapsum( evlbi.gap_sum );
 #endif
 #if 1
-    ucounter_type&   ooosum( rteptr->evlbi_stats.ooosum );
+    ucounter_type&   ooosum( evlbi.ooosum );
 #endif
     // inner loop variables
     bool         discard;
     void*        location;
     uint64_t     blockidx;
     uint64_t     maxseq, minseq;
+    uint64_t     lost = 0, nowlost;
 #if 0
     uint64_t     lastdiscontinuity = 0;
 #endif
@@ -1285,7 +1296,10 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
             maxseq = seqnr;
         else if( seqnr<minseq )
             minseq = seqnr;
-        loscnt = (maxseq - minseq + 1 - pktcnt);
+        // pkt_lost lives in a shard, which is only ever added to
+        nowlost = (maxseq - minseq + 1 - pktcnt);
+        loscnt += nowlost - lost;
+        lost    = nowlost;
 
         // Now we need to find out where to put the data for it!
         // that is, if the packet is not to be discarded
@@ -1600,7 +1614,7 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
 
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
             rteptr->statistics.init(args->stepid, "UdpsReadBH"),
             delete [] dummybuf; delete [] workbuf; delete network->threadid; network->threadid = 0);
 
@@ -1628,11 +1642,12 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
     // removed then (if you do it via pointer
     // then there's two)
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&   loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type&   pktcnt( rteptr->evlbi_stats.pkt_in );
-    ucounter_type&   ooocnt( rteptr->evlbi_stats.pkt_ooo );
-    ucounter_type&   disccnt( rteptr->evlbi_stats.pkt_disc );
-    ucounter_type&   ooosum( rteptr->evlbi_stats.ooosum );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&   loscnt( evlbi.pkt_lost );
+    ucounter_type&   pktcnt( evlbi.pkt_in );
+    ucounter_type&   ooocnt( evlbi.pkt_ooo );
+    ucounter_type&   disccnt( evlbi.pkt_disc );
+    ucounter_type&   ooosum( evlbi.ooosum );
 
     // inner loop variables
     bool           done;
@@ -1641,6 +1656,7 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
     void*          location;
     uint64_t       blockidx;
     uint64_t       maxseq, minseq;
+    uint64_t       lost = 0, nowlost;
     unsigned int   shiftcount;
     netparms_type& np( network->rteptr->netparms );
 
@@ -1784,7 +1800,10 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
             maxseq = seqnr;
         else if( seqnr<minseq )
             minseq = seqnr;
-        loscnt = (maxseq - minseq + 1 - pktcnt);
+        // pkt_lost lives in a shard, which is only ever added to
+        nowlost = (maxseq - minseq + 1 - pktcnt);
+        loscnt += nowlost - lost;
+        lost    = nowlost;
 
         // Now we need to find out where to put the data for it!
         // that is, if the packet is not to be discarded
@@ -2120,6 +2139,39 @@ struct find_by_sender_type {
 
 };
 
+// recvmmsg(2) is Linux only. Elsewhere we fall back to receiving one
+// datagram per call, which is what the readers used to do anyway.
+#if defined(__linux__)
+typedef struct mmsghdr  dgram_batch_type;
+#else
+struct dgram_batch_type {
+    struct msghdr  msg_hdr;
+    unsigned int   msg_len;
+};
+#endif
+
+// Receive at least one and at most n datagrams. Returns the number of
+// datagrams received, -1 on error (errno is set)
+static int recv_dgram_batch(int fd, dgram_batch_type* msgs, unsigned int n) {
+#if defined(__linux__)
+    const tracetime_type  t0 = trace_now();
+    const int             r = ::recvmmsg(fd, msgs, n, MSG_WAITFORONE, 0);
+
+    trace_complete("recvmmsg", t0, (r>0 ? (uint64_t)r : 0));
+    return r;
+#else
+    ssize_t  r;
+
+    if( n==0 || (r=::recvmsg(fd, &msgs[0].msg_hdr, MSG_WAITALL))<0 )
+        return -1;
+    msgs[0].msg_len = (unsigned int)r;
+    return 1;
+#endif
+}
+
+// Receive this many datagrams in one go, at most
+static const unsigned int maxDgBatch = 32;
+
 void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     uint64_t                  seqnr;
     runtime*                  rteptr = 0;
@@ -2153,6 +2205,10 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     const unsigned int           wr_size   = rteptr->sizes[constraints::read_size];
     const unsigned int           blocksize = rteptr->sizes[constraints::blocksize];
     const unsigned int           n_dg_p_block = blocksize/wr_size;
+    // Room to leave at the start of each block for a header that a
+    // downstream step wants to put in front of the data (e.g. the Mark6
+    // write block header)
+    const unsigned int           headroom  = network->headroom;
     const unsigned int           n_zeroes  = (wr_size - rd_size);
     const unsigned char*         zeroes_p  = (n_zeroes ? new unsigned char[n_zeroes] : 0);
     
@@ -2174,37 +2230,45 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
              delete network->threadid;
              delete network->pool;
              network->threadid = new pthread_t( ::pthread_self() );
-             network->pool = new blockpool_type(blocksize, nb));
+             network->pool = new blockpool_type(blocksize + headroom, nb));
 
     if( zeroes_p )
         ::memset(const_cast<unsigned char*>(zeroes_p), 0x0, n_zeroes);
 
-    // Set up the message - a lot of these fields have known & constant values
-    struct iovec    iov[2];
-    struct msghdr   msg;
-
-    // We'd like to know who's sending to us
-    msg.msg_name       = (void*)&sender;
-    msg.msg_namelen    = sizeof(sender);
-
-    // no control stuff, nor flags
-    msg.msg_control    = 0;
-    msg.msg_controllen = 0;
-    msg.msg_flags      = 0;
-
-    // The size of the parts of the message are known
-    // and for the sequencenumber, we already know the destination address
-    iov[0].iov_base    = &seqnr;
-    iov[0].iov_len     = sizeof(seqnr);
-    iov[1].iov_len     = rd_size;
-
-    // message 'msg': two fragments. Sequence number and datapart
-    msg.msg_iovlen     = 2;
-    msg.msg_iov        = &iov[0];
+    // Set up the messages - a lot of these fields have known & constant values
+    // We receive up to maxDgBatch datagrams per system call, each straight
+    // into their final location in the block
+    uint64_t           seqnrs[maxDgBatch];
+    struct sockaddr_in senders[maxDgBatch];
+    struct iovec       iov[maxDgBatch][2];
+    dgram_batch_type   msgs[maxDgBatch];
+
+    for( unsigned int i=0; i<maxDgBatch; i++ ) {
+        struct msghdr&  msg( msgs[i].msg_hdr );
+
+        // We'd like to know who's sending to us
+        msg.msg_name       = (void*)&senders[i];
+        msg.msg_namelen    = sizeof(senders[i]);
+
+        // no control stuff, nor flags
+        msg.msg_control    = 0;
+        msg.msg_controllen = 0;
+        msg.msg_flags      = 0;
+
+        // The size of the parts of the message are known
+        // and for the sequencenumber, we already know the destination address
+        iov[i][0].iov_base = &seqnrs[i];
+        iov[i][0].iov_len  = sizeof(seqnrs[i]);
+        iov[i][1].iov_len  = rd_size;
+
+        // message 'msg': two fragments. Sequence number and datapart
+        msg.msg_iovlen     = 2;
+        msg.msg_iov        = &iov[i][0];
+    }
 
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
             rteptr->statistics.init(args->stepid, "UdpsNorRead"),
             delete [] zeroes_p; delete network->threadid; network->threadid = 0;);
 
@@ -2221,10 +2285,11 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     }
 
     // No, we weren't. Now go into our mainloop!
-    DEBUG(0, "udpsnorreader: fd=" << network->fd << " data:" << iov[1].iov_len
-            << " total:" << (iov[0].iov_len + iov[1].iov_len)
+    DEBUG(0, "udpsnorreader: fd=" << network->fd << " data:" << iov[0][1].iov_len
+            << " total:" << (iov[0][0].iov_len + iov[0][1].iov_len)
             << " pkts:" << n_dg_p_block 
             << " avbs: " << network->allow_variable_block_size
+            << " headroom: " << headroom
             << endl);
 
     // create references to the statisticscounters -
@@ -2232,29 +2297,49 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     // removed then (if you do it via pointer
     // then there's two)
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&   loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type&   pktcnt( rteptr->evlbi_stats.pkt_in );
-//    ucounter_type&   ooocnt( rteptr->evlbi_stats.pkt_ooo );
-//    ucounter_type&   ooosum( rteptr->evlbi_stats.ooosum );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&   loscnt( evlbi.pkt_lost );
+    ucounter_type&   pktcnt( evlbi.pkt_in );
+//    ucounter_type&   ooocnt( evlbi.pkt_ooo );
+//    ucounter_type&   ooosum( evlbi.ooosum );
 //    ucounter_type    tmppkt, tmpooocnt, tmpooosum, tmplos;
     ucounter_type    tmplos;
+    uint64_t         lost = 0;
 
     // inner loop variables
     block          b = network->pool->get();
-    ssize_t        n;
-    const ssize_t  waitallread = (ssize_t)(iov[0].iov_len + iov[1].iov_len);
+    ssize_t        n = 0;
+    const ssize_t  waitallread = (ssize_t)(iov[0][0].iov_len + iov[0][1].iov_len);
     netparms_type& np( network->rteptr->netparms );
+    unsigned char* payload;
+    unsigned int   nrecv = 0, curdg = 0;
 
     // Initialize the important counters & pointers for first use
-    location    = (unsigned char*)b.iov_base;
-    block_end   = location + b.iov_len - wr_size; // If location points beyond this we cannot write a packet any more
+    payload     = (unsigned char*)b.iov_base + headroom;
+    location    = payload;
+    block_end   = (unsigned char*)b.iov_base + b.iov_len - wr_size; // If location points beyond this we cannot write a packet any more
 
     // Drop into our tight inner loop
     while( true ) {
+        // Need to (re)fill the batch? Never ask for more datagrams than
+        // will fit in the current block
+        if( curdg==nrecv ) {
+            const unsigned int nfree = (unsigned int)((block_end - location)/wr_size) + 1;
+            const unsigned int nask  = std::min(nfree, maxDgBatch);
+
+            for( unsigned int i=0; i<nask; i++ ) {
+                iov[i][1].iov_base         = location + i*wr_size;
+                msgs[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+            }
+            n     = recv_dgram_batch(network->fd, msgs, nask);
+            nrecv = (unsigned int)std::max(n, (ssize_t)0);
+            curdg = 0;
+        }
         // Wait here for packet
-        iov[1].iov_base = location;
+        if( curdg<nrecv )
+            n = (ssize_t)msgs[curdg].msg_len;
 
-        if( (n=::recvmsg(network->fd, &msg, MSG_WAITALL))!=waitallread ) {
+        if( curdg==nrecv || n!=waitallread ) {
             lastsyserror_type  lse;
             ostringstream      oss;
 
@@ -2264,9 +2349,9 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
             // the block: it failed to read so the block is not filled :D]
 
             // Fix 1. Check if we need to & are allowed to send a partial block downstream
-            const unsigned int sz = (unsigned int)(location - (unsigned char*)b.iov_base);
+            const unsigned int sz = (unsigned int)(location - payload);
             if( network->allow_variable_block_size && sz )
-                outq->push(b.sub(0, sz));
+                outq->push(b.sub(headroom, sz));
 
             // 1a.) Remove ourselves from the environment - our thread is going
             // to be dead!
@@ -2292,11 +2377,14 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
             // 2.) delete local buffers. In c++11 using unique_ptr this
             // wouldnae be necessary
             delete [] zeroes_p;
-            oss << "::recvmsg(network->fd, &msg, MSG_WAITALL) fails - [" << lse << "] (ask:" << waitallread << " got:" << n << ")";
+            oss << "recv_dgram_batch(network->fd, ...) fails - [" << lse << "] (ask:" << waitallread << " got:" << n << ")";
             throw syscallexception(oss.str());
         }
 
         // OK. Packet reading succeeded
+        seqnr   = seqnrs[curdg];
+        sender  = senders[curdg];
+        curdg++;
         counter += waitallread;
         pktcnt++;
 
@@ -2308,17 +2396,18 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
         // Note: we read rd_size and advance by wr_size!
         location += wr_size;
         if( location>block_end ) {
-            if( outq->push(b)==false )
+            if( outq->push(headroom ? b.sub(headroom, blocksize) : b)==false )
                 break;
             // Reset to new block
             b         = network->pool->get();
-            location  = (unsigned char*)b.iov_base;
-            block_end = location + b.iov_len - wr_size;
+            payload   = (unsigned char*)b.iov_base + headroom;
+            location  = payload;
+            block_end = (unsigned char*)b.iov_base + b.iov_len - wr_size;
         }
 
 #ifdef FILA
         // FiLa10G/Mark5B only sends 32bits of sequence number
-        seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
+        seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)&seqnr)+4)));
 #endif
         // Do sequence number + ACK processing - possibly
         curSender = std::find_if(&per_sender[0], endSender, find_by_sender);
@@ -2353,7 +2442,8 @@ void udpsnorreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
 //        pktcnt = tmppkt;
 //        ooocnt = tmpooocnt;
 //        ooosum = tmpooosum;
-        loscnt = tmplos;
+        loscnt += tmplos - lost;
+        lost    = tmplos;
     } 
     // We stopped blocking reads on the fd, so no more signals needed
     SYNCEXEC(args, delete network->threadid; network->threadid = 0);
@@ -2486,7 +2576,7 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
 
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
             rteptr->statistics.init(args->stepid, "UdpsNorReadStream"),
             delete [] zeroes_p; delete network->threadid; network->threadid = 0;);
 
@@ -2514,12 +2604,14 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
     // removed then (if you do it via pointer
     // then there's two)
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&   loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type&   pktcnt( rteptr->evlbi_stats.pkt_in );
-//    ucounter_type&   ooocnt( rteptr->evlbi_stats.pkt_ooo );
-//    ucounter_type&   ooosum( rteptr->evlbi_stats.ooosum );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&   loscnt( evlbi.pkt_lost );
+    ucounter_type&   pktcnt( evlbi.pkt_in );
+//    ucounter_type&   ooocnt( evlbi.pkt_ooo );
+//    ucounter_type&   ooosum( evlbi.ooosum );
 //    ucounter_type    tmppkt, tmpooocnt, tmpooosum, tmplos;
     ucounter_type    tmplos;
+    uint64_t         lost = 0;
 
     // inner loop variables
     const ssize_t         waitpeek    = (ssize_t)(iov_p[0].iov_len + iov_p[1].iov_len);
@@ -2619,7 +2711,8 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
 //        pktcnt = tmppkt;
 //        ooocnt = tmpooocnt;
 //        ooosum = tmpooosum;
-        loscnt = tmplos;
+        loscnt += tmplos - lost;
+        lost    = tmplos;
     } 
 
     // Fall out of loop because of error if n != waitallread or waitpeek,
@@ -2783,7 +2876,7 @@ void udpreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderargs>*
 
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
             rteptr->statistics.init(args->stepid, "UdpReadStream"),
             delete [] zeroes_p; delete network->threadid; network->threadid = 0;);
 
@@ -2810,7 +2903,8 @@ void udpreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderargs>*
     // removed then (if you do it via pointer
     // then there's two)
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&   pktcnt( rteptr->evlbi_stats.pkt_in );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&   pktcnt( evlbi.pkt_in );
 
     // inner loop variables
     const ssize_t         waitpeek    = (ssize_t)(iov_p[0].iov_len);
@@ -3300,7 +3394,7 @@ void udpreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
 
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
             rteptr->statistics.init(args->stepid, "UdpRead") ,
             delete [] zeroes; delete network->threadid; network->threadid = 0 );
 
@@ -3323,7 +3417,8 @@ void udpreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     // removed then (if you do it via pointer
     // then there's two)
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&   pktcnt( rteptr->evlbi_stats.pkt_in );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&   pktcnt( evlbi.pkt_in );
 
     // inner loop variables
     unsigned char* location;
@@ -3715,6 +3810,25 @@ void fdreader_c(outq_type<block>* outq, sync_type<cfdreaderargs>* args) {
     file->finished = true;
 }
 
+// Playback reads from FlexBuff/Mark6 recordings share the disks with
+// other runtimes' I/O through the I/O scheduler
+static ssize_t scheduled_vbs_read(int fd, void* buf, size_t n, const string& owner) {
+    char     mp[ PATH_MAX ];
+
+    if( ::vbs_mountpoint(fd, mp, sizeof(mp))!=0 )
+        mp[0] = '\0';
+
+    ioslot                slot(mp, ioclass_playback, owner);
+    const tracetime_type  t0 = trace_now();
+    const ssize_t         r = ::vbs_read(fd, buf, n);
+
+    trace_complete("vbs_read", t0, (r>0 ? (uint64_t)r : 0));
+
+    if( r>0 )
+        slot.done( (uint64_t)r );
+    return r;
+}
+
 // read from Buf recording (vbs)
 void vbsreader_c(outq_type<block>* outq, sync_type<cfdreaderargs>* args) {
     bool                   stop;
@@ -3759,7 +3873,7 @@ void vbsreader_c(outq_type<block>* outq, sync_type<cfdreaderargs>* args) {
         size_t  n2read = ( (file->end>0) ? (size_t)std::min((off_t)b.iov_len, (file->end - fp)) : b.iov_len );
 
         // do read data orf the network
-        if( (r=::vbs_read(file->fd, b.iov_base, n2read))!=(int)b.iov_len ) {
+        if( (r=scheduled_vbs_read(file->fd, b.iov_base, n2read, rteptr->name))!=(int)b.iov_len ) {
             // first check if we have less data than we expect AND
             // are allowed to push that
             bool partial_read = false;
@@ -3837,7 +3951,7 @@ void vbsreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
         size_t  n2read = ( (file->end>0) ? (size_t)std::min((off_t)b.iov_len, (file->end - fp)) : b.iov_len );
 
         // do read data orf the network
-        if( (r=::vbs_read(file->fd, b.iov_base, n2read))!=(int)b.iov_len ) {
+        if( (r=scheduled_vbs_read(file->fd, b.iov_base, n2read, rteptr->name))!=(int)b.iov_len ) {
             // first check if we have less data than we expect AND
             // are allowed to push that
             bool partial_read = false;
@@ -3885,7 +3999,8 @@ void udtreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     // this asserts that all sizes make sense and meet certain constraints
     RTEEXEC(*rteptr,
             rteptr->sizes.validate();
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
+            rteptr->udt_links.clear();
             rteptr->statistics.init(args->stepid, "UdtReadv2"));
 
     counter_type&        counter( rteptr->statistics.counter(args->stepid) );
@@ -3894,8 +4009,9 @@ void udtreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
     const unsigned int   bl_size = rteptr->sizes[constraints::blocksize];
     const unsigned int   n_blank = (wr_size - rd_size);
 
-    ucounter_type&       loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type&       pktcnt( rteptr->evlbi_stats.pkt_in );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&       loscnt( evlbi.pkt_lost );
+    ucounter_type&       pktcnt( evlbi.pkt_in );
     SYNCEXEC(args,
              stop = args->cancelled;
              delete network->threadid; network->threadid = new pthread_t( ::pthread_self() );
@@ -3950,8 +4066,9 @@ void udtreader(outq_type<block>* outq, sync_type<fdreaderargs>* args) {
             }
 
             if( UDT::perfmon(network->fd, &ti, true)==0 ) {
-                pktcnt  = ti.pktRecvTotal;
+                pktcnt += ti.pktRecv;
                 loscnt += ti.pktRcvLoss;
+                rteptr->udt_links.update(network->fd, ti.msRTT, ti.mbpsRecvRate, ti.pktRecv, ti.pktRcvLoss);
             }
         }
         // If we read an incomplete block, allow this only if we were allowed to
@@ -5398,7 +5515,7 @@ ostream& operator<<(ostream& os, struct ::timespec& ts) {
 }
 
 
-typedef std::list<tagged<frame> > tflist_type;
+typedef std::vector<tagged<frame> > tfvector_type;
 
 // This cannot be a local type inside the framefilter function. Jeez.
 // Orelse:
@@ -5406,9 +5523,9 @@ typedef std::list<tagged<frame> > tflist_type;
 // """ error: template argument for 'template<class _T1, class _T2> struct std::pair' uses local type
 // 'framefilter(inq_type<tagged<frame> >*, outq_type<tagged<frame> >*, sync_type<framefilterargs_type*>*)::tagstate_type' """
 struct tagstate_type {
-    bool         synced;
-    tflist_type  framelist;
-    unsigned int tagcounter;
+    bool          synced;
+    tfvector_type framelist;
+    unsigned int  tagcounter;
 
     tagstate_type():
         synced( false ), tagcounter( 0 )
@@ -5428,18 +5545,21 @@ void framefilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq,
                break;
     } else {
         // Filtering! 
-        // Need to track state per incoming tag
-        typedef map<unsigned int, tagstate_type>  tagcounter_type;
-        tagcounter_type     tagcounter;
+        // Need to track state per incoming tag. Each tag's frame list is
+        // allocated once, for naccumulate frames, and reused after that
+        per_tag_type<tagstate_type>  tagcounter;
 
         while( inq->pop(tf) ) {
             tagstate_type&  tagstate( tagcounter[tf.tag] );
 
+            if( tagstate.framelist.capacity()<ffargs.naccumulate )
+                tagstate.framelist.reserve( ffargs.naccumulate );
+
             if( tagstate.tagcounter==0 ) {
                 // need to resync. Check if the frame for the current tag's
                 // time stamp is an integer multiple of the output frame
                 // duration
-                if( (tf.item.frametime.tv_subsecond / ffargs.framelength).denominator()!=1 ) {
+                if( !isMultipleOf(tf.item.frametime.tv_subsecond, ffargs.framelength) ) {
                     // If we are synced, this is bad news because apparently
                     // we lost a (couple of) frame(s) because we end up at
                     // an incompatible time stamp [not multiple of VDIF
@@ -5472,7 +5592,7 @@ void framefilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq,
                     DEBUG(2, "framefilter: SYNC'ed at " << tf.item.frametime << endl);
 
                 // Push all frames collected so far and start fresh
-                for( tflist_type::reverse_iterator p=tagstate.framelist.rbegin(); p!=tagstate.framelist.rend(); p++)
+                for( tfvector_type::iterator p=tagstate.framelist.begin(); p!=tagstate.framelist.end(); p++)
                     if( outq->push(*p)==false )
                         break;
                 tagstate.framelist.clear();
@@ -5481,7 +5601,7 @@ void framefilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq,
                 tagstate.tagcounter = ffargs.naccumulate;
                 tagstate.synced     = true;
             }
-            tagstate.framelist.push_front( tf );
+            tagstate.framelist.push_back( tf );
             tagstate.tagcounter--;
             tf = tagged<frame>();
         }
@@ -5490,67 +5610,59 @@ void framefilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq,
 }
 
 // A median filter to throw out frames with erroneous time stamps
-struct extract_time_stamp {
-    time_t operator()( const tagged<frame>& tf ) const {
-        return tf.item.frametime.tv_sec;
-    }
-};
-
 void medianfilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq) {
     typedef tagged<frame>       tf_type;
-    typedef std::list<tf_type>  framebuf_type;
 
     bool               quit = false;
-    // Allocate one array of time stamps. Note that the code below
-    // *assumes* the length of this array ('n') > 1, so better make sure it
-    // actually IS, in case you're considering resizing it.
+    // Allocate one array of time stamps and a ring of as many frames. Note
+    // that the code below *assumes* the length of these arrays ('n') > 1,
+    // so better make sure it actually IS, in case you're considering
+    // resizing it.
     time_t             tsbuf[ 5 ];
     const size_t       n = sizeof(tsbuf)/sizeof(tsbuf[0]);
+    tf_type            framebuf[ n ];
+    size_t             first = 0, nframe = 0;
     uint64_t           dropped = 0, total = 0;
-    framebuf_type      framebuf;
-    extract_time_stamp ts_extractor;
 
     DEBUG(-1, "medianfilter: starting." << endl);
 
     while( !quit ) {
-        tf_type     frm;
-
-        if( inq->pop(frm)==false )
-            break;
-
-        // Here is where we assume 'n' > 1: we can always push first
+        // Here is where we assume 'n' > 1: we can always add first
         // and *then* check for "have we got 'n' frames already?"
-        framebuf.push_back( frm );
+        if( inq->pop(framebuf[ (first + nframe) % n ])==false )
+            break;
+        nframe++;
         total++;
 
         // If not enough frames in buffer yet, nothing to do
-        if( framebuf.size()<n )
+        if( nframe<n )
             continue;
 
-        // Ok - transform the frame's time stamps into a vector
-        // such that they can be sorted
-
-        // Extract all the time stamps
-        std::transform(framebuf.begin(), framebuf.end(), &tsbuf[0], ts_extractor);
+        // Ok - extract all the frames' time stamps such that they can be
+        // sorted
+        for(size_t i=0; i<n; i++)
+            tsbuf[i] = framebuf[i].item.frametime.tv_sec;
 
         // Sort them
         std::sort(&tsbuf[0], &tsbuf[n]);
 
         // Let the first frame pass if it's within +/-1 of the median value
-        if( ::labs((long)(framebuf.front().item.frametime.tv_sec - tsbuf[ n/2 ])) <= 1 )
-            quit = (outq->push( framebuf.front() )==false);
+        tf_type&   front( framebuf[first] );
+
+        if( ::labs((long)(front.item.frametime.tv_sec - tsbuf[ n/2 ])) <= 1 )
+            quit = (outq->push( front )==false);
         else
             dropped++;
-        // Ok, frame was dropped or pushed on; it can go from our list now
-        framebuf.pop_front();
+        // Ok, frame was dropped or pushed on; it can go from our ring now
+        front  = tf_type();
+        first  = (first + 1) % n;
+        nframe--;
     }
     
     // If we weren't quitting (quit == true => failed to push downstream),
     // we should pass on as many frames as we can. Unfiltered?
-    for(framebuf_type::iterator curf=framebuf.begin(); !(quit || curf==framebuf.end()); curf++)
-        quit = (outq->push( *curf )==false);
-    // Ok, clear the buffer
-    framebuf.clear();
+    for( ; !quit && nframe>0; first=(first+1)%n, nframe--)
+        quit = (outq->push( framebuf[first] )==false);
 
     DEBUG(-1, "medianfilter: done. Dropped " << dropped << ", total " << total << " (" <<
               format("%.2lf%%", (total>0) ? ((double)dropped / (double)total)*100.0 : (double)0) << ")" << endl);
@@ -5897,6 +6009,7 @@ fdreaderargs* net_server(networkargs net) {
 
     // copy over the variable block size allowingness
     rv->allow_variable_block_size = net.allow_variable_block_size;
+    rv->headroom                  = net.headroom;
 
     // and do our thang
     if( proto=="rtcp" )
@@ -5949,7 +6062,7 @@ fdreaderargs* net_client(networkargs net) {
     else if( proto=="unix" )
         rv->fd = getsok_unix_client(np.host);
     else if( proto=="udt" )
-        rv->fd = getsok_udt(np.host, np.get_port(), proto, np.get_mtu());
+        rv->fd = getsok_udt(np.host, np.get_port(), proto, np.get_mtu(), np.get_udtcc());
     else if( proto=="itcp" )
         rv->fd = getsok(np.host, np.get_port(), "tcp");
     else
@@ -6226,12 +6339,12 @@ framerargs::~framerargs() {
 
 fillpatargs::fillpatargs():
     run( false ), realtime( false ), fill( ((uint64_t)0x11223344 << 32) + 0x11223344 ),
-    inc( 0 ), rteptr( 0 ), nword( (uint64_t)-1), pool( 0 )
+    inc( 0 ), rteptr( 0 ), nword( (uint64_t)-1), nthread( 1 ), pool( 0 )
 {}
 
 fillpatargs::fillpatargs(runtime* r):
     run( false ), realtime(false), fill( ((uint64_t)0x11223344 << 32) + 0x11223344 ),
-    inc( 0 ), rteptr( r ), nword( (uint64_t)-1), pool( 0 )
+    inc( 0 ), rteptr( r ), nword( (uint64_t)-1), nthread( 1 ), pool( 0 )
 { ASSERT_NZERO(rteptr); }
 
 void fillpatargs::set_realtime(bool newval) {
@@ -6243,6 +6356,9 @@ void fillpatargs::set_run(bool newval) {
 void fillpatargs::set_nword(uint64_t n) {
     nword = n;
 }
+void fillpatargs::set_nthread(unsigned int n) {
+    nthread = n;
+}
 void fillpatargs::set_fill(uint64_t f) {
     fill = f;
 }
@@ -6360,13 +6476,13 @@ reorderargs::~reorderargs() {
 }
 
 networkargs::networkargs() :
-    allow_variable_block_size( false ), rteptr( 0 )
+    allow_variable_block_size( false ), rteptr( 0 ), headroom( 0 )
 {}
 networkargs::networkargs(runtime* r, bool avbs):
-    allow_variable_block_size( avbs ), rteptr( r )
+    allow_variable_block_size( avbs ), rteptr( r ), headroom( 0 )
 { ASSERT_NZERO(rteptr); netparms = rteptr->netparms; }
 networkargs::networkargs(runtime* r, const netparms_type& np, bool avbs):
-    allow_variable_block_size( avbs ), rteptr( r ), netparms( np )
+    allow_variable_block_size( avbs ), rteptr( r ), netparms( np ), headroom( 0 )
 { ASSERT_NZERO(rteptr); }
 
 fdreaderargs::fdreaderargs():
@@ -6375,7 +6491,7 @@ fdreaderargs::fdreaderargs():
     blocksize( 0 ), pool( 0 ),
     start( 0 ), end( 0 ), finished( false ), run( false ), 
     max_bytes_to_cache( numeric_limits<uint64_t>::max() ),
-    allow_variable_block_size( false )
+    allow_variable_block_size( false ), headroom( 0 )
 {}
 fdreaderargs::~fdreaderargs() {
     delete pool;     pool = 0;
@@ -6729,6 +6845,158 @@ void tagger( inq_type<frame>* inq, outq_type<tagged<frame> >* outq, sync_type<un
         outq->push( tagged<frame>(tag, f) );
 }
 
+vdif_demux_args::vdif_demux_args(runtime* rte, unsigned int fs, const std::set<unsigned int>& thr):
+    rteptr( rte ), pool( 0 ), framesize( fs ), threads( thr )
+{ ASSERT_NZERO(rteptr); }
+
+vdif_demux_args::~vdif_demux_args() {
+    delete pool;
+}
+
+// Frames are collected per thread in blocks of (at least) this size
+static const unsigned int  demuxBlockSize = 2*1024*1024;
+// VDIF thread-ids are 10 bits
+static const unsigned int  vdifMaxThread  = 1024;
+// A legacy VDIF header is 16 bytes; we need the first four words
+static const unsigned int  vdifMinHeader  = 16;
+
+// Frame length (bytes) from word 2, thread-id from word 3 of the header
+static unsigned int vdif_frame_length(const unsigned char* hdr) {
+    uint32_t  w;
+    ::memcpy(&w, hdr + 8, sizeof(w));
+    return (w & 0x00ffffff) * 8;
+}
+
+static unsigned int vdif_thread_id(const unsigned char* hdr) {
+    uint32_t  w;
+    ::memcpy(&w, hdr + 12, sizeof(w));
+    return (w >> 16) & 0x3ff;
+}
+
+// per thread: the block being filled and how much is in it
+typedef std::vector<std::pair<block, unsigned int> > demux_outputs_type;
+
+// Append frame to its thread's block; push the block once the frame
+// doesn't fit anymore. Returns false if downstream has gone away
+static bool vdif_demux_route(const unsigned char* f, unsigned int fsz, blockpool_type* pool, unsigned int obs,
+                             demux_outputs_type& outputs, outq_type<tagged<block> >* outq) {
+    const unsigned int               tid = vdif_thread_id(f);
+    std::pair<block, unsigned int>&  out = outputs[ tid ];
+
+    if( !out.first.empty() && out.second+fsz>obs ) {
+        if( outq->push(tagged<block>(tid, out.first.sub(0, out.second)))==false )
+            return false;
+        out.first = block();
+    }
+    if( out.first.empty() ) {
+        out.first  = pool->get();
+        out.second = 0;
+    }
+    ::memcpy((unsigned char*)out.first.iov_base + out.second, f, fsz);
+    out.second += fsz;
+    return true;
+}
+
+void vdif_demux( inq_type<block>* inq, outq_type<tagged<block> >* outq, sync_type<vdif_demux_args>* args ) {
+    block                       b;
+    vdif_demux_args*            demux = args->userdata;
+    runtime*                    rteptr = demux->rteptr;
+    const unsigned int          fixedsize = demux->framesize;
+    const unsigned int          obs = std::max(demuxBlockSize, fixedsize);
+    std::vector<bool>           wanted( vdifMaxThread, demux->threads.empty() );
+    demux_outputs_type          outputs( vdifMaxThread );
+    std::vector<unsigned char>  partial;
+    uint64_t                    nFrame = 0, nSkipped = 0, nInvalid = 0;
+    bool                        stop = false;
+
+    for(std::set<unsigned int>::const_iterator p=demux->threads.begin(); p!=demux->threads.end(); p++)
+        if( *p<vdifMaxThread )
+            wanted[ *p ] = true;
+
+    SYNCEXEC(args,
+             demux->pool = new blockpool_type(obs, 16));
+
+    RTEEXEC(*rteptr, rteptr->statistics.init(args->stepid, "VDIFDemux"));
+    counter_type&  counter( rteptr->statistics.counter(args->stepid) );
+
+    DEBUG(0, "vdif_demux: starting, frame size " << fixedsize << ", " << demux->threads.size() << " threads" << std::endl);
+
+    while( !stop && inq->pop(b) ) {
+        const unsigned char* ptr  = (const unsigned char*)b.iov_base;
+        size_t               left = b.iov_len;
+
+        // Complete a frame that started in the previous block. If it's
+        // still not complete, all of this block went into it
+        if( !partial.empty() ) {
+            const size_t  nhdr = std::min(left, (size_t)(partial.size()<vdifMinHeader ? vdifMinHeader-partial.size() : 0));
+
+            partial.insert(partial.end(), ptr, ptr+nhdr);
+            ptr += nhdr; left -= nhdr;
+            if( partial.size()>=vdifMinHeader ) {
+                const unsigned int  fsz = (fixedsize ? fixedsize : vdif_frame_length(&partial[0]));
+
+                if( fsz<=vdifMinHeader || fsz>obs ) {
+                    // lost track of where the frames are; look for them
+                    // in the rest of the block
+                    nInvalid++;
+                    partial.clear();
+                } else {
+                    const size_t  n = std::min(left, (size_t)(fsz - partial.size()));
+
+                    partial.insert(partial.end(), ptr, ptr+n);
+                    ptr += n; left -= n;
+                    if( partial.size()==fsz ) {
+                        if( vdif_frame_length(&partial[0])!=fsz )
+                            nInvalid++;
+                        else if( !wanted[vdif_thread_id(&partial[0])] )
+                            nSkipped++;
+                        else if( vdif_demux_route(&partial[0], fsz, demux->pool, obs, outputs, outq) )
+                            nFrame++;
+                        else
+                            stop = true;
+                        partial.clear();
+                    }
+                }
+            }
+        }
+
+        while( !stop && left>=vdifMinHeader ) {
+            const unsigned int  hsz = vdif_frame_length(ptr);
+            const unsigned int  fsz = (fixedsize ? fixedsize : hsz);
+
+            if( fsz<=vdifMinHeader || fsz>obs ) {
+                // Without a fixed frame size there's no telling where
+                // the next frame starts
+                nInvalid++;
+                left = 0;
+                break;
+            }
+            if( fsz>left )
+                break;
+            if( hsz!=fsz )
+                nInvalid++;
+            else if( !wanted[vdif_thread_id(ptr)] )
+                nSkipped++;
+            else if( vdif_demux_route(ptr, fsz, demux->pool, obs, outputs, outq) )
+                nFrame++;
+            else
+                stop = true;
+            ptr += fsz; left -= fsz;
+        }
+        if( left )
+            partial.assign(ptr, ptr+left);
+        counter += b.iov_len;
+    }
+
+    // Flush what's left
+    for(unsigned int t=0; !stop && t<outputs.size(); t++)
+        if( !outputs[t].first.empty() && outputs[t].second>0 )
+            stop = (outq->push(tagged<block>(t, outputs[t].first.sub(0, outputs[t].second)))==false);
+
+    DEBUG(0, "vdif_demux: stopping. " << nFrame << " frames routed, " << nSkipped << " of unselected threads, "
+             << nInvalid << " invalid" << (partial.empty() ? "" : ", incomplete last frame") << std::endl);
+}
+
 void header_stripper( inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq, sync_type<headersearch_type>* args) {
     const headersearch_type& hdr = *args->userdata;
     
@@ -6754,34 +7022,47 @@ void header_stripper( inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >*
 // N output frames with tags Z[0], Z[1], ... , Z[N-1]
 // where Z[n] == splitterargs.outputtag(X, n)
 
-// state for each incoming tag X
+// state for each incoming tag X. Kept for every tag that ever came by and
+// reused for each integration, only the blocks are fetched anew.
 struct tag_state {
+    bool                active;
     block               tagblock[16];
     unsigned int        fcount;
     unsigned char*      chunk[16];
     highrestime_type    out_ts;
 
-    tag_state( blockpool_type* bp, unsigned int nch ):
-        fcount( 0 )
+    tag_state():
+        active( false ), fcount( 0 )
     {
+        for(unsigned  int tmpt=0; tmpt<16; tmpt++)
+            chunk[tmpt] = 0;
+    }
+
+    // start a new integration starting at time 'ts'
+    void start( blockpool_type* bp, unsigned int nch, const highrestime_type& ts ) {
         for(unsigned  int tmpt=0; tmpt<nch; tmpt++) {
             tagblock[tmpt] = bp->get();
             chunk[tmpt]    = (unsigned char*)tagblock[tmpt].iov_base;
         }
+        fcount = 0;
+        out_ts = ts;
+        active = true;
     }
 
-    private:
-    tag_state();
+    // integration done; release the blocks
+    void stop( unsigned int nch ) {
+        for(unsigned  int tmpt=0; tmpt<nch; tmpt++)
+            tagblock[tmpt] = block();
+        active = false;
+    }
 };
 
 void coalescing_splitter( inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq, sync_type<splitterargs>* args) {
-    typedef std::map<unsigned int,tag_state> tag_state_map_type;
-
-    bool                 cancel;
-    splitterargs*        splitargs = args->userdata;
-    runtime*             rteptr    = (splitargs?splitargs->rte:0);
-    tagged<frame>        tf;
-    tag_state_map_type   tagstatemap;
+    bool                    cancel;
+    splitterargs*           splitargs = args->userdata;
+    runtime*                rteptr    = (splitargs?splitargs->rte:0);
+    tagged<frame>           tf;
+    per_tag_type<tag_state> tagstates;
     splitproperties_type splitprops = splitargs->splitprops;
 
     // Assert we have arguments
@@ -6850,24 +7131,15 @@ void coalescing_splitter( inq_type<tagged<frame> >* inq, outq_type<tagged<frame>
         // into <nchunk> different pieces. After having processed
         // <nchunk> frames of a particular tag, we send them
         // onwards downstream, potentially re-tagging them
-        unsigned char**               chunk;
-        tag_state_map_type::iterator  curtag;
+        unsigned char** chunk;
+        tag_state&      tagstate( tagstates[tf.tag] );
        
-        if( (curtag=tagstatemap.find(tf.tag))==tagstatemap.end() ) {
-            // first time we see this tag - get a new integration state
-            pair<tag_state_map_type::iterator, bool> insres;
-            insres = tagstatemap.insert( make_pair(tf.tag, tag_state(blkpool, nchunk)) );
-            ASSERT2_COND(insres.second,
-                         SCINFO("Failed to insert new state for splitting into for tag #" << tf.tag));
-            curtag = insres.first;
-
-            // remember the time of the first frame
-            curtag->second.out_ts = tf.item.frametime;
-        }
+        // first frame of an integration for this tag - get new blocks and
+        // remember the time of the first frame
+        if( !tagstate.active )
+            tagstate.start(blkpool, nchunk, tf.item.frametime);
 
         // Everything has been precomputed so we can get going right away
-        tag_state&      tagstate( curtag->second );
-
         chunk = tagstate.chunk;
         splitfn((unsigned char*)tf.item.framedata.iov_base + inputheader.payloadoffset,
                 inputheader.payloadsize,
@@ -6887,7 +7159,7 @@ void coalescing_splitter( inq_type<tagged<frame> >* inq, outq_type<tagged<frame>
         block*       tagblock = tagstate.tagblock;
         unsigned int j;
         for(j=0; j<nchunk; j++)
-            if( outq->push( tagged<frame>(curtag->first*nchunk + j,
+            if( outq->push( tagged<frame>(tf.tag*nchunk + j,
                                           frame(outputheader.frameformat, outputheader.ntrack, tagstate.out_ts,
                                                 tagblock[j].sub(0, outputsize))) )==false )
                 break;
@@ -6898,34 +7170,46 @@ void coalescing_splitter( inq_type<tagged<frame> >* inq, outq_type<tagged<frame>
         }
         counter += nchunk*outputsize;
 
-        // And reset for the next iteration - ie erase the integration for
+        // And reset for the next iteration - ie end the integration for
         // the current tag
-        tagstatemap.erase(curtag);
+        tagstate.stop(nchunk);
     } while( inq->pop(tf) );
     DEBUG(2, "coalescing_splitter: done " << endl);
 }
 
 
+// The VDIF header for each output data thread of reframe_to_vdif
+struct vdif_thread_header {
+    bool                   initialized;
+    non_legacy_vdif_header hdr;
+
+    vdif_thread_header():
+        initialized( false )
+    {}
+};
+
 // Reframe to vdif - output the new frame as a blocklist:
 // first the new header (VDIF) and then the datablock
 // Assume all the samples in all channels have the same time stamp
 // (would be nonsense if this wouldn't hold, but still, it IS an
 //  assumption)
 void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblocklist_type> >* outq, sync_type<reframe_args>* args) {
-    typedef std::map<unsigned int, non_legacy_vdif_header>  tagheadermap_type;
     bool                    stop              = false;
     uint64_t                done              = 0;
     reframe_args*           reframe = args->userdata;
     tagged<frame>           tf;
-    tagheadermap_type       tagheader;
     const unsigned int      bits_p_chan = reframe->bits_per_channel;
     const samplerate_type   bitrate     = reframe->bitrate;
     const unsigned int      input_size  = reframe->input_size;
     const unsigned int      output_size = reframe->output_size;
     const tagremapper_type& tagremapper = reframe->tagremapper;
     const bool              doremap     = (tagremapper.size()>0);
-    const tagremapper_type::const_iterator  endptr = tagremapper.end();
-    tagheadermap_type::iterator             hdrptr;
+    // tag -> (mapped?, datathreadid) and datathreadid -> VDIF header
+    per_tag_type< pair<bool, unsigned int> > tagmap;
+    per_tag_type<vdif_thread_header>         tagheader;
+
+    for(tagremapper_type::const_iterator p=tagremapper.begin(); p!=tagremapper.end(); p++)
+        tagmap[p->first] = make_pair(true, p->second);
 
     EZASSERT2(bits_p_chan>0, reframeexception,
               EZINFO("The number of bits per channel cannot be 0"));
@@ -6969,14 +7253,14 @@ void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblockli
         unsigned int                     datathreadid;
         const unsigned int               last = data.iov_len;
         const highrestime_type           time = tf.item.frametime;
-        tagremapper_type::const_iterator tagptr = tagremapper.find(tf.tag);
+        const pair<bool, unsigned int>&  mapped = tagmap[tf.tag];
 
         if( last!=input_size ) {
             DEBUG(-1, "reframe_to_vdif: got inputsize " << last << ", expected " << input_size << endl);
             continue;
         }
         // Deal with tag -> datathreadid mapping
-        if( doremap && tagptr==endptr ) {
+        if( doremap && !mapped.first ) {
             // no entry for the current tag - discard data
             continue;
         }
@@ -6987,28 +7271,25 @@ void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblockli
             continue;
         }
 
-        datathreadid = (doremap?tagptr->second:tf.tag);
+        datathreadid = (doremap?mapped.second:tf.tag);
 
-        if( (hdrptr=tagheader.find(datathreadid))==tagheader.end() ) {
-            pair<tagheadermap_type::iterator,bool> insres = tagheader.insert( make_pair(datathreadid,non_legacy_vdif_header()) );
-            EZASSERT2( insres.second, reframeexception,
-                       EZINFO("Failed to insert new VDIF header for datathread #" << datathreadid
-                              << " (tag:" << tf.tag << ")"));
-            hdrptr = insres.first;
+        vdif_thread_header&  threadhdr( tagheader[datathreadid] );
 
+        if( !threadhdr.initialized ) {
             // haven't seen this datathreadid before, must initialize VDIF
             // header
-            non_legacy_vdif_header&  hdr( hdrptr->second /*tagheader[t]*/ );
+            non_legacy_vdif_header&  hdr( threadhdr.hdr );
 
             hdr.station_id      = reframe->station_id;
-            hdr.thread_id       = (short unsigned int)(hdrptr->first & 0x3ff);
+            hdr.thread_id       = (short unsigned int)(datathreadid & 0x3ff);
             hdr.data_frame_len8 = (unsigned int)(((output_size+sizeof(non_legacy_vdif_header))/8) & 0x00ffffff);
             hdr.bits_per_sample = (unsigned char)((reframe->bits_per_sample - 1) & 0x1f);
             hdr.ref_epoch       = (unsigned char)(epoch & 0x3f);
+            threadhdr.initialized = true;
         }
 
         // break up the frame into smaller bits?
-        non_legacy_vdif_header&    hdr = hdrptr->second;
+        non_legacy_vdif_header&    hdr = threadhdr.hdr;
 
         // dataframes cannot span second boundaries so this can be done
         // easily outside the breaking-up loop
@@ -7028,12 +7309,11 @@ void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblockli
         //         This would support "x samples per y second" where y != 1
         const subsecond_type vdif_framelen   = 8*output_size / (tf.item.ntrack * bitrate);
         const subsecond_type vdif_framerate  = 1/vdif_framelen;
-        const subsecond_type first_fn        = time.tv_subsecond / vdif_framelen;
 
-        EZASSERT2(first_fn.denominator()==1, reframeexception,
+        EZASSERT2(isMultipleOf(time.tv_subsecond, vdif_framelen), reframeexception,
              EZINFO("data time stamp " << time << " not representable as frame number using frame length " << vdif_framelen));
 
-        for(uint64_t dfn=first_fn.numerator(), pos=0;
+        for(uint64_t dfn=nPeriod(time.tv_subsecond, vdif_framelen), pos=0;
                 !stop && (pos+output_size)<=last;
                 dfn++, pos+=output_size) {
             block          vdifh( pool->get() );
@@ -7055,7 +7335,7 @@ void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblockli
             // into the next UT second
             ((struct non_legacy_vdif_header*)vdifh.iov_base)->data_frame_num = (unsigned int)(dfn & 0x00ffffff);
 
-            stop = (outq->push(tagged<miniblocklist_type>(hdrptr->first/*tf.tag*/,
+            stop = (outq->push(tagged<miniblocklist_type>(datathreadid/*tf.tag*/,
                                miniblocklist_type(vdifh, data.sub(pos, output_size))))==false);
         }
         done++;
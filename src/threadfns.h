@@ -21,7 +21,9 @@
 #define JIVE5A_THREADFNS_H
 
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 #include <runtime.h>
 #include <chain.h>
 #include <block.h>
@@ -108,6 +110,30 @@ struct tagged {
     {}
 };
 
+// State per tag for the steps handling tagged frames. Tags are small
+// integers - the splitters and taggers number their outputs from 0 - so
+// the state lives in a vector indexed by tag i.s.o. a map: no lookup nor
+// heap allocation per frame. The vector only grows when a higher tag than
+// seen before comes by; absurdly high tags are kept in a map.
+template <typename T>
+struct per_tag_type {
+    enum { maxDenseTag = 65536 };
+
+    T& operator[]( unsigned int tag ) {
+        if( tag<dense.size() )
+            return dense[tag];
+        if( tag<maxDenseTag ) {
+            dense.resize( tag+1 );
+            return dense[tag];
+        }
+        return sparse[tag];
+    }
+
+    private:
+        std::vector<T>            dense;
+        std::map<unsigned int, T> sparse;
+};
+
 template <unsigned int N>
 struct emergency_type {
     enum     { nrElements = N };
@@ -217,6 +243,7 @@ struct fillpatargs {
     uint64_t               inc;
     runtime*               rteptr;
     uint64_t               nword;
+    unsigned int           nthread;
     blockpool_type*        pool;
 
     // The 'realtime' boolean indicates wether or not the
@@ -244,6 +271,11 @@ struct fillpatargs {
     // awfull lot ...
     void set_nword(uint64_t n);
 
+    // VDIF only: generate frames for VDIF threads 0 .. n-1 in turn.
+    // Each thread carries the data rate of the mode; all threads' frames
+    // of one frame period have the same time stamp.
+    void set_nthread(unsigned int n);
+
     // Set fill pattern and increment
     void set_fill(uint64_t f);
     void set_inc(uint64_t i);
@@ -252,6 +284,7 @@ struct fillpatargs {
     //           nbyte==-1 (several petabytes generated)
     //           fill == 0x1122334411223344
     //           inc  == 0
+    //           nthread == 1
     fillpatargs();
     // almost same as default, save for rteptr, wich will be == r
     fillpatargs(runtime* r);
@@ -372,6 +405,9 @@ struct networkargs {
     bool               allow_variable_block_size;
     runtime*           rteptr;
     netparms_type      netparms;
+    // number of bytes to leave free at the start of each block,
+    // for readers that support it (udpsnor)
+    unsigned int       headroom;
 
     networkargs();
     networkargs(runtime* r, bool avbs=false);
@@ -397,6 +433,11 @@ struct fdreaderargs {
     // down to integer multiples of blocksize
     bool            allow_variable_block_size;
 
+    // the reader leaves this many bytes free in front of each block it
+    // produces such that a consumer may put a header there and write
+    // header + data in one go. Only the udpsnor reader supports it.
+    unsigned int    headroom;
+
     fdreaderargs();
     ~fdreaderargs();
 
@@ -615,6 +656,26 @@ struct reframe_args {
     ~reframe_args();
 };
 
+// The VDIF thread demultiplexer routes raw VDIF frames to an output tag
+// equal to their VDIF thread-id. It looks only at the frame length and
+// thread-id fields in the header; frames are not decoded. The frames of
+// each thread are collected in large blocks so the writers downstream
+// (e.g. multiwriter<block, fdwriterfunctor>) do few, large writes.
+//
+// 'framesize' = 0 means: take the frame length from each frame's header.
+// If nonzero (the mode is set) every frame is expected to have this size
+// and frames whose header says otherwise (e.g. fill pattern for lost
+// packets) are skipped. Frames of threads not in 'threads' are dropped.
+struct vdif_demux_args {
+    runtime*                rteptr;
+    blockpool_type*         pool;
+    const unsigned int      framesize;
+    std::set<unsigned int>  threads;
+
+    vdif_demux_args(runtime* rte, unsigned int fs, const std::set<unsigned int>& thr);
+    ~vdif_demux_args();
+};
+
 multifdargs*   multiopener( multidestparms mdp );
 multifdargs*   multifileopener( multidestparms mdp );
 // Opens n identical sockets based on rte->netparms
@@ -623,6 +684,7 @@ void           multicloser( multifdargs* );
 void           multirdcloser( multifdrdargs* );
 
 void           tagger( inq_type<frame>*, outq_type<tagged<frame> >*, sync_type<unsigned int>* );
+void           vdif_demux( inq_type<block>*, outq_type<tagged<block> >*, sync_type<vdif_demux_args>* );
 void           splitter( inq_type<frame>*, outq_type<tagged<frame> >*, sync_type<splitterargs>* );
 void           coalescing_splitter( inq_type<tagged<frame> >*, outq_type<tagged<frame> >*, sync_type<splitterargs>* );
 void           reframe_to_vdif(inq_type<tagged<frame> >*, outq_type<tagged<miniblocklist_type> >*, sync_type<reframe_args>* );
@@ -23,6 +23,9 @@
 #include <sciprint.h>
 #include <getsok.h>
 #include <mk6info.h>
+#include <vbscatalog.h>
+#include <ioscheduler.h>
+#include <tracering.h>
 #include <getsok_udt.h>
 #include <threadutil.h>
 #include <auto_array.h>
@@ -40,6 +43,13 @@
 #include <signal.h>
 #include <dirent.h>
 #include <stdlib.h>   // for random
+#include <string.h>   // for memcpy
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
 
 using namespace std;
 
@@ -71,11 +81,11 @@ uint32_t extract_file_seq_no(const string& s) {
 //          filemetadata
 ///////////////////////////////////////////////////////////////////
 filemetadata::filemetadata():
-    fileSize( (off_t)0 )
+    fileSize( (off_t)0 ), rangeOffset( (off_t)0 ), chunkSize( (off_t)-1 )
 {}
 
 filemetadata::filemetadata(const string& fn, off_t sz, uint32_t csn):
-    fileSize( sz ), chunkSequenceNr( csn ), fileName( fn )
+    fileSize( sz ), rangeOffset( (off_t)0 ), chunkSize( (off_t)-1 ), chunkSequenceNr( csn ), fileName( fn )
 {}
 
 
@@ -93,29 +103,53 @@ chunk_location::chunk_location( string mp, string rel):
 ///////////////////////////////////////////////////////////////////
 //          chunkmakerargs_type
 ///////////////////////////////////////////////////////////////////
+
+// The format to index the recording with. Not all recordings have a data
+// format (e.g. fill2vbs, or no mode set) in which case an invalid one is
+// returned, which disables the index
+static headersearch_type index_format(runtime* rteptr) {
+    if( rteptr->trackformat()!=fmt_none ) {
+        try {
+            return headersearch_type(rteptr->trackformat(), rteptr->ntrack(),
+                                     rteptr->trackbitrate(), rteptr->vdifframesize());
+        }
+        catch( const std::exception& e ) {
+            DEBUG(2, "chunkmakerargs_type: not indexing - " << e.what() << endl);
+        }
+    }
+    return headersearch_type();
+}
+
 chunkmakerargs_type::chunkmakerargs_type(runtime* rte, std::string const& rec):
-    rteptr( rte ), recording_name( rec )
+    rteptr( rte ), recording_name( rec ), mk6( false )
 {
     EZASSERT2( rteptr && !recording_name.empty(), std::runtime_error,
                EZINFO("Do not pass NULL runtime pointer (" << (void*)rte << ") " <<
                       "or empty recording name ('" << recording_name << "')"));
+    timeindex   = countedpointer<timeindex_builder>( new timeindex_builder(index_format(rteptr)) );
+    mountpoints = rteptr->mk6info.mountpoints;
+    mk6         = rteptr->mk6info.mk6;
 }
 
 ///////////////////////////////////////////////////////////////////
 //          mark6_vars_type
 ///////////////////////////////////////////////////////////////////
 mark6_vars_type::mark6_vars_type():
-    mk6( false ), packet_size( -1 ), packet_format( mk6_file_header::UNKNOWN_FORMAT )
+    mk6( false ), packet_size( -1 ), packet_format( mk6_file_header::UNKNOWN_FORMAT ), wb_headroom( false )
 {}
 
-mark6_vars_type::mark6_vars_type(int32_t ps, mk6_file_header::packet_formats pf):
-    mk6( true ), packet_size( ps ), packet_format( pf )
+mark6_vars_type::mark6_vars_type(int32_t ps, mk6_file_header::packet_formats pf, bool hr):
+    mk6( true ), packet_size( ps ), packet_format( pf ), wb_headroom( hr )
 {}
 
 
 ///////////////////////////////////////////////////////////////////
 //          multireadargs
 ///////////////////////////////////////////////////////////////////
+multireadargs::multireadargs(runtime* r):
+    rteptr( r )
+{ EZASSERT2_NZERO(rteptr, cmdexception, EZINFO("null pointer runtime!")) }
+
 multireadargs::~multireadargs() {
     // delete all memory pools
     for( mempool_type::iterator pool=mempool.begin(); pool!=mempool.end(); pool++)
@@ -126,9 +160,29 @@ multireadargs::~multireadargs() {
 //          multifileargs
 ///////////////////////////////////////////////////////////////////
 
+diskhealth_type::diskhealth_type():
+    state( ok ), nChunk( 0 ), nByte( 0 ), nSample( 0 ), avgLatency( 0.0 ), lastLatency( 0.0 ),
+    freeBytes( 0 ), nQuarantine( 0 )
+{}
+
+const char* diskhealth_state(diskhealth_type::state_type s) {
+    switch( s ) {
+        case diskhealth_type::ok:          return "ok";
+        case diskhealth_type::quarantined: return "quarantined";
+        case diskhealth_type::full:        return "full";
+        case diskhealth_type::bad:         return "bad";
+        default:                           break;
+    }
+    return "<unknown>";
+}
+
 multifileargs::multifileargs(runtime* ptr, filelist_type fl, mark6_vars_type mk6):
     listlength( fl.size() ), rteptr( ptr ), filelist( fl ), mk6vars( mk6 )
-{ EZASSERT2_NZERO(rteptr, cmdexception, EZINFO("null pointer runtime!")) }
+{
+    EZASSERT2_NZERO(rteptr, cmdexception, EZINFO("null pointer runtime!"));
+    for(filelist_type::const_iterator p=filelist.begin(); p!=filelist.end(); p++)
+        diskhealth[ *p ] = diskhealth_type();
+}
 
 multifileargs::~multifileargs() {
     // delete all memory pools
@@ -295,11 +349,17 @@ void fdoperations_type::set_ipd(int fd, int ipd) const {
 
 // This one WILL throw if something's fishy.
 // Read the metadata up to the double '\0'
-string read_itcp_header(int fd, const fdoperations_type& fdops) {
+string read_itcp_header(int fd, const fdoperations_type& fdops, bool* eof) {
     char          c;
     unsigned int  num_zero_bytes = 0;
     ostringstream oss;
 
+    if( eof ) {
+        if( (*eof=(fdops.readfn(fd, &c, 1, 0)!=1))==true )
+            return string();
+        num_zero_bytes = (c=='\0' ? 1 : 0);
+        oss << c;
+    }
     while( num_zero_bytes<2 ) {
         ASSERT_COND( fdops.readfn(fd, &c, 1, 0)==1 );
         if( c=='\0' )
@@ -324,10 +384,11 @@ struct chunkLocationMaker {
     }
 };
 
-// Use the find_recordingchunks() from mountpoints.h [it's multithreaded!]
-// afterwards we transform the entries into a chunklist_type
+// Look up the chunks in the catalog [vbscatalog.h], only the first time
+// the mountpoints are walked. Afterwards we transform the entries into a
+// chunklist_type
 chunklist_type get_chunklist(string scan, const mountpointlist_type& mountpoints) {
-    filelist_type   chunks = find_recordingchunks(scan, mountpoints);
+    filelist_type   chunks = catalog_chunks(scan, mountpoints);
     chunklist_type  rv;
 
     transform(chunks.begin(), chunks.end(), back_inserter(rv), chunkLocationMaker());
@@ -350,6 +411,20 @@ void mfa_close(multifileargs* mfaptr) {
     }
 }
 
+string mfa_diskhealth(multifileargs* mfaptr) {
+    ostringstream   oss;
+
+    for(diskhealthmap_type::const_iterator p=mfaptr->diskhealth.begin(); p!=mfaptr->diskhealth.end(); p++) {
+        const diskhealth_type&  dh = p->second;
+
+        oss << (p==mfaptr->diskhealth.begin() ? "" : " : ")
+            << p->first << "/" << diskhealth_state(dh.state) << "/" << dh.nChunk << "/" << dh.nByte << "/"
+            << (dh.avgLatency>0.0 ? 1.0/dh.avgLatency : 0.0) << "/" << (dh.lastLatency>0.0 ? 1.0/dh.lastLatency : 0.0) << "/"
+            << dh.freeBytes << "/" << dh.nQuarantine;
+    }
+    return oss.str();
+}
+
 void mna_close(multinetargs* mnaptr) {
     for( threadfdlist_type::iterator tidptr = mnaptr->threadlist.begin();
          tidptr!=mnaptr->threadlist.end(); tidptr++ ) {
@@ -428,71 +503,64 @@ struct inset {
 };
 
 
-void rsyncinitiator(outq_type<chunk_location>* outq, sync_type<rsyncinitargs>* args) {
-    chunklist_type   fl;
-    rsyncinitargs*   rsyncinit = args->userdata;
+// The whole chunk as one range, such that the remote end overwrites the
+// copy it has in place rather than trying to create it
+static chunk_location whole_chunk(const chunk_location& cl) {
+    struct stat     st;
+    chunk_location  rv( cl );
 
-    // Before anything, install signalhandler so we can be cancelled
-    install_zig_for_this_thread(SIGUSR1);
+    if( ::stat((cl.mountpoint + "/" + cl.relative_path).c_str(), &st)==0 )
+        rv.ranges.assign(1, byterange_type(0, st.st_size));
+    return rv;
+}
 
-    DEBUG(2, "rsyncinitiator/starting" << endl);
-    // Get the file list for the indicated scan
-    fl = get_chunklist(rsyncinit->scanname, rsyncinit->netargs.rteptr->mk6info.mountpoints);
+// Same for a chunk that is sent from memory
+static filemetadata whole_chunk(const chunk_type& chunk) {
+    filemetadata  rv( chunk.tag );
 
-    // If there's no files to sync, we're done very quickly! We don't need
-    // to throw exceptions because it's not really exceptional, is it?
-    if( fl.empty() ) {
-        DEBUG(-1, "rsyncinitiator/no files found for scan '" << rsyncinit->scanname << "'" << endl);
-        return;
+    if( rv.chunkSize<0 ) {
+        rv.rangeOffset = 0;
+        rv.chunkSize   = (off_t)chunk.item.iov_len;
     }
-    DEBUG(4, "rsyncinitiator/got " << fl.size() << " files to sync" << endl);
+    return rv;
+}
 
+// Tell the remote end which chunks of 'scan' we have and return the ones
+// it still needs. 'fd' is a fresh connection to the remote end.
+chunklist_type rsync_negotiate(const string& scan, const chunklist_type& fl, int fd, const fdoperations_type& fdops) {
     // Create the message. First the header [indicating this is an rsync
     // request], then the payload, which is a list of '\0'-separated file names
     // (note: only the _relative_ paths because we don't know where the
     // remote end has stored them)
-    bool              cancelled;
     kvmap_type        hdr;
     ostringstream     payload;
 
     // prepare payload so we can inform the remote end how many bytes to read
-    for( chunklist_type::iterator fptr=fl.begin(); fptr!=fl.end(); fptr++ )
+    for( chunklist_type::const_iterator fptr=fl.begin(); fptr!=fl.end(); fptr++ )
         payload << fptr->relative_path << '\0';
 
     const string   payload_s( payload.str() );
 
     // Send two key/value pairs: the scan name +
     // the length of the file list that we'll be sending
-    hdr.set( "requestRsync", rsyncinit->scanname );
+    hdr.set( "requestRsync", scan );
     hdr.set( "payloadSize", payload_s.size() );
+    // Ask for the digests of the chunks the remote end already has such
+    // that we can send only what's missing or different. Older versions
+    // ignore this and reply with the file list only.
+    hdr.set( "rangeSize", chunkdigest_type::defaultRangeSize );
 
     const string   hdr_s( hdr.toBinary() );
 
-    // Connect to remote side and store fdreader thing in our sync_type -
-    // the cancellation function then can get us out of blocking request
-    // should the user wish to cancel us
-    SYNCEXEC(args,
-             cancelled = args->cancelled;
-             if( !cancelled )
-                rsyncinit->conn = net_client(rsyncinit->netargs) );
-    if( cancelled ) {
-        DEBUG(-1, "rsyncinitiator/cancelled before initiating sync");
-        return;
-    }
-
-    // Get a hold of the correct function pointers
-    int               fd( rsyncinit->conn->fd );
-    fdoperations_type fdops( rsyncinit->netargs.netparms.get_protocol() );
-
-    // and send the initiating message
+    // send the initiating message
     fdops.write(fd, hdr_s.c_str(), hdr_s.size());
     fdops.write(fd, payload_s.c_str(), payload_s.size());
 
-    DEBUG(4, "rsyncinitiator/init message sent, now waiting for reply ... " << endl);
+    DEBUG(4, "rsync_negotiate/init message sent, now waiting for reply ... " << endl);
 
     // Now wait for incoming reply
     uint32_t                   sz;
-    kvmap_type::const_iterator szptr, typeptr;
+    kvmap_type::const_iterator szptr, typeptr, infoptr;
 
     hdr.fromBinary( read_itcp_header(fd, fdops) );
 
@@ -510,14 +578,36 @@ void rsyncinitiator(outq_type<chunk_location>* outq, sync_type<rsyncinitargs>* a
     EZASSERT2( ::sscanf(szptr->second.c_str(), "%" SCNu32, &sz)==1, cmdexception,
                EZINFO("Failed to parse reply size from meta data '" << szptr->second << "'") );
 
-    DEBUG(4, "rsyncinitiator/reply sais we need to read " << sz << " bytes, list type = " << typeptr->second << endl);
+    DEBUG(4, "rsync_negotiate/reply sais we need to read " << sz << " bytes, list type = " << typeptr->second << endl);
 
     // Now read the reply
     auto_array<char>  flist( new char[ sz ] );
     ASSERT_COND( fdops.read(fd, &flist[0], (size_t)sz)==(ssize_t)sz );
 
-    // Phew. Finally we have the reply. We don't need the network connection no more
-    SYNCEXEC(args, ::close_filedescriptor(rsyncinit->conn))
+    // If the remote end supports it, the list is followed by the digests
+    // of the chunks it has: "<relative path>\0<digest>\0" for each chunk.
+    // Of chunks without a stored digest the "digest" only has the size
+    typedef map<string, chunkdigest_type>  digestmap_type;
+    digestmap_type     remote_digest;
+
+    if( (infoptr=hdr.find("chunkInfoSz"))!=hdr.end() ) {
+        uint32_t          isz;
+        chunkdigest_type  cd;
+
+        EZASSERT2( ::sscanf(infoptr->second.c_str(), "%" SCNu32, &isz)==1, cmdexception,
+                   EZINFO("Failed to parse chunk info size from meta data '" << infoptr->second << "'") );
+        auto_array<char>  info( new char[ isz ] );
+        ASSERT_COND( fdops.read(fd, &info[0], (size_t)isz)==(ssize_t)isz );
+
+        const vector<string>  info_lst = ::split(string(&info[0], isz), '\0', true);
+
+        EZASSERT2( (info_lst.size()%2)==0, cmdexception, EZINFO("Inconsistent chunk info in rsync reply") );
+        for(vector<string>::const_iterator p=info_lst.begin(); p!=info_lst.end(); p+=2) {
+            EZASSERT2( cd.fromString(*(p+1)), cmdexception, EZINFO("Invalid digest '" << *(p+1) << "' for " << *p) );
+            remote_digest[ *p ] = cd;
+        }
+        DEBUG(4, "rsync_negotiate/reply has size/digest of " << remote_digest.size() << " chunks" << endl);
+    }
 
     // Now we split it at '\0's to get at
     // the list of filessent to us
@@ -538,24 +628,60 @@ void rsyncinitiator(outq_type<chunk_location>* outq, sync_type<rsyncinitargs>* a
         needcopy_fn = not_inset_fn;
     else
         needcopy_fn = inset_fn;
-    // Ok, do it!
-    for( chunklist_type::iterator fptr=fl.begin(); fptr!=fl.end(); fptr++ )
-        if( needcopy_fn(fptr->relative_path, remote_set) )
-            newfl.push_back( *fptr );
+    // Ok, do it! Of the chunks the remote end has (part of), if we know its
+    // digest, we only send the ranges that differ. Of the ones it only
+    // told us the size of, we send what's missing at the end, trusting
+    // what is there like older versions trust the file name
+    for( chunklist_type::const_iterator fptr=fl.begin(); fptr!=fl.end(); fptr++ ) {
+        digestmap_type::const_iterator  rdptr = remote_digest.find( fptr->relative_path );
+
+        if( rdptr==remote_digest.end() ) {
+            if( needcopy_fn(fptr->relative_path, remote_set) )
+                newfl.push_back( *fptr );
+            continue;
+        }
+        chunkdigest_type  local;
+        chunk_location    cl( *fptr );
+        const string      path( cl.mountpoint + "/" + cl.relative_path );
 
-    DEBUG(2, "rsyncinitiator/after filtering there are " << newfl.size() << " files left to be sent" << endl);
+        if( rdptr->second.digest.empty() || !chunkdigest_get(path, rdptr->second.rangeSize, local) ) {
+            struct stat   st;
 
+            if( ::stat(path.c_str(), &st)!=0 ) {
+                DEBUG(-1, "rsync_negotiate/cannot stat " << path << ", skipping it" << endl);
+                continue;
+            }
+            if( st.st_size==rdptr->second.size )
+                continue;
+            if( st.st_size>rdptr->second.size )
+                cl.ranges.push_back( byterange_type(rdptr->second.size, st.st_size-rdptr->second.size) );
+            else
+                cl = whole_chunk(cl);
+            DEBUG(4, "rsync_negotiate/" << cl.relative_path << " is " << rdptr->second.size << " of "
+                     << st.st_size << " bytes remote" << endl);
+            newfl.push_back( cl );
+            continue;
+        }
+        cl.ranges = chunkdigest_diff(local, rdptr->second);
+        if( cl.ranges.empty() )
+            continue;
+        DEBUG(4, "rsync_negotiate/" << cl.relative_path << " differs in " << cl.ranges.size() << " range(s)" << endl);
+        newfl.push_back( cl );
+    }
+    return newfl;
+}
+
+// Order the chunks such that consecutive chunks come from different
+// mountpoints, so reading them is spread over the disks
+chunklist_type stripe_chunklist(const chunklist_type& fl) {
     // Compile a mapping of files to send, organized by mount point
     typedef map<string, chunklist_type>   per_mp_type;
     per_mp_type            per_mp;
+    chunklist_type         rv;
     
-    for( chunklist_type::iterator fptr=newfl.begin(); fptr!=newfl.end(); fptr++ )
+    for( chunklist_type::const_iterator fptr=fl.begin(); fptr!=fl.end(); fptr++ )
         per_mp[ fptr->mountpoint ].push_back( *fptr );
 
-    // Now we clear the original file list and re-order the ones we need to
-    // send
-    fl.clear();
-
     // Now keep on round robin'ing over the mount points
     // to compile a list of files to xfer
     while( !per_mp.empty() ) {
@@ -567,7 +693,7 @@ void rsyncinitiator(outq_type<chunk_location>* outq, sync_type<rsyncinitargs>* a
         // [the fact the Key is still in the map implies there
         //  ARE/IS (a) file(s) to pop]
         for( mpptr=per_mp.begin(); mpptr!=per_mp.end(); mpptr++ ) {
-            fl.push_back( mpptr->second.front() );
+            rv.push_back( mpptr->second.front() );
             mpptr->second.pop_front();
             // See - if the list has just become empty, we remove
             // the whole item
@@ -578,8 +704,55 @@ void rsyncinitiator(outq_type<chunk_location>* outq, sync_type<rsyncinitargs>* a
         for(erase_type::iterator eptr=toerase.begin(); eptr!=toerase.end(); eptr++)
             per_mp.erase( *eptr );
     }
+    return rv;
+}
+
+void rsyncinitiator(outq_type<chunk_location>* outq, sync_type<rsyncinitargs>* args) {
+    chunklist_type   fl;
+    rsyncinitargs*   rsyncinit = args->userdata;
+
+    // Before anything, install signalhandler so we can be cancelled
+    install_zig_for_this_thread(SIGUSR1);
+
+    DEBUG(2, "rsyncinitiator/starting" << endl);
+    // Get the file list for the indicated scan
+    fl = get_chunklist(rsyncinit->scanname, rsyncinit->netargs.rteptr->mk6info.mountpoints);
+
+    // If there's no files to sync, we're done very quickly! We don't need
+    // to throw exceptions because it's not really exceptional, is it?
+    if( fl.empty() ) {
+        DEBUG(-1, "rsyncinitiator/no files found for scan '" << rsyncinit->scanname << "'" << endl);
+        return;
+    }
+    DEBUG(4, "rsyncinitiator/got " << fl.size() << " files to sync" << endl);
+
+    // Connect to remote side and store fdreader thing in our sync_type -
+    // the cancellation function then can get us out of blocking request
+    // should the user wish to cancel us
+    bool              cancelled;
+
+    SYNCEXEC(args,
+             cancelled = args->cancelled;
+             if( !cancelled )
+                rsyncinit->conn = net_client(rsyncinit->netargs) );
+    if( cancelled ) {
+        DEBUG(-1, "rsyncinitiator/cancelled before initiating sync");
+        return;
+    }
+
+    // Get a hold of the correct function pointers
+    fdoperations_type fdops( rsyncinit->netargs.netparms.get_protocol() );
+
+    fl = rsync_negotiate(rsyncinit->scanname, fl, rsyncinit->conn->fd, fdops);
+
+    // Phew. Finally we have the reply. We don't need the network connection no more
+    SYNCEXEC(args, ::close_filedescriptor(rsyncinit->conn))
+
+    DEBUG(2, "rsyncinitiator/after filtering there are " << fl.size() << " files left to be sent" << endl);
+
     // The striping has been done, now all that's left is to push the files
     // downstream
+    fl = stripe_chunklist( fl );
     while( !fl.empty() ) {
         chunk_location   curchunk = fl.front();
         fl.pop_front();
@@ -646,19 +819,6 @@ void parallelreader2(inq_type<chunk_location>* inq,  outq_type<chunk_type>* outq
 
         b = mempoolptr->second->get();
 #endif
-        block  b( (size_t)sz );
-
-        for ( readcounter = 0; readcounter < b.iov_len; readcounter += rv ) {
-            rv = ::read(fd, 
-                        (unsigned char*)b.iov_base + readcounter, 
-                        b.iov_len - readcounter);
-            ASSERT2_POS( rv, SCINFO("failed to read " << file) );
-        }
-
-        // Ok, we're done with fd
-        SYNCEXEC(args, mraptr->threadlist[ ::pthread_self() ] = -1);
-
-        ::close(fd);
         // Do some mongering on the file name
         uint32_t                        bsn;
         const vector<string>            elems = ::split(file, '/', true);
@@ -669,7 +829,47 @@ void parallelreader2(inq_type<chunk_location>* inq,  outq_type<chunk_type>* outq
         bsn = extract_file_seq_no( elems[vsz-1] );
         EZASSERT2(bsn!=(uint32_t)-1, cmdexception, EZINFO("Failed to extract sequence number from " << elems[vsz-1]));
 
-        if( outq->push(chunk_type(filemetadata(elems[vsz-2]+"/"+elems[vsz-1], sz, bsn), b))==false )
+        // Without ranges the whole chunk goes, otherwise each range goes
+        // downstream by itself, saying where it belongs
+        byterangelist_type   ranges( cl.ranges );
+        list<chunk_type>     parts;
+        bool                 pushed = true;
+
+        if( ranges.empty() )
+            ranges.push_back( byterange_type(0, sz) );
+
+        for(byterangelist_type::const_iterator r=ranges.begin(); r!=ranges.end(); r++) {
+            EZASSERT2( r->offset>=0 && r->length>=0 && r->offset+r->length<=sz, FileSizeException,
+                       EZINFO("File '" << file << "' (" << sz << " bytes) does not have range " << r->offset << "+" << r->length) );
+
+            block         b( (size_t)r->length );
+            filemetadata  fmd(elems[vsz-2]+"/"+elems[vsz-1], r->length, bsn);
+
+            // Read in pieces such that the disk can be shared
+            for ( readcounter = 0; readcounter < b.iov_len; readcounter += rv ) {
+                ioslot  slot(cl.mountpoint, ioclass_copy, mraptr->rteptr->name);
+
+                rv = ::pread(fd,
+                             (unsigned char*)b.iov_base + readcounter,
+                             std::min(b.iov_len - readcounter, (size_t)(8*1024*1024)), r->offset + (off_t)readcounter);
+                ASSERT2_POS( rv, SCINFO("failed to read " << file) );
+                slot.done( (uint64_t)rv );
+            }
+            if( !cl.ranges.empty() ) {
+                fmd.rangeOffset = r->offset;
+                fmd.chunkSize   = sz;
+            }
+            parts.push_back( chunk_type(fmd, b) );
+        }
+
+        // Ok, we're done with fd
+        SYNCEXEC(args, mraptr->threadlist[ ::pthread_self() ] = -1);
+
+        ::close(fd);
+
+        for( ; pushed && !parts.empty(); parts.pop_front())
+            pushed = outq->push( parts.front() );
+        if( !pushed )
             break;
         DEBUG(4, "parallelreader[" << ::pthread_self() << "] pushed " << elems[vsz-2] << "/" << elems[vsz-1] << " (" << sz << " bytes)" << endl);
     }
@@ -760,18 +960,107 @@ void parallelreader(outq_type<chunk_type>* outq, sync_type<multifileargs>* args)
 ///////////////////// Parallelsender  ////////////////////
 //////////////////////////////////////////////////////////
 
+chunk_connection::chunk_connection(const networkargs& np, const fdoperations_type& ops):
+    netargs( np ), fdops( ops ), conn( 0 ), nChunk( 0 ), acked( false )
+{}
+
+int chunk_connection::begin(const filemetadata& fmd) {
+    kvmap_type     hdr;
+
+    if( conn==0 ) {
+        int            ipd    = ipd_ns( netargs.netparms );
+        unsigned int   ntries = 0;
+
+        while( conn==0 ) {
+            try {
+                conn = net_client( netargs );
+            }
+            catch( exception const& e ) {
+                EZASSERT2(++ntries<5, cmdexception, EZINFO("parallelsender: " << e.what()));
+                ::sleep( 1 );
+            }
+        }
+
+        if( netargs.netparms.get_protocol().find("tcp")==string::npos ) {
+            EZASSERT2(ipd>=0, cmdexception, EZINFO("An IPD of <0 (" << ipd << ") is unacceptable"));
+            fdops.set_ipd(conn->fd, ipd);
+        }
+    }
+
+    // Make the meta data
+    hdr.set( "fileName",  fmd.fileName );
+    hdr.set( "fileSize",  fmd.fileSize );
+    hdr.set( "keepAlive", 1 );
+    if( fmd.chunkSize>=0 ) {
+        hdr.set( "rangeOffset", fmd.rangeOffset );
+        hdr.set( "chunkSize",   fmd.chunkSize );
+    }
+
+    const string   streamId( hdr.toBinary() );
+
+    // Blurt out the streamId
+    if( fdops.write(conn->fd, streamId.c_str(), (ssize_t)streamId.size(), 0)!=(ssize_t)streamId.size() ) {
+        this->close();
+        THROW_EZEXCEPT(cmdexception, "parallelsender: failed to send header for " << fmd.fileName);
+    }
+    return conn->fd;
+}
+
+bool chunk_connection::end(bool complete) {
+    char    ack;
+    ssize_t rv;
+
+    if( conn==0 )
+        return false;
+    // If the chunk wasn't sent completely the stream is out of sync anyway
+    if( !complete ) {
+        this->close();
+        return false;
+    }
+    // Wait for remote side to acknowledge (or close the sokkit). A receiver
+    // that doesn't do keepAlive closes the connection after it has stored
+    // the chunk, so that's only a failure if this receiver did
+    // acknowledge earlier chunks
+    if( (rv=fdops.read(conn->fd, &ack, 1, 0))!=1 ) {
+        const bool   legacy = (rv==0 && !acked);
+
+        this->close();
+        return legacy;
+    }
+    acked = true;
+    // Hand the receiver back after a while such that senders waiting in
+    // the receiver's listen queue also get their turn
+    if( ack!='\0' || ++nChunk>=maxChunk )
+        this->close();
+    return (ack=='\0');
+}
+
+void chunk_connection::close( void ) {
+    if( conn==0 )
+        return;
+    fdops.close( conn->fd );
+    delete conn;
+    conn   = 0;
+    nChunk = 0;
+    acked  = false;
+}
+
+chunk_connection::~chunk_connection() {
+    this->close();
+}
+
 // Only support TCP and UDT at the moment
 // maybe multinetargs?
 void parallelsender(inq_type<chunk_type>* inq, sync_type<networkargs>* args) {
     // the idea is to pop an item, open a new client connection and blurt
     // out the data
     int                rv;
-    char               dummy[16];
     runtime*           rteptr  = 0;
     chunk_type         chunk;
     const networkargs& np( *args->userdata );
     fdoperations_type  fdops( np.netparms.get_protocol() );
     const bool         is_udt( np.netparms.get_protocol() == "udt" );
+    chunk_connection   cc( np, fdops );
 
     DEBUG(4, "parallelsender[" << ::pthread_self() << "] starting" << endl);
 
@@ -781,80 +1070,239 @@ void parallelsender(inq_type<chunk_type>* inq, sync_type<networkargs>* args) {
     RTEEXEC(*rteptr,
             rteptr->statistics.init(args->stepid, "ParallelSender", 0));
     counter_type&   counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&       loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type&       pktcnt( rteptr->evlbi_stats.pkt_in );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&       loscnt( evlbi.pkt_lost );
+    ucounter_type&       pktcnt( evlbi.pkt_in );
     UDT::TRACEINFO       ti;
 
     // Our main loop!
     while( inq->pop(chunk) ) {
         DEBUG(3, "parallelsender[" << ::pthread_self() << "] processing " << chunk.tag.fileName << endl);
-        // open new connection to wherever we're supposed to send to
-        int            ipd    = ipd_ns( np.netparms );
-        unsigned int   ntries = 0;
-        kvmap_type     hdr;
-        fdreaderargs*  conn = 0;
-        ostringstream  streamIds;
-
-        while( conn==0 ) {
-            try {
-                conn = net_client( np );
-            }
-            catch( exception const& e ) {
-                EZASSERT2(++ntries<5, cmdexception, EZINFO("parallelsender: " << e.what()));
-                ::sleep( 1 );
+        // A chunk the receiver didn't acknowledge is sent once more, over
+        // a new connection. The receiver may have stored it after all so
+        // the second time it goes as a range: written over an existing
+        // copy or created if there is none
+        bool           sent = false;
+
+        for(unsigned int attempt=0; !sent && attempt<2; attempt++) {
+            // (re)use the connection to wherever we're supposed to send to
+            const int      fd = cc.begin( attempt==0 ? chunk.tag : whole_chunk(chunk) );
+            size_t         sz;
+            unsigned char* ptr;
+
+            sz  = chunk.item.iov_len;
+            ptr = (unsigned char*)chunk.item.iov_base;
+            while( sz ) {
+                const ssize_t  n = min((ssize_t)sz, (ssize_t)(2*1024*1024));
+
+                rv = fdops.write(fd, ptr, n, 0);
+
+                if( rv!=n ) {
+                    DEBUG(-1, "Failed to send " << n << " bytes " << chunk.tag.fileName << endl);
+                    break;
+                }
+                ptr += n;
+                sz  -= n;
+                RTEEXEC(*rteptr, counter += n);
+                if( is_udt && UDT::perfmon(fd, &ti, true)==0 ) {
+                    RTEEXEC(*rteptr,
+                            pktcnt += ti.pktSent;
+                            loscnt += ti.pktSndLoss;
+                            evlbi.pkt_retrans += ti.pktRetrans);
+                    rteptr->udt_links.update(fd, ti.msRTT, ti.mbpsSendRate, ti.pktSent, ti.pktSndLoss);
+                }
             }
+            // Ok, wait for remote side to acknowledge (or close the sokkit)
+            DEBUG(3, "parallelsender[" << ::pthread_self() << "] wait for remote" << endl);
+            sent = cc.end( sz==0 );
         }
+        if( !sent )
+            DEBUG(-1, "parallelsender[" << ::pthread_self() << "] " << chunk.tag.fileName << " was not acknowledged, giving up on it" << endl);
 
-        if( np.netparms.get_protocol().find("tcp")==string::npos ) {
-            EZASSERT2(ipd>=0, cmdexception, EZINFO("An IPD of <0 (" << ipd << ") is unacceptable"));
-            fdops.set_ipd(conn->fd, ipd);
-        }
+        // Done! Lose memory resource!
+        chunk.item = block();
+        DEBUG(3, "parallelsender[" << ::pthread_self() << "] done processing " << chunk.tag.fileName << endl);
+    }
+    DEBUG(4, "parallelsender[" << ::pthread_self() << "] done " << byteprint((double)counter, "byte") << endl);
+}
+
+
+//////////////////////////////////////////////////////////
+/////////////////// Parallelfilesender  //////////////////
+//////////////////////////////////////////////////////////
 
-        // Make the meta data
-        hdr.set( "fileName", chunk.tag.fileName );
-        hdr.set( "fileSize", chunk.tag.fileSize );
+// Send at most 'n' bytes from 'fd', starting at '*pos', to the (TCP) socket
+// 'sok'. Where possible the data does not pass through user space. Returns
+// the amount sent, <0 on error.
+static ssize_t send_from_file(int sok, int fd, off_t* pos, size_t n, vector<unsigned char>& buf) {
+#if defined(__linux__)
+    const tracetime_type  t0 = trace_now();
+    const ssize_t         rv = ::sendfile(sok, fd, pos, n);
+
+    trace_complete("sendfile", t0, (rv>0 ? (uint64_t)rv : 0));
+    if( rv>=0 || (errno!=EINVAL && errno!=ENOSYS) )
+        return rv;
+#endif
+    // No zero-copy possible, so the old-fashioned way
+    ssize_t   nr;
+
+    if( buf.empty() )
+        buf.resize( 2*1024*1024 );
+    if( (nr=::pread(fd, &buf[0], std::min(n, buf.size()), *pos))<=0 )
+        return nr;
+    for(ssize_t nw, done=0; done<nr; done+=nw)
+        if( (nw=::write(sok, &buf[0]+done, (size_t)(nr-done)))<=0 )
+            return -1;
+    *pos += nr;
+    return nr;
+}
+
+chunksend_monitor::~chunksend_monitor() {}
+void chunksend_monitor::connection(int) {}
+void chunksend_monitor::sent(off_t) {}
 
-        size_t         sz;
-        const string   streamId( hdr.toBinary() );
-        unsigned char* ptr;
+bool send_chunk_file(const networkargs& np, const fdoperations_type& fdops, const chunk_location& cl,
+                     const string& ioowner, chunksend_monitor* monitor) {
+    chunk_connection   cc( np, fdops );
 
-        // Blurt out the streamId followed by the binary data
-        ASSERT_COND( fdops.write(conn->fd, streamId.c_str(), (ssize_t)streamId.size(), 0)==(ssize_t)streamId.size() );
+    return send_chunk_file(cc, cl, ioowner, monitor);
+}
+
+bool send_chunk_file(chunk_connection& cc, const chunk_location& cl, const string& ioowner, chunksend_monitor* monitor) {
+    const size_t                    sendsz = 2*1024*1024;
+    int                             fd, sok;
+    off_t                           sz, pos = 0;
+    uint32_t                        bsn;
+    chunksend_monitor               nomonitor;
+    vector<unsigned char>           buf;
+    const string                    file( cl.mountpoint + "/" + cl.relative_path );
+    const vector<string>            elems = ::split(file, '/', true);
+    const vector<string>::size_type vsz = elems.size();
+
+    if( monitor==0 )
+        monitor = &nomonitor;
+
+    // Same checks + meta data as parallelreader2 does
+    EZASSERT2(vsz>=3, cmdexception, EZINFO(": " << file << " - file name not consistent; too few '/' characters"));
+    bsn = extract_file_seq_no( elems[vsz-1] );
+    EZASSERT2(bsn!=(uint32_t)-1, cmdexception, EZINFO("Failed to extract sequence number from " << elems[vsz-1]));
+
+    ASSERT2_POS( fd=::open(file.c_str(), O_RDONLY|LARGEFILEFLAG),
+                 SCINFO("failed to open " << file) );
+    try {
+        EZASSERT2((sz=::lseek(fd, 0, SEEK_END))>=0 && sz<=UINT_MAX, FileSizeException,
+                  EZINFO("File '" << file << "' cannot be sized or is too large (" << sz << ")"));
+        for(byterangelist_type::const_iterator r=cl.ranges.begin(); r!=cl.ranges.end(); r++)
+            EZASSERT2(r->offset>=0 && r->length>=0 && r->offset+r->length<=sz, FileSizeException,
+                      EZINFO("File '" << file << "' (" << sz << " bytes) does not have range " << r->offset << "+" << r->length));
+    }
+    catch( ... ) {
+        ::close(fd);
+        throw;
+    }
+    // Without ranges we send the whole chunk, otherwise each range is sent
+    // as a message of its own that says where it goes
+    byterangelist_type   ranges( cl.ranges );
 
-        sz  = chunk.item.iov_len;
-        ptr = (unsigned char*)chunk.item.iov_base;
-        while( sz ) {
-            const ssize_t  n = min((ssize_t)sz, (ssize_t)(2*1024*1024));
+    if( ranges.empty() )
+        ranges.push_back( byterange_type(0, sz) );
 
-            rv = fdops.write(conn->fd, ptr, n, 0);
+    bool    ok = true;
+    for(byterangelist_type::const_iterator r=ranges.begin(); ok && r!=ranges.end(); r++) {
+        const off_t   end = r->offset + r->length;
+        filemetadata  fmd(elems[vsz-2]+"/"+elems[vsz-1], r->length, bsn);
 
-            if( rv!=n ) {
-                DEBUG(-1, "Failed to send " << n << " bytes " << chunk.tag.fileName << endl);
-                break;
+        if( !cl.ranges.empty() ) {
+            fmd.rangeOffset = r->offset;
+            fmd.chunkSize   = sz;
+        }
+        pos = r->offset;
+#if defined(__linux__)
+        ::posix_fadvise(fd, pos, r->length, POSIX_FADV_SEQUENTIAL);
+#endif
+        try {
+            sok = cc.begin( fmd );
+        }
+        catch( ... ) {
+            ::close(fd);
+            throw;
+        }
+        monitor->connection( sok );
+
+        while( pos<end ) {
+            const size_t   n2s = (size_t)std::min((off_t)sendsz, end-pos);
+
+            // Only the disk read is scheduled, not the time the receiver
+            // takes to accept the data: under the slot the kernel is asked
+            // to start reading the piece into the page cache
+            {
+                ioslot         slot(cl.mountpoint, ioclass_copy, ioowner);
+#if defined(__linux__)
+                ::posix_fadvise(fd, pos, (off_t)n2s, POSIX_FADV_WILLNEED);
+#endif
+                slot.done( (uint64_t)n2s );
             }
-            ptr += n;
-            sz  -= n;
-            RTEEXEC(*rteptr, counter += n);
-            if( is_udt && UDT::perfmon(conn->fd, &ti, true)==0 ) {
-                RTEEXEC(*rteptr,
-                        pktcnt += ti.pktSent;
-                        loscnt += ti.pktSndLoss);
+            const ssize_t  n = send_from_file(sok, fd, &pos, n2s, buf);
+
+            if( n<=0 ) {
+                DEBUG(-1, "send_chunk_file: failed to send " << file << " @" << pos << " - " << evlbi5a::strerror(errno) << endl);
+                break;
             }
+            monitor->sent( n );
         }
-        // Ok, wait for remote side to acknowledge (or close the sokkit)
-        // The read fails anyway even if the remote side did send something
-        // (using UDT). The UDT lib is krappy!
-        DEBUG(3, "parallelsender[" << ::pthread_self() << "] wait for remote" << endl);
-        fdops.read(conn->fd, &dummy[0], 16, 0);
-
-        DEBUG(3, "parallelsender[" << ::pthread_self() << "] closing file" << endl);
-        // Done! Close file and lose memory resource!
-        fdops.close( conn->fd );
-        chunk.item = block();
-        delete conn;
-        DEBUG(3, "parallelsender[" << ::pthread_self() << "] done processing " << chunk.tag.fileName << endl);
+        ok = (pos==end);
+
+        // end() may close the socket, after which its number may be
+        // reused; the monitor must not shut it down anymore
+        monitor->connection( -1 );
+
+        // Wait for remote side to acknowledge (or close the sokkit)
+        DEBUG(3, "send_chunk_file[" << ::pthread_self() << "] wait for remote" << endl);
+        ok = cc.end( ok );
     }
-    DEBUG(4, "parallelsender[" << ::pthread_self() << "] done " << byteprint((double)counter, "byte") << endl);
+    ::close(fd);
+    return ok;
+}
+
+// parallelfilesender counts the bytes in the runtime's statistics
+struct stepcounter_monitor: public chunksend_monitor {
+    runtime*       rteptr;
+    counter_type&  counter;
+
+    stepcounter_monitor(runtime* r, counter_type& c):
+        rteptr( r ), counter( c )
+    {}
+    virtual void sent(off_t n) {
+        RTEEXEC(*rteptr, counter += n);
+    }
+};
+
+void parallelfilesender(inq_type<chunk_location>* inq, sync_type<networkargs>* args) {
+    runtime*           rteptr  = 0;
+    chunk_location     cl;
+    const networkargs& np( *args->userdata );
+    fdoperations_type  fdops( np.netparms.get_protocol() );
+
+    DEBUG(4, "parallelfilesender[" << ::pthread_self() << "] starting" << endl);
+
+    EZASSERT2_NZERO((rteptr = np.rteptr), cmdexception, EZINFO("null-pointer for runtime?"));
+    EZASSERT2(np.netparms.get_protocol()=="tcp", cmdexception, EZINFO("parallelfilesender only does tcp"));
+
+    RTEEXEC(*rteptr,
+            rteptr->statistics.init(args->stepid, "ParallelFileSender", 0));
+    counter_type&       counter( rteptr->statistics.counter(args->stepid) );
+    stepcounter_monitor monitor( rteptr, counter );
+    chunk_connection    cc( np, fdops );
+
+    while( inq->pop(cl) ) {
+        DEBUG(3, "parallelfilesender[" << ::pthread_self() << "] processing " << cl.relative_path << endl);
+        // Like parallelsender, try once more if it didn't make it
+        if( !send_chunk_file(cc, cl, rteptr->name, &monitor) &&
+            !send_chunk_file(cc, (cl.ranges.empty() ? whole_chunk(cl) : cl), rteptr->name, &monitor) )
+            DEBUG(-1, "parallelfilesender[" << ::pthread_self() << "] failed to send " << cl.relative_path << ", giving up on it" << endl);
+        DEBUG(3, "parallelfilesender[" << ::pthread_self() << "] done processing " << cl.relative_path << endl);
+    }
+    DEBUG(4, "parallelfilesender[" << ::pthread_self() << "] done " << byteprint((double)counter, "byte") << endl);
 }
 
 
@@ -904,8 +1352,9 @@ void parallelnetreader(outq_type<chunk_type>* outq, sync_type<multinetargs>* arg
     RTEEXEC(*rteptr,
             rteptr->statistics.init(args->stepid, "ParallelNetReader", 0));
     counter_type&   counter( rteptr->statistics.counter(args->stepid) );
-    ucounter_type&       loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type&       pktcnt( rteptr->evlbi_stats.pkt_in );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type&       loscnt( evlbi.pkt_lost );
+    ucounter_type&       pktcnt( evlbi.pkt_in );
     UDT::TRACEINFO       ti;
 
     // Do an accept on the server, read meta data - chunk # and chunk size,
@@ -935,169 +1384,254 @@ void parallelnetreader(outq_type<chunk_type>* outq, sync_type<multinetargs>* arg
 
             DEBUG(3, "parallelnetreader[" << ::pthread_self() << "] incoming fd#" << incoming->first << " (" << incoming->second << ")" << endl);
 
-            // First read the metadata:
-            id_values.fromBinary( read_itcp_header(incoming->first, fdops) );
-
-            // Assert we have the correct ones
-            nmptr = id_values.find("fileName");
-            szptr = id_values.find("fileSize");
-            rqptr = id_values.find("requestRsync");
-            psptr = id_values.find("payloadSize");
-
-            // We must have either nmptr/szptr or rsync/payload, nothing else
-            const bool   conds[4] = { nmptr!=id_values.end(), szptr!=id_values.end(),
-                                      rqptr!=id_values.end(), psptr!=id_values.end() };
-
-            EZASSERT2( (conds[0] && conds[1] && !(conds[2] || conds[3])) ||
-                       (conds[2] && conds[3] && !(conds[0] || conds[1])),
-                       cmdexception, EZINFO("Inconsistent request!") )
-
-            //
-            //   Two major modes of operation, depending on what 'message'
-            //   came in
-            //      nmptr + szptr?  => someone sending a file chunk
-            //                         suck socket empty and blast to disk
-            //      rqptr + psptr?  => someone sending a "request for rsync"
-            //                         compile list of files we already have
-            //                         and send diff list (the shortest one)
-            //
-            if( conds[0] ) {
-                int             rv;
-                uint32_t        n2read;
-                unsigned char*  ptr;
-                // Major mode 1: someone sent a chunk
-                EZASSERT2( ::sscanf(szptr->second.c_str(), "%" SCNu32, &sz)==1, cmdexception,
-                           EZINFO("Failed to parse file size from meta data '" << szptr->second << "'") );
-
-                DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] " << nmptr->second << " (" << szptr->second << " bytes)" << endl);
-
-                // Now it's about time to start reading the file's contents
-#if 0
-                // Messing with the memory pool might be better done
-                // by one thread at a time ...
-                SYNCEXEC(args,
-                    // Look up size in mempool and get a block
-                    mempoolptr = mnaptr->mempool.find( sz );
-
-                    if( mempoolptr==mnaptr->mempool.end() ) 
-                        mempoolptr = mnaptr->mempool.insert(
-                            make_pair(sz,
-                                      new blockpool_type((unsigned int)sz,
-                                                         std::max((unsigned int)1, (unsigned int)(1.0e9/sz)))
-                                      )).first;
-                    );
-                b = mempoolptr->second->get();
-#endif
-                block    b( (size_t)sz );
+            // A sender may ask to keep the connection for more chunks
+            bool    keepalive = false, eof = false;
+            do {
+                // First read the metadata:
+                const string  meta( read_itcp_header(incoming->first, fdops, (keepalive ? &eof : 0)) );
 
-                ptr    = (unsigned char*)b.iov_base;
-                n2read = sz;
-                while( n2read ) {
-                    const ssize_t  n = min((ssize_t)n2read, (ssize_t)(2*1024*1024));
+                // On a connection that is kept alive, the sender closing it
+                // in between chunks is the normal end
+                if( eof )
+                    break;
+                id_values.fromBinary( meta );
 
-                    rv = fdops.read(incoming->first, ptr, n, 0);
+                // Assert we have the correct ones
+                nmptr = id_values.find("fileName");
+                szptr = id_values.find("fileSize");
+                rqptr = id_values.find("requestRsync");
+                psptr = id_values.find("payloadSize");
+                keepalive = (id_values.find("keepAlive")!=id_values.end());
 
-                    if( rv!=n ) {
-                        DEBUG(-1, "parallelnetreader[" << ::pthread_self() << "] " << nmptr->second << " failed to read " << n << " bytes after " << (sz-n2read) << " bytes" << endl);
-                        break;
+                // We must have either nmptr/szptr or rsync/payload, nothing else
+                const bool   conds[4] = { nmptr!=id_values.end(), szptr!=id_values.end(),
+                                          rqptr!=id_values.end(), psptr!=id_values.end() };
+
+                EZASSERT2( (conds[0] && conds[1] && !(conds[2] || conds[3])) ||
+                           (conds[2] && conds[3] && !(conds[0] || conds[1])),
+                           cmdexception, EZINFO("Inconsistent request!") )
+
+                //
+                //   Two major modes of operation, depending on what 'message'
+                //   came in
+                //      nmptr + szptr?  => someone sending a file chunk
+                //                         suck socket empty and blast to disk
+                //      rqptr + psptr?  => someone sending a "request for rsync"
+                //                         compile list of files we already have
+                //                         and send diff list (the shortest one)
+                //
+                if( conds[0] ) {
+                    int             rv;
+                    uint32_t        n2read;
+                    unsigned char*  ptr;
+                    off_t           rangeOffset = 0, chunkSize = -1;
+                    // Major mode 1: someone sent a chunk
+                    EZASSERT2( ::sscanf(szptr->second.c_str(), "%" SCNu32, &sz)==1, cmdexception,
+                               EZINFO("Failed to parse file size from meta data '" << szptr->second << "'") );
+
+                    // A part of a chunk (rsync resume) says where it goes
+                    kvmap_type::const_iterator  roptr = id_values.find("rangeOffset");
+                    kvmap_type::const_iterator  csptr = id_values.find("chunkSize");
+
+                    if( roptr!=id_values.end() && csptr!=id_values.end() ) {
+                        int64_t   ro, cs;
+
+                        EZASSERT2( ::sscanf(roptr->second.c_str(), "%" SCNd64, &ro)==1 &&
+                                   ::sscanf(csptr->second.c_str(), "%" SCNd64, &cs)==1 &&
+                                   ro>=0 && ro+(int64_t)sz<=cs, cmdexception,
+                                   EZINFO("Inconsistent range " << roptr->second << "+" << sz << " of chunk of " << csptr->second << " bytes") );
+                        rangeOffset = (off_t)ro;
+                        chunkSize   = (off_t)cs;
                     }
-                    ptr    += n;
-                    n2read -= n;
-                    RTEEXEC(*rteptr, counter += n);
-                    if( is_udt && UDT::perfmon(incoming->first, &ti, true)==0 ) {
-                        RTEEXEC(*rteptr,
-                                pktcnt += ti.pktRecv;
-                                loscnt += ti.pktRcvLoss);
+
+                    DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] " << nmptr->second << " (" << szptr->second << " bytes)" << endl);
+
+                    // Now it's about time to start reading the file's contents
+    #if 0
+                    // Messing with the memory pool might be better done
+                    // by one thread at a time ...
+                    SYNCEXEC(args,
+                        // Look up size in mempool and get a block
+                        mempoolptr = mnaptr->mempool.find( sz );
+
+                        if( mempoolptr==mnaptr->mempool.end() ) 
+                            mempoolptr = mnaptr->mempool.insert(
+                                make_pair(sz,
+                                          new blockpool_type((unsigned int)sz,
+                                                             std::max((unsigned int)1, (unsigned int)(1.0e9/sz)))
+                                          )).first;
+                        );
+                    b = mempoolptr->second->get();
+    #endif
+                    block    b( (size_t)sz );
+
+                    ptr    = (unsigned char*)b.iov_base;
+                    n2read = sz;
+                    while( n2read ) {
+                        const ssize_t  n = min((ssize_t)n2read, (ssize_t)(2*1024*1024));
+
+                        rv = fdops.read(incoming->first, ptr, n, 0);
+
+                        if( rv!=n ) {
+                            DEBUG(-1, "parallelnetreader[" << ::pthread_self() << "] " << nmptr->second << " failed to read " << n << " bytes after " << (sz-n2read) << " bytes" << endl);
+                            break;
+                        }
+                        ptr    += n;
+                        n2read -= n;
+                        RTEEXEC(*rteptr, counter += n);
+                        if( is_udt && UDT::perfmon(incoming->first, &ti, true)==0 ) {
+                            RTEEXEC(*rteptr,
+                                    pktcnt += ti.pktRecv;
+                                    loscnt += ti.pktRcvLoss);
+                            rteptr->udt_links.update(incoming->first, ti.msRTT, ti.mbpsRecvRate, ti.pktRecv, ti.pktRcvLoss);
+                        }
                     }
-                }
 
-                // Failure to push implies we should stop!
-                // As does failure to read the whole chunk
-                uint32_t    bsn = extract_file_seq_no(nmptr->second);
-                EZASSERT2(bsn!=(uint32_t)-1, cmdexception, EZINFO(" Failed to extract sequence number from " << nmptr->second));
+                    // Failure to push implies we should stop!
+                    // As does failure to read the whole chunk
+                    uint32_t    bsn = extract_file_seq_no(nmptr->second);
+                    EZASSERT2(bsn!=(uint32_t)-1, cmdexception, EZINFO(" Failed to extract sequence number from " << nmptr->second));
 
-                if( n2read || outq->push( chunk_type(filemetadata(nmptr->second, (off_t)b.iov_len, bsn), b) )==false )
-                    done = true;
+                    filemetadata    fmd(nmptr->second, (off_t)b.iov_len, bsn);
 
-                // already release our refcount on the block
-                b = block();
+                    fmd.rangeOffset = rangeOffset;
+                    fmd.chunkSize   = chunkSize;
+                    if( n2read || outq->push( chunk_type(fmd, b) )==false )
+                        done = true;
 
-                //
-                //  End of Major mode 1/file chunk
-                //
-            } else {
-                //  Major mode 2: rsync request
-                char        dummy;
-
-                EZASSERT2( ::sscanf(psptr->second.c_str(), "%" SCNu32, &sz)==1, cmdexception,
-                           EZINFO("Failed to parse size from meta data '" << psptr->second << "'") );
-
-                DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] rsync request '" << rqptr->second << "' (" << psptr->second << " bytes payload)" << endl);
-
-                auto_array<char> flist( new char[sz] );
-                ASSERT_COND( fdops.read(incoming->first, &flist[0], (size_t)sz)==(ssize_t)sz );
-
-                // Create a file list from what we received
-                vector<string>           remote_lst = ::split(string(&flist[0], sz), '\0', true);
-                //set<string>      remote_set(remote_lst.begin(), remote_lst.end());
-                chunklist_type           fl = get_chunklist( rqptr->second, rteptr->mk6info.mountpoints );
-                set<string>              local_set;
-                vector<string>           have, have_not;
-
-                // Create the set of local files
-                for( chunklist_type::const_iterator fptr=fl.begin(); fptr!=fl.end(); fptr++ ) 
-                    local_set.insert( fptr->relative_path );
-
-                DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] rsync request / remote list length " << remote_lst.size() << endl);
-                DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] rsync request / find " << local_set.size() << " files local" << endl);
-
-                // Have to fucking brute force this!
-                inset<set<string> >      have_local(local_set);
-                vector<string>::iterator f, l;
-
-                for(vector<string>::iterator ptr=remote_lst.begin(); ptr!=remote_lst.end(); ptr++)
-                    if( have_local(*ptr) )
-                        have.push_back(*ptr);
-                    else
-                        have_not.push_back(*ptr);
-
-                // already clear out the meta data header
-                id_values.clear();
-
-                if( have.size()<have_not.size() ) {
-                    // We have less files than we need. Set the list
-                    // boundaries (of the file names we must transfer) and
-                    // indicate that these are the files we HAVE
-                    f = have.begin();
-                    l = have.end();
-                    id_values.set( "listType", "have" );
+                    // Tell a sender that knows about keepAlive wether we
+                    // have it. A non-zero byte means it wasn't stored; the
+                    // connection is closed after that
+                    if( keepalive ) {
+                        const char  ack = (done ? '\1' : '\0');
+                        keepalive = (fdops.write(incoming->first, &ack, 1)==1);
+                    }
+
+                    // already release our refcount on the block
+                    b = block();
+
+                    //
+                    //  End of Major mode 1/file chunk
+                    //
                 } else {
-                    // Ok we need to transfer the list of files we *need*
-                    f = have_not.begin();
-                    l = have_not.end();
-                    id_values.set( "listType", "need" );
-                }
+                    //  Major mode 2: rsync request
+                    char        dummy;
+
+                    EZASSERT2( ::sscanf(psptr->second.c_str(), "%" SCNu32, &sz)==1, cmdexception,
+                               EZINFO("Failed to parse size from meta data '" << psptr->second << "'") );
+
+                    DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] rsync request '" << rqptr->second << "' (" << psptr->second << " bytes payload)" << endl);
+
+                    auto_array<char> flist( new char[sz] );
+                    ASSERT_COND( fdops.read(incoming->first, &flist[0], (size_t)sz)==(ssize_t)sz );
+
+                    // Create a file list from what we received
+                    vector<string>           remote_lst = ::split(string(&flist[0], sz), '\0', true);
+                    //set<string>      remote_set(remote_lst.begin(), remote_lst.end());
+                    chunklist_type           fl = get_chunklist( rqptr->second, rteptr->mk6info.mountpoints );
+                    set<string>              local_set;
+                    map<string, string>      local_mp;
+                    vector<string>           have, have_not;
+                    int64_t                  rangeSize = 0;
+                    kvmap_type::iterator     rsptr = id_values.find("rangeSize");
+
+                    // Create the set of local files
+                    for( chunklist_type::const_iterator fptr=fl.begin(); fptr!=fl.end(); fptr++ ) {
+                        local_set.insert( fptr->relative_path );
+                        local_mp[ fptr->relative_path ] = fptr->mountpoint;
+                    }
+
+                    // Newer initiators want the digests of the chunks we
+                    // have, such that they only send what's missing.
+                    // Unreasonably small ranges are not honoured. Only
+                    // digests stored with the chunks are sent: computing
+                    // them means reading all of our chunks before the
+                    // initiator times out waiting for the reply. Of the
+                    // chunks we have no digest for only the size is sent.
+                    if( rsptr!=id_values.end() &&
+                        (::sscanf(rsptr->second.c_str(), "%" SCNd64, &rangeSize)!=1 || rangeSize<64*1024) ) {
+                        DEBUG(-1, "parallelnetreader[" << ::pthread_self() << "] rsync request / ignoring range size '" << rsptr->second << "'" << endl);
+                        rangeSize = 0;
+                    }
 
-                // Now we can construct the message payload
-                ostringstream   os;
+                    DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] rsync request / remote list length " << remote_lst.size() << endl);
+                    DEBUG(4, "parallelnetreader[" << ::pthread_self() << "] rsync request / find " << local_set.size() << " files local" << endl);
+
+                    // Have to fucking brute force this!
+                    inset<set<string> >      have_local(local_set);
+                    vector<string>::iterator f, l;
+
+                    for(vector<string>::iterator ptr=remote_lst.begin(); ptr!=remote_lst.end(); ptr++)
+                        if( have_local(*ptr) )
+                            have.push_back(*ptr);
+                        else
+                            have_not.push_back(*ptr);
+
+                    // already clear out the meta data header
+                    id_values.clear();
+
+                    if( have.size()<have_not.size() ) {
+                        // We have less files than we need. Set the list
+                        // boundaries (of the file names we must transfer) and
+                        // indicate that these are the files we HAVE
+                        f = have.begin();
+                        l = have.end();
+                        id_values.set( "listType", "have" );
+                    } else {
+                        // Ok we need to transfer the list of files we *need*
+                        f = have_not.begin();
+                        l = have_not.end();
+                        id_values.set( "listType", "need" );
+                    }
 
-                for(vector<string>::iterator p=f; p!=l; p++)
-                    os << *p << '\0';
-                const string    pay = os.str();
+                    // Now we can construct the message payload
+                    ostringstream   os;
 
-                // Set the payload size in the message header
-                id_values.set( "rsyncReplySz", pay.size() );
+                    for(vector<string>::iterator p=f; p!=l; p++)
+                        os << *p << '\0';
+                    const string    pay = os.str();
 
-                // Now we can send back the full message, header first, then
-                // payload
-                const string    hdr = id_values.toBinary();
-                fdops.write(incoming->first, hdr.c_str(), hdr.size());
-                fdops.write(incoming->first, pay.c_str(), pay.size());
+                    // Set the payload size in the message header
+                    id_values.set( "rsyncReplySz", pay.size() );
 
-                // Do a dummy read - keep the sokkit open until remote end
-                // has had a chance to read all the dataz
-                fdops.read(incoming->first, &dummy, 1);
-            }
+                    // The digests of what we have go after the list
+                    ostringstream   info;
+
+                    if( rangeSize>0 ) {
+                        chunkdigest_type  cd;
+
+                        for(vector<string>::const_iterator p=have.begin(); p!=have.end(); p++) {
+                            const string  path( local_mp[*p] + "/" + *p );
+                            struct stat   st;
+
+                            if( !chunkdigest_peek(path, (off_t)rangeSize, cd) ) {
+                                if( ::stat(path.c_str(), &st)!=0 )
+                                    continue;
+                                cd           = chunkdigest_type();
+                                cd.rangeSize = (off_t)rangeSize;
+                                cd.size      = st.st_size;
+                            }
+                            info << *p << '\0' << cd.toString() << '\0';
+                        }
+                        id_values.set( "chunkInfoSz", info.str().size() );
+                    }
+                    const string    info_s = info.str();
+
+                    // Now we can send back the full message, header first, then
+                    // payload
+                    const string    hdr = id_values.toBinary();
+                    fdops.write(incoming->first, hdr.c_str(), hdr.size());
+                    fdops.write(incoming->first, pay.c_str(), pay.size());
+                    if( !info_s.empty() )
+                        fdops.write(incoming->first, info_s.c_str(), info_s.size());
+
+                    // Do a dummy read - keep the sokkit open until remote end
+                    // has had a chance to read all the dataz
+                    fdops.read(incoming->first, &dummy, 1);
+                }
+
+                SYNCEXEC(args, done = (done || args->cancelled));
+            } while( keepalive && !done );
 
             // Ok we're done with this filedescriptor, go back to monitoring
             // network->fd
@@ -1217,8 +1751,183 @@ int mkpath(const char* file_path_in, mode_t mode) {
               msg << \
               "  removing it from list!" << endl << \
               "#################################################" << endl) ; \
-    SYNCEXEC(args, mfaptr->listlength -= 1; args->cond_broadcast());
+    SYNCEXEC(args, mfaptr->listlength -= 1; \
+                   mfaptr->diskhealth[mountpoint].state = diskhealth_type::bad; \
+                   args->cond_broadcast());
+
+
+// Tuning of the mountpoint selection (see diskhealth_type):
+//   moving average of the write latency: new = (1-w) * old + w * latest
+static const double        latencyWeight   = 0.25;
+//   disks with average latency <= slowFactor * typical are preferred
+static const double        slowFactor      = 2.0;
+//   a write with latency > spikeFactor * typical quarantines the disk
+static const double        spikeFactor     = 5.0;
+static const double        quarantineTime  = 30.0;
+//   no judging until this many disks have been written to
+static const unsigned int  minDisksJudged  = 3;
+//   a disk is full if it can't hold this many chunks more
+static const uint64_t      minChunksFree   = 4;
+
+// The typical (median) average write latency of the disks in use, 0 if
+// it can't be determined yet
+static double typical_latency(const diskhealthmap_type& dhm) {
+    vector<double>  latencies;
+
+    for(diskhealthmap_type::const_iterator p=dhm.begin(); p!=dhm.end(); p++)
+        if( p->second.state==diskhealth_type::ok && p->second.nSample>0 )
+            latencies.push_back( p->second.avgLatency );
+    if( latencies.size()<minDisksJudged )
+        return 0.0;
+    std::nth_element(latencies.begin(), latencies.begin()+latencies.size()/2, latencies.end());
+    return latencies[ latencies.size()/2 ];
+}
+
+// Any mountpoint left that this chunk was not yet tried on?
+static bool have_untried(const multifileargs& mfa, const set<string>& tried) {
+    for(diskhealthmap_type::const_iterator p=mfa.diskhealth.begin(); p!=mfa.diskhealth.end(); p++)
+        if( (p->second.state==diskhealth_type::ok || p->second.state==diskhealth_type::quarantined) &&
+            tried.find(p->first)==tried.end() )
+            return true;
+    return false;
+}
+
+// Take the mountpoint to write the next chunk to from the ones currently
+// available, or return "" if none is suitable (yet). Must be called with
+// the lock held.
+static string select_mountpoint(multifileargs& mfa, const set<string>& tried) {
+    unsigned int                nHealthy = 0;
+    const double                typical = typical_latency(mfa.diskhealth);
+    const pcint::timeval_type   now( pcint::timeval_type::now() );
+    filelist_type::iterator     preferred = mfa.filelist.end(), usable = mfa.filelist.end(), quarantined = mfa.filelist.end();
+
+    // Quarantines that are over give the disk a fresh start
+    for(diskhealthmap_type::iterator p=mfa.diskhealth.begin(); p!=mfa.diskhealth.end(); p++) {
+        diskhealth_type&  dh = p->second;
+
+        if( dh.state==diskhealth_type::quarantined && !(now<dh.quarantineEnd) ) {
+            DEBUG(2, "parallelwriter: " << p->first << " out of quarantine" << endl);
+            dh.state      = diskhealth_type::ok;
+            dh.nSample    = 0;
+            dh.avgLatency = 0.0;
+        }
+        if( dh.state==diskhealth_type::ok )
+            nHealthy++;
+    }
+
+    for(filelist_type::iterator p=mfa.filelist.begin(); p!=mfa.filelist.end(); p++) {
+        if( tried.find(*p)!=tried.end() )
+            continue;
+        diskhealth_type&  dh = mfa.diskhealth[ *p ];
+
+        if( dh.state==diskhealth_type::quarantined ) {
+            if( quarantined==mfa.filelist.end() )
+                quarantined = p;
+            continue;
+        }
+        if( usable==mfa.filelist.end() )
+            usable = p;
+        if( dh.nSample==0 || typical<=0.0 || dh.avgLatency<=slowFactor*typical ) {
+            preferred = p;
+            break;
+        }
+        // A slow disk that's passed over gradually regains trust such
+        // that it will be tried again
+        dh.avgLatency = std::max(typical, 0.9*dh.avgLatency);
+    }
+
+    filelist_type::iterator  chosen = (preferred!=mfa.filelist.end() ? preferred : usable);
+
+    if( chosen==mfa.filelist.end() && nHealthy==0 )
+        chosen = quarantined;
+    if( chosen==mfa.filelist.end() )
+        return string();
+
+    const string  mountpoint( *chosen );
+    mfa.filelist.erase( chosen );
+    return mountpoint;
+}
+
+// Account a succesful write of 'nbyte' bytes in 'dt' seconds to
+// 'mountpoint', which has 'freeBytes' left after that. Returns false if
+// the disk should not be written to anymore. Must be called with the lock
+// held.
+static bool update_diskhealth(multifileargs& mfa, const string& mountpoint, uint64_t nbyte, double dt, uint64_t freeBytes) {
+    const double      typical = typical_latency(mfa.diskhealth);
+    const double      latency = (nbyte>0 ? dt/((double)nbyte/1.0e6) : 0.0);
+    diskhealth_type&  dh = mfa.diskhealth[ mountpoint ];
+
+    dh.nChunk++;
+    dh.nByte      += nbyte;
+    dh.lastLatency = latency;
+    dh.freeBytes   = freeBytes;
+    dh.avgLatency  = (dh.nSample==0 ? latency : (1.0-latencyWeight)*dh.avgLatency + latencyWeight*latency);
+    dh.nSample++;
+
+    if( freeBytes<minChunksFree*nbyte ) {
+        DEBUG(-1, "parallelwriter: " << mountpoint << " is (almost) full, " << byteprint((double)freeBytes, "byte")
+                  << " left - removing it from list" << endl);
+        dh.state = diskhealth_type::full;
+        return false;
+    }
+    if( dh.state==diskhealth_type::ok && typical>0.0 && latency>spikeFactor*typical ) {
+        DEBUG(-1, "parallelwriter: " << mountpoint << " wrote at " << 1.0/latency << "MB/s, typical is "
+                  << 1.0/typical << "MB/s - quarantined for " << quarantineTime << "s" << endl);
+        dh.state         = diskhealth_type::quarantined;
+        dh.quarantineEnd = pcint::timeval_type::now() + quarantineTime;
+        dh.nQuarantine++;
+    }
+    return true;
+}
+
 
+// Write a part of a chunk (rsync resume) into that chunk, on whichever
+// mountpoint it is. 'found' tells wether it is on any of them at all.
+// Afterwards the chunk's stored digest is brought up to date. Parts of
+// the same chunk may arrive over different connections so the file is
+// locked whilst writing and digesting.
+static bool write_chunk_range(const chunk_type& chunk, const mountpointlist_type& mps, const string& ioowner, bool& found) {
+    found = false;
+    for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+        int                  fd;
+        bool                 ok;
+        ssize_t              nw = 0;
+        const string         fn = *mp + "/" + chunk.tag.fileName;
+        const unsigned char* ptr = (const unsigned char*)chunk.item.iov_base;
+
+        if( (fd=::open(fn.c_str(), O_RDWR|LARGEFILEFLAG))<0 && errno==ENOENT )
+            continue;
+        found = true;
+        if( fd<0 ) {
+            DEBUG(-1, "write_chunk_range: failed to open " << fn << " - " << evlbi5a::strerror(errno) << endl);
+            return false;
+        }
+        if( ::flock(fd, LOCK_EX)!=0 )
+            DEBUG(-1, "write_chunk_range: failed to lock " << fn << " - " << evlbi5a::strerror(errno) << endl);
+
+        ioslot            slot(*mp, ioclass_record, ioowner);
+        size_t            done = 0;
+        chunkdigest_type  before;
+
+        if( !chunkdigest_load(fd, before) )
+            before = chunkdigest_type();
+
+        ok = (::ftruncate(fd, chunk.tag.chunkSize)==0);
+        for( ; ok && done<chunk.item.iov_len; done+=(size_t)nw)
+            ok = ((nw=::pwrite(fd, ptr+done, chunk.item.iov_len-done, chunk.tag.rangeOffset+(off_t)done))>0);
+        slot.done( (uint64_t)done );
+        if( ok )
+            chunkdigest_update(fd, before, chunk.tag.rangeOffset, (off_t)chunk.item.iov_len);
+        else
+            DEBUG(-1, "write_chunk_range: failed to write " << chunk.item.iov_len << " bytes @" << chunk.tag.rangeOffset
+                      << " to " << fn << " - " << evlbi5a::strerror(errno) << endl);
+        ::close( fd );
+        if( ok )
+            ::catalog_chunk_written(*mp, chunk.tag.fileName, (uint64_t)chunk.tag.chunkSize);
+        return ok;
+    }
+    return false;
+}
 
 void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
     // pop from the queue, then take a directory from the file list [the
@@ -1237,54 +1946,49 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
 
         // 'mp_seen' keeps track of which mountpoints we've seen. 
 
+        // Part of a chunk we already have? Then it goes into that one. If
+        // we don't have it and it's the whole chunk anyway, it is written
+        // as any other.
+        if( chunk.tag.chunkSize>=0 && !mk6 ) {
+            bool  found;
+
+            DEBUG(4, "parallelwriter[" << ::pthread_self() << "] need to write " << chunk.tag.fileName << " @" << chunk.tag.rangeOffset
+                     << ", " << chunk.item.iov_len << " bytes" << endl);
+            if( write_chunk_range(chunk, mfaptr->rteptr->mk6info.mountpoints, mfaptr->rteptr->name, found) )
+                continue;
+            if( found ) {
+                DEBUG(-1, "    parallelwriter[" << ::pthread_self() << "] did not write range of " << chunk.tag.fileName << endl);
+                break;
+            }
+            if( chunk.tag.rangeOffset!=0 || chunk.tag.fileSize!=chunk.tag.chunkSize ) {
+                DEBUG(-1, "    parallelwriter[" << ::pthread_self() << "] " << chunk.tag.fileName << " not found, range @"
+                          << chunk.tag.rangeOffset << " discarded" << endl);
+                continue;
+            }
+        }
+
         DEBUG(4, "parallelwriter[" << ::pthread_self() << "] need to write " << chunk.tag.fileName << ", " << chunk.item.iov_len << " bytes (" << hex_t(chunk.item.iov_len) << ")" << endl);
         // Stay in while loop over mount points until we succeed in flushing
         // the data to disk.
         // Note to self: MAKE SURE NOT TO THROW INSIDE OF THIS LOOP!
         //               (We must put back the mountpoint right?!)
         while( !written ) {
-            size_t    listlength = 0;
             string    mountpoint;
 
-            // We need to wait for the filelist (i.e. mount point-list) to
-            // become non-empty so 's we can pop an entry from it
+            // We need to wait for a suitable mount point to become
+            // available (see select_mountpoint()), as long as there are
+            // mount points left that we haven't tried this chunk on yet
+            // [other threads may still be busy writing to them].
             args->lock();
-
-            while( (listlength=mfaptr->listlength)>0 && mfaptr->filelist.empty() )
+            while( mfaptr->listlength>0 && have_untried(*mfaptr, mp_seen) &&
+                   (mountpoint=select_mountpoint(*mfaptr, mp_seen)).empty() )
                 args->cond_wait();
-
-            if( mfaptr->filelist.size()>0 ) {
-                mountpoint = mfaptr->filelist.front();
-                mfaptr->filelist.pop_front();
-            }
             args->unlock();
 
             // If we were unsuccesfull in getting a mount point
             // there's very little we can do
             if( mountpoint.empty() )
                 break;
-
-            // Check if we already tried this mount point and decide
-            // wether to wait for another one
-            if( mp_seen.find(mountpoint)!=mp_seen.end() ) {
-                // We've seen this one before.
-                // If the size of our set >= the theoretical length of the list
-                // we've seen ALL of the mount points
-                //
-                // [the 'theoretical list length' - "listlength", not
-                // the current list length; other threads may still be
-                // busy writing to another mount point]
-                // 
-                // If we haven't seen all of the mount points yet
-                // we may continue.
-                // In both cases we return the mount point to the stack of
-                // mount points.
-                SYNCEXEC(args, mfaptr->filelist.push_back(mountpoint); args->cond_signal());
-                if( mp_seen.size()>=listlength )
-                    break;
-                else
-                    continue;
-            }
             mp_seen.insert( mountpoint );
 
             // Ok, we have location to write to
@@ -1334,41 +2038,63 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
             }
 
             // Ok, we have an open file descriptor - do write Mark6 block header, if we need to
+            // If the reader left room for it in front of the data, the
+            // header goes there and header + data are written in one go.
+            // Otherwise it needs a write of its own.
+            char*     wrptr = (char*)chunk.item.iov_base;
+            uint64_t  wrlen = chunk.item.iov_len;
+
             if( mk6 ) {
                 ssize_t          nw;
                 mk6_wb_header_v2 wb((int32_t)chunk.tag.chunkSequenceNr, (int32_t)chunk.item.iov_len);
 
-                // If we fail to write, remember to error code and make sure
-                // that the system does not try to write the chunk data.
-                if( (nw=::write(fd, &wb, sizeof(mk6_wb_header_v2)))!=(ssize_t)sizeof(mk6_wb_header_v2) ) {
+                if( mk6vars.wb_headroom ) {
+                    wrptr -= sizeof(mk6_wb_header_v2);
+                    wrlen += sizeof(mk6_wb_header_v2);
+                    ::memcpy(wrptr, &wb, sizeof(mk6_wb_header_v2));
+                } else if( (nw=::write(fd, &wb, sizeof(mk6_wb_header_v2)))!=(ssize_t)sizeof(mk6_wb_header_v2) ) {
+                    // If we fail to write, remember to error code and make sure
+                    // that the system does not try to write the chunk data.
                     eno           = errno;
-                    bytes_written = chunk.item.iov_len;
+                    bytes_written = wrlen;
                 }
             }
             
             DEBUG(4, "    parallelwriter[" << ::pthread_self() << "] attempt " << fn << endl);
         
-            // Dump contents into file, save errno
-            while ( bytes_written < chunk.item.iov_len ) {
-                rv  = ::write(fd, ((char*)chunk.item.iov_base) + bytes_written, 
-                              chunk.item.iov_len - bytes_written);
-                if ( rv <= 0 ) {
-                    eno = errno;
-                    break;
-                }
-                else {
-                    bytes_written += rv;
+            // Dump contents into file, save errno. Recording I/O does not
+            // wait for other disk users but they do for us.
+            const pcint::timeval_type  start( pcint::timeval_type::now() );
+            {
+                ioslot                slot(mountpoint, ioclass_record, mfaptr->rteptr->name);
+                const tracetime_type  t0 = trace_now();
+
+                while ( bytes_written < wrlen ) {
+                    rv  = ::write(fd, wrptr + bytes_written, wrlen - bytes_written);
+                    if ( rv <= 0 ) {
+                        eno = errno;
+                        break;
+                    }
+                    else {
+                        bytes_written += rv;
+                    }
                 }
+                trace_complete("write", t0, bytes_written);
+                slot.done( bytes_written );
             }
-            DEBUG(4, "    parallelwriter[" << ::pthread_self() << "] result " << (bytes_written==(uint64_t)chunk.item.iov_len) << endl);
-            // close file already [unless we're emulating Mark6 mode]
+            const double  dt = pcint::timeval_type::now() - start;
+            DEBUG(4, "    parallelwriter[" << ::pthread_self() << "] result " << (bytes_written==wrlen) << endl);
+            // close file already [unless we're emulating Mark6 mode],
+            // keeping the digest of what's in it with it
             if( !mk6 ) {
+                if( bytes_written==wrlen )
+                    ::chunkdigest_store(fd, ::chunkdigest_compute(wrptr, (size_t)wrlen));
                 ::close( fd );
                 fd = -1;
             }
 
             // Now inspect how well it went
-            written = (bytes_written==(uint64_t)chunk.item.iov_len);
+            written = (bytes_written==wrlen);
 
             if( !written ) {
                 // Oh dear, failed to write. Mountpoint bad?
@@ -1379,9 +2105,25 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
                 }
             } else {
                 // Writing to file finished succesfully, now put back
-                // mountpoint on the list and wake up only one waiter
+                // mountpoint on the list and wake up only one waiter.
+                // Unless the disk is full, that is.
+                struct statvfs  vfs;
+                uint64_t        freeBytes = ~((uint64_t)0);
+
+                if( ::statvfs(mountpoint.c_str(), &vfs)==0 )
+                    freeBytes = (uint64_t)vfs.f_bavail * (uint64_t)vfs.f_frsize;
+                if( !mk6 )
+                    ::catalog_chunk_written(mountpoint, chunk.tag.fileName, bytes_written);
                 SYNCEXEC(args,
-                    mfaptr->filelist.push_back(mountpoint); args->cond_signal();
+                    const diskhealth_type::state_type  prev = mfaptr->diskhealth[mountpoint].state;
+                    if( update_diskhealth(*mfaptr, mountpoint, bytes_written, dt, freeBytes) ) {
+                        mfaptr->filelist.push_back(mountpoint);
+                        args->cond_signal();
+                    } else
+                        mfaptr->listlength -= 1;
+                    // Waiters may have to reconsider
+                    if( mfaptr->diskhealth[mountpoint].state!=prev )
+                        args->cond_broadcast();
                     mfaptr->fdmap.insert(make_pair(mountpoint, fd)) );
             }
         }
@@ -1398,6 +2140,213 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
 }
 
 
+//////////////////////////////////////////////////////////
+//                  chunkspiller
+// Elastic buffer between chunkmaker and parallelwriter,
+// see chunkspillargs
+//////////////////////////////////////////////////////////
+chunkspillargs::chunkspillargs(runtime* rte, uint64_t res, unsigned int bs, unsigned int hr):
+    rteptr( rte ), reserve( res ), blocksize( bs ), headroom( hr ),
+    nCur( 0 ), nHighWater( 0 ), nSpilled( 0 ), nOverflow( 0 ), lastDrain( 0.0 ), maxDrain( 0.0 )
+{ EZASSERT2_NZERO(rteptr, cmdexception, EZINFO("null pointer runtime!")) }
+
+string chunkspill_status(chunkspillargs* csaptr) {
+    ostringstream   oss;
+
+    oss << csaptr->reserve << " : " << csaptr->nCur << " : " << csaptr->nHighWater << " : "
+        << csaptr->nSpilled << " : " << csaptr->nOverflow << " : " << csaptr->lastDrain << " : " << csaptr->maxDrain;
+    return oss.str();
+}
+
+typedef std::list<chunk_type>   spilllist_type;
+
+// The reserve is allocated up front but touched, to take the page faults
+// before they're needed, a piece at a time whenever the spiller has
+// nothing else to do, such that chunks are forwarded from the start.
+struct spillreserve_type {
+    vector<pool_type*>  pools;
+    list<block>         touched;    // touched, not handed out yet
+    block               current;    // being touched
+    size_t              pos;        // up to here
+    bool                complete;
+
+    spillreserve_type():
+        pos( 0 ), complete( false )
+    {}
+
+    // Touched blocks first
+    block get( void ) {
+        block   b;
+
+        if( !touched.empty() ) {
+            b = touched.front();
+            touched.pop_front();
+            return b;
+        }
+        for(vector<pool_type*>::iterator p=pools.begin(); p!=pools.end() && b.empty(); p++)
+            b = (*p)->get();
+        return b;
+    }
+
+    // Touch the next 'n' bytes of the reserve
+    void touch(size_t n) {
+        if( current.empty() ) {
+            for(vector<pool_type*>::iterator p=pools.begin(); p!=pools.end() && current.empty(); p++)
+                current = (*p)->get();
+            pos = 0;
+            if( (complete=current.empty())==true )
+                return;
+        }
+        n = std::min(n, current.iov_len - pos);
+        ::memset((unsigned char*)current.iov_base + pos, 0, n);
+        if( (pos+=n)==current.iov_len ) {
+            touched.push_back( current );
+            current = block();
+        }
+    }
+
+    // Blocks still in use by the writers keep their pool alive
+    ~spillreserve_type() {
+        touched.clear();
+        current = block();
+        for(vector<pool_type*>::iterator p=pools.begin(); p!=pools.end(); p++)
+            delete *p;
+    }
+};
+
+// Hand out the oldest spilled chunk, waiting for a writer to take it
+static bool push_oldest(outq_type<chunk_type>* outq, spilllist_type& spilled) {
+    if( !outq->push(spilled.front()) )
+        return false;
+    spilled.pop_front();
+    return true;
+}
+
+// Put 'chunk' at the back of the buffer. If the reserve is used up the
+// oldest chunk must be handed out first and 'chunk' is kept as it is.
+static bool spill(const chunk_type& chunk, outq_type<chunk_type>* outq, spilllist_type& spilled,
+                  spillreserve_type& reserve, chunkspillargs* csa, sync_type<chunkspillargs>* args) {
+    block   rb;
+
+    if( chunk.item.iov_len<=csa->blocksize )
+        rb = reserve.get();
+
+    if( rb.empty() ) {
+        SYNCEXEC(args, csa->nOverflow++);
+        if( spilled.empty() )
+            return outq->push(chunk);
+        if( !push_oldest(outq, spilled) )
+            return false;
+        spilled.push_back( chunk );
+        return true;
+    }
+    ::memcpy((unsigned char*)rb.iov_base + csa->headroom, chunk.item.iov_base, chunk.item.iov_len);
+    spilled.push_back( chunk_type(chunk.tag, rb.sub(csa->headroom, (unsigned int)chunk.item.iov_len)) );
+    SYNCEXEC(args, csa->nSpilled++);
+    return true;
+}
+
+void chunkspiller(inq_type<chunk_type>* inq, outq_type<chunk_type>* outq, sync_type<chunkspillargs>* args) {
+    bool                 ok = true;
+    chunk_type           chunk;
+    spilllist_type       spilled;
+    chunkspillargs*      csa = args->userdata;
+    spillreserve_type    reserve;
+    pcint::timeval_type  backlogStart;
+    const unsigned int   poolbs = csa->blocksize + csa->headroom;
+    const uint64_t       nblock = (poolbs ? csa->reserve/poolbs : 0);
+
+    // Reserve the memory; it's touched later on. A single pool can't be
+    // >4GB.
+    try {
+        uint64_t        n = 0;
+
+        while( n<nblock ) {
+            const unsigned int  nb = (unsigned int)std::min(nblock-n, std::max((uint64_t)1, (uint64_t)(1u<<31)/poolbs));
+
+            reserve.pools.push_back( new pool_type(poolbs, nb) );
+            n += nb;
+        }
+    }
+    catch( const std::exception& e ) {
+        DEBUG(-1, "chunkspiller: failed to reserve all of " << byteprint((double)csa->reserve, "byte") << " - " << e.what() << endl);
+    }
+    DEBUG(2, "chunkspiller: starting with " << byteprint((double)(reserve.pools.size() ? nblock*poolbs : 0), "byte") << " reserved in "
+             << reserve.pools.size() << " pool(s) of " << byteprint((double)poolbs, "byte") << " blocks" << endl);
+
+    while( ok ) {
+        push_result_type  pr;
+
+        if( spilled.empty() ) {
+            // Touch more of the reserve if no chunk is waiting
+            if( !reserve.complete ) {
+                struct timeval  now;
+                struct timespec wakeup;
+
+                ::gettimeofday(&now, 0);
+                wakeup.tv_sec  = now.tv_sec;
+                wakeup.tv_nsec = now.tv_usec*1000;
+
+                const pop_result_type  r = inq->pop(chunk, wakeup);
+                if( r==pop_disabled )
+                    break;
+                if( r==pop_timeout ) {
+                    reserve.touch( 8*1024*1024 );
+                    if( reserve.complete )
+                        DEBUG(3, "chunkspiller: reserve touched" << endl);
+                    continue;
+                }
+            } else if( !inq->pop(chunk) )
+                break;
+            if( (pr=outq->try_push(chunk))==push_success )
+                continue;
+            if( pr==push_disabled )
+                break;
+            // The writers are all busy: a backlog starts
+            backlogStart = pcint::timeval_type::now();
+            ok = spill(chunk, outq, spilled, reserve, csa, args);
+        } else if( (pr=outq->try_push(spilled.front()))==push_success ) {
+            spilled.pop_front();
+            if( spilled.empty() ) {
+                const double  dt = pcint::timeval_type::now() - backlogStart;
+
+                DEBUG(3, "chunkspiller: backlog drained in " << dt << "s" << endl);
+                SYNCEXEC(args, csa->lastDrain = dt; csa->maxDrain = std::max(csa->maxDrain, dt));
+            }
+        } else if( pr==push_disabled ) {
+            break;
+        } else {
+            // Writers still busy. Accept new chunks in the mean time but
+            // check back soon if a writer has become available
+            struct timeval  now;
+            struct timespec wakeup;
+
+            ::gettimeofday(&now, 0);
+            now.tv_usec   += 10000;
+            wakeup.tv_sec  = now.tv_sec + now.tv_usec/1000000;
+            wakeup.tv_nsec = (now.tv_usec%1000000)*1000;
+
+            const pop_result_type  r = inq->pop(chunk, wakeup);
+            if( r==pop_success )
+                ok = spill(chunk, outq, spilled, reserve, csa, args);
+            else if( r==pop_disabled ) {
+                // No more input; hand out what we still have
+                while( !spilled.empty() && push_oldest(outq, spilled) )
+                    SYNCEXEC(args, csa->nCur = (unsigned int)spilled.size());
+                break;
+            }
+        }
+        SYNCEXEC(args, csa->nCur = (unsigned int)spilled.size();
+                       csa->nHighWater = std::max(csa->nHighWater, csa->nCur));
+    }
+    if( !spilled.empty() ) {
+        DEBUG(-1, "chunkspiller: " << spilled.size() << " chunk(s) not written" << endl);
+    }
+    DEBUG(2, "chunkspiller: done. " << csa->nSpilled << " chunks spilled, at most " << csa->nHighWater
+             << " at once, " << csa->nOverflow << " overflows" << endl);
+}
+
+
 void parallelsink(inq_type<chunk_type>* inq, sync_type<multifileargs>* ) {
     uint64_t    nDiscarded = 0;
     chunk_type  chunk;
@@ -1417,9 +2366,10 @@ void parallelsink(inq_type<chunk_type>* inq, sync_type<multifileargs>* ) {
 // file name for the chunk based on the scan name
 //////////////////////////////////////////////////////////
 void chunkmaker(inq_type<block>* inq, outq_type<chunk_type>* outq, sync_type<chunkmakerargs_type>* args) {
-    block           b;
-    uint32_t        chunkCount = 0;
-    const string&   scanName( args->userdata->recording_name );
+    block               b;
+    uint32_t            chunkCount = 0;
+    const string&       scanName( args->userdata->recording_name );
+    timeindex_builder&  timeindex( *args->userdata->timeindex );
 
     while( inq->pop(b) ) {
         ostringstream   fn_s;
@@ -1428,6 +2378,7 @@ void chunkmaker(inq_type<block>* inq, outq_type<chunk_type>* outq, sync_type<chu
         fn_s << scanName << "/" << scanName << "." << format("%08u", chunkCount);
 
         DEBUG(4, "chunkmaker: created chunk " << fn_s.str() << " (size=" << b.iov_len << ")" << endl);
+        timeindex.add(chunkCount, b);
 
         if( outq->push(chunk_type(filemetadata(fn_s.str(), (off_t)b.iov_len, chunkCount), b))==false )
             break;
@@ -1440,13 +2391,13 @@ void chunkmaker(inq_type<block>* inq, outq_type<chunk_type>* outq, sync_type<chu
 // For Mark6 the file name is just the scan name with ".mk6" appended (...)
 // The multiwriter will open <mountpoint>/<fileName> and dump the chunk in there
 void mk6_chunkmaker(inq_type<block>* inq, outq_type<chunk_type>* outq, sync_type<chunkmakerargs_type>* args) {
-    block           b;
-    uint32_t        chunkCount = 0;
-    const string    fileName( args->userdata->recording_name/*+".mk6"*/ );
+    block               b;
+    uint32_t            chunkCount = 0;
+    const string        fileName( args->userdata->recording_name/*+".mk6"*/ );
+    timeindex_builder&  timeindex( *args->userdata->timeindex );
 
     while( inq->pop(b) ) {
-        ostringstream   fn_s;
-
+        timeindex.add(chunkCount, b);
         if( outq->push(chunk_type(filemetadata(fileName, (off_t)b.iov_len, chunkCount), b))==false )
             break;
         chunkCount++;
@@ -1454,6 +2405,12 @@ void mk6_chunkmaker(inq_type<block>* inq, outq_type<chunk_type>* outq, sync_type
     }
 }
 
+// Chain final function: by now all chunks are on disk so we know which
+// mountpoints hold the recording
+void write_timeindex(chunkmakerargs_type cma) {
+    cma.timeindex->write(cma.recording_name, cma.mountpoints, cma.mk6);
+}
+
 //////////////////////////////////////////////////////////
 //                  chunkmaker 
 // Assign chunk sequence numbers and generate the correct
@@ -23,6 +23,10 @@
 #include <threadfns.h>
 #include <ezexcept.h>
 #include <mountpoint.h>
+#include <timeindex.h>
+#include <chunkdigest.h>
+#include <countedpointer.h>
+#include <timewrap.h>
 
 #include <list>
 #include <string>
@@ -47,8 +51,13 @@ struct taggeditem {
 // Description of a chunk of data
 // fileName should be a relative path "<scan>/<scan>.<number>"
 // such that it can be appended to any old mountpoint or root
+// When only part of a chunk is sent (rsync resume) fileSize is the size of
+// that part, which goes at rangeOffset in a chunk of chunkSize bytes.
+// For whole chunks chunkSize<0.
 struct filemetadata {
     off_t        fileSize;
+    off_t        rangeOffset;
+    off_t        chunkSize;
     uint32_t     chunkSequenceNr;
     std::string  fileName;
 
@@ -65,6 +74,8 @@ typedef taggeditem<filemetadata, block>  chunk_type;
 struct chunk_location {
     std::string  mountpoint;         // e.g. "/mnt/disk19"
     std::string  relative_path;      // e.g. "te110_Mh_No0019/te110_Mh_No0019.00012035"
+    // Empty: send the whole chunk, otherwise only these parts of it
+    byterangelist_type  ranges;
 
     chunk_location();
 
@@ -77,6 +88,13 @@ struct chunkmakerargs_type {
     runtime*    rteptr;
     std::string recording_name;
 
+    // The (non-stream) chunkmakers index the recording's frames. The
+    // index is written by write_timeindex(), registered as chain final
+    // function, after the last chunk has been written to disk
+    countedpointer<timeindex_builder> timeindex;
+    mountpointlist_type               mountpoints;
+    bool                              mk6;
+
     // asserts that rte != null && rec != empty
     chunkmakerargs_type(runtime* rte, std::string const& rec);
 
@@ -86,6 +104,37 @@ struct chunkmakerargs_type {
         chunkmakerargs_type();
 };
 
+// Elastic buffer between the chunkmakers and the parallelwriters.
+// If all writers are busy - e.g. a disk stalls for a moment - the
+// chunkmaker would block and the back pressure would reach the network
+// reader, which then loses packets. chunkspiller() instead copies the
+// chunks that can't be handed to a writer right away into memory that it
+// reserved up front, such that the reader's blocks are released
+// immediately, and hands them out again as fast as the writers take them.
+// Only when the reserve is used up does the back pressure return. The
+// reserve is touched, to take the page faults early, while there's
+// nothing to forward.
+struct chunkspillargs {
+    runtime*      rteptr;
+    uint64_t      reserve;      // bytes to reserve for spilled chunks
+    unsigned int  blocksize;    // of the reserve's blocks: max. chunk size
+    unsigned int  headroom;     // bytes free in front of each chunk
+
+    // statistics
+    unsigned int  nCur;         // chunks in the buffer now
+    unsigned int  nHighWater;   // max. chunks in the buffer at once
+    uint64_t      nSpilled;     // chunks that went through the buffer
+    uint64_t      nOverflow;    // chunks that found the buffer full
+    double        lastDrain;    // seconds the last backlog took to drain
+    double        maxDrain;
+
+    // asserts rte != null
+    chunkspillargs(runtime* rte, uint64_t res, unsigned int bs, unsigned int hr);
+
+    private:
+        chunkspillargs();
+};
+
 
 // The list of filenames (chunks) and a function to build
 // a list of chunks for a specific scan
@@ -103,11 +152,14 @@ typedef std::map<off_t, blockpool_type*> mempool_type;
 
 // Parameter for the multi-file reader
 // The only thing we require is the memory pool and
-// the threadfdlist
+// the threadfdlist (and the runtime, to account the disk I/O to)
 struct multireadargs {
+    runtime*          rteptr;
     mempool_type      mempool;
     threadfdlist_type threadlist;
 
+    multireadargs(runtime* r);
+
     // delete all block pools!
     ~multireadargs();
 };
@@ -120,14 +172,47 @@ struct mark6_vars_type {
     const bool                            mk6;
     const int32_t                         packet_size;
     const mk6_file_header::packet_formats packet_format;
+    // If true, each chunk's memory has sizeof(mk6_wb_header_v2) bytes
+    // free in front of iov_base (see fdreaderargs::headroom) such that
+    // write block header + data can be written with one write(2)
+    const bool                            wb_headroom;
 
 
     // Default c'tor => No Mk6 emulation
     mark6_vars_type();
 
     // Non-default => set Mk6 emulation info
-    mark6_vars_type(int32_t ps, mk6_file_header::packet_formats pf);
+    mark6_vars_type(int32_t ps, mk6_file_header::packet_formats pf, bool hr = false);
+};
+
+// How well a mountpoint is doing as seen by parallelwriter(). A single
+// slow or almost full disk would hold up the whole recording so such
+// disks are avoided:
+//      - chunks go round robin over the disks whose average write
+//        latency is not much worse than that of the typical disk
+//      - a disk on which a write takes far longer than is typical is
+//        'quarantined' for a while: it is only written to if there is no
+//        other disk left. After the quarantine it starts with a clean slate
+//      - a disk that doesn't have room for a few more chunks is 'full'
+//        and, like a 'bad' disk (failed to write), no longer used
+struct diskhealth_type {
+    enum state_type { ok, quarantined, full, bad };
+
+    state_type           state;
+    unsigned int         nChunk;        // chunks written
+    uint64_t             nByte;
+    unsigned int         nSample;       // # writes in avgLatency
+    double               avgLatency;    // moving average, seconds per MB
+    double               lastLatency;   // seconds per MB
+    uint64_t             freeBytes;
+    unsigned int         nQuarantine;
+    pcint::timeval_type  quarantineEnd;
+
+    diskhealth_type();
 };
+typedef std::map<std::string, diskhealth_type>  diskhealthmap_type;
+
+const char* diskhealth_state(diskhealth_type::state_type s);
 
 struct multifileargs {
 
@@ -161,6 +246,8 @@ struct multifileargs {
     filelist_type     filelist;
     mark6_vars_type   mk6vars;
     threadfdlist_type threadlist;
+    // one entry for each of the original list's mountpoints
+    diskhealthmap_type diskhealth;
 
     ~multifileargs();
 };
@@ -197,8 +284,10 @@ struct fdoperations_type {
     int         close(int fd) const;
 };
 
-// Helper function to read the "itcp_id" style header (see "kvmap.h")
-std::string read_itcp_header(int fd, const fdoperations_type& fdops);
+// Helper function to read the "itcp_id" style header (see "kvmap.h").
+// If 'eof' is given, the connection being closed (or failing) before the
+// first byte of the header is not an error: *eof is set and "" returned.
+std::string read_itcp_header(int fd, const fdoperations_type& fdops, bool* eof = 0);
 
 // For the mulitple net readers we need an fdreaderargs type
 // to hold the server fd to accept() on and a mempool where to
@@ -235,8 +324,18 @@ multinetargs*  mk_server(runtime* rteptr, netparms_type np);
 // mfaptr->threadlist
 void           mfa_close(multifileargs* mfaptr);
 void           mna_close(multinetargs* mnaptr);
+// "<mountpoint>/<state>/<chunks>/<bytes>/<MB/s>/<last MB/s>/<free bytes>/<#quarantined>[ : ...]"
+std::string    mfa_diskhealth(multifileargs* mfaptr);
 void           rsyncinit_close(rsyncinitargs* mnaptr);
 
+// Tell the remote end (a fresh connection to a net2vbs) which chunks of
+// 'scan' we have and return the ones it still needs
+chunklist_type rsync_negotiate(const std::string& scan, const chunklist_type& fl,
+                               int fd, const fdoperations_type& fdops);
+
+// Reorder chunks such that consecutive ones are on different mountpoints
+chunklist_type stripe_chunklist(const chunklist_type& fl);
+
 // The initiator. Negotiates with the remote side about which files
 // to actually transfer. Also takes care of the striping of the local
 // read.
@@ -248,10 +347,79 @@ void rsyncinitiator(outq_type<chunk_location>*, sync_type<rsyncinitargs>*);
 //void parallelreader(outq_type<chunk_location>*, sync_type<multifileargs>*);
 void parallelreader2(inq_type<chunk_location>*, outq_type<chunk_type>*, sync_type<multireadargs>*);
 
-// For each popped item a new connection will be opened; i.e. the
-// blocks will be transferred in parallel.
+// A connection to a net2vbs (parallelnetreader) over which any number
+// of chunks can be sent one after the other, each preceded by its
+// "itcp_id" style header. The header carries "keepAlive" which asks the
+// receiver to acknowledge the chunk with one byte and then wait for the
+// next header instead of closing the connection. This saves the
+// connection setup and TCP slow start (or UDT's startup) per chunk.
+// Receivers that don't know about this close the connection after each
+// chunk, upon which a new connection is made for the next one.
+// A receiver thread serves one connection at a time, so while a sender
+// keeps its connection that receiver thread is its own. With more senders
+// than receiver threads the other senders wait in the listen queue; the
+// connection is therefore closed after 'maxChunk' chunks, such that every
+// sender gets its turn.
+class chunk_connection {
+    public:
+        chunk_connection(const networkargs& np, const fdoperations_type& fdops);
+
+        // Connect if not connected and send the header for 'fmd'.
+        // Returns the file descriptor to send the chunk's contents to.
+        // Throws if no connection can be made.
+        int  begin(const filemetadata& fmd);
+
+        // To be called after the chunk's contents were sent; 'complete'
+        // tells if all of it was. Waits for the receiver to acknowledge
+        // (or close). Returns true if the receiver has the chunk; if not,
+        // the chunk must be sent again (or counted as lost). The
+        // connection is kept if it can be reused.
+        bool end(bool complete);
+
+        void close( void );
+
+        ~chunk_connection();
+
+    private:
+        const networkargs       netargs;
+        const fdoperations_type fdops;
+        fdreaderargs*           conn;
+        unsigned int            nChunk;  // chunks acknowledged on conn
+        bool                    acked;   // conn's receiver does keepAlive
+
+        static const unsigned int maxChunk = 64;
+
+        // no copying
+        chunk_connection(const chunk_connection&);
+        const chunk_connection& operator=(const chunk_connection&);
+};
+
+// Each sender thread keeps a connection (see chunk_connection) over which
+// it sends the popped chunks; i.e. the chunks are transferred in parallel.
 void parallelsender(inq_type<chunk_type>*, sync_type<networkargs>*);
 
+// Send one chunk file to a net2vbs: the "itcp_id" style header followed
+// by the file's contents, sent zero-copy where possible (TCP). The first
+// form uses a new connection for this chunk alone. The monitor, if given,
+// is told about the connection's file descriptor (and -1 when the chunk
+// is done) and each amount of bytes sent. The disk reads are scheduled as
+// copy I/O of 'ioowner' (see ioscheduler.h). Returns true if the whole file
+// was sent.
+struct chunksend_monitor {
+    virtual void connection(int fd);
+    virtual void sent(off_t n);
+    virtual ~chunksend_monitor();
+};
+bool send_chunk_file(const networkargs& np, const fdoperations_type& fdops, const chunk_location& cl,
+                     const std::string& ioowner, chunksend_monitor* monitor = 0);
+bool send_chunk_file(chunk_connection& cc, const chunk_location& cl, const std::string& ioowner,
+                     chunksend_monitor* monitor = 0);
+
+// Zero-copy replacement for parallelreader2 + parallelsender over TCP:
+// each thread keeps a connection over which the popped chunks are sent,
+// with the same headers, straight from the page cache using sendfile(2)
+void parallelfilesender(inq_type<chunk_location>*, sync_type<networkargs>*);
+
 
 // >1 parallel net reader should be active, each does an "accept()" on
 // the server and sucks the data out of the listen socket.
@@ -262,6 +430,9 @@ void parallelnetreader(outq_type<chunk_type>*, sync_type<multinetargs>*);
 // now is a list of mount points "/mnt/diskN" where we can write to.
 // As soon as we're finished writing we put it back onto the list.
 void parallelwriter(inq_type<chunk_type>*, sync_type<multifileargs>*);
+void chunkspiller(inq_type<chunk_type>*, outq_type<chunk_type>*, sync_type<chunkspillargs>*);
+// "<reserve bytes> : <in buffer> : <high water> : <spilled> : <overflows> : <last drain s> : <max drain s>"
+std::string chunkspill_status(chunkspillargs*);
 void parallelsink(inq_type<chunk_type>*, sync_type<multifileargs>*);
 
 // The chunkmaker step transfers big blocks of data
@@ -271,5 +442,6 @@ void chunkmaker(inq_type<block>*, outq_type<chunk_type>*, sync_type<chunkmakerar
 void mk6_chunkmaker(inq_type<block>*, outq_type<chunk_type>*, sync_type<chunkmakerargs_type>*);
 void chunkmaker_stream(inq_type< tagged<block> >*, outq_type<chunk_type>*, sync_type<chunkmakerargs_type>*);
 void mk6_chunkmaker_stream(inq_type< tagged<block> >*, outq_type<chunk_type>*, sync_type<chunkmakerargs_type>*);
+void write_timeindex(chunkmakerargs_type);
 
 #endif
@@ -0,0 +1,470 @@
+// compact time -> byte offset index of FlexBuff/Mark6 recordings
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <timeindex.h>
+#include <mk6info.h>
+#include <evlbidebug.h>
+#include <threadutil.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(timeindexexception)
+
+#ifdef O_LARGEFILE
+    #define LARGEFILEFLAG  O_LARGEFILE
+#else
+    #define LARGEFILEFLAG  0
+#endif
+
+// What the recorder puts in the place of data it did not receive
+static const uint64_t  fill_pattern = 0x1122334411223344ULL;
+
+// On-disk layout: this header followed by 'nentry' timeindex_entry's, in
+// host byte order
+struct timeindex_file_header {
+    char      magic[8];
+    uint32_t  version;
+    uint32_t  entrysize;
+    uint32_t  format;
+    uint32_t  framesize;
+    uint64_t  length;
+    uint64_t  nentry;
+};
+static const char      timeindex_magic[8] = {'J', '5', 'A', 'B', 'T', 'I', 'D', 'X'};
+static const uint32_t  timeindex_version  = 1;
+
+static string timeindex_path(const string& mp, const string& recname, bool mk6) {
+    if( mk6 )
+        return mp + "/." + recname + ".tidx";
+    return mp + "/" + recname + "/" + recname + ".tidx";
+}
+
+// For binary searching the entries by offset or by second
+struct offset_less {
+    bool operator()(uint64_t o, const timeindex_entry& e) const {
+        return o < e.offset;
+    }
+    bool operator()(const timeindex_entry& e, uint64_t o) const {
+        return e.offset < o;
+    }
+    bool operator()(const timeindex_entry& a, const timeindex_entry& b) const {
+        return a.offset < b.offset;
+    }
+};
+struct second_less {
+    bool operator()(int64_t s, const timeindex_entry& e) const {
+        return s < e.tv_sec;
+    }
+    bool operator()(const timeindex_entry& e, int64_t s) const {
+        return e.tv_sec < s;
+    }
+};
+
+
+timeindex_entry::timeindex_entry():
+    offset( 0 ), tv_sec( 0 ), chunk( 0 ), thread( 0 ), flags( 0 )
+{}
+
+timeindex_entry::timeindex_entry(uint64_t o, int64_t s, uint32_t c, uint16_t t, uint16_t f):
+    offset( o ), tv_sec( s ), chunk( c ), thread( t ), flags( f )
+{}
+
+///////////////////////////////////////////////////////////////////
+//          timeindex_builder
+///////////////////////////////////////////////////////////////////
+
+timeindex_builder::timeindex_builder(const headersearch_type& format):
+    hdr( format ), vdif( is_vdif(format.frameformat) ), enabled( format.valid() ),
+    length( 0 ), next( 0 ), scanend( 0 ), lastsec( -1 ),
+    syncwordsearch( format.syncword, format.syncwordsize )
+{}
+
+int timeindex_builder::frametime(unsigned char const* frame, int64_t& sec, uint16_t& thread) {
+    if( vdif ) {
+        struct vdif_header const* h = (struct vdif_header const*)frame;
+
+        if( *(uint64_t const*)frame==fill_pattern )
+            return 0;
+        // VDIF has no syncword; a header of the wrong size means we're
+        // not looking at a frame
+        if( h->data_frame_len8*8!=hdr.framesize )
+            return -1;
+        if( h->invalid )
+            return 0;
+
+        // Decoding the time stamp involves mktime(3), so only do that
+        // once per reference epoch
+        epochs_type::iterator  ep = epochs.find( h->ref_epoch );
+
+        if( ep==epochs.end() ) {
+            const highrestime_type  t = hdr.decode_timestamp(frame, headersearch::strict_type());
+
+            ep = epochs.insert( make_pair((unsigned int)h->ref_epoch, (int64_t)t.tv_sec - (int64_t)h->epoch_seconds) ).first;
+        }
+        sec    = ep->second + (int64_t)h->epoch_seconds;
+        thread = (uint16_t)h->thread_id;
+        return 1;
+    }
+    if( !hdr.check(frame, headersearch::strict_type()|headersearch::chk_syncword, 0) )
+        return -1;
+
+    const highrestime_type  t = hdr.decode_timestamp(frame, headersearch::strict_type() | headersearch::chk_allow_dbe | headersearch::chk_nothrow);
+
+    if( t.tv_sec==0 )
+        return 0;
+    sec    = (int64_t)t.tv_sec;
+    thread = 0;
+    return 1;
+}
+
+// Remember the second of the thread; returns the flag if it's a new one
+uint16_t timeindex_builder::thread_second(int64_t sec, uint16_t thread) {
+    threadsecond_type::iterator  ts = threadsec.find( thread );
+
+    if( ts!=threadsec.end() && ts->second==sec )
+        return 0;
+    threadsec[thread] = sec;
+    return timeindex_entry::start_of_thread_second;
+}
+
+// Frame 'lo' is not in a new second, frame 'hi' is. Bisect to find a
+// frame that is while the one before isn't
+uint64_t timeindex_builder::first_of_second(unsigned char const* base, uint64_t lo, uint64_t hi) {
+    while( hi-lo>hdr.framesize ) {
+        const uint64_t  mid = lo + ((hi-lo)/hdr.framesize/2)*hdr.framesize;
+        int64_t         s;
+        uint16_t        t;
+
+        if( this->frametime(base+mid, s, t)>0 && s>lastsec )
+            hi = mid;
+        else
+            lo = mid;
+    }
+    return hi;
+}
+
+// Record the first frame of second 'sec' and of each thread's second in
+// the frames [from, to)
+void timeindex_builder::new_second(unsigned char const* base, uint64_t start, uint32_t chunk,
+                                   uint64_t from, uint64_t to, int64_t sec) {
+    for(uint64_t p=from; p+hdr.headersize<=to; p+=hdr.framesize) {
+        int64_t   s;
+        uint16_t  t;
+        uint16_t  flags = 0;
+
+        if( this->frametime(base+p, s, t)<=0 || s!=sec )
+            continue;
+        if( s>lastsec ) {
+            flags  |= timeindex_entry::start_of_second;
+            lastsec = s;
+        }
+        flags |= this->thread_second(s, t);
+        if( flags )
+            entries.push_back( timeindex_entry(start+p, s, chunk, t, flags) );
+    }
+}
+
+void timeindex_builder::add(uint32_t chunk, const block& b) {
+    unsigned char const* const base  = (unsigned char const*)b.iov_base;
+    const uint64_t             len   = b.iov_len;
+    const uint64_t             start = length;
+    uint64_t                   pos;
+    uint64_t                   aligned;
+    uint64_t                   last = 0;
+    bool                       first = true;
+    bool                       havelast = false;
+
+    length += len;
+    if( !enabled )
+        return;
+
+    // Continue where the last frame of the previous chunk ended. A frame
+    // whose header straddled the chunk boundary is skipped.
+    while( next<start )
+        next += hdr.framesize;
+    pos     = next - start;
+    aligned = pos;
+
+    // The scan after a second boundary at the end of the previous chunk
+    // continues here
+    if( scanend>start+pos )
+        this->new_second(base, start, chunk, pos, std::min(scanend-start, len), lastsec);
+
+    // Decoding every frame header costs too much at high data rates, so
+    // only every sample_stride'th frame and the chunk's last frame are
+    // looked at. When the second changed between two samples, bisection
+    // finds where. The VDIF threads do not all change second at the same
+    // frame, so there the frames around that point are scanned for the
+    // first frame of each thread's new second.
+    try {
+        while( pos+hdr.headersize<=len ) {
+            int       rv;
+            int64_t   sec;
+            uint16_t  thread;
+
+            if( (rv=this->frametime(base+pos, sec, thread))<0 ) {
+                // Lost track of the frames. Without syncword there's
+                // nothing to look for; try again at the next chunk
+                const uint64_t        from = pos + hdr.syncwordoffset + 1;
+                unsigned char const*  sw   = 0;
+
+                if( !vdif && from<len )
+                    sw = syncwordsearch(base+from, (unsigned int)(len-from));
+                if( sw==0 ) {
+                    pos = len;
+                    break;
+                }
+                pos      = (uint64_t)(sw - base) - hdr.syncwordoffset;
+                aligned  = pos;
+                havelast = false;
+                continue;
+            }
+            if( rv>0 ) {
+                uint16_t  flags;
+
+                if( first )
+                    entries.push_back( timeindex_entry(start+pos, sec, chunk, thread, timeindex_entry::start_of_chunk) );
+                first = false;
+
+                if( sec>lastsec ) {
+                    const uint64_t  w  = (vdif ? sample_stride*hdr.framesize : 0);
+                    const uint64_t  at = (havelast ? this->first_of_second(base, last, pos) : pos);
+
+                    scanend = start + at + w + hdr.framesize;
+                    this->new_second(base, start, chunk, (at-aligned>w ? at-w : aligned),
+                                     std::min(at+w+hdr.framesize, len), sec);
+                } else if( (flags=this->thread_second(sec, thread))!=0 ) {
+                    entries.push_back( timeindex_entry(start+pos, sec, chunk, thread, flags) );
+                }
+            }
+            last     = pos;
+            havelast = true;
+
+            // Next sample, but never skip the chunk's last frame
+            const uint64_t  lastframe = pos + ((len - hdr.headersize - pos)/hdr.framesize)*hdr.framesize;
+
+            if( pos==lastframe )
+                pos += hdr.framesize;
+            else
+                pos = std::min(pos + sample_stride*hdr.framesize, lastframe);
+        }
+    }
+    catch( const std::exception& e ) {
+        DEBUG(-1, "timeindex_builder: not indexing this recording - " << e.what() << endl);
+        enabled = false;
+        entries.clear();
+    }
+    next = start + pos;
+}
+
+void timeindex_builder::write(const string& recname, const mountpointlist_type& mps, bool mk6) const {
+    unsigned int           nWritten = 0;
+    timeindex_file_header  fh;
+
+    if( !enabled || entries.empty() )
+        return;
+
+    ::memcpy(fh.magic, timeindex_magic, sizeof(fh.magic));
+    fh.version   = timeindex_version;
+    fh.entrysize = sizeof(timeindex_entry);
+    fh.format    = (uint32_t)hdr.frameformat;
+    fh.framesize = hdr.framesize;
+    fh.length    = length;
+    fh.nentry    = entries.size();
+
+    for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+        int            fd;
+        struct stat    st;
+        const string   fn( timeindex_path(*mp, recname, mk6) );
+        const size_t   nbyte = entries.size() * sizeof(timeindex_entry);
+
+        // Only next to (a part of) the recording
+        if( ::stat((*mp+"/"+recname).c_str(), &st)!=0 )
+            continue;
+        if( (fd=::open(fn.c_str(), O_CREAT|O_TRUNC|O_WRONLY|LARGEFILEFLAG, 0644))<0 ) {
+            DEBUG(-1, "timeindex: failed to create " << fn << " - " << evlbi5a::strerror(errno) << endl);
+            continue;
+        }
+        if( mk6info_type::fchown_fn(fd, mk6info_type::real_user_id, -1)!=0 )
+            DEBUG(-1, "timeindex: failed to change ownership of " << fn << " - " << evlbi5a::strerror(errno) << endl);
+
+        if( ::write(fd, &fh, sizeof(fh))!=(ssize_t)sizeof(fh) ||
+            ::write(fd, &entries[0], nbyte)!=(ssize_t)nbyte ) {
+            DEBUG(-1, "timeindex: failed to write " << fn << " - " << evlbi5a::strerror(errno) << endl);
+            ::close(fd);
+            ::unlink(fn.c_str());
+            continue;
+        }
+        ::close(fd);
+        nWritten++;
+    }
+    DEBUG(2, "timeindex: " << entries.size() << " entries for " << recname << " written to " << nWritten << " mountpoints" << endl);
+}
+
+///////////////////////////////////////////////////////////////////
+//          timeindex_type
+///////////////////////////////////////////////////////////////////
+
+timeindex_type::timeindex_type(const string& recname, const mountpointlist_type& mps):
+    fmt( fmt_none ), frmsize( 0 ), reclen( 0 )
+{
+    bool  found = false;
+
+    for(mountpointlist_type::const_iterator mp=mps.begin(); !found && mp!=mps.end(); mp++) {
+        for(unsigned int mk6=0; !found && mk6<2; mk6++) {
+            int                    fd;
+            timeindex_file_header  fh;
+            const string           fn( timeindex_path(*mp, recname, mk6==1) );
+
+            if( (fd=::open(fn.c_str(), O_RDONLY|LARGEFILEFLAG))<0 )
+                continue;
+            if( ::read(fd, &fh, sizeof(fh))==(ssize_t)sizeof(fh) &&
+                ::memcmp(fh.magic, timeindex_magic, sizeof(fh.magic))==0 &&
+                fh.version==timeindex_version && fh.entrysize==sizeof(timeindex_entry) &&
+                fh.nentry>0 && fh.framesize>0 ) {
+                const size_t  nbyte = fh.nentry * sizeof(timeindex_entry);
+
+                entries.resize( fh.nentry );
+                if( ::read(fd, &entries[0], nbyte)==(ssize_t)nbyte ) {
+                    fmt     = (format_type)fh.format;
+                    frmsize = fh.framesize;
+                    reclen  = fh.length;
+                    found   = true;
+                    DEBUG(3, "timeindex: loaded " << fh.nentry << " entries from " << fn << endl);
+                }
+            }
+            if( !found )
+                DEBUG(-1, "timeindex: " << fn << " is not a valid time index" << endl);
+            ::close(fd);
+        }
+    }
+    EZASSERT2(found, timeindexexception, EZINFO("no time index found for " << recname));
+
+    // The builder records the frames around a second boundary after the
+    // start of the chunk they're in
+    std::stable_sort(entries.begin(), entries.end(), offset_less());
+
+    for(entries_type::const_iterator p=entries.begin(); p!=entries.end(); p++) {
+        if( p->flags & timeindex_entry::start_of_second )
+            seconds.push_back( *p );
+        if( p->flags & timeindex_entry::start_of_thread_second )
+            threads[p->thread].push_back( *p );
+    }
+    EZASSERT2(!seconds.empty(), timeindexexception, EZINFO("time index for " << recname << " has no time stamps"));
+}
+
+// The first entry is the start of the recording, not of a second.
+// The rate is taken from a complete second as close as possible.
+double timeindex_type::rate_at(const entries_type& secs, entries_type::size_type i) const {
+    for(unsigned int n=0; n<3; n++) {
+        const entries_type::size_type  j = i + n - 1;
+
+        // n = 0, 1, 2 => span j = i-1, i, i+1 where span j is [secs[j], secs[j+1]]
+        if( (n==0 && i==0) || j<1 || j+1>=secs.size() )
+            continue;
+        if( secs[j+1].tv_sec==secs[j].tv_sec+1 )
+            return (double)(secs[j+1].offset - secs[j].offset);
+    }
+    return 0.0;
+}
+
+// Where the second of secs[i] started. For the first entry that is
+// before the start of the recording
+double timeindex_type::boundary(const entries_type& secs, entries_type::size_type i, double rate) const {
+    if( i==0 && secs.size()>1 && secs[1].tv_sec==secs[0].tv_sec+1 && rate>0.0 )
+        return (double)secs[1].offset - rate;
+    return (double)secs[i].offset;
+}
+
+highrestime_type timeindex_type::time_of(int64_t offset) const {
+    entries_type::const_iterator   p = std::upper_bound(seconds.begin(), seconds.end(), (uint64_t)std::max(offset, (int64_t)0), offset_less());
+    const entries_type::size_type  i = (p==seconds.begin() ? 0 : (entries_type::size_type)(p - seconds.begin()) - 1);
+    const double                   rate = rate_at(seconds, i);
+    const double                   dt = (rate>0.0 ? ((double)offset - boundary(seconds, i, rate))/rate : 0.0);
+
+    return highrestime_type((time_t)seconds[i].tv_sec) + highresdelta_type((int64_t)::floor(dt*1.0e9), 1000000000);
+}
+
+bool timeindex_type::offset_of(const highrestime_type& t, int64_t& offset, unsigned int thread) const {
+    entries_type const*            secs = &seconds;
+
+    if( thread!=any_thread ) {
+        threads_type::const_iterator  tp = threads.find( thread );
+
+        if( tp==threads.end() )
+            return false;
+        secs = &tp->second;
+    }
+    entries_type::const_iterator   p = std::lower_bound(secs->begin(), secs->end(), (int64_t)t.tv_sec, second_less());
+
+    if( p==secs->end() || p->tv_sec!=(int64_t)t.tv_sec )
+        return false;
+
+    const entries_type::size_type  i    = (entries_type::size_type)(p - secs->begin());
+    const double                   rate = rate_at(*secs, i);
+    const double                   frac = (t.tv_subsecond==highrestime_type::UNKNOWN_SUBSECOND ? 0.0 :
+                                           boost::rational_cast<double>(t.tv_subsecond));
+    const double                   o    = boundary(*secs, i, rate) + frac*rate;
+
+    if( o<(double)(*secs)[0].offset || o>=(double)reclen )
+        return false;
+
+    // Round down to the start of a frame, counting from the second's
+    // first frame
+    const uint64_t  anchor = p->offset;
+    const uint64_t  o64    = std::max((uint64_t)o, anchor);
+
+    offset = (int64_t)(anchor + ((o64-anchor)/frmsize)*frmsize);
+    return true;
+}
+
+int64_t timeindex_type::frame_at(int64_t offset) const {
+    entries_type::const_iterator  p = std::upper_bound(entries.begin(), entries.end(), (uint64_t)std::max(offset, (int64_t)0), offset_less());
+
+    if( p==entries.begin() )
+        return offset;
+    p--;
+    return (int64_t)(p->offset + (((uint64_t)offset - p->offset)/frmsize)*frmsize);
+}
+
+highrestime_type timeindex_type::start( void ) const {
+    return time_of( (int64_t)seconds[0].offset );
+}
+
+format_type timeindex_type::format( void ) const {
+    return fmt;
+}
+
+unsigned int timeindex_type::framesize( void ) const {
+    return frmsize;
+}
+
+uint64_t timeindex_type::length( void ) const {
+    return reclen;
+}
@@ -0,0 +1,157 @@
+// compact time -> byte offset index of FlexBuff/Mark6 recordings
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_TIMEINDEX_H
+#define JIVE5AB_TIMEINDEX_H
+
+#include <block.h>
+#include <headersearch.h>
+#include <highrestime.h>
+#include <boyer_moore.h>
+#include <mountpoint.h>
+#include <ezexcept.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+DECLARE_EZEXCEPT(timeindexexception)
+
+// While recording, the chunkmaker feeds each chunk through a
+// timeindex_builder. It samples the frame headers and remembers, for each
+// frame that
+//      - is the first frame of a chunk
+//      - is the first frame of a new second (any VDIF thread)
+//      - is the first frame of a new second of its VDIF thread
+// the integer second and the byte offset in the recording. At the end of
+// the recording the index is written next to the recording:
+//      FlexBuff: <mountpoint>/<recording>/<recording>.tidx
+//      Mark6:    <mountpoint>/.<recording>.tidx
+// such that "scan_set=" et.al. can find the exact byte offset of any time
+// without reading the recording. Byte offsets are wrt the start of the
+// recording as seen through vbs_reader_base, i.e. the concatenation of the
+// chunks' payloads.
+struct timeindex_entry {
+    enum flag_type {
+        start_of_chunk = 0x1, start_of_second = 0x2, start_of_thread_second = 0x4
+    };
+    // in non-VDIF data all frames are 'thread 0'
+    uint64_t  offset;
+    int64_t   tv_sec;
+    uint32_t  chunk;
+    uint16_t  thread;
+    uint16_t  flags;
+
+    timeindex_entry();
+    timeindex_entry(uint64_t o, int64_t s, uint32_t c, uint16_t t, uint16_t f);
+};
+
+class timeindex_builder {
+    public:
+        // If the format is not valid (e.g. fill2vbs of no particular data
+        // format) the builder does nothing
+        timeindex_builder(const headersearch_type& format);
+
+        // Chunks must be added in order of their sequence number
+        void    add(uint32_t chunk, const block& b);
+
+        // Write the index on each of the mountpoints that hold (a part
+        // of) the recording. Errors are reported, not thrown.
+        void    write(const std::string& recname, const mountpointlist_type& mps, bool mk6) const;
+
+    private:
+        // one in this many frames is looked at, see add()
+        static const uint64_t  sample_stride = 256;
+
+        typedef std::map<uint16_t, int64_t>  threadsecond_type;
+        typedef std::map<unsigned int, int64_t> epochs_type;
+
+        headersearch_type             hdr;
+        const bool                    vdif;
+        bool                          enabled;
+        uint64_t                      length;   // total bytes added so far
+        uint64_t                      next;     // offset where next frame expected
+        uint64_t                      scanend;  // scan for threads' seconds up to here
+        int64_t                       lastsec;
+        threadsecond_type             threadsec;
+        epochs_type                   epochs;
+        boyer_moore                   syncwordsearch;
+        std::vector<timeindex_entry>  entries;
+
+        // returns <0 if no frame at 'frame', 0 if frame without usable
+        // time stamp, >0 if 'sec' and 'thread' are filled in
+        int     frametime(unsigned char const* frame, int64_t& sec, uint16_t& thread);
+        uint16_t thread_second(int64_t sec, uint16_t thread);
+        uint64_t first_of_second(unsigned char const* base, uint64_t lo, uint64_t hi);
+        void     new_second(unsigned char const* base, uint64_t start, uint32_t chunk,
+                            uint64_t from, uint64_t to, int64_t sec);
+
+        timeindex_builder();
+        timeindex_builder(const timeindex_builder&);
+        const timeindex_builder& operator=(const timeindex_builder&);
+};
+
+class timeindex_type {
+    public:
+        static const unsigned int any_thread = ~0u;
+
+        // Load the index of recording 'recname' from the first mountpoint
+        // that has one. Throws timeindexexception if there is none or it
+        // is not a valid index
+        timeindex_type(const std::string& recname, const mountpointlist_type& mps);
+
+        // Time of the data at byte offset 'offset'. Between second
+        // boundaries the time is interpolated using the actual amount of
+        // bytes recorded in that second.
+        highrestime_type time_of(int64_t offset) const;
+
+        // Byte offset of the frame containing time 't', optionally of one
+        // VDIF thread. Returns false if 't' is outside the recording
+        bool             offset_of(const highrestime_type& t, int64_t& offset,
+                                   unsigned int thread = any_thread) const;
+
+        // Round 'offset' down to the nearest frame start (as far as the
+        // index can tell)
+        int64_t          frame_at(int64_t offset) const;
+
+        highrestime_type start( void ) const;
+        format_type      format( void ) const;
+        unsigned int     framesize( void ) const;
+        uint64_t         length( void ) const;
+
+    private:
+        typedef std::vector<timeindex_entry>           entries_type;
+        typedef std::map<unsigned int, entries_type>   threads_type;
+
+        format_type      fmt;
+        unsigned int     frmsize;
+        uint64_t         reclen;
+        entries_type     entries;
+        entries_type     seconds;   // only the start_of_second ones
+        threads_type     threads;   // the start_of_thread_second ones
+
+        // bytes per second around entry 'i' in 'secs' and the offset
+        // where that second started
+        double           rate_at(const entries_type& secs, entries_type::size_type i) const;
+        double           boundary(const entries_type& secs, entries_type::size_type i, double rate) const;
+};
+
+#endif
@@ -101,6 +101,24 @@ int jdboy(int year) {
   return jd;
 }
 
+bool is_leap_year(int year) {
+    return (year%4==0 && year%100!=0) || year%400==0;
+}
+
+// number of leap years in [1, year]
+static int leap_years_upto(int year) {
+    return year/4 - year/100 + year/400;
+}
+
+time_t utc_seconds(int year, int yday, time_t sec) {
+    const time_t days = (time_t)365*(year-1970) + (leap_years_upto(year-1) - leap_years_upto(1969)) + yday;
+    return days*86400 + sec;
+}
+
+int mjdtoday( void ) {
+    return (int)(UNIX_MJD_EPOCH + ::time(NULL)/86400);
+}
+
 double mjdnow( void ) {
     time_t     now = ::time(NULL);
     struct tm  tm_now;
@@ -42,6 +42,17 @@ double mjdnow( void );
 // 'boy' = begin of year ...
 int jdboy(int year);
 
+// Integer-only, timezone-independent counterparts of the above for the
+// per-frame time stamp en/decoders; mktime(3) and gmtime(3)+mjd() cost
+// more than the rest of the decoding put together.
+bool   is_leap_year(int year);
+// Seconds since the UNIX epoch of 00h00m00s UTC on the (zero based) day
+// 'yday' of 'year' plus 'sec' seconds. 'yday' and 'sec' may exceed the
+// length of the year or day, like mktime(3) normalizes them.
+time_t utc_seconds(int year, int yday, time_t sec);
+// The current UTC day as MJD, i.e. (int)mjdnow()
+int    mjdtoday( void );
+
 // Fill in year/doy/h/m/s and it will normalize
 // it. (Notably the change from day-of-year -> month/day)
 // The normalization only seems to work reliably 
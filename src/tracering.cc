@@ -0,0 +1,248 @@
+// per-thread rings of trace events, dumpable as Chrome trace JSON
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <ioscheduler.h>
+#include <tracering.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <threadutil.h>
+#include <evlbidebug.h>
+
+#include <vector>
+#include <fstream>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(traceexception)
+
+// 32 bytes per event, 512kB per thread
+static const unsigned int  nEvent = 16384;
+
+struct traceevent_type {
+    const char*     name;
+    tracetime_type  start;
+    tracetime_type  end;        // == start for instantaneous events
+    uint64_t        arg;
+};
+
+// Only the owning thread writes to a ring; it publishes an event by
+// incrementing 'head' after writing it. A reader copies events and checks
+// 'head' afterwards to see which of them may have been overwritten in the
+// mean time.
+struct tracering_type {
+    volatile uint64_t  head;
+    // events before this one are from a previous owner
+    uint64_t           first;
+    bool               inuse;
+    std::string        name;
+    traceevent_type    event[nEvent];
+
+    tracering_type():
+        head( 0 ), first( 0 ), inuse( true )
+    {}
+};
+
+struct tracestate_type {
+    typedef std::vector<tracering_type*>  rings_type;
+
+    volatile bool    enabled;
+    pthread_key_t    key;
+    pthread_mutex_t  mutex;
+    rings_type       rings;
+    // For converting trace_now() values into wall clock time
+    tracetime_type   t0;
+    struct timeval   tv0;
+
+    tracestate_type():
+        enabled( true )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+        PTHREAD_CALL( ::pthread_key_create(&key, &tracestate_type::release) );
+        t0 = trace_now();
+        ::gettimeofday(&tv0, 0);
+    }
+
+    // Thread exits: its ring may be given to a new thread
+    static void release(void* ringptr);
+};
+
+static tracestate_type  tracestate;
+
+void tracestate_type::release(void* ringptr) {
+    mutex_locker  locker( tracestate.mutex );
+    ((tracering_type*)ringptr)->inuse = false;
+}
+
+static tracering_type* get_ring( void ) {
+    tracering_type*  ring = (tracering_type*)::pthread_getspecific(tracestate.key);
+
+    if( ring )
+        return ring;
+
+    mutex_locker  locker( tracestate.mutex );
+    for(tracestate_type::rings_type::iterator p=tracestate.rings.begin(); p!=tracestate.rings.end() && !ring; p++) {
+        if( (*p)->inuse )
+            continue;
+        ring        = *p;
+        ring->inuse = true;
+        ring->first = ring->head;
+        ring->name.clear();
+    }
+    if( !ring ) {
+        ring = new tracering_type();
+        tracestate.rings.push_back( ring );
+    }
+    ::pthread_setspecific(tracestate.key, ring);
+    return ring;
+}
+
+static inline void record(const char* name, tracetime_type start, tracetime_type end, uint64_t arg) {
+    tracering_type*   ring = get_ring();
+    const uint64_t    h = ring->head;
+    traceevent_type&  ev = ring->event[ h%nEvent ];
+
+    ev.name  = name;
+    ev.start = start;
+    ev.end   = end;
+    ev.arg   = arg;
+    // The event must be complete before it's published. x86 doesn't
+    // reorder stores so there it's only the compiler we must stop.
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "" ::: "memory" );
+#else
+    __sync_synchronize();
+#endif
+    ring->head = h + 1;
+}
+
+void trace_complete(const char* name, tracetime_type t0, uint64_t arg) {
+    if( tracestate.enabled )
+        record(name, t0, trace_now(), arg);
+}
+
+void trace_instant(const char* name, uint64_t arg) {
+    if( tracestate.enabled ) {
+        const tracetime_type  t = trace_now();
+        record(name, t, t, arg);
+    }
+}
+
+void trace_thread_name(const string& name) {
+    tracering_type*  ring = get_ring();
+    mutex_locker     locker( tracestate.mutex );
+    ring->name = name;
+}
+
+void trace_enable(bool on) {
+    tracestate.enabled = on;
+}
+
+bool trace_enabled( void ) {
+    return tracestate.enabled;
+}
+
+unsigned int trace_nring( void ) {
+    mutex_locker  locker( tracestate.mutex );
+    return (unsigned int)tracestate.rings.size();
+}
+
+unsigned int trace_ringsize( void ) {
+    return nEvent;
+}
+
+// JSON string escaping of the names we're likely to meet
+static string json_string(const string& s) {
+    string  r( "\"" );
+
+    for(string::const_iterator p=s.begin(); p!=s.end(); p++) {
+        if( *p=='"' || *p=='\\' )
+            r += '\\';
+        if( (unsigned char)*p>=0x20 )
+            r += *p;
+    }
+    return r + "\"";
+}
+
+unsigned int trace_dump(const string& path) {
+    typedef std::vector<traceevent_type>                   events_type;
+    typedef std::vector< pair<tracering_type*, string> >   ringlist_type;
+
+    ofstream        out( path.c_str() );
+    unsigned int    n = 0;
+    ringlist_type   rings;
+    const pid_t     pid = ::getpid();
+    struct timeval  tv1;
+    tracetime_type  t1;
+
+    EZASSERT2(out.good(), traceexception, EZINFO("failed to open " << path << " - " << evlbi5a::strerror(errno)));
+
+    // Rings are never deleted so only the list needs protection
+    {
+        mutex_locker    locker( tracestate.mutex );
+        for(tracestate_type::rings_type::iterator p=tracestate.rings.begin(); p!=tracestate.rings.end(); p++)
+            rings.push_back( make_pair(*p, (*p)->name) );
+    }
+
+    // Calibrate the clock: trace_now() ticks per microsecond
+    t1 = trace_now();
+    ::gettimeofday(&tv1, 0);
+
+    const double    us = (double)(tv1.tv_sec - tracestate.tv0.tv_sec)*1.0e6 + (double)(tv1.tv_usec - tracestate.tv0.tv_usec);
+    const double    tick_per_us = (us>0.0 && t1>tracestate.t0) ? (double)(t1 - tracestate.t0)/us : 1.0;
+    const double    us0 = (double)tracestate.tv0.tv_sec*1.0e6 + (double)tracestate.tv0.tv_usec;
+
+    out.precision( 16 );
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for(unsigned int r=0; r<rings.size(); r++) {
+        const tracering_type&  ring = *rings[r].first;
+        events_type            events;
+        const uint64_t         h0 = ring.head;
+        const uint64_t         first = std::max(ring.first, (h0>nEvent ? h0-nEvent : 0));
+
+        for(uint64_t i=first; i<h0; i++)
+            events.push_back( ring.event[i%nEvent] );
+        __sync_synchronize();
+        // Whatever the owner wrote in the mean time may have overwritten
+        // what we just copied
+        const uint64_t         h1 = ring.head;
+        const uint64_t         valid = (h1>=nEvent ? h1-nEvent+1 : 0);
+
+        out << (r ? "," : "") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << r
+            << ",\"args\":{\"name\":" << json_string(rings[r].second.empty() ? "thread" : rings[r].second) << "}}";
+        for(uint64_t i=std::max(first, valid); i<h0; i++) {
+            const traceevent_type&  ev = events[i-first];
+
+            out << ",\n{\"name\":" << json_string(ev.name) << ",\"pid\":" << pid << ",\"tid\":" << r
+                << ",\"ts\":" << us0 + (double)(int64_t)(ev.start - tracestate.t0)/tick_per_us;
+            if( ev.end!=ev.start )
+                out << ",\"ph\":\"X\",\"dur\":" << (double)(ev.end - ev.start)/tick_per_us;
+            else
+                out << ",\"ph\":\"i\",\"s\":\"t\"";
+            out << ",\"args\":{\"n\":" << ev.arg << "}}";
+            n++;
+        }
+    }
+    out << "\n]}\n";
+    EZASSERT2(out.good(), traceexception, EZINFO("failed to write " << path));
+    return n;
+}
@@ -0,0 +1,80 @@
+// per-thread rings of trace events, dumpable as Chrome trace JSON
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_TRACERING_H
+#define JIVE5AB_TRACERING_H
+
+#include <ezexcept.h>
+#include <string>
+
+#include <stdint.h>
+#if !(defined(__i386__) || defined(__x86_64__))
+#include <time.h>
+#endif
+
+// Always-on tracing of what the threads are doing, cheap enough to be left
+// on in the hot paths of the processing chains: block get, queue push/pop,
+// disk read/write, receive syscalls, ...
+//
+// Each thread records into a ring of its own (no locking); when the ring
+// is full the oldest events are overwritten. On request the rings are
+// written to a file in the Chrome trace event format (JSON), which can be
+// loaded into chrome://tracing or ui.perfetto.dev, to see where the time
+// goes in a running transfer.
+//
+// Timestamps are taken from the time stamp counter on x86 and converted
+// to wall clock time when dumped.
+DECLARE_EZEXCEPT(traceexception)
+
+typedef uint64_t  tracetime_type;
+
+inline tracetime_type trace_now( void ) {
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t  lo, hi;
+    __asm__ __volatile__( "rdtsc" : "=a"(lo), "=d"(hi) );
+    return ((tracetime_type)hi << 32) | lo;
+#else
+    struct timespec  ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (tracetime_type)ts.tv_sec*1000000000ull + (tracetime_type)ts.tv_nsec;
+#endif
+}
+
+// Record that 'name' happened from 't0' until now. 'name' is not copied so
+// it must be a string literal. 'arg' is free for the caller to use, e.g.
+// the number of bytes.
+void          trace_complete(const char* name, tracetime_type t0, uint64_t arg = 0);
+// Id. for something that has no duration
+void          trace_instant(const char* name, uint64_t arg = 0);
+
+// Name the calling thread's ring, e.g. after the step it is executing
+void          trace_thread_name(const std::string& name);
+
+void          trace_enable(bool on);
+bool          trace_enabled( void );
+
+// Number of rings and events per ring
+unsigned int  trace_nring( void );
+unsigned int  trace_ringsize( void );
+
+// Write all events still in the rings to 'path'. Returns the number of
+// events written. Throws on failure to write the file.
+unsigned int  trace_dump(const std::string& path);
+
+#endif
@@ -511,12 +511,15 @@ void udtwriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
     // since we ended up here we must be connected!
     // we do not clear the wait flag since we're not the one guarding that
     RTEEXEC(*rteptr,
-            rteptr->evlbi_stats = evlbi_stats_type();
+            rteptr->evlbi_stats.clear();
+            rteptr->udt_links.clear();
             rteptr->transfersubmode.set(connected_flag);
             rteptr->statistics.init(args->stepid, "UdtWrite"));
     counter_type&  counter = rteptr->statistics.counter(args->stepid);
-    ucounter_type& loscnt( rteptr->evlbi_stats.pkt_lost );
-    ucounter_type& pktcnt( rteptr->evlbi_stats.pkt_in );
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
+    ucounter_type& loscnt( evlbi.pkt_lost );
+    ucounter_type& pktcnt( evlbi.pkt_in );
+    ucounter_type& rexmitcnt( evlbi.pkt_retrans );
 
     if( stop ) {
         DEBUG(0, "udtwriter: got stopsignal before actually starting" << std::endl);
@@ -576,8 +579,10 @@ void udtwriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
             }
         }
         if( UDT::perfmon(network->fd, &ti, true)==0 ) {
-            pktcnt = ti.pktSentTotal;
-            loscnt += ti.pktSndLoss;
+            pktcnt    += ti.pktSent;
+            loscnt    += ti.pktSndLoss;
+            rteptr->udt_links.update(network->fd, ti.msRTT, ti.mbpsSendRate, ti.pktSent, ti.pktSndLoss);
+            rexmitcnt += ti.pktRetrans;
         }
     }
     // We're not going to block on the fd anymore, do unregister ourselves
@@ -620,6 +625,11 @@ void udpswriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
     struct ::timeval       sop;
     struct ::timeval       now;
     const netparms_type&   np( network->rteptr->netparms );
+    // optional deliberate impairment (testing only, see "net_impair=")
+    bool                   held = false;
+    unsigned int           seed;
+    double                 p_loss, p_reorder;
+    std::vector<unsigned char> heldbuf;
 
     rteptr = network->rteptr;
 
@@ -639,9 +649,21 @@ void udpswriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
     }
     RTEEXEC(*rteptr,
             rteptr->transfersubmode.set(connected_flag);
-            rteptr->statistics.init(args->stepid, "NetWrite/UDPs"));
-
-    counter_type& counter( rteptr->statistics.counter(args->stepid) );
+            rteptr->statistics.init(args->stepid, "NetWrite/UDPs");
+            p_loss    = np.impair_loss;
+            p_reorder = np.impair_reorder;
+            seed      = np.impair_seed);
+
+    counter_type&     counter( rteptr->statistics.counter(args->stepid) );
+    // When impairing, the sender keeps track of what it did to the
+    // stream: datagrams sent, dropped and sent out-of-order, such that
+    // the receiver's statistics can be checked against them. Only then
+    // do they start from zero
+    const bool        impair( p_loss>0.0 || p_reorder>0.0 );
+    if( impair ) {
+        RTEEXEC(*rteptr, rteptr->evlbi_stats.clear());
+    }
+    evlbi_stats_type& evlbi( rteptr->evlbi_stats.shard() );
 
     // Initialize the sequence number with a random 32bit value
     // - just to make sure that the receiver does not make any
@@ -670,6 +692,11 @@ void udpswriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
     DEBUG(0, "udpswriter: first sequencenr=" << seqnr
              << " fd=" << network->fd
              << " n2write=" << ntosend << std::endl);
+    if( impair ) {
+        heldbuf.resize( ntosend );
+        DEBUG(0, "udpswriter: impairing stream - loss=" << p_loss << "% reorder="
+                 << p_reorder << "% seed=" << seed << std::endl);
+    }
     // send out any incoming blocks out over the network
     // initialize "start-of-packet" to "now()". the sendloop
     // waits with sending as long as "now()" is not later than
@@ -752,11 +779,37 @@ void udpswriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
                     if( now.tv_usec>=sop.tv_usec )
                         break;
                 }
-                if( ::sendmsg(network->fd, &msg, MSG_EOR)!=ntosend ) {
-                    DEBUG(-1, "udpswriter: failed to send " << ntosend << " bytes - " <<
-                            evlbi5a::strerror(errno) << " (" << errno << ")" << std::endl);
-                    stop = true;
-                    break;
+                // When impairing, drop this datagram or hold it back to
+                // send it after the next one. Only one is held at a time.
+                const double  r = (impair ? 100.0 * (double)::rand_r(&seed) / ((double)RAND_MAX + 1.0) : 100.0);
+
+                if( r<p_loss ) {
+                    evlbi.pkt_lost++;
+                } else if( r<p_loss+p_reorder && !held ) {
+                    ::memcpy(&heldbuf[0], &seqnr, sizeof(seqnr));
+                    ::memcpy(&heldbuf[sizeof(seqnr)], ptr, wr_size);
+                    held = true;
+                } else {
+                    if( ::sendmsg(network->fd, &msg, MSG_EOR)!=ntosend ) {
+                        DEBUG(-1, "udpswriter: failed to send " << ntosend << " bytes - " <<
+                                evlbi5a::strerror(errno) << " (" << errno << ")" << std::endl);
+                        stop = true;
+                        break;
+                    }
+                    if( impair )
+                        evlbi.pkt_in++;
+                    if( held ) {
+                        if( ::send(network->fd, &heldbuf[0], ntosend, MSG_EOR)!=ntosend ) {
+                            DEBUG(-1, "udpswriter: failed to send held back datagram - " <<
+                                    evlbi5a::strerror(errno) << " (" << errno << ")" << std::endl);
+                            stop = true;
+                            break;
+                        }
+                        held = false;
+                        evlbi.pkt_in++;
+                        evlbi.pkt_ooo++;
+                        evlbi.ooosum++;
+                    }
                 }
 #if 0
                 delta = ((int)now.tv_sec - (int)last.tv_sec)*1000000 + (int)now.tv_usec - (int)last.tv_usec;
@@ -781,6 +834,12 @@ void udpswriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
             }
         }
     }
+    // Whatever was held back still goes out, as if it were very late
+    if( held && !stop && ::send(network->fd, &heldbuf[0], ntosend, MSG_EOR)==ntosend ) {
+        evlbi.pkt_in++;
+        evlbi.pkt_ooo++;
+        evlbi.ooosum++;
+    }
     SYNCEXEC(args, delete network->threadid; network->threadid=0);
     DEBUG(0, "udpswriter: stopping. wrote "
              << nbyte << " (" << byteprint((double)nbyte, "byte") << ")"
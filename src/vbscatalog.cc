@@ -0,0 +1,705 @@
+// in-memory catalog of the FlexBuff recordings on the mountpoints
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <vbscatalog.h>
+#include <dirwalker.h>
+#include <evlbidebug.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <threadutil.h>
+#include <dosyscall.h>
+
+#include <set>
+#include <list>
+#include <vector>
+
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/poll.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+    #include <sys/inotify.h>
+#endif
+
+using namespace std;
+
+
+catalog_entry_type::catalog_entry_type():
+    nChunk( 0 ), nByte( 0 )
+{}
+
+
+// chunk number => size
+typedef map<unsigned int, uint64_t>  chunksizes_type;
+
+struct catrecording_type {
+    int              wd;       // inotify watch on the recording's directory
+    chunksizes_type  chunks;
+
+    catrecording_type():
+        wd( -1 )
+    {}
+};
+typedef map<string, catrecording_type>  catrecordings_type;
+
+struct catmountpoint_type {
+    int                  wd;         // inotify watch on the mountpoint
+    bool                 valid;      // everything's watched, contents are up to date
+    bool                 scanning;   // being walked
+    catrecordings_type   recordings;
+    mountpointinfo_type  space;
+    time_t               spaceTime;
+
+    catmountpoint_type():
+        wd( -1 ), valid( false ), scanning( false ), spaceTime( 0 )
+    {}
+};
+typedef map<string, catmountpoint_type>  catmountpoints_type;
+
+// What an inotify watch refers to. 'recording' is empty for the watch on
+// the mountpoint itself
+struct catwatch_type {
+    string   mountpoint;
+    string   recording;
+
+    catwatch_type()
+    {}
+    catwatch_type(const string& mp, const string& rec):
+        mountpoint( mp ), recording( rec )
+    {}
+};
+typedef map<int, catwatch_type>  catwatches_type;
+
+#if defined(__linux__)
+static const uint32_t  mpEvents  = IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR;
+static const uint32_t  recEvents = IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_CLOSE_WRITE|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR;
+#else
+static const uint32_t  mpEvents  = 0;
+static const uint32_t  recEvents = 0;
+#endif
+
+// Returns <0 if the path could not be watched
+static int add_watch(int ifd, const string& path, uint32_t mask) {
+#if defined(__linux__)
+    int   wd;
+
+    if( ifd<0 )
+        return -1;
+    if( (wd=::inotify_add_watch(ifd, path.c_str(), mask))<0 )
+        DEBUG(3, "vbscatalog: cannot watch " << path << " - " << evlbi5a::strerror(errno) << endl);
+    return wd;
+#else
+    (void)ifd; (void)path; (void)mask;
+    return -1;
+#endif
+}
+
+static void rm_watch(int ifd, int wd) {
+#if defined(__linux__)
+    if( ifd>=0 && wd>=0 )
+        ::inotify_rm_watch(ifd, wd);
+#else
+    (void)ifd; (void)wd;
+#endif
+}
+
+// Is 'name' "<rec>.<8 digits>"?
+static bool is_chunk(const string& rec, const char* name, unsigned int& n) {
+    const size_t  len = ::strlen(name);
+
+    if( len!=rec.size()+9 || rec.compare(0, string::npos, name, rec.size())!=0 || name[rec.size()]!='.' )
+        return false;
+    n = 0;
+    for(const char* p=name+rec.size()+1; *p; p++) {
+        if( *p<'0' || *p>'9' )
+            return false;
+        n = n*10 + (unsigned int)(*p-'0');
+    }
+    return true;
+}
+
+static string chunk_name(const string& rec, unsigned int n) {
+    char   seq[16];
+
+    ::snprintf(seq, sizeof(seq), ".%08u", n);
+    return rec+seq;
+}
+
+// Watch and read the chunks of one recording. Touches no shared state.
+// Returns false if the directory could not be watched.
+static bool scan_recording(int ifd, const string& mp, const string& rec,
+                           catrecording_type& cr, catwatches_type& watches) {
+    int                   eno;
+    const string          dir( mp+"/"+rec );
+    dirwalk_entries_type  entries;
+
+    // Start watching before reading so no changes go unnoticed
+    if( (cr.wd=add_watch(ifd, dir, recEvents))>=0 )
+        watches[ cr.wd ] = catwatch_type(mp, rec);
+    cr.chunks.clear();
+
+    if( (eno=dirwalk_read(dir, entries))!=0 ) {
+        DEBUG(3, "vbscatalog: cannot read " << dir << " - " << evlbi5a::strerror(eno) << endl);
+        return false;
+    }
+    for(dirwalk_entries_type::const_iterator p=entries.begin(); p!=entries.end(); p++) {
+        unsigned int  n;
+        struct stat   st;
+
+        if( is_chunk(rec, p->name.c_str(), n) && ::stat((dir+"/"+p->name).c_str(), &st)==0 )
+            cr.chunks[ n ] = (uint64_t)st.st_size;
+    }
+    return cr.wd>=0;
+}
+
+// Walking one mountpoint; one thread per mountpoint
+struct catscan_type {
+    const int           ifd;
+    const string        mountpoint;
+    catmountpoint_type  result;
+    catwatches_type     watches;
+
+    catscan_type(int fd, const string& mp):
+        ifd( fd ), mountpoint( mp )
+    {}
+};
+
+static void* scan_mountpoint(void* argptr) {
+    int                   eno;
+    bool                  valid;
+    catscan_type*         cs = (catscan_type*)argptr;
+    dirwalk_entries_type  entries;
+
+    if( (cs->result.wd=add_watch(cs->ifd, cs->mountpoint, mpEvents))>=0 )
+        cs->watches[ cs->result.wd ] = catwatch_type(cs->mountpoint, string());
+    valid = (cs->result.wd>=0);
+
+    if( (eno=dirwalk_read(cs->mountpoint, entries))!=0 ) {
+        DEBUG(-1, "vbscatalog: cannot read " << cs->mountpoint << " - " << evlbi5a::strerror(eno) << endl);
+        return (void*)0;
+    }
+    for(dirwalk_entries_type::const_iterator p=entries.begin(); p!=entries.end(); p++) {
+        if( p->name[0]=='.' || p->type!=DT_DIR )
+            continue;
+        if( !scan_recording(cs->ifd, cs->mountpoint, p->name, cs->result.recordings[p->name], cs->watches) )
+            valid = false;
+    }
+    cs->result.valid = valid;
+    return (void*)0;
+}
+
+
+// An inotify event that is kept until the walk that created its watch is
+// done
+struct catevent_type {
+    int       wd;
+    uint32_t  mask;
+    string    name;
+
+    catevent_type(int w, uint32_t m, const string& n):
+        wd( w ), mask( m ), name( n )
+    {}
+};
+typedef list<catevent_type>  catevents_type;
+
+// A chunk size reported by a writer
+struct catwritten_type {
+    string        mountpoint;
+    string        recording;
+    unsigned int  chunk;
+    uint64_t      size;
+
+    catwritten_type(const string& mp, const string& rec, unsigned int n, uint64_t sz):
+        mountpoint( mp ), recording( rec ), chunk( n ), size( sz )
+    {}
+};
+typedef list<catwritten_type>  catwrittens_type;
+
+// The catalog, all protected by the mutex. The watcher thread applies the
+// inotify events; it is started the first time the catalog is used.
+// Mountpoints are walked without the mutex held; their new watches are
+// only known after the walk, so until then the events that can't be placed
+// are kept in 'pending'. Writers only queue their chunk sizes, under
+// 'wmutex', for the watcher to apply; they never wait for a walk.
+struct catalog_type {
+    int                  ifd;
+    int                  stoppipe[2];
+    int                  wakepipe[2];
+    bool                 initialized;
+    bool                 started;
+    unsigned int         nScan;
+    pthread_t            watcher;
+    catmountpoints_type  mountpoints;
+    catwatches_type      watches;
+    catevents_type       pending;
+    pthread_mutex_t      mutex;
+    pthread_cond_t       condition;
+
+    // the writers' queue
+    bool                 accepting;
+    catwrittens_type     written;
+    pthread_mutex_t      wmutex;
+
+    catalog_type():
+        ifd( -1 ), initialized( false ), started( false ), nScan( 0 ), accepting( false )
+    {
+        stoppipe[0] = stoppipe[1] = -1;
+        wakepipe[0] = wakepipe[1] = -1;
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+        PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+        PTHREAD_CALL( ::pthread_mutex_init(&wmutex, 0) );
+    }
+
+    // (mutex must NOT be held) Make sure the mountpoints are in the
+    // catalog and up to date
+    void update(const mountpointlist_type& mps);
+
+    // (mutex must be held)
+    void handle(int wd, uint32_t mask, const string& name);
+
+    ~catalog_type() {
+        if( started ) {
+            if( ::write(stoppipe[1], "", 1)!=1 )
+                DEBUG(-1, "~catalog_type: failed to stop watcher - " << evlbi5a::strerror(errno) << endl);
+            ::pthread_join(watcher, 0);
+        }
+        if( ifd>=0 )
+            ::close( ifd );
+        for(unsigned int i=0; i<2; i++) {
+            if( stoppipe[i]>=0 )
+                ::close( stoppipe[i] );
+            if( wakepipe[i]>=0 )
+                ::close( wakepipe[i] );
+        }
+        ::pthread_mutex_destroy(&wmutex);
+        ::pthread_cond_destroy(&condition);
+        ::pthread_mutex_destroy(&mutex);
+    }
+};
+
+static catalog_type  catalog;
+
+// Apply the chunk sizes the writers queued (mutex must be held)
+static void apply_written(catwrittens_type& cw) {
+    for(catwrittens_type::const_iterator w=cw.begin(); w!=cw.end(); w++) {
+        catmountpoints_type::iterator  mptr = catalog.mountpoints.find( w->mountpoint );
+
+        if( mptr==catalog.mountpoints.end() || !mptr->second.valid )
+            continue;
+        // If the recording isn't there yet, the watcher will find it
+        catrecordings_type::iterator   rptr = mptr->second.recordings.find( w->recording );
+        if( rptr!=mptr->second.recordings.end() )
+            rptr->second.chunks[ w->chunk ] = w->size;
+    }
+}
+
+#if defined(__linux__)
+static void* catalog_watcher(void*) {
+    // inotify_events must be aligned; a vector of uint64_t is
+    vector<uint64_t>  buffer( 8192 );
+    char* const       buf = (char*)&buffer[0];
+    const size_t      bufsize = buffer.size()*sizeof(uint64_t);
+
+    DEBUG(3, "catalog_watcher: starting" << endl);
+    while( true ) {
+        ssize_t        n = 0;
+        struct pollfd  pfd[3];
+
+        pfd[0].fd     = catalog.ifd;
+        pfd[0].events = POLLIN;
+        pfd[1].fd     = catalog.stoppipe[0];
+        pfd[1].events = POLLIN;
+        pfd[2].fd     = catalog.wakepipe[0];
+        pfd[2].events = POLLIN;
+        if( ::poll(pfd, 3, -1)<0 ) {
+            if( errno==EINTR )
+                continue;
+            DEBUG(-1, "catalog_watcher: poll fails - " << evlbi5a::strerror(errno) << endl);
+            break;
+        }
+        if( pfd[1].revents )
+            break;
+        if( pfd[0].revents && (n=::read(catalog.ifd, buf, bufsize))<=0 ) {
+            if( n<0 && (errno==EINTR || errno==EAGAIN) )
+                continue;
+            DEBUG(-1, "catalog_watcher: read fails - " << evlbi5a::strerror(errno) << endl);
+            break;
+        }
+        catwrittens_type   cw;
+
+        if( pfd[2].revents ) {
+            char   dummy[64];
+
+            while( ::read(catalog.wakepipe[0], dummy, sizeof(dummy))>0 ) { }
+            mutex_locker   wlocker( catalog.wmutex );
+            cw.swap( catalog.written );
+        }
+
+        mutex_locker   locker( catalog.mutex );
+        for(char* p=buf; p<buf+n; ) {
+            const struct inotify_event*  ev = (const struct inotify_event*)p;
+            const string                 name( ev->len ? ev->name : "" );
+
+            // The watch may be one of a walk that's not finished yet
+            if( catalog.nScan && (ev->mask & IN_Q_OVERFLOW)==0 && catalog.watches.find(ev->wd)==catalog.watches.end() )
+                catalog.pending.push_back( catevent_type(ev->wd, ev->mask, name) );
+            else
+                catalog.handle( ev->wd, ev->mask, name );
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        apply_written( cw );
+    }
+    {
+        mutex_locker   wlocker( catalog.wmutex );
+        catalog.accepting = false;
+        catalog.written.clear();
+    }
+    // Without watcher nothing can be trusted anymore
+    mutex_locker   locker( catalog.mutex );
+    for(catmountpoints_type::iterator p=catalog.mountpoints.begin(); p!=catalog.mountpoints.end(); p++)
+        p->second.valid = false;
+    ::close( catalog.ifd );
+    catalog.ifd = -1;
+    DEBUG(3, "catalog_watcher: done" << endl);
+    return (void*)0;
+}
+
+void catalog_type::handle(int wd, uint32_t mask, const string& name) {
+    // Events were lost - walk everything again when asked
+    if( mask & IN_Q_OVERFLOW ) {
+        DEBUG(2, "vbscatalog: inotify queue overflow, rescanning all mountpoints" << endl);
+        for(catmountpoints_type::iterator p=mountpoints.begin(); p!=mountpoints.end(); p++)
+            p->second.valid = false;
+        return;
+    }
+    catwatches_type::iterator  wptr = watches.find( wd );
+
+    if( wptr==watches.end() )
+        return;
+
+    // take a copy; the watch may be erased
+    const catwatch_type            cw( wptr->second );
+    catmountpoints_type::iterator  mptr = mountpoints.find( cw.mountpoint );
+
+    if( mask & IN_IGNORED ) {
+        watches.erase( wptr );
+        if( mptr==mountpoints.end() )
+            return;
+        if( cw.recording.empty() ) {
+            mptr->second.wd    = -1;
+            mptr->second.valid = false;
+        } else {
+            catrecordings_type::iterator  rptr = mptr->second.recordings.find( cw.recording );
+            if( rptr!=mptr->second.recordings.end() && rptr->second.wd==wd )
+                mptr->second.recordings.erase( rptr );
+        }
+        return;
+    }
+    if( mptr==mountpoints.end() )
+        return;
+
+    catmountpoint_type&  mp( mptr->second );
+
+    // Something happened to the mountpoint or one of the recordings in it
+    if( cw.recording.empty() ) {
+        if( mask & (IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT) ) {
+            mp.valid = false;
+            return;
+        }
+        if( (mask & IN_ISDIR)==0 || name.empty() || name[0]=='.' )
+            return;
+
+        if( mask & (IN_CREATE|IN_MOVED_TO) ) {
+            catwatches_type  nw;
+
+            if( !scan_recording(ifd, cw.mountpoint, name, mp.recordings[name], nw) )
+                mp.valid = false;
+            for(catwatches_type::const_iterator p=nw.begin(); p!=nw.end(); p++)
+                watches[ p->first ] = p->second;
+        } else if( mask & (IN_DELETE|IN_MOVED_FROM) ) {
+            catrecordings_type::iterator  rptr = mp.recordings.find( name );
+
+            if( rptr==mp.recordings.end() )
+                return;
+            // A moved directory keeps its watch
+            if( mask & IN_MOVED_FROM )
+                rm_watch(ifd, rptr->second.wd);
+            mp.recordings.erase( rptr );
+        }
+        return;
+    }
+
+    // Chunks of a recording
+    unsigned int                  n;
+    catrecordings_type::iterator  rptr = mp.recordings.find( cw.recording );
+
+    if( rptr==mp.recordings.end() || rptr->second.wd!=wd )
+        return;
+    if( mask & (IN_DELETE_SELF|IN_MOVE_SELF) ) {
+        if( mask & IN_MOVE_SELF )
+            rm_watch(ifd, rptr->second.wd);
+        mp.recordings.erase( rptr );
+        return;
+    }
+    if( !is_chunk(cw.recording, name.c_str(), n) )
+        return;
+    if( mask & (IN_DELETE|IN_MOVED_FROM) ) {
+        rptr->second.chunks.erase( n );
+    } else if( mask & (IN_CREATE|IN_MOVED_TO|IN_CLOSE_WRITE) ) {
+        struct stat   st;
+
+        if( ::stat((cw.mountpoint+"/"+cw.recording+"/"+name).c_str(), &st)==0 )
+            rptr->second.chunks[ n ] = (uint64_t)st.st_size;
+        else
+            rptr->second.chunks.erase( n );
+    }
+}
+#else
+void catalog_type::handle(int, uint32_t, const string&) { }
+#endif
+
+void catalog_type::update(const mountpointlist_type& mps) {
+    typedef list<catscan_type*>  scans_type;
+    typedef list<pthread_t>      tids_type;
+    scans_type   scans;
+    tids_type    tids;
+
+    {
+        mutex_locker   locker( mutex );
+#if defined(__linux__)
+        // Start watching; if that fails the mountpoints are walked on every
+        // query
+        if( !initialized ) {
+            initialized = true;
+            if( (ifd=::inotify_init())<0 ) {
+                DEBUG(-1, "vbscatalog: inotify_init fails - " << evlbi5a::strerror(errno) << endl);
+            } else if( ::pipe(stoppipe)!=0 || ::pipe(wakepipe)!=0 ||
+                       ::fcntl(wakepipe[0], F_SETFL, O_NONBLOCK)!=0 || ::fcntl(wakepipe[1], F_SETFL, O_NONBLOCK)!=0 ||
+                       ::mp_pthread_create(&watcher, &catalog_watcher, 0)!=0 ) {
+                DEBUG(-1, "vbscatalog: failed to start watcher" << endl);
+                ::close( ifd );
+                ifd = -1;
+            } else {
+                mutex_locker   wlocker( wmutex );
+                started   = true;
+                accepting = true;
+            }
+        }
+#endif
+        for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+            if( *mp==noMountpoint )
+                continue;
+            catmountpoint_type&  mpc( mountpoints[*mp] );
+
+            if( !mpc.valid && !mpc.scanning ) {
+                mpc.scanning = true;
+                scans.push_back( new catscan_type(ifd, *mp) );
+            }
+        }
+        nScan += scans.size();
+    }
+
+    // Walk the mountpoints in parallel
+    for(scans_type::iterator p=scans.begin(); p!=scans.end(); p++) {
+        pthread_t   tid;
+
+        if( scans.size()>1 && ::mp_pthread_create(&tid, &scan_mountpoint, *p)==0 )
+            tids.push_back( tid );
+        else
+            scan_mountpoint( *p );
+    }
+    for(tids_type::iterator p=tids.begin(); p!=tids.end(); p++)
+        ::pthread_join(*p, 0);
+
+    mutex_locker   locker( mutex );
+    for(scans_type::iterator p=scans.begin(); p!=scans.end(); p++) {
+        catscan_type*        cs = *p;
+        catmountpoint_type&  mp( mountpoints[cs->mountpoint] );
+
+        // Forget the old watches of this mountpoint
+        for(catwatches_type::iterator w=watches.begin(); w!=watches.end(); )
+            if( w->second.mountpoint==cs->mountpoint )
+                watches.erase( w++ );
+            else
+                w++;
+        for(catwatches_type::const_iterator w=cs->watches.begin(); w!=cs->watches.end(); w++)
+            watches[ w->first ] = w->second;
+
+        DEBUG(3, "vbscatalog: " << cs->mountpoint << " has " << cs->result.recordings.size() << " recordings"
+                 << (cs->result.valid ? "" : " [not watched]") << endl);
+        mp.wd       = cs->result.wd;
+        mp.valid    = cs->result.valid;
+        mp.scanning = false;
+        mp.recordings.swap( cs->result.recordings );
+        delete cs;
+    }
+    nScan -= scans.size();
+
+    // What happened while walking can be placed now
+    if( nScan==0 ) {
+        catevents_type   evs;
+
+        evs.swap( pending );
+        for(catevents_type::const_iterator e=evs.begin(); e!=evs.end(); e++)
+            handle(e->wd, e->mask, e->name);
+    }
+    if( !scans.empty() )
+        PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+
+    // Mountpoints someone else is walking must be done before we look
+    while( true ) {
+        mountpointlist_type::const_iterator  mp;
+
+        for(mp=mps.begin(); mp!=mps.end(); mp++) {
+            catmountpoints_type::const_iterator  mptr = mountpoints.find( *mp );
+
+            if( mptr!=mountpoints.end() && mptr->second.scanning )
+                break;
+        }
+        if( mp==mps.end() )
+            break;
+        PTHREAD_CALL( ::pthread_cond_wait(&condition, &mutex) );
+    }
+}
+
+
+catalog_listing_type catalog_recordings(const mountpointlist_type& mps) {
+    catalog_listing_type  rv;
+
+    catalog.update( mps );
+
+    mutex_locker   locker( catalog.mutex );
+    for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+        catmountpoints_type::const_iterator  mptr = catalog.mountpoints.find( *mp );
+
+        if( mptr==catalog.mountpoints.end() )
+            continue;
+        for(catrecordings_type::const_iterator r=mptr->second.recordings.begin(); r!=mptr->second.recordings.end(); r++) {
+            if( r->second.chunks.empty() )
+                continue;
+            catalog_entry_type&  entry( rv[r->first] );
+
+            entry.nChunk += r->second.chunks.size();
+            for(chunksizes_type::const_iterator c=r->second.chunks.begin(); c!=r->second.chunks.end(); c++)
+                entry.nByte += c->second;
+        }
+    }
+    return rv;
+}
+
+filelist_type catalog_chunks(const string& recording, const mountpointlist_type& mps) {
+    filelist_type  rv;
+
+    catalog.update( mps );
+
+    mutex_locker   locker( catalog.mutex );
+    for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+        catmountpoints_type::const_iterator  mptr = catalog.mountpoints.find( *mp );
+
+        if( mptr==catalog.mountpoints.end() )
+            continue;
+
+        catrecordings_type::const_iterator   rptr = mptr->second.recordings.find( recording );
+
+        if( rptr==mptr->second.recordings.end() )
+            continue;
+        for(chunksizes_type::const_iterator c=rptr->second.chunks.begin(); c!=rptr->second.chunks.end(); c++)
+            rv.push_back( *mp+"/"+recording+"/"+chunk_name(recording, c->first) );
+    }
+    return rv;
+}
+
+int catalog_nrecording(const mountpointlist_type& mps) {
+    set<string>    recordings;
+    mutex_locker   locker( catalog.mutex );
+
+    for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+        if( *mp==noMountpoint )
+            continue;
+        catmountpoints_type::const_iterator  mptr = catalog.mountpoints.find( *mp );
+
+        if( mptr==catalog.mountpoints.end() || !mptr->second.valid )
+            return -1;
+        for(catrecordings_type::const_iterator r=mptr->second.recordings.begin(); r!=mptr->second.recordings.end(); r++)
+            if( !r->second.chunks.empty() )
+                recordings.insert( r->first );
+    }
+    return (int)recordings.size();
+}
+
+mountpointinfo_type catalog_space(const mountpointlist_type& mps) {
+    const time_t         now = ::time(0);
+    mountpointinfo_type  rv;
+    mountpointlist_type  stale;
+
+    {
+        mutex_locker   locker( catalog.mutex );
+
+        for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++)
+            if( *mp!=noMountpoint && catalog.mountpoints[*mp].spaceTime!=now )
+                stale.insert( *mp );
+    }
+    // statvfs(3) may take long on a disk that's in trouble
+    map<string, mountpointinfo_type>  fresh;
+
+    for(mountpointlist_type::const_iterator mp=stale.begin(); mp!=stale.end(); mp++)
+        fresh[*mp] = statmountpoint( *mp );
+
+    mutex_locker   locker( catalog.mutex );
+    for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+        if( *mp==noMountpoint )
+            continue;
+        catmountpoint_type&                               mpc( catalog.mountpoints[*mp] );
+        map<string, mountpointinfo_type>::const_iterator  f = fresh.find( *mp );
+
+        if( f!=fresh.end() ) {
+            mpc.space     = f->second;
+            mpc.spaceTime = now;
+        }
+        rv.f_size += mpc.space.f_size;
+        rv.f_free += mpc.space.f_free;
+    }
+    return rv;
+}
+
+void catalog_chunk_written(const string& mountpoint, const string& relpath, uint64_t size) {
+    unsigned int            n;
+    const string::size_type slash = relpath.find('/');
+
+    if( slash==string::npos )
+        return;
+
+    const string  rec( relpath.substr(0, slash) );
+
+    if( !is_chunk(rec, relpath.c_str()+slash+1, n) )
+        return;
+
+    // Only wake up the watcher for the first one it hasn't seen yet
+    mutex_locker   locker( catalog.wmutex );
+
+    if( !catalog.accepting )
+        return;
+    catalog.written.push_back( catwritten_type(mountpoint, rec, n, size) );
+    if( catalog.written.size()==1 && ::write(catalog.wakepipe[1], "", 1)<0 && errno!=EAGAIN )
+        DEBUG(-1, "catalog_chunk_written: failed to wake up watcher - " << evlbi5a::strerror(errno) << endl);
+}
@@ -0,0 +1,72 @@
+// in-memory catalog of the FlexBuff recordings on the mountpoints
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_VBSCATALOG_H
+#define JIVE5AB_VBSCATALOG_H
+
+#include <mountpoint.h>
+
+#include <map>
+#include <string>
+
+#include <stdint.h>
+
+// Walking tens of disks with hundreds of thousands of chunk files on every
+// listing or chunk lookup is slow and hammers the disks' metadata while
+// recording. The catalog walks each mountpoint once, the first time it is
+// asked about, and keeps the recordings, their chunks and the chunk sizes
+// in memory. On Linux inotify(7) keeps it current; the writers of jive5ab
+// itself tell it the sizes of the chunks they've written. The mountpoints
+// are walked without holding the catalog's lock, so the writers and
+// queries about other mountpoints are not held up.
+//
+// If a mountpoint can not be watched (no inotify or out of watches) it is
+// walked again on each query, as before. Free space is taken from
+// statvfs(3), at most once per second per mountpoint.
+//
+// Only FlexBuff recordings are in the catalog (<mountpoint>/<rec>/<rec>.<8 digits>)
+struct catalog_entry_type {
+    unsigned int   nChunk;
+    uint64_t       nByte;
+
+    catalog_entry_type();
+};
+typedef std::map<std::string, catalog_entry_type>  catalog_listing_type;
+
+// All recordings found on the mountpoints, with the number of chunks and
+// total size over all of them
+catalog_listing_type catalog_recordings(const mountpointlist_type& mps);
+
+// Full paths of the chunks of the recording on the mountpoints. Same
+// result as find_recordingchunks()
+filelist_type        catalog_chunks(const std::string& recording, const mountpointlist_type& mps);
+
+// Number of recordings on the mountpoints if the catalog has all of them
+// up to date, <0 otherwise. Does not walk the mountpoints
+int                  catalog_nrecording(const mountpointlist_type& mps);
+
+// Total and free space of the mountpoints
+mountpointinfo_type  catalog_space(const mountpointlist_type& mps);
+
+// Writers call this when they've written 'size' bytes to
+// <mountpoint>/<relpath>. Never waits for a walk of the mountpoints; the
+// catalog is updated in the background
+void                 catalog_chunk_written(const std::string& mountpoint, const std::string& relpath, uint64_t size);
+
+#endif
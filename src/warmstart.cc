@@ -0,0 +1,321 @@
+// getting transfers up to speed quickly
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <warmstart.h>
+#include <runtime.h>
+#include <chainstats.h>
+#include <pthreadcall.h>
+#include <mutex_locker.h>
+#include <evlbidebug.h>
+
+#include <map>
+#include <list>
+#include <iostream>
+#include <algorithm>
+
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+using namespace std;
+
+static double delta_t(const struct timeval& a, const struct timeval& b) {
+    return (double)(b.tv_sec - a.tv_sec) + (double)(b.tv_usec - a.tv_usec)/1.0e6;
+}
+
+//
+// The pool memory cache
+//
+typedef multimap<uint64_t, unsigned char*>  warmcache_type;
+
+static pthread_mutex_t   warmcache_lock = PTHREAD_MUTEX_INITIALIZER;
+static warmcache_type    warmcache;
+static warmstart_parms   warmparms;
+static warmcache_stats   warmstats;
+
+warmstart_parms::warmstart_parms():
+    enabled( false ), maxCached( 4096ull*1024*1024 )
+{}
+
+warmcache_stats::warmcache_stats():
+    nByte( 0 ), nPool( 0 ), nHit( 0 ), nMiss( 0 )
+{}
+
+// Write one byte in each page so it's there when the data comes
+static void touch(unsigned char* p, uint64_t n) {
+    const long  pagesize = ::sysconf(_SC_PAGESIZE);
+    const uint64_t  step = (uint64_t)(pagesize>0 ? pagesize : 4096);
+
+    for(uint64_t i=0; i<n; i+=step)
+        p[i] = 0;
+}
+
+void warmstart_set_parms(const warmstart_parms& p) {
+    list<unsigned char*>  tofree;
+    {
+        mutex_locker   locker( warmcache_lock );
+
+        warmparms = p;
+        // Drop what no longer fits
+        while( !warmcache.empty() && (!warmparms.enabled || warmstats.nByte>warmparms.maxCached) ) {
+            warmcache_type::iterator  last = warmcache.end();
+
+            --last;
+            warmstats.nByte -= last->first;
+            warmstats.nPool--;
+            tofree.push_back( last->second );
+            warmcache.erase( last );
+        }
+    }
+    for(list<unsigned char*>::iterator m=tofree.begin(); m!=tofree.end(); m++)
+        delete [] *m;
+}
+
+warmstart_parms warmstart_get_parms( void ) {
+    mutex_locker   locker( warmcache_lock );
+    return warmparms;
+}
+
+unsigned char* warm_alloc(uint64_t n) {
+    bool            enabled;
+    unsigned char*  p;
+    {
+        mutex_locker              locker( warmcache_lock );
+        warmcache_type::iterator  cached = warmcache.find( n );
+
+        if( (enabled=warmparms.enabled)==true ) {
+            if( cached!=warmcache.end() ) {
+                p = cached->second;
+                warmstats.nByte -= n;
+                warmstats.nPool--;
+                warmstats.nHit++;
+                warmcache.erase( cached );
+                return p;
+            }
+            warmstats.nMiss++;
+        }
+    }
+    p = new unsigned char[ n ];
+    if( enabled )
+        touch(p, n);
+    return p;
+}
+
+void warm_free(unsigned char* p, uint64_t n) {
+    {
+        mutex_locker   locker( warmcache_lock );
+
+        if( warmparms.enabled && warmstats.nByte+n<=warmparms.maxCached ) {
+            warmcache.insert( make_pair(n, p) );
+            warmstats.nByte += n;
+            warmstats.nPool++;
+            return;
+        }
+    }
+    delete [] p;
+}
+
+unsigned int warm_prefault(uint64_t n, unsigned int npool) {
+    unsigned int  kept = 0;
+
+    for( ; kept<npool; kept++) {
+        {
+            mutex_locker   locker( warmcache_lock );
+            if( !warmparms.enabled || warmstats.nByte+n>warmparms.maxCached )
+                break;
+        }
+        unsigned char*  p = new unsigned char[ n ];
+
+        touch(p, n);
+        {
+            mutex_locker   locker( warmcache_lock );
+
+            // parameters may have changed in the mean time
+            if( !warmparms.enabled || warmstats.nByte+n>warmparms.maxCached ) {
+                delete [] p;
+                break;
+            }
+            warmcache.insert( make_pair(n, p) );
+            warmstats.nByte += n;
+            warmstats.nPool++;
+        }
+    }
+    return kept;
+}
+
+warmcache_stats warm_cache_stats( void ) {
+    mutex_locker   locker( warmcache_lock );
+    return warmstats;
+}
+
+
+//
+// Measuring the time to steady state
+//
+static const double        rampInterval = 0.1;     // seconds between samples
+static const unsigned int  rampNWindow  = 5;       // this many samples
+static const double        rampSpread   = 0.1;     // within this fraction of their average
+static const double        rampTimeout  = 120.0;   // give up after this many seconds
+
+ramp_type::ramp_type():
+    firstData( -1.0 ), steady( -1.0 ), rate( 0.0 ), done( false )
+{}
+
+struct rampstate_type {
+    ramp_type       ramp;
+    struct timeval  start, last;
+    int64_t         lastCount;
+    unsigned int    nRate;
+    double          rate[ rampNWindow ];
+    double          since[ rampNWindow ];   // the sample's window started this long after start
+
+    rampstate_type():
+        lastCount( 0 ), nRate( 0 )
+    {
+        ::gettimeofday(&start, 0);
+        last = start;
+    }
+};
+
+typedef map<runtime*, rampstate_type>  rampmap_type;
+
+static pthread_mutex_t   ramp_lock = PTHREAD_MUTEX_INITIALIZER;
+static rampmap_type      ramps;
+static bool              rampMonitorRunning = false;
+
+// The counter of the last step in the chain that keeps one. The steps add
+// theirs while we look; the copy is made under the statistics' own lock
+static int64_t last_step_count(const runtime& rte) {
+    int64_t                rv = 0;
+    const chainstats_type  stats( rte.statistics );
+
+    for(chainstats_type::const_iterator p=stats.begin(); p!=stats.end(); p++)
+        rv = p->second.value();
+    return rv;
+}
+
+static void sample(runtime* rteptr, rampstate_type& rs, const struct timeval& now) {
+    int64_t       count;
+    const double  dt = delta_t(rs.last, now);
+    const double  t  = delta_t(rs.start, now);
+
+    count = last_step_count(*rteptr);
+
+    // a new chain may have been built and not announced yet
+    if( count<rs.lastCount )
+        rs.lastCount = 0;
+
+    if( count>0 && rs.ramp.firstData<0.0 )
+        rs.ramp.firstData = t;
+
+    if( dt>0.0 ) {
+        if( rs.nRate==rampNWindow ) {
+            std::copy(&rs.rate[1], &rs.rate[rampNWindow], &rs.rate[0]);
+            std::copy(&rs.since[1], &rs.since[rampNWindow], &rs.since[0]);
+            rs.nRate--;
+        }
+        rs.rate[ rs.nRate ]  = (double)(count - rs.lastCount)/dt;
+        rs.since[ rs.nRate ] = t - dt;
+        rs.nRate++;
+    }
+    rs.lastCount = count;
+    rs.last      = now;
+
+    if( rs.nRate==rampNWindow ) {
+        double  avg = 0.0;
+        bool    steady;
+
+        for(unsigned int i=0; i<rs.nRate; i++)
+            avg += rs.rate[i];
+        avg    /= rs.nRate;
+        steady  = (avg>0.0);
+        for(unsigned int i=0; steady && i<rs.nRate; i++)
+            steady = (::fabs(rs.rate[i]-avg)<=rampSpread*avg);
+
+        if( steady ) {
+            rs.ramp.steady = rs.since[0];
+            rs.ramp.rate   = avg;
+            rs.ramp.done   = true;
+            DEBUG(1, rteptr->name << ": steady at " << avg/1.0e6 << "MB/s after " << rs.ramp.steady << "s"
+                     << " (first data after " << rs.ramp.firstData << "s)" << endl);
+            return;
+        }
+    }
+    if( t>rampTimeout ) {
+        rs.ramp.done = true;
+        DEBUG(1, rteptr->name << ": no steady rate after " << t << "s" << endl);
+    }
+}
+
+// Runs while there are measurements to do; ramp_begin() starts it again
+static void* ramp_monitor(void*) {
+    const struct timespec  ts = { 0, (long)(rampInterval*1.0e9) };
+
+    while( true ) {
+        ::nanosleep(&ts, 0);
+
+        bool            pending = false;
+        struct timeval  now;
+        mutex_locker    locker( ramp_lock );
+
+        ::gettimeofday(&now, 0);
+        for(rampmap_type::iterator p=ramps.begin(); p!=ramps.end(); p++) {
+            if( p->second.ramp.done )
+                continue;
+            sample(p->first, p->second, now);
+            pending = (pending || !p->second.ramp.done);
+        }
+        if( !pending ) {
+            rampMonitorRunning = false;
+            break;
+        }
+    }
+    return 0;
+}
+
+void ramp_begin(runtime* rteptr) {
+    mutex_locker   locker( ramp_lock );
+
+    ramps[ rteptr ] = rampstate_type();
+    if( !rampMonitorRunning ) {
+        pthread_t       tid;
+        pthread_attr_t  attr;
+
+        PTHREAD_CALL( ::pthread_attr_init(&attr) );
+        PTHREAD_CALL( ::pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) );
+        PTHREAD_CALL( ::pthread_create(&tid, &attr, ramp_monitor, 0) );
+        PTHREAD_CALL( ::pthread_attr_destroy(&attr) );
+        rampMonitorRunning = true;
+    }
+}
+
+void ramp_forget(runtime* rteptr) {
+    mutex_locker   locker( ramp_lock );
+    ramps.erase( rteptr );
+}
+
+bool ramp_get(runtime* rteptr, ramp_type& r) {
+    mutex_locker            locker( ramp_lock );
+    rampmap_type::iterator  p = ramps.find( rteptr );
+
+    if( p==ramps.end() )
+        return false;
+    r = p->second.ramp;
+    return true;
+}
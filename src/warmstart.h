@@ -0,0 +1,92 @@
+// getting transfers up to speed quickly
+// Copyright (C) 2007-2010 Harro Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Harro Verkouter - verkouter@jive.nl
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5AB_WARMSTART_H
+#define JIVE5AB_WARMSTART_H
+
+#include <string>
+
+#include <stdint.h>
+
+// At the start of a transfer the steps create their block pools. The
+// memory of those is fresh: the first time each page is written to it
+// must be faulted in, which on multi-GB configurations may take long
+// enough to lose packets in the first seconds of a scan.
+//
+// With warm start enabled the memory of pools that are no longer in use
+// is kept, up to a maximum, and given to the next pool of exactly the
+// same size - typically the same step of the next transfer with the same
+// settings. Freshly allocated pool memory is touched before use and
+// pools can be pre-allocated before the first transfer (warm_prefault).
+//
+// Without warm start pool memory is allocated and freed as it always
+// was.
+struct warmstart_parms {
+    bool      enabled;
+    uint64_t  maxCached;    // bytes
+
+    // defaults: disabled, 4GB
+    warmstart_parms();
+};
+
+void            warmstart_set_parms(const warmstart_parms& p);
+warmstart_parms warmstart_get_parms( void );
+
+// Memory for a block pool of 'n' bytes, allocated with new []
+unsigned char*  warm_alloc(uint64_t n);
+// Give back memory obtained from warm_alloc(n)
+void            warm_free(unsigned char* p, uint64_t n);
+// Allocate and touch 'npool' pools of 'n' bytes and keep them. Returns
+// how many were kept; fewer than requested if the maximum was reached
+unsigned int    warm_prefault(uint64_t n, unsigned int npool);
+
+struct warmcache_stats {
+    uint64_t      nByte;
+    unsigned int  nPool;
+    uint64_t      nHit, nMiss;
+
+    warmcache_stats();
+};
+warmcache_stats warm_cache_stats( void );
+
+
+// How long it takes from starting a transfer until data flows at a
+// steady rate. Call ramp_begin() right after the runtime's processing
+// chain was started; from then on the counter of the last step of the
+// chain is sampled every 100ms. The rate is steady when five consecutive
+// samples are within 10% of their average; this is logged and can be
+// retrieved with ramp_get(). Measuring gives up after two minutes.
+struct runtime;
+
+struct ramp_type {
+    double  firstData;      // seconds after start, <0 if not (yet)
+    double  steady;         // seconds after start, <0 if not (yet)
+    double  rate;           // bytes/s once steady
+    bool    done;           // no longer measuring
+
+    ramp_type();
+};
+
+void ramp_begin(runtime* rteptr);
+// ~runtime() must call this
+void ramp_forget(runtime* rteptr);
+// false if no transfer was ever started on 'rteptr'
+bool ramp_get(runtime* rteptr, ramp_type& r);
+
+#endif